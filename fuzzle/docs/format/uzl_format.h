@@ -21,6 +21,105 @@ following format.
    |         ----------------
    |         |  REG_RECORD  | Register Record
    --------> ----------------
+
+Version 0x0001 stores the records uncompressed so the file can be mapped into
+memory. Each name is written before its data and the data starts on a page
+(0x1000) aligned file offset.
+
+             ----------------
+             |      UZL     | Magic ('UZL' - 0x555a4c)
+             ----------------
+             |      HDR     | Header
+             ----------------
+             | MEM_RECORD 0 | Memory Record
+             ----------------
+             |     Name     | Optional String Name
+             ----------------
+             |    Padding   | Zeroes up to the next page boundary
+             ----------------
+             |     Data     | Page aligned
+             ----------------
+             | MEM_RECORD N | Memory Record
+             ----------------
+             |     Name     | Optional String Name
+             ----------------
+             |    Padding   | Zeroes up to the next page boundary
+             ----------------
+             |     Data     | Page aligned
+             ----------------
+             |  REG_RECORD  | Register Record
+             ----------------
+
+Version 0x0001 writes records holding zero pages as sparse memory records
+(type 0x0003). The page bitmap has a bit per page, set for the pages that are
+stored after the padding. Missing pages are zero.
+
+             ----------------
+             | SPARSE REC 0 | Sparse Memory Record
+             ----------------
+             |     Name     | Optional String Name
+             ----------------
+             |  Page Count  | 8 bytes
+             ----------------
+             |    Bitmap    | 1 bit per page
+             ----------------
+             |    Padding   | Zeroes up to the next page boundary
+             ----------------
+             |    Pages     | Non-zero pages only
+             ----------------
+
+With a page pool attached, version 0x0001 writes pooled memory records (type
+0x0004) that reference pages stored once in a shared pool file. Slot 0 is a
+page of zeroes.
+
+             ----------------
+             |  POOL REC 0  | Pooled Memory Record
+             ----------------
+             |     Name     | Optional String Name
+             ----------------
+             |    Pool ID   | 8 bytes
+             ----------------
+             |  Page Count  | 8 bytes
+             ----------------
+             |  Page Index  | Slot and FNV-1a hash, 8 bytes each per page
+             ----------------
+
+Page pool file, slot N is stored at offset N * 0x1000:
+
+             ----------------
+             |      PZP     | Magic, version, pool ID and page count
+             ----------------
+             |    Page 1    |
+             ----------------
+             |      ...     |
+             ----------------
+
+Version 0x0002 compresses every memory record on its own in chunks of the
+header's chunk size. A chunk index of compressed sizes lets a loader inflate
+any single chunk. A size of zero marks a chunk of zeroes and a size equal to
+the uncompressed length marks a chunk stored raw.
+
+             ----------------
+             |      UZL     | Magic ('UZL' - 0x555a4c)
+             ----------------
+             |      HDR     | Header
+             ----------------
+             | MEM_RECORD 0 | Memory Record
+             ----------------
+             |     Name     | Optional String Name
+             ----------------
+             |  Chunk Count | 8 bytes
+             ----------------
+             |  Chunk Index | 8 bytes per chunk
+             ----------------
+             |    Chunks    | DEFLATE streams
+             ----------------
+             | MEM_RECORD N | Memory Record
+             ----------------
+             |      ...     |
+             ----------------
+             |  REG_RECORD  | Register Record
+             ----------------
 */
 
 typedef enum arch_enum
@@ -50,6 +149,12 @@ Header TLV
 ----------------------
 | 0x0000000000000000 | Data Size
 ----------------------
+| 0x0000000000010000 | Chunk Size (version 0x0002 only)
+----------------------
+|        0x01        | Codec, 0 none, 1 DEFLATE (version 0x0002 only)
+----------------------
+|        0x06        | Level (version 0x0002 only)
+----------------------
 */
 typedef struct hdr_struct
 {
@@ -58,6 +163,9 @@ typedef struct hdr_struct
     uint16_t version;
     arch_t arch;
     uint64_t data_size;
+    uint64_t chk_size;
+    uint8_t codec;
+    uint8_t level;
 } hdr_rec_t;
 
 /*
@@ -98,7 +206,6 @@ typedef struct mem_rec_struct
     uint64_t str_size;
     uint8_t *dat;
     uint8_t *str;
-    struct mem_rec_struct *next;
 } mem_rec_t;
 
 /*
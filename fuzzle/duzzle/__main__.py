@@ -4,9 +4,11 @@ import argparse
 import importlib
 
 from fuzzle import pypzl
-from fuzzle.duzzle.core.utils import dprint, read_file_bytes
+from fuzzle.duzzle.core.utils import dprint
 from fuzzle.duzzle.core.context import DuzzleContext
 
+# Segment data read per transfer when streaming
+STREAM_READ_SIZE = 0x100000
 
 def main(duzzle=DuzzleContext()):
     """
@@ -27,7 +29,7 @@ def main(duzzle=DuzzleContext()):
     parser.add_argument('--arch',
                         '-a',
                         required=True,
-                        help='Target architecture [x86_64]')
+                        help='Target architecture [x86_64, arm, aarch64, mips]')
     parser.add_argument('--breakpoint',
                         '-b',
                         required=True,
@@ -36,6 +38,28 @@ def main(duzzle=DuzzleContext()):
                         '-o',
                         required=True,
                         help='Output file path to write packed UZL file')
+    parser.add_argument('--format',
+                        choices=['deflate', 'mmap', 'chunked'],
+                        default='deflate',
+                        help='UZL layout, mmap is uncompressed and page aligned, '
+                             'chunked compresses each region in chunks')
+    parser.add_argument('--pool',
+                        '-p',
+                        help='Page pool shared between snapshots, implies --format mmap')
+    parser.add_argument('--file-refs',
+                        action='store_true',
+                        help='Reference unmodified pages of mapped files instead of '
+                             'storing them, implies --format mmap')
+    parser.add_argument('--level',
+                        type=int,
+                        choices=range(0, 10),
+                        default=6,
+                        help='Chunk compression level, 0 stores chunks raw [6]')
+    parser.add_argument('--threads',
+                        '-j',
+                        type=int,
+                        default=0,
+                        help='Compression workers, 0 uses every CPU [0]')
     parser.add_argument('--follow-child',
                         '-f',
                         action='store_true',
@@ -92,62 +116,85 @@ def main(duzzle=DuzzleContext()):
     # Wait for break point
     duzzle.wait(duzzle.BREAKPOINT)
 
-    # Dump memory segments
+    # Readable segments, streamed before the register gadgets resume the
+    # inferior
     mem_segments = []
     for segment in duzzle.vmmap():
 
         if (segment['perms'] & pypzl.READ) != 0 and \
            segment['name'] not in duzzle.kernel_segments:
+            mem_segments.append(segment)
 
-            try:
-                file_path = duzzle.dump_segment(segment)
-                mem_segments.append({'start': segment['start'],
-                                     'end': segment['end'],
-                                     'perms': segment['perms'],
-                                     'name': segment['name'],
-                                     'data': file_path})
-
-                # Debug
-                print('[*] Dumped {} to {} - {}'.format(segment['start'],
-                                                        segment['end'],
-                                                        segment['name']))
+    # Pack
+    ctx = pypzl.PuzzleContext(arch.ARCH)
+    if args.format == 'mmap':
+        ctx.set_version(pypzl.VERSION_MMAP)
+    elif args.format == 'chunked':
+        ctx.set_version(pypzl.VERSION_CHUNKED)
+        if args.level == 0:
+            ctx.set_codec(pypzl.CODEC_NONE)
+        else:
+            ctx.set_codec(pypzl.CODEC_DEFLATE, args.level)
+        ctx.set_threads(args.threads)
+
+    # Store pages once across snapshots
+    pool = None
+    if args.pool:
+        pool = pypzl.PagePool(args.pool)
+        ctx.set_version(pypzl.VERSION_MMAP)
+        ctx.set_pool(pool)
+
+    # Leave clean pages of mapped files to the files
+    if args.file_refs:
+        ctx.set_version(pypzl.VERSION_MMAP)
+
+    # Stream memory segments from the inferior into the file
+    with open(out_file, 'wb') as file:
+        stream = pypzl.PuzzleStream(ctx, file)
+        for segment in mem_segments:
 
+            # Unreadable segments are left out
+            chunks = duzzle.read_segment(segment, STREAM_READ_SIZE)
+            try:
+                data = next(chunks)
             except Exception:
                 print('[*] Cannot dump {}'.format(segment['start']))
-
-    # Dump user registers
-    user_regs = duzzle.dump_registers()
-    print('[*] Dumped user registers')
+                continue
+
+            # Pages still matching the mapped file
+            clean = None
+            if args.file_refs:
+                clean = duzzle.clean_pages(segment)
+
+            # Add memory record
+            stream.add_mem_rec(int(segment['start'], 16),
+                               int(segment['end'], 16),
+                               segment['perms'],
+                               None if not segment['name'] else \
+                               str.encode(segment['name']),
+                               segment['offset'],
+                               clean)
+            stream.write(data)
+            for data in chunks:
+                stream.write(data)
+
+            # Debug
+            print('[*] Dumped {} to {} - {}'.format(segment['start'],
+                                                    segment['end'],
+                                                    segment['name']))
+
+        # Dump user registers, the register record is written last
+        user_regs = duzzle.dump_registers()
+        print('[*] Dumped user registers')
+        ctx.add_reg_rec(arch.pack(user_regs))
+
+        stream.end()
 
     # Shutdown
     duzzle.shutdown()
 
-    # Pack
-    ctx = pypzl.PuzzleContext(arch.ARCH)
-
-    # Add memory segments
-    for segment in mem_segments:
-
-        # Debug
-        print('[*] Packing "{}"'.format(segment['data']))
-
-        # Add memory record
-        ctx.add_mem_rec(int(segment['start'], 16),
-                        int(segment['end'], 16),
-                        segment['perms'],
-                        read_file_bytes(segment['data']),
-                        None if not segment['name'] else \
-                        str.encode(segment['name']))
-
-    # Add user registers
-    ctx.add_reg_rec(arch.pack(user_regs))
-
-    # Pack data
-    pack_data = ctx.pack()
-
-    # Write to file
-    with open(out_file, 'wb') as file:
-        file.write(pack_data)
+    if pool:
+        pool.close()
 
     # Clean up
 
@@ -170,7 +217,6 @@ if __name__ == '__main__':
     except KeyboardInterrupt:
 
         # Kill threads
-        duzzle._out_q.put('die')
-        duzzle._listener.join()
+        duzzle.shutdown()
 
         print('[*] Exiting')
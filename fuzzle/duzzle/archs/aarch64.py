@@ -0,0 +1,57 @@
+import struct
+
+from fuzzle import pypzl
+from fuzzle.duzzle.core import utils
+
+
+# Set architecture
+ARCH = pypzl.AARCH64
+
+# mrs x0, tpidr_el0
+_READ_TLS = struct.pack('<I', 0xd53bd040)
+
+def pack(user_regs):
+    """
+    Pack aarch64 registers into bytes object.
+
+    Args:
+        user_regs: A dictionary of dumped user registers.
+
+    Returns:
+        A bytes object packed in the puzzle format.
+    """
+
+    # Pack aarch64 registers
+    user_regs_data = b''
+    for num in range(31):
+        user_regs_data += struct.pack('<Q', int(user_regs['x{}'.format(num)], 16))
+    user_regs_data += struct.pack('<Q', int(user_regs['sp'], 16))
+    user_regs_data += struct.pack('<Q', int(user_regs['pc'], 16))
+    user_regs_data += struct.pack('<Q', int(user_regs['cpsr'], 16))
+    user_regs_data += struct.pack('<Q', int(user_regs['tls'], 16))
+
+    return user_regs_data
+
+def dump_registers(duzzle):
+    """
+    Extract tpidr_el0 of the process running under gdbserver.
+
+    Args:
+        duzzle: duzzle context object.
+
+    Returns:
+        A name address dictionary containing the tls.
+    """
+
+    # Newer gdbservers report it directly
+    if 'tpidr' in duzzle._registers:
+        return {'tls': duzzle._registers['tpidr']}
+
+    # Otherwise read it with an mrs gadget
+    gadget = utils.gadget_addr(duzzle, _READ_TLS, 4)
+    if gadget is None:
+        print('[-] Cannot read aarch64 tls')
+        return {'tls': '0x0'}
+
+    values = utils.run_gadget(duzzle, gadget, 4, 'pc', ['x0'])
+    return {'tls': values['x0']}
@@ -0,0 +1,58 @@
+import struct
+
+from fuzzle import pypzl
+from fuzzle.duzzle.core import utils
+
+
+# Set architecture
+ARCH = pypzl.ARM
+
+# mrc p15, 0, r0, c13, c0, 3
+_READ_TLS = struct.pack('<I', 0xee1d0f70)
+
+def pack(user_regs):
+    """
+    Pack arm registers into bytes object.
+
+    Args:
+        user_regs: A dictionary of dumped user registers.
+
+    Returns:
+        A bytes object packed in the puzzle format.
+    """
+
+    # Pack arm registers
+    user_regs_data = b''
+    for num in range(13):
+        user_regs_data += struct.pack('<I', int(user_regs['r{}'.format(num)], 16))
+    user_regs_data += struct.pack('<I', int(user_regs['sp'], 16))
+    user_regs_data += struct.pack('<I', int(user_regs['lr'], 16))
+    user_regs_data += struct.pack('<I', int(user_regs['pc'], 16))
+    user_regs_data += struct.pack('<I', int(user_regs['cpsr'], 16))
+    user_regs_data += struct.pack('<I', int(user_regs['tls'], 16))
+
+    return user_regs_data
+
+def dump_registers(duzzle):
+    """
+    Extract the thread pointer of the process running under gdbserver.
+
+    Args:
+        duzzle: duzzle context object.
+
+    Returns:
+        A name address dictionary containing the tls.
+    """
+
+    # Newer gdbservers report it directly
+    if 'tpidruro' in duzzle._registers:
+        return {'tls': duzzle._registers['tpidruro']}
+
+    # Otherwise read it with an mrc gadget, arm state only
+    gadget = utils.gadget_addr(duzzle, _READ_TLS, 4)
+    if gadget is None or int(duzzle._registers['cpsr'], 16) & 0x20:
+        print('[-] Cannot read arm tls')
+        return {'tls': '0x0'}
+
+    values = utils.run_gadget(duzzle, gadget, 4, 'pc', ['r0'])
+    return {'tls': values['r0']}
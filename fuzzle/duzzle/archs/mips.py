@@ -0,0 +1,86 @@
+import struct
+
+from fuzzle import pypzl
+from fuzzle.duzzle.core import utils
+
+
+# Set architecture
+ARCH = pypzl.MIPS_32
+
+# General purpose registers as named by gdb
+_GPRS = ['zero', 'at', 'v0', 'v1', 'a0', 'a1', 'a2', 'a3',
+         't0', 't1', 't2', 't3', 't4', 't5', 't6', 't7',
+         's0', 's1', 's2', 's3', 's4', 's5', 's6', 's7',
+         't8', 't9', 'k0', 'k1', 'gp', 'sp', 's8', 'ra']
+
+# rdhwr $3, $29
+_READ_TLS = 0x7c03e83b
+
+def pack(user_regs):
+    """
+    Pack mips o32 registers into bytes object.
+
+    Args:
+        user_regs: A dictionary of dumped user registers.
+
+    Returns:
+        A bytes object packed in the puzzle format.
+    """
+
+    # Pack mips registers
+    user_regs_data = b''
+    for name in _GPRS:
+        user_regs_data += struct.pack('<I', int(user_regs[name], 16))
+    user_regs_data += struct.pack('<I', int(user_regs['lo'], 16))
+    user_regs_data += struct.pack('<I', int(user_regs['hi'], 16))
+    user_regs_data += struct.pack('<I', int(user_regs['pc'], 16))
+    user_regs_data += struct.pack('<I', int(user_regs['tls'], 16))
+    user_regs_data += struct.pack('<I', int(user_regs['big_endian'], 16))
+
+    return user_regs_data
+
+def dump_registers(duzzle):
+    """
+    Extract the byte order and userlocal register of the process running under gdbserver.
+
+    Args:
+        duzzle: duzzle context object.
+
+    Returns:
+        A name address dictionary containing big_endian and the tls.
+    """
+
+    # Regiters dictionary
+    registers = {}
+    big_endian = _big_endian(duzzle)
+    registers['big_endian'] = hex(big_endian)
+
+    # Read userlocal with an rdhwr gadget
+    opcode = struct.pack('>I' if big_endian else '<I', _READ_TLS)
+    gadget = utils.gadget_addr(duzzle, opcode, 4)
+    if gadget is None:
+        print('[-] Cannot read mips tls')
+        registers['tls'] = '0x0'
+    else:
+        registers['tls'] = utils.run_gadget(duzzle, gadget, 4, 'pc', ['v1'])['v1']
+
+    return registers
+
+def _big_endian(duzzle):
+    """
+    Ask gdb for the target byte order.
+
+    Args:
+        duzzle: duzzle context object.
+
+    Returns:
+        1 for big endian targets, 0 otherwise.
+    """
+
+    # Answer arrives as a console message
+    console = len(duzzle.console)
+    duzzle.write('-interpreter-exec console "show endian"')
+    for resp in duzzle.console[console:]:
+        if 'big endian' in str(resp['payload']):
+            return 1
+    return 0
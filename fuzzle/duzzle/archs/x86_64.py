@@ -154,29 +154,5 @@ def _syscall_addr(duzzle):
         Abolute address of syscall instruction within executable memory segment.
     """
 
-    # Extract executable segments
-    segments = list(filter(lambda x: (x['perms'] & pypzl.EXECUTE != 0),
-                                     duzzle._segments))
-
     # Locate syscall gadget
-    for segment in segments:
-
-        # Check kernel segment
-        if segment['name'] in duzzle.kernel_segments:
-            continue
-
-        # File path
-        file_path = utils.file_path(duzzle.pid, '{}.{}'.format(segment['start'],
-                                                               segment['perms']))
-        # Open raw dump
-        with open(file_path, 'rb') as file:
-            data = file.read()
-
-        # Iterate bytes
-        for offset in range(len(data) - 1):
-
-            # Find syscall instruction
-            if data[offset] == 0x0f and data[offset + 1] == 0x05:
-
-                # Resolve address
-                return int(segment['start'], 16) + offset
+    return utils.gadget_addr(duzzle, b'\x0f\x05')
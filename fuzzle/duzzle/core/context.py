@@ -1,11 +1,35 @@
 import os
 import json
+import stat
+import threading
 
-from queue import Queue
+from queue import Queue, Empty
+from concurrent.futures import Future
+from fuzzle import pypzl
 from fuzzle.duzzle.core import utils
 from pygdbmi.gdbcontroller import GdbController
 from fuzzle.duzzle.core.listener import DuzzleListener
 
+# Bytes requested per memory transfer
+MEMORY_READ_SIZE = 0x100000
+
+# Addresses of a gdbserver that may share our /proc
+LOCAL_ADDRESSES = ['127.0.0.1', 'localhost', '::1']
+
+# Bytes compared through /proc and gdbmi before trusting /proc
+VERIFY_READ_SIZE = 0x40
+
+# Page size of the UZL page bitmaps
+PAGE_SIZE = 0x1000
+
+# Pagemap entry flags, see Documentation/admin-guide/mm/pagemap.rst
+PAGEMAP_PRESENT = 1 << 63
+PAGEMAP_SWAPPED = 1 << 62
+PAGEMAP_FILE = 1 << 61
+
+# Paths of remote mappings that are never regular files
+SPECIAL_PREFIXES = ('/dev/', '/proc/', '/sys/', '/SYSV')
+
 
 class DuzzleContext(object):
     """
@@ -36,12 +60,14 @@ class DuzzleContext(object):
         # Initialise
         self._arch = arch
         self._token = 0
-        self._stopped = []
+        self._futures = {}
+        self._lock = threading.Lock()
+        self._stop_q = Queue()
         self._segments = {}
+        self._anonymous = None
         self._registers = {}
         self._name_list = []
-        self._in_q = Queue()
-        self._out_q = Queue()
+        self._listener = None
         self._verbose = verbose
 
         # Kernel segments
@@ -52,6 +78,12 @@ class DuzzleContext(object):
         # PID
         self.pid = None
 
+        # Local gdbserver, memory is read through /proc when permitted and
+        # once the process there is confirmed to be the inferior
+        self._local = False
+        self._local_checked = False
+        self._mem_file = None
+
     def set_arch(self, arch):
         """
         Set target architecture.
@@ -82,7 +114,7 @@ class DuzzleContext(object):
             raise Exception('Architecture has not been set')
 
         # Start listener thread
-        self._listener = DuzzleListener(self._out_q, self._in_q, verbose=self._verbose)
+        self._listener = DuzzleListener(self._handle, verbose=self._verbose)
         self._listener.daemon = True
         self._listener.start()
 
@@ -109,100 +141,173 @@ class DuzzleContext(object):
         resp = self.write('-target-select remote {}:{}'.format(address, port))
         if resp['message'] != 'connected':
             raise Exception('Cannot connect to target "{}:{}"'.format(address, port))
+        self._local = address in LOCAL_ADDRESSES
+        self._local_checked = False
 
         return resp
 
-    def write(self, gdbmi_cmd):
+    def _check_local(self):
         """
-        Place gdbmi_cmd string in the output queue.
-
-        Args:
-            gdbmi_cmd: gdbmi command string.
+        Confirms that the process behind our /proc/<pid> is the inferior. A
+        port forwarded to an adb device, container or VM also looks local,
+        and the same pid then names an unrelated process on this host. Its
+        maps must match the ones downloaded through gdb and the first bytes
+        of its first readable segment the ones read through gdbmi, otherwise
+        everything is read through gdbmi.
 
         Returns:
-            Associated gdbmi response message.
+            True if /proc of the inferior may be read in place.
+        """
+
+        if not self._local or self._local_checked:
+            return self._local
+        self._local_checked = True
+        self._local = False
+
+        # Same mappings
+        maps_file = '/proc/{}/maps'.format(self.pid)
+        try:
+            with open(maps_file) as file:
+                local_maps = file.read()
+            with open(self.get_file(maps_file, 'maps')) as file:
+                remote_maps = file.read()
+        except Exception:
+            return False
+        if local_maps != remote_maps:
+            utils.dprint('[-] Local pid {} is another process'.format(self.pid),
+                         self._verbose)
+            return False
+
+        # Same memory
+        for segment in utils.parse_map(maps_file):
+            if (segment['perms'] & pypzl.READ) == 0 or \
+               segment['name'] in self.kernel_segments:
+                continue
+
+            address = int(segment['start'], 16)
+            count = min(VERIFY_READ_SIZE, segment['size'])
+            try:
+                with open('/proc/{}/mem'.format(self.pid), 'rb', buffering=0) as file:
+                    local_data = os.pread(file.fileno(), count, address)
+                remote_data = bytes.fromhex(self.read_bytes(hex(address), count))
+            except Exception:
+                return False
+            if local_data != remote_data:
+                utils.dprint('[-] Local pid {} is another process'.format(self.pid),
+                             self._verbose)
+                return False
+            break
+
+        self._local = True
+        return True
+
+    def _handle(self, resp):
         """
+        Route a gdb response, called from the listener thread.
 
-        # Build command
-        gdbmi_cmd = '{}{}'.format(self._token, gdbmi_cmd)
-        self._out_q.put(gdbmi_cmd)
+        Args:
+            resp: Parsed gdbmi response.
+        """
 
-        # Wait for response
-        while True:
+        # Get PID
+        if self.pid is None and \
+           isinstance(resp['payload'], dict) and \
+           'pid' in resp['payload']:
 
-            if not self._in_q.empty():
-                resp = self._in_q.get()
+            # Set PID
+            self.pid = resp['payload']['pid']
 
-                # Get PID
-                if self.pid is None and \
-                   resp['payload'] is not None and \
-                   'pid' in resp['payload']:
+            # Debug
+            utils.dprint('[+] Process PID "{}"'.format(self.pid), self._verbose)
 
-                    # Set PID
-                    self.pid = resp['payload']['pid']
+        # Console message
+        if resp['type'] == 'console':
+            self.console.append(resp)
 
-                    # Debug
-                    utils.dprint('[+] Process PID "{}"'.format(self.pid), self._verbose)
+        # Stopped message
+        elif resp['message'] == 'stopped':
+            self._stop_q.put(resp)
 
-                # Console message
-                if resp['type'] == 'console':
-                    self.console.append(resp)
-                    self._in_q.task_done()
-                    continue
+        # Response message, resolves the command with the same token
+        elif resp['type'] == 'result' and resp['token'] is not None:
+            with self._lock:
+                future = self._futures.pop(resp['token'], None)
+            if future is not None:
+                future.set_result(resp)
 
-                # Stopped message
-                elif resp['message'] == 'stopped':
-                    self._stopped.append(resp)
+    def send(self, gdbmi_cmd):
+        """
+        Dispatch gdbmi_cmd without waiting for its response.
 
-                # Response message
-                elif resp['message'] is not None and \
-                     resp['token'] is not None and \
-                     resp['token'] == self._token:
-                    self._token += 1
-                    self._in_q.task_done()
+        Args:
+            gdbmi_cmd: gdbmi command string.
 
-                    return resp
+        Returns:
+            Future resolved with the associated gdbmi response message.
+        """
 
-                # Release lock
-                self._in_q.task_done()
+        # Build command
+        future = Future()
+        with self._lock:
+            token = self._token
+            self._token += 1
+            self._futures[token] = future
+
+        self._listener.dispatch('{}{}'.format(token, gdbmi_cmd))
+        return future
 
-    def wait(self, reason):
+    def write(self, gdbmi_cmd, timeout=None):
         """
-        Block until a stop event with specified reason is detected.
+        Dispatch gdbmi_cmd and wait for its response.
 
         Args:
-            reason: Reason the debugger stopped.
+            gdbmi_cmd: gdbmi command string.
+            timeout: Seconds to wait, None waits forever.
 
         Returns:
-            Message from the gdb stop event.
+            Associated gdbmi response message.
         """
 
-        # Stop event already found
-        if len(self._stopped) != 0:
-            utils.dprint('[+] Event already stopped', self._verbose)
+        return self.send(gdbmi_cmd).result(timeout)
 
-            for resp in self._stopped:
-                if resp['message'] == 'stopped' and \
-                   'reason' in resp['payload'] and \
-                   resp['payload']['reason'] == reason:
+    def write_many(self, gdbmi_cmds, timeout=None):
+        """
+        Pipeline independent commands, all are in flight before any response
+        is awaited, so a slow link costs one round trip rather than one each.
 
-                    return resp
+        Args:
+            gdbmi_cmds: List of gdbmi command strings.
+            timeout: Seconds to wait for each response, None waits forever.
 
-        # Read in_q
-        while True:
+        Returns:
+            List of the associated gdbmi response messages in command order.
+        """
 
-            if not self._in_q.empty():
+        futures = [self.send(gdbmi_cmd) for gdbmi_cmd in gdbmi_cmds]
+        return [future.result(timeout) for future in futures]
 
-                resp = self._in_q.get()
+    def wait(self, reason, timeout=None):
+        """
+        Block until a stop event with specified reason is detected.
 
-                if resp['message'] == 'stopped' and \
-                   'reason' in resp['payload'] and \
-                   resp['payload']['reason'] == reason:
+        Args:
+            reason: Reason the debugger stopped.
+            timeout: Seconds to wait, None waits forever.
 
-                    self._in_q.task_done()
-                    return resp
+        Returns:
+            Message from the gdb stop event otherwise raises an exception.
+        """
 
-                self._in_q.task_done()
+        # Stop events with other reasons are dropped
+        while True:
+            try:
+                resp = self._stop_q.get(timeout=timeout)
+            except Empty:
+                raise Exception('Timed out waiting for "{}"'.format(reason))
+
+            if 'reason' in resp['payload'] and \
+               resp['payload']['reason'] == reason:
+                return resp
 
     def run(self):
         """
@@ -258,10 +363,9 @@ class DuzzleContext(object):
         if resp['message'] != 'done':
             raise Exception('Cannot download file "{}"'.format(src_file))
 
-        # Wait for file
-        while True:
-            if os.path.isfile(dst_file):
-                break
+        # The transfer has completed once gdb reports done
+        if not os.path.isfile(dst_file):
+            raise Exception('Cannot find downloaded file "{}"'.format(dst_file))
 
         return dst_file
 
@@ -273,41 +377,154 @@ class DuzzleContext(object):
             A parsed Linux maps file in list/dictionary format.
         """
 
-        # Get maps file
-        maps_file = self.get_file('/proc/{}/maps'.format(self.pid), 'maps')
+        # Get maps file, read in place when gdbserver is local
+        maps_file = '/proc/{}/maps'.format(self.pid)
+        if not self._check_local() or not os.access(maps_file, os.R_OK):
+            maps_file = self.get_file(maps_file, 'maps')
 
         # Debug
         utils.dprint('[+] Downloaded maps file "{}"'.format(maps_file), self._verbose)
         self._segments = utils.parse_map(maps_file)
+        self._anonymous = None
 
         return self._segments
 
-    def dump_segment(self, segment):
+    def clean_pages(self, segment):
         """
-        Dumps a memory segment from the inferior process to local file.
+        Finds the pages of a file mapping that still match the mapped file.
+
+        Local processes, once confirmed to be the inferior, are checked page by
+        page through /proc/<pid>/pagemap, a page is clean unless it is resident
+        anonymous memory or swapped out. Remote ones only through smaps, so a
+        mapping is either clean as a whole or not at all.
 
         Args:
-            segment: Segment to dump in duzzle format.
+            segment: Segment in duzzle format.
 
         Returns:
-           File path where of the dump file otherwise raises an exception.
+            Bitmap bytes with a bit set per clean page, None if the segment is
+            not a private mapping of a regular file or has no clean page.
+        """
+
+        # Private mappings of regular files only, shared ones and devices may
+        # change under the file and are stored inline
+        name = segment['name']
+        if not name or not name.startswith('/') or name.endswith('(deleted)') or \
+           not segment['private'] or segment['inode'] == 0 or \
+           segment['offset'] % PAGE_SIZE != 0:
+            return None
+        local = self._check_local()
+        if local:
+            try:
+                info = os.stat(name)
+            except OSError:
+                return None
+            if not stat.S_ISREG(info.st_mode) or info.st_ino != segment['inode']:
+                return None
+        elif name.startswith(SPECIAL_PREFIXES):
+            return None
+
+        start = int(segment['start'], 16)
+        pages = (segment['size'] + PAGE_SIZE - 1) // PAGE_SIZE
+        bmp = bytearray((pages + 7) // 8)
+
+        # Page by page
+        pagemap_file = '/proc/{}/pagemap'.format(self.pid)
+        if local and os.access(pagemap_file, os.R_OK):
+            with open(pagemap_file, 'rb', buffering=0) as file:
+                entries = os.pread(file.fileno(), pages * 8, (start // PAGE_SIZE) * 8)
+            for page in range(min(pages, len(entries) // 8)):
+                entry = int.from_bytes(entries[page * 8:page * 8 + 8], 'little')
+                if entry & PAGEMAP_SWAPPED or \
+                   (entry & PAGEMAP_PRESENT and not entry & PAGEMAP_FILE):
+                    continue
+                bmp[page // 8] |= 1 << (page % 8)
+
+        # Whole mapping
+        else:
+            if self._anonymous is None:
+                self._anonymous = utils.parse_smaps(
+                    self.get_file('/proc/{}/smaps'.format(self.pid), 'smaps'))
+            if self._anonymous.get(segment['start'], 1) != 0:
+                return None
+            for page in range(pages):
+                bmp[page // 8] |= 1 << (page % 8)
+
+        return bytes(bmp) if any(bmp) else None
+
+    def read_segment(self, segment, size=MEMORY_READ_SIZE):
+        """
+        Reads a memory segment of the inferior process without temporary files.
+
+        Args:
+            segment: Segment to read in duzzle format.
+            size: Bytes read per transfer.
+
+        Returns:
+            Generator of bytes objects covering the segment in order. Raises an
+            exception if the first transfer fails, later unreadable ranges are
+            zero filled so the segment keeps its size.
         """
 
-        # Dump file handle
-        dump_file_name = '{}.{}'.format(segment['start'], segment['perms'])
-        dump_file_name = utils.file_path(self.pid, dump_file_name)
+        start = int(segment['start'], 16)
+        end = int(segment['end'], 16)
 
-        # Dump command
-        gdbmi_cmd = '-interpreter-exec console "dump memory {} {} {}"'.format(dump_file_name,
-                                                                              segment['start'],
-                                                                              segment['end'])
+        for address in range(start, end, size):
+            count = min(size, end - address)
+            try:
+                data = self._read_memory(address, count)
+            except Exception:
+                if address == start:
+                    raise
+                utils.dprint('[-] Zero filling {} bytes at {}'.format(count, hex(address)),
+                             self._verbose)
+                data = bytes(count)
+            yield data
+
+    def _read_memory(self, address, count):
+        """
+        Reads a range of inferior memory, through /proc/<pid>/mem when the
+        gdbserver is local and the kernel allows it, otherwise through gdbmi.
 
-        # Dispatch
-        resp = self.write(gdbmi_cmd)
+        Args:
+            address: Absolute address to begin reading bytes.
+            count: Byte count to read.
+
+        Returns:
+            Bytes object of count bytes, unreadable parts are zero filled.
+        """
+
+        # Open the inferior memory once, a refusal falls back to gdbmi
+        if self._mem_file is None and self._check_local():
+            try:
+                self._mem_file = open('/proc/{}/mem'.format(self.pid), 'rb', buffering=0)
+                utils.dprint('[+] Reading memory through /proc', self._verbose)
+            except OSError:
+                self._local = False
+
+        if self._mem_file is not None:
+            data = os.pread(self._mem_file.fileno(), count, address)
+            if len(data) != count:
+                raise Exception('Cannot read {} bytes from {}'.format(count, hex(address)))
+            return data
+
+        # One large transfer, gdb reports the readable blocks within it
+        resp = self.write('-data-read-memory-bytes {} {}'.format(hex(address), count))
         if resp['message'] != 'done':
-            raise Exception('Cannot dump memory region {}-{}'.format(segment['start'],
-                                                                     segment['end']))
-        return dump_file_name
+            raise Exception('Cannot read {} bytes from {}'.format(count, hex(address)))
+
+        blocks = resp['payload']['memory']
+        if len(blocks) == 1 and int(blocks[0]['begin'], 16) == address and \
+           int(blocks[0]['end'], 16) == address + count:
+            return bytes.fromhex(blocks[0]['contents'])
+
+        data = bytearray(count)
+        for block in blocks:
+            offset = int(block['begin'], 16) - address
+            contents = bytes.fromhex(block['contents'])
+            data[offset:offset + len(contents)] = contents
+
+        return bytes(data)
 
     def dump_registers(self):
         """
@@ -317,8 +534,11 @@ class DuzzleContext(object):
             File path of JSON dump file otherwise raises an exception.
         """
 
-        self._name_list = name_list = self._dump_registers_name()
-        value_dict = self._dump_registers_value()
+        # Names and values are requested together
+        names, values = self.write_many(['-data-list-register-names',
+                                         '-data-list-register-values x'])
+        self._name_list = name_list = self._parse_registers_name(names)
+        value_dict = self._parse_registers_value(values)
 
         # Create register dictionary
         for num, value in value_dict.items():
@@ -337,23 +557,48 @@ class DuzzleContext(object):
             List of register names otherwise raises an exception.
         """
 
-        resp = self.write('-data-list-register-names')
+        return self._parse_registers_name(self.write('-data-list-register-names'))
+
+    def _dump_registers_value(self):
+        """
+        Extract register values.
+
+        Returns:
+            Dictionary indexed by register number containing its value otherwise raises an
+            exception.
+        """
+
+        return self._parse_registers_value(self.write('-data-list-register-values x'))
+
+    def _parse_registers_name(self, resp):
+        """
+        Parse a -data-list-register-names response.
+
+        Args:
+            resp: gdbmi response message.
+
+        Returns:
+            List of register names otherwise raises an exception.
+        """
+
         if resp['message'] != 'done':
             raise Exception('Cannot dump register names')
 
         # Parse register name list
         return resp['payload']['register-names']
 
-    def _dump_registers_value(self):
+    def _parse_registers_value(self, resp):
         """
-        Extract register values.
+        Parse a -data-list-register-values response.
+
+        Args:
+            resp: gdbmi response message.
 
         Returns:
             Dictionary indexed by register number containing its value otherwise raises an
             exception.
         """
 
-        resp = self.write('-data-list-register-values x')
         if resp['message'] != 'done':
             raise Exception('Cannot dump register values')
 
@@ -441,6 +686,12 @@ class DuzzleContext(object):
         Kill all threads and exits gdb.
         """
 
+        # Release inferior memory
+        if self._mem_file is not None:
+            self._mem_file.close()
+            self._mem_file = None
+
         # Kill threads
-        self._out_q.put('die')
-        self._listener.join()
+        if self._listener is not None:
+            self._listener.kill()
+            self._listener = None
@@ -3,73 +3,84 @@ import threading
 from fuzzle.duzzle.core import utils
 from pygdbmi.gdbcontroller import GdbController
 
+# Seconds a read blocks before checking for shutdown
+READ_TIMEOUT = 0.1
+
+# Seconds to wait for more output once a response has started arriving
+MORE_OUTPUT_TIMEOUT = 0.001
+
 
 class DuzzleListener(threading.Thread):
     """
     docstring for DuzzleListener
     """
 
-    def __init__(self, out_q, in_q, verbose):
+    def __init__(self, handler, verbose):
         """
         Constructor for DuzzleListener.
 
         Args:
-            out_q: Queue of GDMI commands to be dispatched.
-            in_q: Queue of responses from GDB.
-        """    
+            handler: Called from this thread with every response from GDB.
+            verbose: Verbosity flag.
+        """
 
         # Super constructor
         super(DuzzleListener, self).__init__()
-    
+
         # Initialise
-        self._out_q = out_q
-        self._in_q = in_q
+        self._handler = handler
         self._verbose = verbose
-        self._communicator = GdbController()
+        self._lock = threading.Lock()
+        self._stop_event = threading.Event()
+        self._communicator = GdbController(
+            time_to_check_for_additional_output_sec=MORE_OUTPUT_TIMEOUT)
 
     def run(self):
         """
         Main thread.
         """
 
-        # Main listener loop
-        while True:
+        # Main listener loop, blocks in select until gdb writes
+        while not self._stop_event.is_set():
 
             # Read from gdb
-            resp = self._communicator.get_gdb_response(timeout_sec=0, raise_error_on_timeout=False)
+            resp = self._communicator.get_gdb_response(timeout_sec=READ_TIMEOUT,
+                                                       raise_error_on_timeout=False)
 
-            # Write to out queue
-            if len(resp) > 0:
-                for msg in resp:
+            # Hand over responses
+            for msg in resp:
 
-                    # Debug
-                    utils.dprint('[+] Read response', self._verbose)
-                    utils.dprint(msg, self._verbose)
+                # Debug
+                utils.dprint('[+] Read response', self._verbose)
+                utils.dprint(msg, self._verbose)
 
-                    self._in_q.put(msg)
+                self._handler(msg)
 
-            # Out message to process
-            if not self._out_q.empty():
+    def dispatch(self, gdbmi_cmd):
+        """
+        Write a command to gdb straight away, callers may have several in flight.
 
-                # Get out message
-                out_msg = self._out_q.get()
+        Args:
+            gdbmi_cmd: gdbmi command string including its token.
+        """
 
-                # Check for kill command
-                if out_msg != 'die':
+        with self._lock:
 
-                    # Debug
-                    utils.dprint('[+] Dispatched command "{}"'.format(out_msg), self._verbose)
+            # Debug
+            utils.dprint('[+] Dispatched command "{}"'.format(gdbmi_cmd), self._verbose)
 
-                    # Write to gdb
-                    self._communicator.write(out_msg, read_response=False)
-                    self._out_q.task_done()
+            # Write to gdb
+            self._communicator.write(gdbmi_cmd, read_response=False)
 
-                # Kill thread
-                else:
+    def kill(self):
+        """
+        Exit gdb and wait for the thread to finish.
+        """
 
-                    # Kill gdb
-                    self._communicator.write('-gdb-exit', read_response=False)
+        # Kill gdb
+        self.dispatch('-gdb-exit')
 
-                    # Debug
-                    utils.dprint('[+] Killing thread', self._verbose)
-                    return
+        # Debug
+        utils.dprint('[+] Killing thread', self._verbose)
+        self._stop_event.set()
+        self.join()
@@ -81,8 +81,15 @@ def parse_map(file_name):
 
                 segment['perms'] = perms
 
-                # Extract name if exists
+                # Private mappings only diverge from their file when written
+                segment['private'] = 'p' in str_perms
+
+                # File offset and inode, zero for anonymous mappings
                 fields = list(filter(lambda x: x != '', line.split(' ')))
+                segment['offset'] = int(fields[2], 16) if len(fields) > 2 else 0
+                segment['inode'] = int(fields[4]) if len(fields) > 4 else 0
+
+                # Extract name if exists
                 if len(fields) == 6:
                     segment['name'] = fields[-1:][0]
                 else:
@@ -93,6 +100,41 @@ def parse_map(file_name):
 
     return maps
 
+def parse_smaps(file_name):
+    """
+    Parses a Linux smaps file for the anonymous memory of each mapping.
+
+    Args:
+        file_name: Location of smaps file on local disk.
+
+    Returns:
+        Dictionary of anonymous bytes keyed by segment start address.
+    """
+
+    # Create regex
+    addr_regex = re.compile(r'^([0-9a-fA-F]+)-([0-9a-fA-F]+)\s')
+    anon_regex = re.compile(r'^Anonymous:\s*([0-9]+) kB')
+
+    # Anonymous dictionary
+    anonymous = {}
+    start = None
+
+    with open(file_name) as file:
+        for line in file.readlines():
+
+            # Mapping header
+            addr_match = re.search(addr_regex, line)
+            if addr_match:
+                start = '0x{}'.format(addr_match.group(1))
+                continue
+
+            # Anonymous size of the current mapping
+            anon_match = re.search(anon_regex, line)
+            if anon_match and start is not None:
+                anonymous[start] = int(anon_match.group(1)) * 1024
+
+    return anonymous
+
 def read_file_bytes(file_path):
     """
     """
@@ -118,3 +160,76 @@ def read_file(file_path):
             # Read chunk
             for byte in data_bytes:
                 yield byte
+
+def gadget_addr(duzzle, opcode, align=1):
+    """
+    Searches the dumped executable segments for an instruction.
+
+    Args:
+        duzzle: duzzle context object.
+        opcode: Bytes of the instruction in target byte order.
+        align: Instruction alignment.
+
+    Returns:
+        Absolute address of the instruction, None if it is not mapped.
+    """
+
+    # Extract executable segments
+    segments = list(filter(lambda x: (x['perms'] & pypzl.EXECUTE != 0),
+                                     duzzle._segments))
+
+    for segment in segments:
+
+        # Check kernel segment
+        if segment['name'] in duzzle.kernel_segments:
+            continue
+
+        # Read segment from the inferior
+        try:
+            data = b''.join(duzzle.read_segment(segment))
+        except Exception:
+            continue
+
+        # Aligned matches only
+        offset = data.find(opcode)
+        while offset >= 0:
+            if offset % align == 0:
+                return int(segment['start'], 16) + offset
+            offset = data.find(opcode, offset + 1)
+
+    return None
+
+def run_gadget(duzzle, addr, size, pc, registers):
+    """
+    Executes the single instruction at addr and restores clobbered registers.
+
+    Args:
+        duzzle: duzzle context object.
+        addr: Address of the instruction.
+        size: Instruction size in bytes.
+        pc: Name of the program counter register.
+        registers: Register names to read once the instruction has run.
+
+    Returns:
+        Dictionary of the requested register values.
+    """
+
+    # Set breakpoint after the instruction
+    duzzle.breakpoint('*{}'.format(hex(addr + size)))
+    duzzle.write_register(pc, hex(addr))
+
+    # Execute instruction
+    duzzle.run()
+    duzzle.wait(duzzle.BREAKPOINT)
+
+    # Read results
+    values = duzzle._dump_registers_value()
+    results = {}
+    for name in registers:
+        results[name] = values[duzzle._name_list.index(name)]
+
+    # Restore clobbered registers
+    for name in registers + [pc]:
+        duzzle.write_register(name, duzzle._registers[name])
+
+    return results
@@ -5,6 +5,44 @@
 #ifndef __PUZZLE_H__
 #define __PUZZLE_H__
 
+/* Format versions */
+#define PZL_VERSION_DEFLATE 0x0000
+#define PZL_VERSION_MMAP 0x0001
+#define PZL_VERSION_CHUNKED 0x0002
+
+/* Alignment of raw memory record data */
+#define PZL_PAGE_SIZE 0x1000
+#define PZL_PAGE_ALIGN(__val) \
+    (((uint64_t) (__val) + PZL_PAGE_SIZE - 1) & ~((uint64_t) PZL_PAGE_SIZE - 1))
+#define PZL_PAGE_CNT(__size) (PZL_PAGE_ALIGN(__size) / PZL_PAGE_SIZE)
+
+/* Bytes of a page inside a record, only the last page can be short */
+#define PZL_PAGE_LEN(__size, __page) \
+    ((__size) - (__page) * PZL_PAGE_SIZE < PZL_PAGE_SIZE ? \
+     (__size) - (__page) * PZL_PAGE_SIZE : PZL_PAGE_SIZE)
+
+/* Fixed part of a memory record before its name */
+#define PZL_MEM_REC_HDR_SIZE (2 + 8 + 8 + 8 + 8 + 1 + 1 + 8)
+
+/* Bitmap bytes covering a record of __size bytes */
+#define PZL_BMP_SIZE(__size) ((PZL_PAGE_CNT(__size) + 7) / 8)
+
+/* FNV-1a constants */
+#define PZL_FNV_OFFSET 0xcbf29ce484222325
+#define PZL_FNV_PRIME 0x100000001b3
+
+/* Default uncompressed chunk size of chunked memory records */
+#define PZL_CHUNK_SIZE 0x10000
+
+/* Chunk codecs */
+#define PZL_CODEC_NONE 0x00
+#define PZL_CODEC_DEFLATE 0x01
+
+/* Codec levels, fast trades ratio for speed */
+#define PZL_LEVEL_FAST 1
+#define PZL_LEVEL_DEFAULT 6
+#define PZL_LEVEL_BEST 9
+
 /* Memory permissions */
 #define PZL_READ 0x04
 #define PZL_WRITE 0x02
@@ -68,6 +106,127 @@ The UZL format will eventually support 8 processor architectures and have the fo
    |         ----------------
    |         |  REG_RECORD  | Register Record
    --------> ----------------
+
+Version 0x0001 (PZL_VERSION_MMAP) drops compression so the file can be mapped
+straight into memory. The name is written before the data and the data is
+padded out to a PZL_PAGE_SIZE file offset, which lets every mem_rec_t::dat
+point into the mapping without copying.
+
+             ----------------
+             |      UZL     | Magic
+             ----------------
+             |      HDR     | Header
+             ----------------
+             | MEM_RECORD 0 | Memory Record
+             ----------------
+             |     Name     | Optional String Name
+             ----------------
+             |    Padding   | Zeroes up to the next page boundary
+             ----------------
+             |     Data     | Page aligned
+             ----------------
+             | MEM_RECORD N | Memory Record
+             ----------------
+             |     Name     | Optional String Name
+             ----------------
+             |    Padding   | Zeroes up to the next page boundary
+             ----------------
+             |     Data     | Page aligned
+             ----------------
+             |  REG_RECORD  | Register Record
+             ----------------
+
+Records holding whole pages of zeroes are written as sparse memory records
+(type 0x0003) instead. A page bitmap follows the name and only the pages with
+a set bit are stored, page aligned and in order. Loaders back the zero pages
+with anonymous memory.
+
+             ----------------
+             | SPARSE REC 0 | Sparse Memory Record
+             ----------------
+             |     Name     | Optional String Name
+             ----------------
+             |  Page Count  | 8 bytes
+             ----------------
+             |    Bitmap    | 1 bit per page, set for stored pages
+             ----------------
+             |    Padding   | Zeroes up to the next page boundary
+             ----------------
+             |    Pages     | Non-zero pages only
+             ----------------
+
+With a page pool attached (pzl_set_pool) records are written as pooled memory
+records (type 0x0004) instead. Every page is stored once in the shared pool
+file and the record lists the pool slot and hash of each page, slot 0 being a
+page of zeroes. Loaders map the pool pages copy-on-write, so snapshots loaded
+in one process share identical pages.
+
+             ----------------
+             | POOL REC 0   | Pooled Memory Record
+             ----------------
+             |     Name     | Optional String Name
+             ----------------
+             |    Pool ID   | 8 bytes, must match the attached pool
+             ----------------
+             |  Page Count  | 8 bytes
+             ----------------
+             |  Page Index  | Slot and hash, 8 bytes each per page
+             ----------------
+
+Records of file mappings can be written as file memory records (type 0x0005)
+instead, see pzl_set_mem_rec_file. Pages still matching the mapped file are
+not stored; the record names the file by its mapping name, the file offset of
+the first page and a hash of the referenced pages. A page bitmap marks the
+pages that are stored, the ones written by the process, which follow page
+aligned and in order. Loaders map the local copy of the file copy-on-write,
+prefixed by pzl_set_root. With pzl_set_verify they also hash the referenced
+pages and reject the copy if the hash differs, which reads the whole file.
+
+             ----------------
+             |  FILE REC 0  | File Memory Record
+             ----------------
+             |     Name     | File path, required
+             ----------------
+             |  File Offset | 8 bytes, page aligned
+             ----------------
+             |     Hash     | 8 bytes, over the file backed pages in order
+             ----------------
+             |  Page Count  | 8 bytes
+             ----------------
+             |    Bitmap    | 1 bit per page, set for stored pages
+             ----------------
+             |    Padding   | Zeroes up to the next page boundary
+             ----------------
+             |    Pages     | Stored pages only
+             ----------------
+
+Version 0x0002 (PZL_VERSION_CHUNKED) compresses every memory record on its own
+in chunks of hdr_rec_t::chk_size bytes. Each record carries an index of its
+compressed chunk sizes so a single chunk can be located and inflated without
+touching the rest of the file. A chunk size of zero marks a chunk of zeroes
+and a size equal to the uncompressed length marks a chunk stored raw.
+
+             ----------------
+             |      UZL     | Magic
+             ----------------
+             |      HDR     | Header
+             ----------------
+             | MEM_RECORD 0 | Memory Record
+             ----------------
+             |     Name     | Optional String Name
+             ----------------
+             |  Chunk Count | Number of chunks
+             ----------------
+             |  Chunk Index | Compressed size of each chunk
+             ----------------
+             |    Chunks    | DEFLATE streams
+             ----------------
+             | MEM_RECORD N | Memory Record
+             ----------------
+             |      ...     |
+             ----------------
+             |  REG_RECORD  | Register Record
+             ----------------
 */
 
 typedef enum arch_enum
@@ -97,6 +256,12 @@ Header TLV
 ----------------------
 | 0x0000000000000000 | Data Size
 ----------------------
+| 0x0000000000010000 | Chunk Size (PZL_VERSION_CHUNKED only)
+----------------------
+|        0x01        | Codec (PZL_VERSION_CHUNKED only)
+----------------------
+|        0x06        | Level (PZL_VERSION_CHUNKED only)
+----------------------
 */
 typedef struct hdr_struct
 {
@@ -105,6 +270,9 @@ typedef struct hdr_struct
     uint16_t version;
     arch_t arch;
     uint64_t data_size;
+    uint64_t chk_size;
+    uint8_t codec;
+    uint8_t level;
 } hdr_rec_t;
 
 /*
@@ -132,6 +300,17 @@ Memory Record TLV
 
 Memory Record's will always be appended with a string TLV for the binary
 absolute path if one exists.
+
+dat_ref is not packed; it marks data that references a buffer the record does
+not own, such as a file mapped by pzl_open_mmap, so it is never freed.
+
+file_bmp is set for records of file mappings, one bit per page set when the
+page still matches the file at file_off. It is owned by the record.
+
+Records opened lazily from a chunked file keep their chunk index. chk_off
+holds chk_cnt + 1 offsets into cmp_dat and chk_ld flags the chunks already
+inflated into dat, which is an anonymous mapping (dat_map) so chunks that are
+never loaded cost no memory.
 */
 typedef struct mem_rec_struct
 {
@@ -145,7 +324,14 @@ typedef struct mem_rec_struct
     uint64_t str_size;
     uint8_t *dat;
     uint8_t *str;
-    struct mem_rec_struct *next;
+    bool dat_ref;
+    bool dat_map;
+    uint64_t chk_cnt;
+    uint64_t *chk_off;
+    uint8_t *chk_ld;
+    uint8_t *cmp_dat;
+    uint64_t file_off;
+    uint8_t *file_bmp;
 } mem_rec_t;
 
 /*
@@ -204,17 +390,178 @@ typedef struct user_regs_struct_x86_64
     uint64_t gs;
 } usr_regs_x86_64_t;
 
+/*
+arch = arm, tls is the user read only thread id register (tpidruro)
+*/
+typedef struct user_regs_struct_arm
+{
+    uint32_t r0;
+    uint32_t r1;
+    uint32_t r2;
+    uint32_t r3;
+    uint32_t r4;
+    uint32_t r5;
+    uint32_t r6;
+    uint32_t r7;
+    uint32_t r8;
+    uint32_t r9;
+    uint32_t r10;
+    uint32_t r11;
+    uint32_t r12;
+    uint32_t sp;
+    uint32_t lr;
+    uint32_t pc;
+    uint32_t cpsr;
+    uint32_t tls;
+} usr_regs_arm_t;
+
+/*
+arch = aarch64, tls is tpidr_el0
+*/
+typedef struct user_regs_struct_aarch64
+{
+    uint64_t x[31];
+    uint64_t sp;
+    uint64_t pc;
+    uint64_t pstate;
+    uint64_t tls;
+} usr_regs_aarch64_t;
+
+/*
+arch = mips32 (o32), tls is the userlocal register. The header carries no
+byte order so big_endian records it for the emulator, memory records hold
+target order bytes while registers are stored as host values.
+*/
+typedef struct user_regs_struct_mips
+{
+    uint32_t r[32];
+    uint32_t lo;
+    uint32_t hi;
+    uint32_t pc;
+    uint32_t tls;
+    uint32_t big_endian;
+} usr_regs_mips_t;
+
+/*
+Page Pool
+
+----------------------
+|        PZP         | Magic
+----------------------
+|       0x0000       | Version
+----------------------
+| 0x0000000000000000 | Pool ID
+----------------------
+| 0x0000000000000000 | Page Count
+----------------------
+|      Padding       | Zeroes up to PZL_PAGE_SIZE
+----------------------
+|      Page 1..N     | Slot N lives at file offset N * PZL_PAGE_SIZE
+----------------------
+
+A pool is opened once and attached to any number of contexts, it is not
+owned by them. Writers keep a hash table of every slot and compare page
+contents before sharing one, readers map slots straight from fd. A pool must
+not be written while another process reads it.
+*/
+typedef struct pzl_pool_struct
+{
+    int32_t fd;
+    bool write;
+    uint64_t id;
+    uint64_t page_cnt;
+    uint64_t tbl_cap;
+    uint64_t *tbl_hash;
+    uint64_t *tbl_slot;
+} pzl_pool_t;
+
 /*
 Puzzle Context
+
+mem_rec is an array of mem_rec_cnt records sorted by start, grown to
+mem_rec_cap as records are appended. It stays NULL until the first record.
+
+map_fd stays open while map is set so records can map file pages directly.
+
+pool is not owned by the context; memory records are packed into it and
+loaded from it while attached.
+
+threads is not packed; it bounds the workers used to compress and inflate
+chunked memory records, 1 keeps all work on the calling thread.
+
+root is not owned by the context; it prefixes the paths of file memory
+records when they are loaded, NULL uses the paths as recorded.
+
+verify is not packed; when set, file memory records are checked against
+their hash as they are loaded.
 */
 typedef struct pzl_ctx_struct
 {
     uint8_t mgc[3];
     hdr_rec_t hdr_rec;
-    mem_rec_t *mem_rec;
+    mem_rec_t **mem_rec;
+    uint64_t mem_rec_cnt;
+    uint64_t mem_rec_cap;
     reg_rec_t *reg_rec;
+    uint8_t *map;
+    uint64_t map_size;
+    int32_t map_fd;
+    uint32_t threads;
+    pzl_pool_t *pool;
+    const char *root;
+    bool verify;
 } pzl_ctx_t;
 
+/*
+Stream Writer
+
+Writes a UZL file to fd while memory records are still being produced, so a
+dump never has to be held in memory as a whole. Records are started with
+pzl_pack_stream_mem and their data appended with pzl_pack_stream_dat in as
+many pieces as the caller likes; pzl_pack_stream_end writes the register
+record of the context and backfills the header.
+
+fd must be seekable. Header, record lengths, sparse bitmaps and chunk indexes
+are written with pwrite once known, offsets are relative to base, the file
+position of fd when the stream starts. Only buf_cap bytes of data are held at
+a time, one page for PZL_VERSION_MMAP and threads chunks for
+PZL_VERSION_CHUNKED, PZL_VERSION_DEFLATE is compressed as it arrives.
+
+Without a pool PZL_VERSION_MMAP records are written sparse and turned back
+into plain records when they hold no zero page and the bitmap did not push
+the data onto a later page, matching pzl_pack_raw when base is zero.
+
+Records started with pzl_pack_stream_mem_file are written as file memory
+records whatever the pool; clean marks the pages left to the file, which are
+only hashed into file_hash.
+*/
+typedef struct pzl_stream_struct
+{
+    pzl_ctx_t *context;
+    int32_t fd;
+    uint64_t base;
+    uint64_t offset;
+    uint64_t data_size;
+    uint64_t rec_cnt;
+    bool rec_open;
+    mem_rec_t rec;
+    uint64_t rec_off;
+    uint64_t idx_off;
+    uint64_t dat_len;
+    uint8_t *buf;
+    uint64_t buf_len;
+    uint64_t buf_cap;
+    uint8_t *out;
+    uint64_t out_cap;
+    uint64_t *chk_len;
+    uint64_t blk_idx;
+    uint8_t *bmp;
+    bool zero_page;
+    void *zstrm;
+    uint8_t *clean;
+    uint64_t file_hash;
+} pzl_stream_t;
+
 /* Function prototypes */
 bool pzl_init(pzl_ctx_t **context, arch_t arch);
 bool pzl_free(pzl_ctx_t *context);
@@ -226,7 +573,25 @@ bool pzl_create_mem_rec(pzl_ctx_t *context,
                         uint8_t *dat,
                         uint64_t str_size,
                         uint8_t *str);
+bool pzl_create_mem_rec_ref(pzl_ctx_t *context,
+                            uint64_t start,
+                            uint64_t end,
+                            uint64_t size,
+                            uint8_t perms,
+                            uint8_t *dat,
+                            uint64_t str_size,
+                            uint8_t *str);
+mem_rec_t *pzl_add_mem_rec(pzl_ctx_t *context,
+                           uint64_t start,
+                           uint64_t end,
+                           uint64_t size,
+                           uint8_t perms,
+                           uint8_t *dat,
+                           bool dat_ref,
+                           uint64_t str_size,
+                           uint8_t *str);
 bool pzl_append_mem_rec(pzl_ctx_t *context, mem_rec_t *mem_rec);
+mem_rec_t *pzl_find_mem_rec(pzl_ctx_t *context, uint64_t addr);
 bool pzl_free_mem_rec(mem_rec_t *mem_rec);
 bool pzl_create_reg_rec(pzl_ctx_t *context, void *reg_rec);
 uint64_t pzl_get_mgc_size(pzl_ctx_t *context);
@@ -234,10 +599,21 @@ uint64_t pzl_get_hdr_size(pzl_ctx_t *context);
 uint64_t pzl_get_mem_size(pzl_ctx_t *context);
 uint64_t pzl_get_reg_size(pzl_ctx_t *context);
 uint64_t pzl_get_usr_reg_size(pzl_ctx_t *context);
+bool pzl_is_zero(uint8_t *dat, uint64_t size);
+bool pzl_set_version(pzl_ctx_t *context, uint16_t version);
+bool pzl_set_chk_size(pzl_ctx_t *context, uint64_t chk_size);
+bool pzl_set_codec(pzl_ctx_t *context, uint8_t codec, uint8_t level);
+bool pzl_set_threads(pzl_ctx_t *context, uint32_t threads);
+bool pzl_run_jobs(pzl_ctx_t *context,
+                  uint64_t job_cnt,
+                  bool (*job)(void *arg, uint64_t job_idx),
+                  void *arg);
 bool pzl_pack(pzl_ctx_t *context, uint8_t *data, uint64_t *size);
+bool pzl_pack_raw(pzl_ctx_t *context, uint8_t *data, uint64_t *size);
 bool pzl_pack_mgc(pzl_ctx_t *context, uint8_t *data, uint64_t *offset);
 bool pzl_pack_hdr_rec(pzl_ctx_t *context, uint8_t *data, uint64_t *offset);
 bool pzl_pack_mem_rec(pzl_ctx_t *context, uint8_t *data, uint64_t *offset);
+bool pzl_pack_raw_mem_rec(pzl_ctx_t *context, uint8_t *data, uint64_t *offset);
 bool pzl_pack_reg_rec(pzl_ctx_t *context, uint8_t *data, uint64_t *offset);
 bool pzl_pack_cmp_dat(uint8_t *cmp_data, uint8_t *data, uint64_t *offset, uint64_t size);
 uint64_t pzl_pack_size(pzl_ctx_t *context);
@@ -246,8 +622,87 @@ bool pzl_unpack_mgc(pzl_ctx_t *context, uint8_t *data, uint64_t *offset, uint64_
 bool pzl_unpack_hdr_rec(pzl_ctx_t *context, uint8_t *data, uint64_t *offset, uint64_t size);
 bool pzl_unpack_mem_rec(pzl_ctx_t *context, uint8_t *data, uint64_t *offset, uint64_t size);
 bool pzl_unpack_sgl_mem_rec(pzl_ctx_t *context, uint8_t *data, uint64_t *offset, uint64_t size);
+bool pzl_unpack_raw(pzl_ctx_t *context,
+                    uint8_t *data,
+                    uint64_t *offset,
+                    uint64_t size,
+                    bool ref);
+bool pzl_unpack_raw_mem_rec(pzl_ctx_t *context,
+                            uint8_t *data,
+                            uint64_t *offset,
+                            uint64_t size,
+                            bool ref);
 bool pzl_unpack_reg_rec(pzl_ctx_t *context, uint8_t *data, uint64_t *offset, uint64_t size);
-bool pzl_unpack_reg_rec(pzl_ctx_t *context, uint8_t *data, uint64_t *offset, uint64_t size);
+bool pzl_has_zero_page(mem_rec_t *mem_rec);
+bool pzl_pack_sparse_mem_rec(mem_rec_t *mem_rec, uint8_t *data, uint64_t *offset);
+bool pzl_unpack_sparse_mem_rec(pzl_ctx_t *context,
+                               uint8_t *data,
+                               uint64_t *offset,
+                               uint64_t size,
+                               bool ref);
 bool pzl_unpack_cmp_dat(uint8_t **cmp_data, uint8_t *data, uint64_t *offset, uint64_t size);
+bool pzl_pack_chk(pzl_ctx_t *context, uint8_t *data, uint64_t *size);
+bool pzl_pack_chk_mem_rec(pzl_ctx_t *context, uint8_t *data, uint64_t *offset);
+uint64_t pzl_pack_chk_size(pzl_ctx_t *context);
+uint64_t pzl_pack_chk_slot(pzl_ctx_t *context);
+bool pzl_pack_chk_batch(pzl_ctx_t *context,
+                        uint8_t *src,
+                        uint64_t src_len,
+                        uint8_t *dst,
+                        uint64_t *cmp_len);
+bool pzl_unpack_chk(pzl_ctx_t *context,
+                    uint8_t *data,
+                    uint64_t *offset,
+                    uint64_t size,
+                    bool lazy);
+bool pzl_unpack_chk_mem_rec(pzl_ctx_t *context,
+                            uint8_t *data,
+                            uint64_t *offset,
+                            uint64_t size);
+bool pzl_load_mem_chk(pzl_ctx_t *context, mem_rec_t *mem_rec, uint64_t chk_idx);
+bool pzl_load_mem_rec(pzl_ctx_t *context, mem_rec_t *mem_rec);
+bool pzl_load_mem_recs(pzl_ctx_t *context);
+bool pzl_drop_mem_chk(mem_rec_t *mem_rec);
+bool pzl_pack_pool_mem_rec(pzl_ctx_t *context, mem_rec_t *mem_rec, uint8_t *data, uint64_t *offset);
+bool pzl_unpack_pool_mem_rec(pzl_ctx_t *context, uint8_t *data, uint64_t *offset, uint64_t size);
+uint64_t pzl_hash_file_page(uint64_t hash, uint8_t *page, uint64_t len);
+bool pzl_set_mem_rec_file(pzl_ctx_t *context, uint64_t start, uint64_t file_off, uint8_t *clean);
+bool pzl_set_root(pzl_ctx_t *context, const char *root);
+bool pzl_set_verify(pzl_ctx_t *context, bool verify);
+bool pzl_pack_file_mem_rec(mem_rec_t *mem_rec, uint8_t *data, uint64_t *offset);
+bool pzl_unpack_file_mem_rec(pzl_ctx_t *context,
+                             uint8_t *data,
+                             uint64_t *offset,
+                             uint64_t size,
+                             bool ref);
+uint64_t pzl_hash_page(uint8_t *page, uint64_t len);
+bool pzl_pool_open(pzl_pool_t **pool, const char *path, bool write);
+bool pzl_pool_add(pzl_pool_t *pool, uint8_t *page, uint64_t len, uint64_t *slot, uint64_t *hash);
+bool pzl_pool_close(pzl_pool_t *pool);
+bool pzl_set_pool(pzl_ctx_t *context, pzl_pool_t *pool);
+bool pzl_pack_stream_init(pzl_stream_t **stream, pzl_ctx_t *context, int32_t fd);
+bool pzl_pack_stream_mem(pzl_stream_t *stream,
+                         uint64_t start,
+                         uint64_t end,
+                         uint64_t size,
+                         uint8_t perms,
+                         uint64_t str_size,
+                         uint8_t *str);
+bool pzl_pack_stream_mem_file(pzl_stream_t *stream,
+                              uint64_t start,
+                              uint64_t end,
+                              uint64_t size,
+                              uint8_t perms,
+                              uint64_t str_size,
+                              uint8_t *str,
+                              uint64_t file_off,
+                              uint8_t *clean);
+bool pzl_pack_stream_dat(pzl_stream_t *stream, uint8_t *dat, uint64_t len);
+bool pzl_pack_stream_end(pzl_stream_t *stream);
+bool pzl_pack_stream_abort(pzl_stream_t *stream);
+bool pzl_pack_to_fd(pzl_ctx_t *context, int32_t fd);
+bool pzl_open_mmap(pzl_ctx_t *context, const char *path);
+bool pzl_open_lazy(pzl_ctx_t *context, const char *path);
+bool pzl_close_mmap(pzl_ctx_t *context);
 
 #endif
@@ -21,6 +21,12 @@ int main(int argc, char **argv, char **envp)
         return false;
     }
 
+    /* Optional format version */
+    if(argc > 1 && strcmp(argv[1], "mmap") == 0)
+        pzl_set_version(context, PZL_VERSION_MMAP);
+    else if(argc > 1 && strcmp(argv[1], "chunked") == 0)
+        pzl_set_version(context, PZL_VERSION_CHUNKED);
+
     /* Create dummy memory record */
     uint64_t dat_size = 1024;
 
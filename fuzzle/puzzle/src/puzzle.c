@@ -2,6 +2,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
+#include <unistd.h>
 #include <puzzle.h>
 
 
@@ -21,7 +22,15 @@ bool pzl_init(pzl_ctx_t **context, arch_t arch)
     /* Initialise context */
     memcpy((*context)->mgc, "\x55\x5a\x4c", 3);
     (*context)->mem_rec = NULL;
+    (*context)->mem_rec_cnt = 0;
+    (*context)->mem_rec_cap = 0;
     (*context)->reg_rec = NULL;
+    (*context)->map = NULL;
+    (*context)->map_size = 0;
+    (*context)->map_fd = -1;
+    (*context)->threads = 1;
+    (*context)->pool = NULL;
+    (*context)->root = NULL;
 
     /* Initialise header */
     (*context)->hdr_rec.type = 0x0000;
@@ -29,6 +38,89 @@ bool pzl_init(pzl_ctx_t **context, arch_t arch)
     (*context)->hdr_rec.version = 0x0000;
     (*context)->hdr_rec.arch = arch;
     (*context)->hdr_rec.data_size = 0;
+    (*context)->hdr_rec.chk_size = PZL_CHUNK_SIZE;
+    (*context)->hdr_rec.codec = PZL_CODEC_DEFLATE;
+    (*context)->hdr_rec.level = PZL_LEVEL_DEFAULT;
+
+    return true;
+}
+
+/* Select the format written by pzl_pack */
+bool pzl_set_version(pzl_ctx_t *context, uint16_t version)
+{
+    CHECK_PTR(context, "pzl_set_version - context");
+
+    switch(version)
+    {
+        case PZL_VERSION_DEFLATE:
+        case PZL_VERSION_MMAP:
+            context->hdr_rec.version = version;
+            context->hdr_rec.length = (2 + 8 + 2 + 4 + 8);
+            return true;
+        case PZL_VERSION_CHUNKED:
+            context->hdr_rec.version = version;
+            context->hdr_rec.length = (2 + 8 + 2 + 4 + 8 + 8 + 1 + 1);
+            return true;
+        default:
+            printf("pzl_set_version: unknown version 0x%04x\n", version);
+            return false;
+    }
+}
+
+/* Set uncompressed chunk size of chunked memory records */
+bool pzl_set_chk_size(pzl_ctx_t *context, uint64_t chk_size)
+{
+    CHECK_PTR(context, "pzl_set_chk_size - context");
+
+    /* Chunks are loaded into page sized holes */
+    if(chk_size == 0 || chk_size % PZL_PAGE_SIZE != 0)
+    {
+        printf("pzl_set_chk_size: chunk size must be a multiple of 0x%x\n", PZL_PAGE_SIZE);
+        return false;
+    }
+    context->hdr_rec.chk_size = chk_size;
+
+    return true;
+}
+
+/* Set codec used for chunked memory records */
+bool pzl_set_codec(pzl_ctx_t *context, uint8_t codec, uint8_t level)
+{
+    CHECK_PTR(context, "pzl_set_codec - context");
+
+    switch(codec)
+    {
+        case PZL_CODEC_NONE:
+            context->hdr_rec.codec = codec;
+            context->hdr_rec.level = 0;
+            return true;
+        case PZL_CODEC_DEFLATE:
+            if(level < PZL_LEVEL_FAST || level > PZL_LEVEL_BEST)
+            {
+                printf("pzl_set_codec: level must be between %d and %d\n",
+                       PZL_LEVEL_FAST, PZL_LEVEL_BEST);
+                return false;
+            }
+            context->hdr_rec.codec = codec;
+            context->hdr_rec.level = level;
+            return true;
+        default:
+            printf("pzl_set_codec: unknown codec 0x%02x\n", codec);
+            return false;
+    }
+}
+
+/* Set worker count, zero uses every online CPU */
+bool pzl_set_threads(pzl_ctx_t *context, uint32_t threads)
+{
+    CHECK_PTR(context, "pzl_set_threads - context");
+
+    if(threads == 0)
+    {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = cpus > 0 ? (uint32_t) cpus : 1;
+    }
+    context->threads = threads;
 
     return true;
 }
@@ -38,19 +130,13 @@ bool pzl_free(pzl_ctx_t *context)
 {
     CHECK_PTR(context, "pzl_free - context:");
 
-    /* Check at least memory region exists */
-    if(context->mem_rec != NULL)
-    {
-        mem_rec_t *cur_mem_rec = context->mem_rec;
-        mem_rec_t *prev_mem_rec;
-
-        while(cur_mem_rec != NULL)
-        {
-            prev_mem_rec = cur_mem_rec;
-            cur_mem_rec = cur_mem_rec->next;
-            pzl_free_mem_rec(prev_mem_rec);
-        }
-    }
+    /* Free memory records */
+    uint64_t idx;
+    for(idx = 0; idx < context->mem_rec_cnt; idx++)
+        pzl_free_mem_rec(context->mem_rec[idx]);
+    free(context->mem_rec);
+    context->mem_rec = NULL;
+    context->mem_rec_cnt = 0;
 
     /* Free user registers */
     if(context->reg_rec && context->reg_rec->usr_reg)
@@ -61,6 +147,9 @@ bool pzl_free(pzl_ctx_t *context)
     free(context->reg_rec);
     context->reg_rec = NULL;
 
+    /* Release mapped file after the records referencing it */
+    pzl_close_mmap(context);
+
     /* Free context pointer */
     free(context);
     context = NULL;
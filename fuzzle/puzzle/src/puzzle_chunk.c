@@ -0,0 +1,669 @@
+#define MINIZ_HEADER_FILE_ONLY
+#include <miniz.c>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <puzzle.h>
+
+
+/* Number of chunks covering a record */
+#define PZL_CHK_CNT(__size, __chk_size) \
+    (((__size) + (__chk_size) - 1) / (__chk_size))
+
+/* Uncompressed length of a chunk */
+#define PZL_CHK_LEN(__size, __chk_idx, __chk_size) \
+    ((__size) - (__chk_idx) * (__chk_size) < (__chk_size) ? \
+     (__size) - (__chk_idx) * (__chk_size) : (__chk_size))
+
+/* Single chunk of work */
+typedef struct pzl_chk_job_struct
+{
+    mem_rec_t *mem_rec;
+    uint64_t chk_idx;
+    uint64_t slot_off;
+    uint64_t cmp_len;
+} pzl_chk_job_t;
+
+/* Chunk jobs handed to pzl_run_jobs */
+typedef struct pzl_chk_jobs_struct
+{
+    pzl_ctx_t *context;
+    uint8_t *data;
+    pzl_chk_job_t *job;
+} pzl_chk_jobs_t;
+
+/* Space a compressed chunk may need beyond its raw size */
+static uint64_t pzl_chk_slack(uint64_t chk_size)
+{
+    return compressBound(chk_size) - chk_size;
+}
+
+/***************************************************************/
+/*                           PACKING                           */
+/***************************************************************/
+bool pzl_pack_chk(pzl_ctx_t *context, uint8_t *data, uint64_t *size)
+{
+    CHECK_PTR(context, "pzl_pack_chk - context");
+    CHECK_PTR(context->mem_rec, "pzl_pack_chk - context->mem_rec");
+    CHECK_PTR(context->reg_rec, "pzl_pack_chk - context->reg_rec");
+    CHECK_PTR(data, "pzl_pack_chk - data");
+    CHECK_PTR(size, "pzl_pack_chk - size");
+
+    /* Records follow the magic and header */
+    uint64_t dat_start = pzl_get_mgc_size(context) + pzl_get_hdr_size(context);
+    uint64_t offset = dat_start;
+
+    /* Pack records in place */
+    if(!pzl_pack_chk_mem_rec(context, data, &offset))
+    {
+        printf("pzl_pack_chk: cannot pack memory records\n");
+        return false;
+    }
+    if(!pzl_pack_reg_rec(context, data, &offset))
+    {
+        printf("pzl_pack_chk: cannot pack register record\n");
+        return false;
+    }
+    *size = offset;
+
+    /* Header carries the uncompressed data size */
+    offset = 0;
+    context->hdr_rec.data_size = pzl_get_mem_size(context) + pzl_get_reg_size(context);
+    pzl_pack_mgc(context, data, &offset);
+    pzl_pack_hdr_rec(context, data, &offset);
+
+    return true;
+}
+
+/* Compress a chunk into its worst case slot */
+static bool pzl_pack_chk_job(void *arg, uint64_t job_idx)
+{
+    pzl_chk_jobs_t *jobs = (pzl_chk_jobs_t *) arg;
+    pzl_chk_job_t *job = &(jobs->job[job_idx]);
+    hdr_rec_t *hdr_rec = &(jobs->context->hdr_rec);
+
+    /* Locals */
+    uint8_t *src = job->mem_rec->dat + job->chk_idx * hdr_rec->chk_size;
+    uint64_t src_len = PZL_CHK_LEN(job->mem_rec->size, job->chk_idx, hdr_rec->chk_size);
+    uint8_t *dst = jobs->data + job->slot_off;
+    mz_ulong cmp_len = src_len + pzl_chk_slack(hdr_rec->chk_size);
+
+    /* Zero chunks are implied by the index alone */
+    if(pzl_is_zero(src, src_len))
+    {
+        job->cmp_len = 0;
+        return true;
+    }
+
+    /* Store raw if compression is off or the chunk grows */
+    if(hdr_rec->codec != PZL_CODEC_DEFLATE ||
+       compress2(dst, &cmp_len, src, src_len, hdr_rec->level) != Z_OK ||
+       cmp_len >= src_len)
+    {
+        memcpy(dst, src, src_len);
+        cmp_len = src_len;
+    }
+    job->cmp_len = cmp_len;
+
+    return true;
+}
+
+/* Pack memory records as independently compressed chunks */
+bool pzl_pack_chk_mem_rec(pzl_ctx_t *context, uint8_t *data, uint64_t *offset)
+{
+    CHECK_PTR(context, "pzl_pack_chk_mem_rec - context");
+    CHECK_PTR(context->mem_rec, "pzl_pack_chk_mem_rec - context->mem_rec");
+
+    /* Locals */
+    uint64_t chk_size = context->hdr_rec.chk_size;
+    uint64_t slack = pzl_chk_slack(chk_size);
+    uint64_t job_cnt = 0;
+    uint64_t job_idx;
+    uint64_t chk_idx;
+    uint64_t slot_off;
+    uint64_t rec_idx;
+    pzl_chk_jobs_t jobs;
+    mem_rec_t *cur_mem_rec;
+
+    /* One job per chunk */
+    for(rec_idx = 0; rec_idx < context->mem_rec_cnt; rec_idx++)
+        job_cnt += PZL_CHK_CNT(context->mem_rec[rec_idx]->size, chk_size);
+
+    jobs.context = context;
+    jobs.data = data;
+    jobs.job = (pzl_chk_job_t *) malloc((job_cnt ? job_cnt : 1) * sizeof(pzl_chk_job_t));
+    if(jobs.job == NULL)
+    {
+        printf("pzl_pack_chk_mem_rec: cannot allocate chunk jobs\n");
+        return false;
+    }
+
+    /* Give every chunk a slot in the worst case layout bounded by pzl_pack_chk_size */
+    job_idx = 0;
+    slot_off = *offset;
+    for(rec_idx = 0; rec_idx < context->mem_rec_cnt; rec_idx++)
+    {
+        cur_mem_rec = context->mem_rec[rec_idx];
+        uint64_t chk_cnt = PZL_CHK_CNT(cur_mem_rec->size, chk_size);
+
+        slot_off += PZL_MEM_REC_HDR_SIZE + cur_mem_rec->str_size;
+        slot_off += sizeof(chk_cnt) + chk_cnt * sizeof(uint64_t);
+        for(chk_idx = 0; chk_idx < chk_cnt; chk_idx++, job_idx++)
+        {
+            jobs.job[job_idx].mem_rec = cur_mem_rec;
+            jobs.job[job_idx].chk_idx = chk_idx;
+            jobs.job[job_idx].slot_off = slot_off;
+            slot_off += PZL_CHK_LEN(cur_mem_rec->size, chk_idx, chk_size) + slack;
+        }
+    }
+
+    /* Compress in parallel */
+    if(!pzl_run_jobs(context, job_cnt, pzl_pack_chk_job, &jobs))
+    {
+        printf("pzl_pack_chk_mem_rec: cannot compress chunks\n");
+        free(jobs.job);
+        return false;
+    }
+
+    /*
+    Compact in order. Every field lands at or before its slot so writing a
+    record never overwrites chunks that have not been moved yet.
+    */
+    job_idx = 0;
+    for(rec_idx = 0; rec_idx < context->mem_rec_cnt; rec_idx++)
+    {
+        cur_mem_rec = context->mem_rec[rec_idx];
+        uint64_t rec_start = *offset;
+        uint64_t chk_cnt = PZL_CHK_CNT(cur_mem_rec->size, chk_size);
+
+        /* Type */
+        memcpy(data + *offset, &(cur_mem_rec->type), sizeof(cur_mem_rec->type));
+        *offset += sizeof(cur_mem_rec->type);
+
+        /* Length is written once the chunks are placed */
+        uint64_t len_off = *offset;
+        *offset += sizeof(cur_mem_rec->length);
+
+        /* Start */
+        memcpy(data + *offset, &(cur_mem_rec->start), sizeof(cur_mem_rec->start));
+        *offset += sizeof(cur_mem_rec->start);
+
+        /* End */
+        memcpy(data + *offset, &(cur_mem_rec->end), sizeof(cur_mem_rec->end));
+        *offset += sizeof(cur_mem_rec->end);
+
+        /* Size */
+        memcpy(data + *offset, &(cur_mem_rec->size), sizeof(cur_mem_rec->size));
+        *offset += sizeof(cur_mem_rec->size);
+
+        /* Permissions */
+        memcpy(data + *offset, &(cur_mem_rec->perms), sizeof(cur_mem_rec->perms));
+        *offset += sizeof(cur_mem_rec->perms);
+
+        /* String flag */
+        memcpy(data + *offset, &(cur_mem_rec->str_flag), sizeof(cur_mem_rec->str_flag));
+        *offset += sizeof(cur_mem_rec->str_flag);
+
+        /* String size */
+        memcpy(data + *offset, &(cur_mem_rec->str_size), sizeof(cur_mem_rec->str_size));
+        *offset += sizeof(cur_mem_rec->str_size);
+
+        /* Pack name string */
+        if(cur_mem_rec->str_flag == 0x01)
+        {
+            memcpy(data + *offset, cur_mem_rec->str, cur_mem_rec->str_size);
+            *offset += cur_mem_rec->str_size;
+        }
+
+        /* Chunk count */
+        memcpy(data + *offset, &chk_cnt, sizeof(chk_cnt));
+        *offset += sizeof(chk_cnt);
+
+        /* Chunk index */
+        for(chk_idx = 0; chk_idx < chk_cnt; chk_idx++)
+        {
+            memcpy(data + *offset, &(jobs.job[job_idx + chk_idx].cmp_len), sizeof(uint64_t));
+            *offset += sizeof(uint64_t);
+        }
+
+        /* Chunks */
+        for(chk_idx = 0; chk_idx < chk_cnt; chk_idx++, job_idx++)
+        {
+            memmove(data + *offset, data + jobs.job[job_idx].slot_off, jobs.job[job_idx].cmp_len);
+            *offset += jobs.job[job_idx].cmp_len;
+        }
+
+        /* Length */
+        uint64_t length = *offset - rec_start;
+        memcpy(data + len_off, &length, sizeof(length));
+    }
+    free(jobs.job);
+
+    return true;
+}
+
+/* Worst case space of one compressed chunk */
+uint64_t pzl_pack_chk_slot(pzl_ctx_t *context)
+{
+    CHECK_PTR(context, "pzl_pack_chk_slot - context");
+
+    return context->hdr_rec.chk_size + pzl_chk_slack(context->hdr_rec.chk_size);
+}
+
+/* Compress consecutive chunks of src into pzl_pack_chk_slot sized slots of dst */
+bool pzl_pack_chk_batch(pzl_ctx_t *context,
+                        uint8_t *src,
+                        uint64_t src_len,
+                        uint8_t *dst,
+                        uint64_t *cmp_len)
+{
+    CHECK_PTR(context, "pzl_pack_chk_batch - context");
+    CHECK_PTR(src, "pzl_pack_chk_batch - src");
+    CHECK_PTR(dst, "pzl_pack_chk_batch - dst");
+    CHECK_PTR(cmp_len, "pzl_pack_chk_batch - cmp_len");
+
+    /* Locals */
+    uint64_t chk_size = context->hdr_rec.chk_size;
+    uint64_t job_cnt = PZL_CHK_CNT(src_len, chk_size);
+    uint64_t job_idx;
+    pzl_chk_jobs_t jobs;
+    mem_rec_t batch;
+    bool ret;
+
+    if(job_cnt == 0)
+        return true;
+
+    /* Batch stands in for a record holding just these chunks */
+    memset(&batch, 0, sizeof(batch));
+    batch.dat = src;
+    batch.size = src_len;
+
+    jobs.context = context;
+    jobs.data = dst;
+    jobs.job = (pzl_chk_job_t *) malloc(job_cnt * sizeof(pzl_chk_job_t));
+    if(jobs.job == NULL)
+    {
+        printf("pzl_pack_chk_batch: cannot allocate chunk jobs\n");
+        return false;
+    }
+    for(job_idx = 0; job_idx < job_cnt; job_idx++)
+    {
+        jobs.job[job_idx].mem_rec = &batch;
+        jobs.job[job_idx].chk_idx = job_idx;
+        jobs.job[job_idx].slot_off = job_idx * pzl_pack_chk_slot(context);
+    }
+
+    ret = pzl_run_jobs(context, job_cnt, pzl_pack_chk_job, &jobs);
+    for(job_idx = 0; ret && job_idx < job_cnt; job_idx++)
+        cmp_len[job_idx] = jobs.job[job_idx].cmp_len;
+    free(jobs.job);
+
+    return ret;
+}
+
+/* Worst case size of the chunked records */
+uint64_t pzl_pack_chk_size(pzl_ctx_t *context)
+{
+    CHECK_PTR(context, "pzl_pack_chk_size - context");
+
+    /* Locals */
+    uint64_t chk_size = context->hdr_rec.chk_size;
+    uint64_t cum_size = 0;
+
+    /* Every chunk may need slack beyond its raw size */
+    uint64_t rec_idx;
+    for(rec_idx = 0; rec_idx < context->mem_rec_cnt; rec_idx++)
+    {
+        mem_rec_t *mem_rec = context->mem_rec[rec_idx];
+        uint64_t chk_cnt = PZL_CHK_CNT(mem_rec->size, chk_size);
+        cum_size += mem_rec->length + sizeof(uint64_t) + chk_cnt * sizeof(uint64_t);
+        cum_size += chk_cnt * pzl_chk_slack(chk_size);
+    }
+    cum_size += pzl_get_reg_size(context);
+
+    return cum_size;
+}
+
+/***************************************************************/
+/*                         UNPACKING                           */
+/***************************************************************/
+bool pzl_unpack_chk(pzl_ctx_t *context,
+                    uint8_t *data,
+                    uint64_t *offset,
+                    uint64_t size,
+                    bool lazy)
+{
+    CHECK_PTR(context, "pzl_unpack_chk - context");
+    CHECK_PTR(data, "pzl_unpack_chk - data");
+    CHECK_PTR(offset, "pzl_unpack_chk - offset");
+    CHECK_SIZE(size, *offset, 2, "pzl_unpack_chk - data");
+
+    /* Memory records run until the register record */
+    uint16_t type;
+    memcpy(&type, data + *offset, sizeof(type));
+    while(type == 0x0001)
+    {
+        if(!pzl_unpack_chk_mem_rec(context, data, offset, size))
+        {
+            printf("pzl_unpack_chk: cannot unpack memory record\n");
+            return false;
+        }
+
+        CHECK_SIZE(size, *offset, 2, "pzl_unpack_chk - data");
+        memcpy(&type, data + *offset, sizeof(type));
+    }
+
+    /* Require at least one memory record */
+    if(context->mem_rec == NULL)
+    {
+        printf("pzl_unpack_chk: no memory records found\n");
+        return false;
+    }
+
+    /* Unpack register record */
+    if(!pzl_unpack_reg_rec(context, data, offset, size))
+    {
+        printf("pzl_unpack_chk: cannot unpack register record\n");
+        return false;
+    }
+
+    /* Inflate now when the compressed data will not outlive the call */
+    if(!lazy)
+    {
+        if(!pzl_load_mem_recs(context))
+        {
+            printf("pzl_unpack_chk: cannot load memory records\n");
+            return false;
+        }
+
+        uint64_t rec_idx;
+        for(rec_idx = 0; rec_idx < context->mem_rec_cnt; rec_idx++)
+            pzl_drop_mem_chk(context->mem_rec[rec_idx]);
+    }
+
+    return true;
+}
+
+/* Unpack single chunked memory record */
+bool pzl_unpack_chk_mem_rec(pzl_ctx_t *context,
+                            uint8_t *data,
+                            uint64_t *offset,
+                            uint64_t size)
+{
+    CHECK_PTR(context, "pzl_unpack_chk_mem_rec - context");
+    CHECK_PTR(data, "pzl_unpack_chk_mem_rec - data");
+    CHECK_PTR(offset, "pzl_unpack_chk_mem_rec - offset");
+    CHECK_SIZE(size, *offset, PZL_MEM_REC_HDR_SIZE, "pzl_unpack_chk_mem_rec - data");
+
+    /* Locals */
+    uint64_t rec_start = *offset;
+    uint64_t chk_size = context->hdr_rec.chk_size;
+    uint16_t mem_type;
+    uint64_t mem_len, mem_start, mem_end, mem_size, mem_str_len, chk_cnt, chk_idx;
+    uint8_t mem_perms, mem_str_flag;
+    uint8_t *mem_str = NULL;
+    uint8_t *mem_dat;
+    mem_rec_t *mem_rec;
+
+    /* Type */
+    memcpy(&mem_type, data + *offset, sizeof(mem_type));
+    *offset += sizeof(mem_type);
+    if(mem_type != 0x0001)
+    {
+        printf("pzl_unpack_chk_mem_rec: cannot find memory record\n");
+        return false;
+    }
+
+    /* Length */
+    memcpy(&mem_len, data + *offset, sizeof(mem_len));
+    *offset += sizeof(mem_len);
+    if(mem_len > size - rec_start || mem_len < PZL_MEM_REC_HDR_SIZE + sizeof(chk_cnt))
+    {
+        printf("pzl_unpack_chk_mem_rec: not enough data remaining\n");
+        return false;
+    }
+
+    /* Start */
+    memcpy(&mem_start, data + *offset, sizeof(mem_start));
+    *offset += sizeof(mem_start);
+
+    /* End */
+    memcpy(&mem_end, data + *offset, sizeof(mem_end));
+    *offset += sizeof(mem_end);
+
+    /* Size */
+    memcpy(&mem_size, data + *offset, sizeof(mem_size));
+    *offset += sizeof(mem_size);
+
+    /* Permissions */
+    memcpy(&mem_perms, data + *offset, sizeof(mem_perms));
+    *offset += sizeof(mem_perms);
+
+    /* String flag */
+    memcpy(&mem_str_flag, data + *offset, sizeof(mem_str_flag));
+    *offset += sizeof(mem_str_flag);
+
+    /* String length */
+    memcpy(&mem_str_len, data + *offset, sizeof(mem_str_len));
+    *offset += sizeof(mem_str_len);
+    if(mem_str_flag != 0x01)
+        mem_str_len = 0;
+    if(mem_str_len > mem_len - PZL_MEM_REC_HDR_SIZE - sizeof(chk_cnt))
+    {
+        printf("pzl_unpack_chk_mem_rec: string exceeds record length\n");
+        return false;
+    }
+
+    /* String */
+    if(mem_str_flag == 0x01)
+        mem_str = data + *offset;
+    *offset += mem_str_len;
+
+    /* Chunk count */
+    memcpy(&chk_cnt, data + *offset, sizeof(chk_cnt));
+    *offset += sizeof(chk_cnt);
+    if(mem_size == 0 || chk_cnt != PZL_CHK_CNT(mem_size, chk_size) ||
+       chk_cnt > (rec_start + mem_len - *offset) / sizeof(uint64_t))
+    {
+        printf("pzl_unpack_chk_mem_rec: chunk index does not match record size\n");
+        return false;
+    }
+
+    /* Anonymous mapping keeps unloaded chunks free */
+    mem_dat = (uint8_t *) mmap(NULL, mem_size, PROT_READ | PROT_WRITE,
+                               MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(mem_dat == MAP_FAILED)
+    {
+        printf("pzl_unpack_chk_mem_rec: cannot map data buffer\n");
+        return false;
+    }
+
+    /* Create memory record */
+    mem_rec = pzl_add_mem_rec(context,
+                              mem_start,
+                              mem_end,
+                              mem_size,
+                              mem_perms,
+                              mem_dat,
+                              false,
+                              mem_str_len,
+                              mem_str);
+    if(mem_rec == NULL)
+    {
+        printf("pzl_unpack_chk_mem_rec: cannot create memory record\n");
+        munmap(mem_dat, mem_size);
+        return false;
+    }
+    mem_rec->dat_map = true;
+
+    /* Chunk index */
+    mem_rec->chk_off = (uint64_t *) malloc((chk_cnt + 1) * sizeof(uint64_t));
+    mem_rec->chk_ld = (uint8_t *) calloc(chk_cnt, sizeof(uint8_t));
+    if(mem_rec->chk_off == NULL || mem_rec->chk_ld == NULL)
+    {
+        printf("pzl_unpack_chk_mem_rec: cannot allocate chunk index\n");
+        return false;
+    }
+    mem_rec->chk_cnt = chk_cnt;
+
+    /* Offsets are relative to the first chunk */
+    uint64_t cmp_len;
+    uint64_t cmp_end = rec_start + mem_len - (*offset + chk_cnt * sizeof(uint64_t));
+    mem_rec->chk_off[0] = 0;
+    for(chk_idx = 0; chk_idx < chk_cnt; chk_idx++)
+    {
+        memcpy(&cmp_len, data + *offset, sizeof(cmp_len));
+        *offset += sizeof(cmp_len);
+
+        mem_rec->chk_off[chk_idx + 1] = mem_rec->chk_off[chk_idx] + cmp_len;
+        if(cmp_len > chk_size || mem_rec->chk_off[chk_idx + 1] > cmp_end)
+        {
+            printf("pzl_unpack_chk_mem_rec: chunk exceeds record length\n");
+            return false;
+        }
+    }
+    mem_rec->cmp_dat = data + *offset;
+    *offset = rec_start + mem_len;
+
+    return true;
+}
+
+/* Inflate a single chunk of a memory record */
+bool pzl_load_mem_chk(pzl_ctx_t *context, mem_rec_t *mem_rec, uint64_t chk_idx)
+{
+    CHECK_PTR(context, "pzl_load_mem_chk - context");
+    CHECK_PTR(mem_rec, "pzl_load_mem_chk - mem_rec");
+
+    /* Record already complete */
+    if(mem_rec->cmp_dat == NULL)
+        return true;
+
+    if(chk_idx >= mem_rec->chk_cnt)
+    {
+        printf("pzl_load_mem_chk: chunk %lu out of range\n", chk_idx);
+        return false;
+    }
+
+    /* Already inflated */
+    if(mem_rec->chk_ld[chk_idx])
+        return true;
+
+    /* Locals */
+    uint64_t chk_size = context->hdr_rec.chk_size;
+    uint8_t *dst = mem_rec->dat + chk_idx * chk_size;
+    uint64_t dst_len = PZL_CHK_LEN(mem_rec->size, chk_idx, chk_size);
+    uint8_t *src = mem_rec->cmp_dat + mem_rec->chk_off[chk_idx];
+    uint64_t src_len = mem_rec->chk_off[chk_idx + 1] - mem_rec->chk_off[chk_idx];
+
+    /* Zero chunks are already zero in the anonymous mapping */
+    if(src_len == dst_len)
+        memcpy(dst, src, dst_len);
+    else if(src_len != 0)
+    {
+        mz_ulong out_len = dst_len;
+        if(uncompress(dst, &out_len, src, src_len) != Z_OK || out_len != dst_len)
+        {
+            printf("pzl_load_mem_chk: cannot decompress chunk %lu of %p\n",
+                   chk_idx, (void *) mem_rec->start);
+            return false;
+        }
+    }
+    mem_rec->chk_ld[chk_idx] = 0x01;
+
+    return true;
+}
+
+/* Inflate every chunk of a memory record */
+bool pzl_load_mem_rec(pzl_ctx_t *context, mem_rec_t *mem_rec)
+{
+    CHECK_PTR(context, "pzl_load_mem_rec - context");
+    CHECK_PTR(mem_rec, "pzl_load_mem_rec - mem_rec");
+
+    uint64_t chk_idx;
+    for(chk_idx = 0; chk_idx < mem_rec->chk_cnt && mem_rec->cmp_dat != NULL; chk_idx++)
+    {
+        if(!pzl_load_mem_chk(context, mem_rec, chk_idx))
+            return false;
+    }
+
+    return true;
+}
+
+/* Inflate a chunk on behalf of pzl_run_jobs */
+static bool pzl_load_chk_job(void *arg, uint64_t job_idx)
+{
+    pzl_chk_jobs_t *jobs = (pzl_chk_jobs_t *) arg;
+
+    return pzl_load_mem_chk(jobs->context, jobs->job[job_idx].mem_rec, jobs->job[job_idx].chk_idx);
+}
+
+/* Inflate every memory record in the context */
+bool pzl_load_mem_recs(pzl_ctx_t *context)
+{
+    CHECK_PTR(context, "pzl_load_mem_recs - context");
+
+    /* Locals */
+    uint64_t job_cnt = 0;
+    uint64_t chk_idx;
+    uint64_t rec_idx;
+    pzl_chk_jobs_t jobs;
+    mem_rec_t *mem_rec;
+    bool ret;
+
+    /* One job per chunk not yet inflated */
+    for(rec_idx = 0; rec_idx < context->mem_rec_cnt; rec_idx++)
+    {
+        mem_rec = context->mem_rec[rec_idx];
+        for(chk_idx = 0; chk_idx < mem_rec->chk_cnt && mem_rec->cmp_dat != NULL; chk_idx++)
+            job_cnt += !mem_rec->chk_ld[chk_idx];
+    }
+    if(job_cnt == 0)
+        return true;
+
+    jobs.context = context;
+    jobs.data = NULL;
+    jobs.job = (pzl_chk_job_t *) malloc(job_cnt * sizeof(pzl_chk_job_t));
+    if(jobs.job == NULL)
+    {
+        printf("pzl_load_mem_recs: cannot allocate chunk jobs\n");
+        return false;
+    }
+
+    job_cnt = 0;
+    for(rec_idx = 0; rec_idx < context->mem_rec_cnt; rec_idx++)
+    {
+        mem_rec = context->mem_rec[rec_idx];
+        for(chk_idx = 0; chk_idx < mem_rec->chk_cnt && mem_rec->cmp_dat != NULL; chk_idx++)
+        {
+            if(mem_rec->chk_ld[chk_idx])
+                continue;
+            jobs.job[job_cnt].mem_rec = mem_rec;
+            jobs.job[job_cnt].chk_idx = chk_idx;
+            job_cnt++;
+        }
+    }
+
+    /* Chunks inflate into disjoint pages */
+    ret = pzl_run_jobs(context, job_cnt, pzl_load_chk_job, &jobs);
+    free(jobs.job);
+
+    return ret;
+}
+
+/* Release the chunk index of a memory record */
+bool pzl_drop_mem_chk(mem_rec_t *mem_rec)
+{
+    CHECK_PTR(mem_rec, "pzl_drop_mem_chk - mem_rec");
+
+    free(mem_rec->chk_off);
+    mem_rec->chk_off = NULL;
+    free(mem_rec->chk_ld);
+    mem_rec->chk_ld = NULL;
+    mem_rec->chk_cnt = 0;
+    mem_rec->cmp_dat = NULL;
+
+    return true;
+}
@@ -0,0 +1,409 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <puzzle.h>
+
+
+/* Fold the next file backed page into a record hash */
+uint64_t pzl_hash_file_page(uint64_t hash, uint8_t *page, uint64_t len)
+{
+    return (hash ^ pzl_hash_page(page, len)) * PZL_FNV_PRIME;
+}
+
+/* Hash of the clean pages of a record, in page order */
+static uint64_t pzl_hash_file_pages(uint8_t *dat, uint64_t size, uint8_t *clean)
+{
+    uint64_t hash = PZL_FNV_OFFSET;
+    uint64_t page;
+
+    for(page = 0; page < PZL_PAGE_CNT(size); page++)
+    {
+        if(clean[page / 8] & (1 << (page % 8)))
+            hash = pzl_hash_file_page(hash, dat + page * PZL_PAGE_SIZE, PZL_PAGE_LEN(size, page));
+    }
+
+    return hash;
+}
+
+/* Mark the pages of the record at start that still match its file */
+bool pzl_set_mem_rec_file(pzl_ctx_t *context, uint64_t start, uint64_t file_off, uint8_t *clean)
+{
+    CHECK_PTR(context, "pzl_set_mem_rec_file - context");
+    CHECK_PTR(clean, "pzl_set_mem_rec_file - clean");
+
+    /* Record must be named after its file */
+    mem_rec_t *mem_rec = pzl_find_mem_rec(context, start);
+    if(mem_rec == NULL || mem_rec->start != start || mem_rec->str_flag != 0x01)
+    {
+        printf("pzl_set_mem_rec_file: no named memory record at %p\n", (void *) start);
+        return false;
+    }
+    if(file_off % PZL_PAGE_SIZE != 0)
+    {
+        printf("pzl_set_mem_rec_file: file offset is not page aligned\n");
+        return false;
+    }
+
+    uint8_t *file_bmp = (uint8_t *) malloc(PZL_BMP_SIZE(mem_rec->size));
+    if(file_bmp == NULL)
+    {
+        printf("pzl_set_mem_rec_file: cannot allocate page bitmap\n");
+        return false;
+    }
+    memcpy(file_bmp, clean, PZL_BMP_SIZE(mem_rec->size));
+
+    free(mem_rec->file_bmp);
+    mem_rec->file_bmp = file_bmp;
+    mem_rec->file_off = file_off;
+
+    return true;
+}
+
+/* Prefix file memory record paths with root when loading */
+bool pzl_set_root(pzl_ctx_t *context, const char *root)
+{
+    CHECK_PTR(context, "pzl_set_root - context");
+
+    context->root = root;
+
+    return true;
+}
+
+/* Hash the referenced pages of file memory records when loading */
+bool pzl_set_verify(pzl_ctx_t *context, bool verify)
+{
+    CHECK_PTR(context, "pzl_set_verify - context");
+
+    context->verify = verify;
+
+    return true;
+}
+
+/* Pack memory record storing only the pages that differ from its file */
+bool pzl_pack_file_mem_rec(mem_rec_t *mem_rec, uint8_t *data, uint64_t *offset)
+{
+    CHECK_PTR(mem_rec, "pzl_pack_file_mem_rec - mem_rec");
+    CHECK_PTR(mem_rec->file_bmp, "pzl_pack_file_mem_rec - mem_rec->file_bmp");
+    CHECK_PTR(data, "pzl_pack_file_mem_rec - data");
+
+    /* Locals */
+    uint16_t type = 0x0005;
+    uint64_t rec_start = *offset;
+    uint64_t page_cnt = PZL_PAGE_CNT(mem_rec->size);
+    uint64_t hash = pzl_hash_file_pages(mem_rec->dat, mem_rec->size, mem_rec->file_bmp);
+    uint64_t page;
+
+    /* Type */
+    memcpy(data + *offset, &type, sizeof(type));
+    *offset += sizeof(type);
+
+    /* Length is written once the pages are stored */
+    uint64_t len_off = *offset;
+    *offset += sizeof(mem_rec->length);
+
+    /* Start */
+    memcpy(data + *offset, &(mem_rec->start), sizeof(mem_rec->start));
+    *offset += sizeof(mem_rec->start);
+
+    /* End */
+    memcpy(data + *offset, &(mem_rec->end), sizeof(mem_rec->end));
+    *offset += sizeof(mem_rec->end);
+
+    /* Size */
+    memcpy(data + *offset, &(mem_rec->size), sizeof(mem_rec->size));
+    *offset += sizeof(mem_rec->size);
+
+    /* Permissions */
+    memcpy(data + *offset, &(mem_rec->perms), sizeof(mem_rec->perms));
+    *offset += sizeof(mem_rec->perms);
+
+    /* String flag */
+    memcpy(data + *offset, &(mem_rec->str_flag), sizeof(mem_rec->str_flag));
+    *offset += sizeof(mem_rec->str_flag);
+
+    /* String size */
+    memcpy(data + *offset, &(mem_rec->str_size), sizeof(mem_rec->str_size));
+    *offset += sizeof(mem_rec->str_size);
+
+    /* Pack name string */
+    memcpy(data + *offset, mem_rec->str, mem_rec->str_size);
+    *offset += mem_rec->str_size;
+
+    /* File offset */
+    memcpy(data + *offset, &(mem_rec->file_off), sizeof(mem_rec->file_off));
+    *offset += sizeof(mem_rec->file_off);
+
+    /* Hash */
+    memcpy(data + *offset, &hash, sizeof(hash));
+    *offset += sizeof(hash);
+
+    /* Page count */
+    memcpy(data + *offset, &page_cnt, sizeof(page_cnt));
+    *offset += sizeof(page_cnt);
+
+    /* Bitmap of stored pages is the complement of the clean ones */
+    uint8_t *bmp = data + *offset;
+    memset(bmp, 0, PZL_BMP_SIZE(mem_rec->size));
+    *offset += PZL_BMP_SIZE(mem_rec->size);
+
+    /* Padding */
+    uint64_t dat_off = PZL_PAGE_ALIGN(*offset);
+    memset(data + *offset, 0, dat_off - *offset);
+    *offset = dat_off;
+
+    /* Pages written by the process */
+    for(page = 0; page < page_cnt; page++)
+    {
+        uint64_t src_len = PZL_PAGE_LEN(mem_rec->size, page);
+
+        if(mem_rec->file_bmp[page / 8] & (1 << (page % 8)))
+            continue;
+
+        bmp[page / 8] |= 1 << (page % 8);
+        memcpy(data + *offset, mem_rec->dat + page * PZL_PAGE_SIZE, src_len);
+        *offset += src_len;
+    }
+
+    /* Length */
+    uint64_t length = *offset - rec_start;
+    memcpy(data + len_off, &length, sizeof(length));
+
+    return true;
+}
+
+/* Unpack file memory record by mapping the local copy of its file */
+bool pzl_unpack_file_mem_rec(pzl_ctx_t *context,
+                             uint8_t *data,
+                             uint64_t *offset,
+                             uint64_t size,
+                             bool ref)
+{
+    CHECK_PTR(context, "pzl_unpack_file_mem_rec - context");
+    CHECK_PTR(data, "pzl_unpack_file_mem_rec - data");
+    CHECK_PTR(offset, "pzl_unpack_file_mem_rec - offset");
+    CHECK_SIZE(size, *offset, PZL_MEM_REC_HDR_SIZE, "pzl_unpack_file_mem_rec - data");
+
+    /* Locals */
+    uint64_t rec_start = *offset;
+    uint16_t mem_type;
+    uint64_t mem_len, mem_start, mem_end, mem_size, mem_str_len, file_off, hash, page_cnt, page;
+    uint64_t file_end, stored = 0;
+    uint8_t mem_perms, mem_str_flag;
+    uint8_t *mem_str;
+    uint8_t *mem_dat;
+    uint8_t *bmp;
+    uint8_t *clean;
+    char path[PATH_MAX];
+    struct stat statbuf;
+    int32_t fd;
+
+    /* Type */
+    memcpy(&mem_type, data + *offset, sizeof(mem_type));
+    *offset += sizeof(mem_type);
+    if(mem_type != 0x0005)
+    {
+        printf("pzl_unpack_file_mem_rec: cannot find file memory record\n");
+        return false;
+    }
+
+    /* Length */
+    memcpy(&mem_len, data + *offset, sizeof(mem_len));
+    *offset += sizeof(mem_len);
+    if(mem_len > size - rec_start || mem_len < PZL_MEM_REC_HDR_SIZE + 8 + 8 + 8)
+    {
+        printf("pzl_unpack_file_mem_rec: not enough data remaining\n");
+        return false;
+    }
+
+    /* Start */
+    memcpy(&mem_start, data + *offset, sizeof(mem_start));
+    *offset += sizeof(mem_start);
+
+    /* End */
+    memcpy(&mem_end, data + *offset, sizeof(mem_end));
+    *offset += sizeof(mem_end);
+
+    /* Size */
+    memcpy(&mem_size, data + *offset, sizeof(mem_size));
+    *offset += sizeof(mem_size);
+
+    /* Permissions */
+    memcpy(&mem_perms, data + *offset, sizeof(mem_perms));
+    *offset += sizeof(mem_perms);
+
+    /* String flag */
+    memcpy(&mem_str_flag, data + *offset, sizeof(mem_str_flag));
+    *offset += sizeof(mem_str_flag);
+
+    /* String length, the path is required */
+    memcpy(&mem_str_len, data + *offset, sizeof(mem_str_len));
+    *offset += sizeof(mem_str_len);
+    if(mem_str_flag != 0x01 || mem_str_len == 0 ||
+       mem_str_len > mem_len - PZL_MEM_REC_HDR_SIZE - 8 - 8 - 8)
+    {
+        printf("pzl_unpack_file_mem_rec: record does not name its file\n");
+        return false;
+    }
+
+    /* String */
+    mem_str = data + *offset;
+    *offset += mem_str_len;
+
+    /* File offset and hash */
+    memcpy(&file_off, data + *offset, sizeof(file_off));
+    *offset += sizeof(file_off);
+    memcpy(&hash, data + *offset, sizeof(hash));
+    *offset += sizeof(hash);
+
+    /* Page count and bitmap */
+    memcpy(&page_cnt, data + *offset, sizeof(page_cnt));
+    *offset += sizeof(page_cnt);
+    if(mem_size == 0 || page_cnt != PZL_PAGE_CNT(mem_size) || file_off % PZL_PAGE_SIZE != 0 ||
+       PZL_BMP_SIZE(mem_size) > rec_start + mem_len - *offset)
+    {
+        printf("pzl_unpack_file_mem_rec: bitmap does not match record size\n");
+        return false;
+    }
+    bmp = data + *offset;
+    *offset = PZL_PAGE_ALIGN(*offset + PZL_BMP_SIZE(mem_size));
+
+    /* Stored pages must end the record */
+    for(page = 0; page < page_cnt; page++)
+    {
+        if(bmp[page / 8] & (1 << (page % 8)))
+            stored += PZL_PAGE_LEN(mem_size, page);
+    }
+    if(*offset + stored != rec_start + mem_len)
+    {
+        printf("pzl_unpack_file_mem_rec: pages do not match record length\n");
+        return false;
+    }
+
+    /* Local copy of the file */
+    if(snprintf(path, sizeof(path), "%s%.*s", context->root ? context->root : "",
+                (int) mem_str_len, mem_str) >= (int) sizeof(path))
+    {
+        printf("pzl_unpack_file_mem_rec: path of %p is too long\n", (void *) mem_start);
+        return false;
+    }
+    fd = open(path, O_RDONLY);
+    if(fd < 0 || fstat(fd, &statbuf) != 0)
+    {
+        printf("pzl_unpack_file_mem_rec: cannot open '%s'\n", path);
+        if(fd >= 0)
+            close(fd);
+        return false;
+    }
+    file_end = PZL_PAGE_ALIGN(statbuf.st_size);
+
+    /* Clean pages are kept for repacking */
+    clean = (uint8_t *) malloc(PZL_BMP_SIZE(mem_size));
+    if(clean == NULL)
+    {
+        printf("pzl_unpack_file_mem_rec: cannot allocate page bitmap\n");
+        close(fd);
+        return false;
+    }
+    for(page = 0; page < PZL_BMP_SIZE(mem_size); page++)
+        clean[page] = ~bmp[page];
+
+    /* Pages past the end of the file stay untouched anonymous memory */
+    mem_dat = (uint8_t *) mmap(NULL, mem_size, PROT_READ | PROT_WRITE,
+                               MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(mem_dat == MAP_FAILED)
+    {
+        printf("pzl_unpack_file_mem_rec: cannot map data buffer\n");
+        free(clean);
+        close(fd);
+        return false;
+    }
+
+    /* Map runs of clean pages from the file and place runs of stored ones */
+    page = 0;
+    while(page < page_cnt)
+    {
+        bool is_stored = bmp[page / 8] & (1 << (page % 8));
+        uint64_t run_start = page;
+        while(page < page_cnt && (bool) (bmp[page / 8] & (1 << (page % 8))) == is_stored)
+            page++;
+
+        uint8_t *dst = mem_dat + run_start * PZL_PAGE_SIZE;
+        uint64_t run_len = (page - run_start - 1) * PZL_PAGE_SIZE +
+                           PZL_PAGE_LEN(mem_size, page - 1);
+
+        /* File pages copy-on-write, clipped to the end of the file */
+        if(!is_stored)
+        {
+            uint64_t run_off = file_off + run_start * PZL_PAGE_SIZE;
+            uint64_t map_len = run_off < file_end ? file_end - run_off : 0;
+            if(map_len > PZL_PAGE_ALIGN(run_len))
+                map_len = PZL_PAGE_ALIGN(run_len);
+            if(map_len > 0 &&
+               mmap(dst, map_len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED,
+                    fd, run_off) == MAP_FAILED)
+            {
+                printf("pzl_unpack_file_mem_rec: cannot map '%s' at %p\n", path, (void *) mem_start);
+                goto error;
+            }
+            continue;
+        }
+
+        /* Whole pages of a mapped UZL file are mapped over the reservation */
+        uint64_t map_len = 0;
+        if(ref && data == context->map && context->map_fd >= 0)
+            map_len = run_len & ~((uint64_t) PZL_PAGE_SIZE - 1);
+        if(map_len > 0 &&
+           mmap(dst, map_len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED,
+                context->map_fd, *offset) == MAP_FAILED)
+        {
+            printf("pzl_unpack_file_mem_rec: cannot map pages of %p\n", (void *) mem_start);
+            goto error;
+        }
+        memcpy(dst + map_len, data + *offset + map_len, run_len - map_len);
+        *offset += run_len;
+    }
+    close(fd);
+    fd = -1;
+
+    /* Local copy must hold what the process had mapped, hashing faults in every page */
+    if(context->verify && pzl_hash_file_pages(mem_dat, mem_size, clean) != hash)
+    {
+        printf("pzl_unpack_file_mem_rec: '%s' differs from the snapshot\n", path);
+        goto error;
+    }
+
+    /* Create memory record */
+    mem_rec_t *mem_rec = pzl_add_mem_rec(context,
+                                         mem_start,
+                                         mem_end,
+                                         mem_size,
+                                         mem_perms,
+                                         mem_dat,
+                                         false,
+                                         mem_str_len,
+                                         mem_str);
+    if(mem_rec == NULL)
+    {
+        printf("pzl_unpack_file_mem_rec: cannot create memory record\n");
+        goto error;
+    }
+    mem_rec->dat_map = true;
+    mem_rec->file_off = file_off;
+    mem_rec->file_bmp = clean;
+
+    return true;
+
+error:
+    if(fd >= 0)
+        close(fd);
+    munmap(mem_dat, mem_size);
+    free(clean);
+    return false;
+}
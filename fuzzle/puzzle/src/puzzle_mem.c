@@ -2,38 +2,44 @@
 #include <stdlib.h>
 #include <stdbool.h>
 #include <string.h>
+#include <sys/mman.h>
 #include <puzzle.h>
 
 
-/* Create memory record */
-bool pzl_create_mem_rec(pzl_ctx_t *context,
+/* Build memory record around a data buffer */
+mem_rec_t *pzl_add_mem_rec(pzl_ctx_t *context,
                            uint64_t start,
                            uint64_t end,
                            uint64_t size,
                            uint8_t perms,
                            uint8_t *dat,
+                           bool dat_ref,
                            uint64_t str_size,
                            uint8_t *str)
 {
-    CHECK_PTR(context, "pzl_create_mem_record - context");
-    CHECK_PTR(dat, "pzl_create_mem_record - dat");
+    if(context == NULL)
+    {
+        printf("pzl_add_mem_rec - context: has not been allocated\n");
+        return NULL;
+    }
 
     /* Create mem_rec */
     mem_rec_t *mem_rec = (mem_rec_t *) malloc(sizeof(mem_rec_t));
     if(mem_rec == NULL)
     {
         printf("pzl_create_mem_record: cannot allocate space for memory record\n");
-        return false;
-    }
-
-    /* Create data buffer */
-    uint8_t *dat_buf = (uint8_t *) malloc(size);
-    if(dat_buf == NULL)
-    {
-        printf("pzl_create_mem_record: cannot allocate space for data buffer\n");
-        pzl_free_mem_rec(mem_rec);
-        return false;
+        return NULL;
     }
+    mem_rec->dat = NULL;
+    mem_rec->dat_ref = true;
+    mem_rec->dat_map = false;
+    mem_rec->chk_cnt = 0;
+    mem_rec->chk_off = NULL;
+    mem_rec->chk_ld = NULL;
+    mem_rec->cmp_dat = NULL;
+    mem_rec->file_off = 0;
+    mem_rec->file_bmp = NULL;
+    mem_rec->str = NULL;
 
     /* Initalise */
     if(str == NULL || str_size <= 0)
@@ -50,10 +56,8 @@ bool pzl_create_mem_rec(pzl_ctx_t *context,
         if(str_buf == NULL)
         {
             printf("pzl_create_mem_record: cannot allocate space for data buffer\n");
-            free(dat_buf);
-            dat_buf = NULL;
             pzl_free_mem_rec(mem_rec);
-            return false;
+            return NULL;
         }
         memcpy(str_buf, str, tmp_str_size);
         mem_rec->str_flag = 0x01;
@@ -62,54 +66,163 @@ bool pzl_create_mem_rec(pzl_ctx_t *context,
     }
 
     mem_rec->type = 0x0001;
-    mem_rec->length = (2 + 8 + 8 + 8 + 8 + 1 + 1 + 8 + mem_rec->str_size + size);
+    mem_rec->length = PZL_MEM_REC_HDR_SIZE + mem_rec->str_size + size;
     mem_rec->start = start;
     mem_rec->end = end;
     mem_rec->size = size;
     mem_rec->perms = perms;
-
-    /* Copy data buffer */
-    memcpy(dat_buf, dat, size);
-    mem_rec->dat = dat_buf;
-    mem_rec->next = NULL;
+    mem_rec->dat = dat;
+    mem_rec->dat_ref = dat_ref;
 
     if(pzl_append_mem_rec(context, mem_rec) == false)
     {
         printf("pzl_create_mem_record: cannot append mem_rec to context\n");
+        mem_rec->dat = NULL;
         pzl_free_mem_rec(mem_rec);
+        return NULL;
+    }
+
+    return mem_rec;
+}
+
+/* Create memory record */
+bool pzl_create_mem_rec(pzl_ctx_t *context,
+                           uint64_t start,
+                           uint64_t end,
+                           uint64_t size,
+                           uint8_t perms,
+                           uint8_t *dat,
+                           uint64_t str_size,
+                           uint8_t *str)
+{
+    CHECK_PTR(context, "pzl_create_mem_record - context");
+    CHECK_PTR(dat, "pzl_create_mem_record - dat");
+
+    /* Create data buffer */
+    uint8_t *dat_buf = (uint8_t *) malloc(size);
+    if(dat_buf == NULL)
+    {
+        printf("pzl_create_mem_record: cannot allocate space for data buffer\n");
+        return false;
+    }
+
+    /* Copy data buffer */
+    memcpy(dat_buf, dat, size);
+
+    if(pzl_add_mem_rec(context,
+                       start,
+                       end,
+                       size,
+                       perms,
+                       dat_buf,
+                       false,
+                       str_size,
+                       str) == NULL)
+    {
+        free(dat_buf);
+        dat_buf = NULL;
         return false;
     }
 
     return true;
 }
 
-/* Append new memory record to context */
+/* Create memory record referencing data owned by the caller */
+bool pzl_create_mem_rec_ref(pzl_ctx_t *context,
+                            uint64_t start,
+                            uint64_t end,
+                            uint64_t size,
+                            uint8_t perms,
+                            uint8_t *dat,
+                            uint64_t str_size,
+                            uint8_t *str)
+{
+    CHECK_PTR(context, "pzl_create_mem_rec_ref - context");
+    CHECK_PTR(dat, "pzl_create_mem_rec_ref - dat");
+
+    return pzl_add_mem_rec(context,
+                           start,
+                           end,
+                           size,
+                           perms,
+                           dat,
+                           true,
+                           str_size,
+                           str) != NULL;
+}
+
+/* Insert memory record keeping records sorted by start */
 bool pzl_append_mem_rec(pzl_ctx_t *context, mem_rec_t *mem_rec)
 {
     CHECK_PTR(context, "pzl_append_mem_rec - context");
+    CHECK_PTR(mem_rec, "pzl_append_mem_rec - mem_rec");
 
-    /* Set head */
-    if(context->mem_rec == NULL)
-        context->mem_rec = mem_rec;
-    /* Append to list*/
-    else
+    /* Grow array */
+    if(context->mem_rec_cnt == context->mem_rec_cap)
     {
-        mem_rec_t *cur_mem_rec = context->mem_rec;
-
-        /* Walk context mem_record list */
-        while(cur_mem_rec->next != NULL)
+        uint64_t cap = context->mem_rec_cap ? context->mem_rec_cap * 2 : 16;
+        mem_rec_t **recs = (mem_rec_t **) realloc(context->mem_rec, cap * sizeof(mem_rec_t *));
+        if(recs == NULL)
         {
-            /* Get next node */
-            cur_mem_rec = cur_mem_rec->next;
+            printf("pzl_append_mem_rec: cannot grow memory record array\n");
+            return false;
         }
+        context->mem_rec = recs;
+        context->mem_rec_cap = cap;
+    }
 
-        /* Update if head only */
-        cur_mem_rec->next = mem_rec;
+    /* Dumps arrive in address order so the tail is the common case */
+    uint64_t idx = context->mem_rec_cnt;
+    if(idx > 0 && context->mem_rec[idx - 1]->start > mem_rec->start)
+    {
+        /* First record starting after the new one */
+        uint64_t low = 0;
+        uint64_t high = idx;
+        while(low < high)
+        {
+            uint64_t mid = low + (high - low) / 2;
+            if(context->mem_rec[mid]->start > mem_rec->start)
+                high = mid;
+            else
+                low = mid + 1;
+        }
+        idx = low;
+        memmove(&(context->mem_rec[idx + 1]), &(context->mem_rec[idx]),
+                (context->mem_rec_cnt - idx) * sizeof(mem_rec_t *));
     }
+    context->mem_rec[idx] = mem_rec;
+    context->mem_rec_cnt++;
 
     return true;
 }
 
+/* Find memory record containing addr */
+mem_rec_t *pzl_find_mem_rec(pzl_ctx_t *context, uint64_t addr)
+{
+    if(context == NULL || context->mem_rec_cnt == 0)
+        return NULL;
+
+    /* Last record starting at or before addr */
+    uint64_t low = 0;
+    uint64_t high = context->mem_rec_cnt;
+    while(low < high)
+    {
+        uint64_t mid = low + (high - low) / 2;
+        if(context->mem_rec[mid]->start > addr)
+            high = mid;
+        else
+            low = mid + 1;
+    }
+    if(low == 0)
+        return NULL;
+
+    mem_rec_t *mem_rec = context->mem_rec[low - 1];
+    if(addr >= mem_rec->start + mem_rec->size)
+        return NULL;
+
+    return mem_rec;
+}
+
 /* Free memory record */
 bool pzl_free_mem_rec(mem_rec_t *mem_rec)
 {
@@ -120,8 +233,14 @@ bool pzl_free_mem_rec(mem_rec_t *mem_rec)
     /* Free memory */
     free(mem_rec->str);
     mem_rec->str = NULL;
-    free(mem_rec->dat);
+    if(!mem_rec->dat_ref && mem_rec->dat_map)
+        munmap(mem_rec->dat, mem_rec->size);
+    else if(!mem_rec->dat_ref)
+        free(mem_rec->dat);
     mem_rec->dat = NULL;
+    free(mem_rec->file_bmp);
+    mem_rec->file_bmp = NULL;
+    pzl_drop_mem_chk(mem_rec);
     free(mem_rec);
     mem_rec = NULL;
 
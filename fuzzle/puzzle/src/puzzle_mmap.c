@@ -0,0 +1,134 @@
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdbool.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <puzzle.h>
+
+
+/* Map UZL file and reference or decode its records */
+static bool pzl_open_map(pzl_ctx_t *context, const char *path, bool lazy)
+{
+    CHECK_PTR(context, "pzl_open_mmap - context");
+    CHECK_PTR(path, "pzl_open_mmap - path");
+
+    /* Locals */
+    bool ret;
+    int32_t fd;
+    uint8_t *map;
+    uint64_t size;
+    uint64_t offset;
+    struct stat statbuf;
+
+    /* One mapping per context */
+    if(context->map != NULL)
+    {
+        printf("pzl_open_mmap: context already has a mapped file\n");
+        return false;
+    }
+
+    /* Open file */
+    fd = open(path, O_RDONLY);
+    if(fd < 0)
+    {
+        printf("pzl_open_mmap: cannot open file '%s'\n", path);
+        return false;
+    }
+
+    /* Stat */
+    if(fstat(fd, &statbuf) != 0 || !S_ISREG(statbuf.st_mode) || statbuf.st_size < 1)
+    {
+        printf("pzl_open_mmap: cannot read file '%s'\n", path);
+        close(fd);
+        return false;
+    }
+    size = statbuf.st_size;
+
+    /* Private mapping so writes to region data never reach the file */
+    map = (uint8_t *) mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    if(map == MAP_FAILED)
+    {
+        printf("pzl_open_mmap: cannot map file '%s'\n", path);
+        close(fd);
+        return false;
+    }
+    context->map = map;
+    context->map_size = size;
+    context->map_fd = fd;
+
+    /* Unpack magic */
+    offset = 0;
+    if(!pzl_unpack_mgc(context, map, &offset, size))
+    {
+        printf("pzl_open_mmap: cannot unpack magic bytes\n");
+        pzl_close_mmap(context);
+        return false;
+    }
+
+    /* Unpack header */
+    if(!pzl_unpack_hdr_rec(context, map, &offset, size))
+    {
+        printf("pzl_open_mmap: cannot unpack header record\n");
+        pzl_close_mmap(context);
+        return false;
+    }
+
+    /* Chunked records inflate on demand straight from the mapping */
+    if(lazy && context->hdr_rec.version == PZL_VERSION_CHUNKED)
+    {
+        if(!pzl_unpack_chk(context, map, &offset, size, true))
+        {
+            printf("pzl_open_mmap: cannot unpack chunked records\n");
+            return false;
+        }
+        return true;
+    }
+
+    /* Compressed layouts are decoded into private buffers */
+    if(context->hdr_rec.version != PZL_VERSION_MMAP)
+    {
+        ret = pzl_unpack(context, map, size);
+        pzl_close_mmap(context);
+        return ret;
+    }
+
+    /* Reference records in place */
+    if(!pzl_unpack_raw(context, map, &offset, size, true))
+    {
+        printf("pzl_open_mmap: cannot unpack records\n");
+        return false;
+    }
+
+    return true;
+}
+
+/* Map UZL file and reference its records in place */
+bool pzl_open_mmap(pzl_ctx_t *context, const char *path)
+{
+    return pzl_open_map(context, path, false);
+}
+
+/* Map UZL file keeping chunked records compressed until loaded */
+bool pzl_open_lazy(pzl_ctx_t *context, const char *path)
+{
+    return pzl_open_map(context, path, true);
+}
+
+/* Unmap UZL file, records must no longer reference it */
+bool pzl_close_mmap(pzl_ctx_t *context)
+{
+    CHECK_PTR(context, "pzl_close_mmap - context");
+
+    if(context->map == NULL)
+        return true;
+
+    munmap(context->map, context->map_size);
+    close(context->map_fd);
+    context->map = NULL;
+    context->map_size = 0;
+    context->map_fd = -1;
+
+    return true;
+}
@@ -17,6 +17,21 @@ bool pzl_pack(pzl_ctx_t *context, uint8_t *data, uint64_t *size)
     CHECK_PTR(context->reg_rec, "pzl_pack - context->reg_rec");
     CHECK_PTR(size, "pzl_pack - size");
 
+    /* Lazily opened records must be complete */
+    if(!pzl_load_mem_recs(context))
+    {
+        printf("pzl_pack: cannot load memory records\n");
+        return false;
+    }
+
+    /* Uncompressed page aligned layout */
+    if(context->hdr_rec.version == PZL_VERSION_MMAP)
+        return pzl_pack_raw(context, data, size);
+
+    /* Per record chunked layout */
+    if(context->hdr_rec.version == PZL_VERSION_CHUNKED)
+        return pzl_pack_chk(context, data, size);
+
     /* Locals */
     uint32_t cmp_status;
     uint64_t mgc_size = pzl_get_mgc_size(context);
@@ -75,6 +90,7 @@ bool pzl_pack(pzl_ctx_t *context, uint8_t *data, uint64_t *size)
 
     /* Pack data */
     offset = 0;
+    context->hdr_rec.data_size = mem_size + reg_size;
     pzl_pack_mgc(context, data, &offset);
     pzl_pack_hdr_rec(context, data, &offset);
     pzl_pack_cmp_dat(cmp_data, data, &offset, cmp_size);
@@ -86,6 +102,41 @@ bool pzl_pack(pzl_ctx_t *context, uint8_t *data, uint64_t *size)
     return true;
 }
 
+/* Pack uncompressed page aligned layout */
+bool pzl_pack_raw(pzl_ctx_t *context, uint8_t *data, uint64_t *size)
+{
+    CHECK_PTR(context, "pzl_pack_raw - context");
+    CHECK_PTR(context->mem_rec, "pzl_pack_raw - context->mem_rec");
+    CHECK_PTR(context->reg_rec, "pzl_pack_raw - context->reg_rec");
+    CHECK_PTR(data, "pzl_pack_raw - data");
+    CHECK_PTR(size, "pzl_pack_raw - size");
+
+    /* Records follow the magic and header */
+    uint64_t dat_start = pzl_get_mgc_size(context) + pzl_get_hdr_size(context);
+    uint64_t offset = dat_start;
+
+    /* Pack records in place */
+    if(!pzl_pack_raw_mem_rec(context, data, &offset))
+    {
+        printf("pzl_pack_raw: cannot pack memory records\n");
+        return false;
+    }
+    if(!pzl_pack_reg_rec(context, data, &offset))
+    {
+        printf("pzl_pack_raw: cannot pack register record\n");
+        return false;
+    }
+    *size = offset;
+
+    /* Header carries the final data size */
+    offset = 0;
+    context->hdr_rec.data_size = *size - dat_start;
+    pzl_pack_mgc(context, data, &offset);
+    pzl_pack_hdr_rec(context, data, &offset);
+
+    return true;
+}
+
 /* Pack magic bytes */
 bool pzl_pack_mgc(pzl_ctx_t *context, uint8_t *data, uint64_t *offset)
 {
@@ -119,10 +170,24 @@ bool pzl_pack_hdr_rec(pzl_ctx_t *context, uint8_t *data, uint64_t *offset)
     *offset += sizeof(context->hdr_rec.arch);
 
     /* Date size  */
-    context->hdr_rec.data_size = pzl_get_mem_size(context) + pzl_get_reg_size(context);
     memcpy(data + *offset, &(context->hdr_rec.data_size), sizeof(context->hdr_rec.data_size));
     *offset += sizeof(context->hdr_rec.data_size);
 
+    /* Chunk size */
+    if(context->hdr_rec.version == PZL_VERSION_CHUNKED)
+    {
+        memcpy(data + *offset, &(context->hdr_rec.chk_size), sizeof(context->hdr_rec.chk_size));
+        *offset += sizeof(context->hdr_rec.chk_size);
+
+        /* Codec */
+        memcpy(data + *offset, &(context->hdr_rec.codec), sizeof(context->hdr_rec.codec));
+        *offset += sizeof(context->hdr_rec.codec);
+
+        /* Level */
+        memcpy(data + *offset, &(context->hdr_rec.level), sizeof(context->hdr_rec.level));
+        *offset += sizeof(context->hdr_rec.level);
+    }
+
     return true;
 }
 
@@ -132,10 +197,12 @@ bool pzl_pack_mem_rec(pzl_ctx_t *context, uint8_t *data, uint64_t *offset)
     CHECK_PTR(context, "pzl_pack_mem_rec - context");
     CHECK_PTR(context->mem_rec, "pzl_pack_mem_rec - context->mem_rec");
 
-    /* Walk list */
-    mem_rec_t *cur_mem_rec = context->mem_rec;
-    while(cur_mem_rec != NULL)
+    /* Walk records */
+    uint64_t idx;
+    for(idx = 0; idx < context->mem_rec_cnt; idx++)
     {
+        mem_rec_t *cur_mem_rec = context->mem_rec[idx];
+
         /* Type */
         memcpy(data + *offset, &(cur_mem_rec->type), sizeof(cur_mem_rec->type));
         *offset += sizeof(cur_mem_rec->type);
@@ -178,8 +245,99 @@ bool pzl_pack_mem_rec(pzl_ctx_t *context, uint8_t *data, uint64_t *offset)
             memcpy(data + *offset, cur_mem_rec->str, cur_mem_rec->str_size);
             *offset += cur_mem_rec->str_size;
         }
+    }
+
+    return true;
+}
+
+/* Pack memory records with page aligned data */
+bool pzl_pack_raw_mem_rec(pzl_ctx_t *context, uint8_t *data, uint64_t *offset)
+{
+    CHECK_PTR(context, "pzl_pack_raw_mem_rec - context");
+    CHECK_PTR(context->mem_rec, "pzl_pack_raw_mem_rec - context->mem_rec");
+
+    /* Walk records */
+    uint64_t idx;
+    for(idx = 0; idx < context->mem_rec_cnt; idx++)
+    {
+        mem_rec_t *cur_mem_rec = context->mem_rec[idx];
+
+        /* Clean pages of file mappings are left to the file */
+        if(cur_mem_rec->file_bmp != NULL)
+        {
+            if(!pzl_pack_file_mem_rec(cur_mem_rec, data, offset))
+                return false;
+            continue;
+        }
+
+        /* Pages live in the attached pool */
+        if(context->pool != NULL)
+        {
+            if(!pzl_pack_pool_mem_rec(context, cur_mem_rec, data, offset))
+                return false;
+            continue;
+        }
+
+        /* Records with zero pages only store the rest */
+        if(pzl_has_zero_page(cur_mem_rec))
+        {
+            if(!pzl_pack_sparse_mem_rec(cur_mem_rec, data, offset))
+                return false;
+            continue;
+        }
+
+        /* Length covers the padding in front of the data */
+        uint64_t rec_start = *offset;
+        uint64_t dat_off = PZL_PAGE_ALIGN(rec_start + PZL_MEM_REC_HDR_SIZE +
+                                          cur_mem_rec->str_size);
+        uint64_t length = dat_off + cur_mem_rec->size - rec_start;
+
+        /* Type */
+        memcpy(data + *offset, &(cur_mem_rec->type), sizeof(cur_mem_rec->type));
+        *offset += sizeof(cur_mem_rec->type);
+
+        /* Length */
+        memcpy(data + *offset, &length, sizeof(length));
+        *offset += sizeof(length);
+
+        /* Start */
+        memcpy(data + *offset, &(cur_mem_rec->start), sizeof(cur_mem_rec->start));
+        *offset += sizeof(cur_mem_rec->start);
+
+        /* End */
+        memcpy(data + *offset, &(cur_mem_rec->end), sizeof(cur_mem_rec->end));
+        *offset += sizeof(cur_mem_rec->end);
+
+        /* Size */
+        memcpy(data + *offset, &(cur_mem_rec->size), sizeof(cur_mem_rec->size));
+        *offset += sizeof(cur_mem_rec->size);
+
+        /* Permissions */
+        memcpy(data + *offset, &(cur_mem_rec->perms), sizeof(cur_mem_rec->perms));
+        *offset += sizeof(cur_mem_rec->perms);
+
+        /* String flag */
+        memcpy(data + *offset, &(cur_mem_rec->str_flag), sizeof(cur_mem_rec->str_flag));
+        *offset += sizeof(cur_mem_rec->str_flag);
+
+        /* String size */
+        memcpy(data + *offset, &(cur_mem_rec->str_size), sizeof(cur_mem_rec->str_size));
+        *offset += sizeof(cur_mem_rec->str_size);
+
+        /* Pack name string */
+        if(cur_mem_rec->str_flag == 0x01)
+        {
+            memcpy(data + *offset, cur_mem_rec->str, cur_mem_rec->str_size);
+            *offset += cur_mem_rec->str_size;
+        }
 
-        cur_mem_rec = cur_mem_rec->next;
+        /* Padding */
+        memset(data + *offset, 0, dat_off - *offset);
+        *offset = dat_off;
+
+        /* Data */
+        memcpy(data + *offset, cur_mem_rec->dat, cur_mem_rec->size);
+        *offset += cur_mem_rec->size;
     }
 
     return true;
@@ -231,6 +389,27 @@ uint64_t pzl_pack_size(pzl_ctx_t *context)
   uint64_t cum_size = 0;
   cum_size += pzl_get_mgc_size(context);
   cum_size += pzl_get_hdr_size(context);
+
+  /* Chunked records */
+  if(context->hdr_rec.version == PZL_VERSION_CHUNKED)
+      return cum_size + pzl_pack_chk_size(context);
+
+  /* Uncompressed records with worst case padding, sparse bitmaps or page index */
+  if(context->hdr_rec.version == PZL_VERSION_MMAP)
+  {
+      uint64_t idx;
+      for(idx = 0; idx < context->mem_rec_cnt; idx++)
+      {
+          mem_rec_t *mem_rec = context->mem_rec[idx];
+          cum_size += mem_rec->length + PZL_PAGE_SIZE - 1;
+          cum_size += sizeof(uint64_t) + (PZL_PAGE_CNT(mem_rec->size) + 7) / 8;
+          cum_size += 2 * sizeof(uint64_t) * (PZL_PAGE_CNT(mem_rec->size) + 1);
+      }
+      cum_size += pzl_get_reg_size(context);
+
+      return cum_size;
+  }
+
   cum_size += compressBound(pzl_get_mem_size(context) + \
                             pzl_get_reg_size(context));
 
@@ -269,6 +448,18 @@ bool pzl_unpack(pzl_ctx_t *context, uint8_t *data, uint64_t size)
         return false;
     }
 
+    /* Uncompressed layout */
+    if(context->hdr_rec.version == PZL_VERSION_MMAP)
+        return pzl_unpack_raw(context, data, &offset, size, false);
+    /* Chunked layout, inflated up front */
+    else if(context->hdr_rec.version == PZL_VERSION_CHUNKED)
+        return pzl_unpack_chk(context, data, &offset, size, false);
+    else if(context->hdr_rec.version != PZL_VERSION_DEFLATE)
+    {
+        printf("pzl_unpack: unknown version 0x%04x\n", context->hdr_rec.version);
+        return false;
+    }
+
     /* Unpack compressed data */
     ret = pzl_unpack_cmp_dat(&cmp_data, data, &offset, size);
     if(ret == false)
@@ -385,6 +576,37 @@ bool pzl_unpack_hdr_rec(pzl_ctx_t *context, uint8_t *data, uint64_t *offset, uin
     memcpy(&(context->hdr_rec.data_size), data + *offset, sizeof(context->hdr_rec.data_size));
     *offset += sizeof(context->hdr_rec.data_size);
 
+    /* Chunk size */
+    if(context->hdr_rec.version == PZL_VERSION_CHUNKED)
+    {
+        CHECK_SIZE(size, *offset, 8 + 1 + 1, "pzl_unpack_hdr_rec - data");
+        if(context->hdr_rec.length < (2 + 8 + 2 + 4 + 8 + 8 + 1 + 1))
+        {
+            printf("pzl_unpack_hdr_rec: header too short for chunked layout\n");
+            return false;
+        }
+        memcpy(&(context->hdr_rec.chk_size), data + *offset, sizeof(context->hdr_rec.chk_size));
+        *offset += sizeof(context->hdr_rec.chk_size);
+        if(context->hdr_rec.chk_size == 0 || context->hdr_rec.chk_size % PZL_PAGE_SIZE != 0)
+        {
+            printf("pzl_unpack_hdr_rec: invalid chunk size\n");
+            return false;
+        }
+
+        /* Codec */
+        memcpy(&(context->hdr_rec.codec), data + *offset, sizeof(context->hdr_rec.codec));
+        *offset += sizeof(context->hdr_rec.codec);
+        if(context->hdr_rec.codec != PZL_CODEC_NONE && context->hdr_rec.codec != PZL_CODEC_DEFLATE)
+        {
+            printf("pzl_unpack_hdr_rec: unknown codec 0x%02x\n", context->hdr_rec.codec);
+            return false;
+        }
+
+        /* Level */
+        memcpy(&(context->hdr_rec.level), data + *offset, sizeof(context->hdr_rec.level));
+        *offset += sizeof(context->hdr_rec.level);
+    }
+
     return true;
 }
 
@@ -528,6 +750,177 @@ bool pzl_unpack_sgl_mem_rec(pzl_ctx_t *context, uint8_t *data, uint64_t *offset,
     return true;
 }
 
+/* Unpack uncompressed page aligned records */
+bool pzl_unpack_raw(pzl_ctx_t *context,
+                    uint8_t *data,
+                    uint64_t *offset,
+                    uint64_t size,
+                    bool ref)
+{
+    CHECK_PTR(context, "pzl_unpack_raw - context");
+    CHECK_PTR(data, "pzl_unpack_raw - data");
+    CHECK_PTR(offset, "pzl_unpack_raw - offset");
+    CHECK_SIZE(size, *offset, 2, "pzl_unpack_raw - data");
+
+    /* Memory records run until the register record */
+    uint16_t type;
+    memcpy(&type, data + *offset, sizeof(type));
+    while(type == 0x0001 || type == 0x0003 || type == 0x0004 || type == 0x0005)
+    {
+        if(type == 0x0005 && !pzl_unpack_file_mem_rec(context, data, offset, size, ref))
+        {
+            printf("pzl_unpack_raw: cannot unpack file memory record\n");
+            return false;
+        }
+        if(type == 0x0004 && !pzl_unpack_pool_mem_rec(context, data, offset, size))
+        {
+            printf("pzl_unpack_raw: cannot unpack pooled memory record\n");
+            return false;
+        }
+        if(type == 0x0003 && !pzl_unpack_sparse_mem_rec(context, data, offset, size, ref))
+        {
+            printf("pzl_unpack_raw: cannot unpack sparse memory record\n");
+            return false;
+        }
+        if(type == 0x0001 && !pzl_unpack_raw_mem_rec(context, data, offset, size, ref))
+        {
+            printf("pzl_unpack_raw: cannot unpack memory record\n");
+            return false;
+        }
+
+        CHECK_SIZE(size, *offset, 2, "pzl_unpack_raw - data");
+        memcpy(&type, data + *offset, sizeof(type));
+    }
+
+    /* Require at least one memory record */
+    if(context->mem_rec == NULL)
+    {
+        printf("pzl_unpack_raw: no memory records found\n");
+        return false;
+    }
+
+    /* Unpack register record */
+    if(!pzl_unpack_reg_rec(context, data, offset, size))
+    {
+        printf("pzl_unpack_raw: cannot unpack register record\n");
+        return false;
+    }
+
+    return true;
+}
+
+/* Unpack single page aligned memory record */
+bool pzl_unpack_raw_mem_rec(pzl_ctx_t *context,
+                            uint8_t *data,
+                            uint64_t *offset,
+                            uint64_t size,
+                            bool ref)
+{
+    CHECK_PTR(context, "pzl_unpack_raw_mem_rec - context");
+    CHECK_PTR(data, "pzl_unpack_raw_mem_rec - data");
+    CHECK_PTR(offset, "pzl_unpack_raw_mem_rec - offset");
+    CHECK_SIZE(size, *offset, PZL_MEM_REC_HDR_SIZE, "pzl_unpack_raw_mem_rec - data");
+
+    /* Locals */
+    uint64_t rec_start = *offset;
+    uint16_t mem_type;
+    uint64_t mem_len, mem_start, mem_end, mem_size, mem_str_len;
+    uint8_t mem_perms, mem_str_flag;
+    uint8_t *mem_str = NULL;
+
+    /* Type */
+    memcpy(&mem_type, data + *offset, sizeof(mem_type));
+    *offset += sizeof(mem_type);
+    if(mem_type != 0x0001)
+    {
+        printf("pzl_unpack_raw_mem_rec: cannot find memory record\n");
+        return false;
+    }
+
+    /* Length */
+    memcpy(&mem_len, data + *offset, sizeof(mem_len));
+    *offset += sizeof(mem_len);
+    if(mem_len > size - rec_start)
+    {
+        printf("pzl_unpack_raw_mem_rec: not enough data remaining\n");
+        return false;
+    }
+
+    /* Start */
+    memcpy(&mem_start, data + *offset, sizeof(mem_start));
+    *offset += sizeof(mem_start);
+
+    /* End */
+    memcpy(&mem_end, data + *offset, sizeof(mem_end));
+    *offset += sizeof(mem_end);
+
+    /* Size */
+    memcpy(&mem_size, data + *offset, sizeof(mem_size));
+    *offset += sizeof(mem_size);
+
+    /* Permissions */
+    memcpy(&mem_perms, data + *offset, sizeof(mem_perms));
+    *offset += sizeof(mem_perms);
+
+    /* String flag */
+    memcpy(&mem_str_flag, data + *offset, sizeof(mem_str_flag));
+    *offset += sizeof(mem_str_flag);
+
+    /* String length */
+    memcpy(&mem_str_len, data + *offset, sizeof(mem_str_len));
+    *offset += sizeof(mem_str_len);
+    if(mem_str_flag != 0x01)
+        mem_str_len = 0;
+    if(mem_str_len > mem_len)
+    {
+        printf("pzl_unpack_raw_mem_rec: string exceeds record length\n");
+        return false;
+    }
+
+    /* String */
+    if(mem_str_flag == 0x01)
+        mem_str = data + *offset;
+    *offset += mem_str_len;
+
+    /* Data must end the record on a page boundary offset */
+    uint64_t dat_off = PZL_PAGE_ALIGN(*offset);
+    if(mem_size > mem_len || dat_off + mem_size != rec_start + mem_len)
+    {
+        printf("pzl_unpack_raw_mem_rec: data does not match record length\n");
+        return false;
+    }
+    *offset = dat_off;
+
+    /* Create memory record */
+    bool ret;
+    if(ref)
+        ret = pzl_create_mem_rec_ref(context,
+                                     mem_start,
+                                     mem_end,
+                                     mem_size,
+                                     mem_perms,
+                                     data + *offset,
+                                     mem_str_len,
+                                     mem_str);
+    else
+        ret = pzl_create_mem_rec(context,
+                                 mem_start,
+                                 mem_end,
+                                 mem_size,
+                                 mem_perms,
+                                 data + *offset,
+                                 mem_str_len,
+                                 mem_str);
+    if(ret == false)
+    {
+        printf("pzl_unpack_raw_mem_rec: cannot create memory record\n");
+        return false;
+    }
+    *offset += mem_size;
+
+    return true;
+}
+
 /* Unpack register record */
 bool pzl_unpack_reg_rec(pzl_ctx_t *context, uint8_t *data, uint64_t *offset, uint64_t size)
 {
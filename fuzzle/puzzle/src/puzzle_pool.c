@@ -0,0 +1,574 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <puzzle.h>
+
+
+/* Pool header size */
+#define PZL_POOL_HDR_SIZE (3 + 2 + 8 + 8)
+
+/* Pages hashed per read when indexing an existing pool */
+#define PZL_POOL_BATCH 64
+
+/* Hash page contents, FNV-1a over 64-bit words */
+uint64_t pzl_hash_page(uint8_t *page, uint64_t len)
+{
+    uint64_t hash = PZL_FNV_OFFSET;
+    uint64_t word;
+    uint64_t offset;
+
+    for(offset = 0; offset + sizeof(word) <= len; offset += sizeof(word))
+    {
+        memcpy(&word, page + offset, sizeof(word));
+        hash = (hash ^ word) * PZL_FNV_PRIME;
+    }
+    for(; offset < len; offset++)
+        hash = (hash ^ page[offset]) * PZL_FNV_PRIME;
+
+    /* Zero is reserved for the zero page */
+    return hash ? hash : 1;
+}
+
+/* Insert slot into the hash table */
+static bool pzl_pool_insert(pzl_pool_t *pool, uint64_t hash, uint64_t slot)
+{
+    uint64_t idx;
+
+    /* Keep the table at most half full */
+    if(pool->page_cnt * 2 >= pool->tbl_cap)
+    {
+        uint64_t old_cap = pool->tbl_cap;
+        uint64_t *old_hash = pool->tbl_hash;
+        uint64_t *old_slot = pool->tbl_slot;
+
+        pool->tbl_cap = old_cap ? old_cap * 2 : 1024;
+        pool->tbl_hash = (uint64_t *) calloc(pool->tbl_cap, sizeof(uint64_t));
+        pool->tbl_slot = (uint64_t *) calloc(pool->tbl_cap, sizeof(uint64_t));
+        if(pool->tbl_hash == NULL || pool->tbl_slot == NULL)
+        {
+            printf("pzl_pool_insert: cannot grow hash table\n");
+            free(pool->tbl_hash);
+            free(pool->tbl_slot);
+            pool->tbl_cap = old_cap;
+            pool->tbl_hash = old_hash;
+            pool->tbl_slot = old_slot;
+            return false;
+        }
+
+        for(idx = 0; idx < old_cap; idx++)
+        {
+            if(old_slot[idx] == 0)
+                continue;
+
+            uint64_t new_idx = old_hash[idx] & (pool->tbl_cap - 1);
+            while(pool->tbl_slot[new_idx] != 0)
+                new_idx = (new_idx + 1) & (pool->tbl_cap - 1);
+            pool->tbl_hash[new_idx] = old_hash[idx];
+            pool->tbl_slot[new_idx] = old_slot[idx];
+        }
+        free(old_hash);
+        free(old_slot);
+    }
+
+    /* Linear probing, slot 0 marks an empty entry */
+    idx = hash & (pool->tbl_cap - 1);
+    while(pool->tbl_slot[idx] != 0)
+        idx = (idx + 1) & (pool->tbl_cap - 1);
+    pool->tbl_hash[idx] = hash;
+    pool->tbl_slot[idx] = slot;
+
+    return true;
+}
+
+/* Write pool header */
+static bool pzl_pool_write_hdr(pzl_pool_t *pool)
+{
+    uint8_t hdr[PZL_POOL_HDR_SIZE];
+    uint16_t version = 0x0000;
+    uint64_t offset = 0;
+
+    memcpy(hdr + offset, "PZP", 3);
+    offset += 3;
+    memcpy(hdr + offset, &version, sizeof(version));
+    offset += sizeof(version);
+    memcpy(hdr + offset, &(pool->id), sizeof(pool->id));
+    offset += sizeof(pool->id);
+    memcpy(hdr + offset, &(pool->page_cnt), sizeof(pool->page_cnt));
+    offset += sizeof(pool->page_cnt);
+
+    return pwrite(pool->fd, hdr, sizeof(hdr), 0) == sizeof(hdr);
+}
+
+/* Hash every page of an existing pool */
+static bool pzl_pool_index(pzl_pool_t *pool)
+{
+    uint8_t *buf = (uint8_t *) malloc(PZL_POOL_BATCH * PZL_PAGE_SIZE);
+    uint64_t page_cnt = pool->page_cnt;
+    uint64_t slot, batch, idx;
+
+    if(buf == NULL)
+    {
+        printf("pzl_pool_index: cannot allocate read buffer\n");
+        return false;
+    }
+
+    /* Re-insert one slot at a time so the table grows as it would on add */
+    pool->page_cnt = 0;
+    for(slot = 1; slot <= page_cnt; slot += batch)
+    {
+        batch = page_cnt - slot + 1;
+        if(batch > PZL_POOL_BATCH)
+            batch = PZL_POOL_BATCH;
+
+        if(pread(pool->fd, buf, batch * PZL_PAGE_SIZE, slot * PZL_PAGE_SIZE) !=
+           (ssize_t) (batch * PZL_PAGE_SIZE))
+        {
+            printf("pzl_pool_index: cannot read slot %lu\n", slot);
+            free(buf);
+            return false;
+        }
+
+        for(idx = 0; idx < batch; idx++)
+        {
+            uint64_t hash = pzl_hash_page(buf + idx * PZL_PAGE_SIZE, PZL_PAGE_SIZE);
+            if(!pzl_pool_insert(pool, hash, slot + idx))
+            {
+                free(buf);
+                return false;
+            }
+            pool->page_cnt++;
+        }
+    }
+    free(buf);
+
+    return true;
+}
+
+/* Open or create page pool */
+bool pzl_pool_open(pzl_pool_t **pool, const char *path, bool write)
+{
+    CHECK_PTR(pool, "pzl_pool_open - pool");
+    CHECK_PTR(path, "pzl_pool_open - path");
+
+    /* Locals */
+    uint8_t hdr[PZL_POOL_HDR_SIZE];
+    uint16_t version;
+    struct stat statbuf;
+    pzl_pool_t *new_pool;
+
+    new_pool = (pzl_pool_t *) calloc(1, sizeof(pzl_pool_t));
+    if(new_pool == NULL)
+    {
+        printf("pzl_pool_open: cannot allocate pool\n");
+        return false;
+    }
+    new_pool->write = write;
+
+    /* Open file */
+    new_pool->fd = open(path, write ? O_RDWR | O_CREAT : O_RDONLY, 0644);
+    if(new_pool->fd < 0 || fstat(new_pool->fd, &statbuf) != 0)
+    {
+        printf("pzl_pool_open: cannot open pool '%s'\n", path);
+        if(new_pool->fd >= 0)
+            close(new_pool->fd);
+        free(new_pool);
+        return false;
+    }
+
+    /* Create empty pool */
+    if(write && statbuf.st_size == 0)
+    {
+        new_pool->id = pzl_hash_page((uint8_t *) &statbuf, sizeof(statbuf)) ^
+                       ((uint64_t) time(NULL) << 20) ^ (uint64_t) getpid();
+        if(ftruncate(new_pool->fd, PZL_PAGE_SIZE) != 0 || !pzl_pool_write_hdr(new_pool))
+        {
+            printf("pzl_pool_open: cannot create pool '%s'\n", path);
+            pzl_pool_close(new_pool);
+            return false;
+        }
+        *pool = new_pool;
+        return true;
+    }
+
+    /* Read header */
+    if(pread(new_pool->fd, hdr, sizeof(hdr), 0) != sizeof(hdr) ||
+       memcmp(hdr, "PZP", 3) != 0)
+    {
+        printf("pzl_pool_open: '%s' is not a page pool\n", path);
+        pzl_pool_close(new_pool);
+        return false;
+    }
+    memcpy(&version, hdr + 3, sizeof(version));
+    memcpy(&(new_pool->id), hdr + 3 + 2, sizeof(new_pool->id));
+    memcpy(&(new_pool->page_cnt), hdr + 3 + 2 + 8, sizeof(new_pool->page_cnt));
+    if(version != 0x0000 ||
+       (uint64_t) statbuf.st_size / PZL_PAGE_SIZE < new_pool->page_cnt + 1)
+    {
+        printf("pzl_pool_open: pool '%s' is truncated or unsupported\n", path);
+        pzl_pool_close(new_pool);
+        return false;
+    }
+
+    /* Writers need to find existing pages */
+    if(write && !pzl_pool_index(new_pool))
+    {
+        printf("pzl_pool_open: cannot index pool '%s'\n", path);
+        pzl_pool_close(new_pool);
+        return false;
+    }
+
+    *pool = new_pool;
+    return true;
+}
+
+/* Find or store a page, zero pages always use slot 0 */
+bool pzl_pool_add(pzl_pool_t *pool, uint8_t *page, uint64_t len, uint64_t *slot, uint64_t *hash)
+{
+    CHECK_PTR(pool, "pzl_pool_add - pool");
+    CHECK_PTR(page, "pzl_pool_add - page");
+
+    /* Locals */
+    uint8_t buf[PZL_PAGE_SIZE];
+    uint8_t cur[PZL_PAGE_SIZE];
+    uint64_t idx;
+
+    if(!pool->write || len > PZL_PAGE_SIZE)
+    {
+        printf("pzl_pool_add: pool is read only or page is too big\n");
+        return false;
+    }
+
+    if(pzl_is_zero(page, len))
+    {
+        *slot = 0;
+        *hash = 0;
+        return true;
+    }
+
+    /* Short pages are stored zero padded */
+    memcpy(buf, page, len);
+    memset(buf + len, 0, PZL_PAGE_SIZE - len);
+    *hash = pzl_hash_page(buf, PZL_PAGE_SIZE);
+
+    /* Compare contents of every slot with the same hash */
+    for(idx = *hash & (pool->tbl_cap - 1); pool->tbl_cap && pool->tbl_slot[idx] != 0;
+        idx = (idx + 1) & (pool->tbl_cap - 1))
+    {
+        if(pool->tbl_hash[idx] != *hash)
+            continue;
+
+        if(pread(pool->fd, cur, PZL_PAGE_SIZE, pool->tbl_slot[idx] * PZL_PAGE_SIZE) == PZL_PAGE_SIZE &&
+           memcmp(cur, buf, PZL_PAGE_SIZE) == 0)
+        {
+            *slot = pool->tbl_slot[idx];
+            return true;
+        }
+    }
+
+    /* Append new slot */
+    *slot = pool->page_cnt + 1;
+    if(pwrite(pool->fd, buf, PZL_PAGE_SIZE, *slot * PZL_PAGE_SIZE) != PZL_PAGE_SIZE ||
+       !pzl_pool_insert(pool, *hash, *slot))
+    {
+        printf("pzl_pool_add: cannot store page\n");
+        return false;
+    }
+    pool->page_cnt++;
+
+    return true;
+}
+
+/* Close page pool, writers record the final page count */
+bool pzl_pool_close(pzl_pool_t *pool)
+{
+    if(pool == NULL)
+        return true;
+
+    if(pool->write && pool->fd >= 0 && pool->id != 0 && !pzl_pool_write_hdr(pool))
+        printf("pzl_pool_close: cannot write pool header\n");
+    if(pool->fd >= 0)
+        close(pool->fd);
+    free(pool->tbl_hash);
+    free(pool->tbl_slot);
+    free(pool);
+
+    return true;
+}
+
+/* Attach page pool used to pack and load memory records */
+bool pzl_set_pool(pzl_ctx_t *context, pzl_pool_t *pool)
+{
+    CHECK_PTR(context, "pzl_set_pool - context");
+
+    context->pool = pool;
+
+    return true;
+}
+
+/* Pack memory record as references into the page pool */
+bool pzl_pack_pool_mem_rec(pzl_ctx_t *context, mem_rec_t *mem_rec, uint8_t *data, uint64_t *offset)
+{
+    CHECK_PTR(context, "pzl_pack_pool_mem_rec - context");
+    CHECK_PTR(context->pool, "pzl_pack_pool_mem_rec - context->pool");
+    CHECK_PTR(mem_rec, "pzl_pack_pool_mem_rec - mem_rec");
+
+    /* Locals */
+    uint16_t type = 0x0004;
+    uint64_t page_cnt = PZL_PAGE_CNT(mem_rec->size);
+    uint64_t length = PZL_MEM_REC_HDR_SIZE + mem_rec->str_size + 8 + 8 + page_cnt * (8 + 8);
+    uint64_t page, slot, hash;
+
+    /* Type */
+    memcpy(data + *offset, &type, sizeof(type));
+    *offset += sizeof(type);
+
+    /* Length */
+    memcpy(data + *offset, &length, sizeof(length));
+    *offset += sizeof(length);
+
+    /* Start */
+    memcpy(data + *offset, &(mem_rec->start), sizeof(mem_rec->start));
+    *offset += sizeof(mem_rec->start);
+
+    /* End */
+    memcpy(data + *offset, &(mem_rec->end), sizeof(mem_rec->end));
+    *offset += sizeof(mem_rec->end);
+
+    /* Size */
+    memcpy(data + *offset, &(mem_rec->size), sizeof(mem_rec->size));
+    *offset += sizeof(mem_rec->size);
+
+    /* Permissions */
+    memcpy(data + *offset, &(mem_rec->perms), sizeof(mem_rec->perms));
+    *offset += sizeof(mem_rec->perms);
+
+    /* String flag */
+    memcpy(data + *offset, &(mem_rec->str_flag), sizeof(mem_rec->str_flag));
+    *offset += sizeof(mem_rec->str_flag);
+
+    /* String size */
+    memcpy(data + *offset, &(mem_rec->str_size), sizeof(mem_rec->str_size));
+    *offset += sizeof(mem_rec->str_size);
+
+    /* Pack name string */
+    if(mem_rec->str_flag == 0x01)
+    {
+        memcpy(data + *offset, mem_rec->str, mem_rec->str_size);
+        *offset += mem_rec->str_size;
+    }
+
+    /* Pool ID */
+    memcpy(data + *offset, &(context->pool->id), sizeof(context->pool->id));
+    *offset += sizeof(context->pool->id);
+
+    /* Page count */
+    memcpy(data + *offset, &page_cnt, sizeof(page_cnt));
+    *offset += sizeof(page_cnt);
+
+    /* Page index */
+    for(page = 0; page < page_cnt; page++)
+    {
+        if(!pzl_pool_add(context->pool,
+                         mem_rec->dat + page * PZL_PAGE_SIZE,
+                         PZL_PAGE_LEN(mem_rec->size, page),
+                         &slot,
+                         &hash))
+        {
+            printf("pzl_pack_pool_mem_rec: cannot add page %lu of %p\n",
+                   page, (void *) mem_rec->start);
+            return false;
+        }
+
+        memcpy(data + *offset, &slot, sizeof(slot));
+        *offset += sizeof(slot);
+        memcpy(data + *offset, &hash, sizeof(hash));
+        *offset += sizeof(hash);
+    }
+
+    return true;
+}
+
+/* Unpack pooled memory record by mapping pool pages */
+bool pzl_unpack_pool_mem_rec(pzl_ctx_t *context, uint8_t *data, uint64_t *offset, uint64_t size)
+{
+    CHECK_PTR(context, "pzl_unpack_pool_mem_rec - context");
+    CHECK_PTR(data, "pzl_unpack_pool_mem_rec - data");
+    CHECK_PTR(offset, "pzl_unpack_pool_mem_rec - offset");
+    CHECK_SIZE(size, *offset, PZL_MEM_REC_HDR_SIZE, "pzl_unpack_pool_mem_rec - data");
+
+    /* Locals */
+    uint64_t rec_start = *offset;
+    uint16_t mem_type;
+    uint64_t mem_len, mem_start, mem_end, mem_size, mem_str_len, pool_id, page_cnt, page;
+    uint8_t mem_perms, mem_str_flag;
+    uint8_t *mem_str = NULL;
+    uint8_t *mem_dat;
+    uint64_t *slots;
+
+    /* Type */
+    memcpy(&mem_type, data + *offset, sizeof(mem_type));
+    *offset += sizeof(mem_type);
+    if(mem_type != 0x0004)
+    {
+        printf("pzl_unpack_pool_mem_rec: cannot find pooled memory record\n");
+        return false;
+    }
+
+    /* Pages live in the attached pool */
+    if(context->pool == NULL)
+    {
+        printf("pzl_unpack_pool_mem_rec: record references a page pool, attach one with pzl_set_pool\n");
+        return false;
+    }
+
+    /* Length */
+    memcpy(&mem_len, data + *offset, sizeof(mem_len));
+    *offset += sizeof(mem_len);
+    if(mem_len > size - rec_start || mem_len < PZL_MEM_REC_HDR_SIZE + 8 + 8)
+    {
+        printf("pzl_unpack_pool_mem_rec: not enough data remaining\n");
+        return false;
+    }
+
+    /* Start */
+    memcpy(&mem_start, data + *offset, sizeof(mem_start));
+    *offset += sizeof(mem_start);
+
+    /* End */
+    memcpy(&mem_end, data + *offset, sizeof(mem_end));
+    *offset += sizeof(mem_end);
+
+    /* Size */
+    memcpy(&mem_size, data + *offset, sizeof(mem_size));
+    *offset += sizeof(mem_size);
+
+    /* Permissions */
+    memcpy(&mem_perms, data + *offset, sizeof(mem_perms));
+    *offset += sizeof(mem_perms);
+
+    /* String flag */
+    memcpy(&mem_str_flag, data + *offset, sizeof(mem_str_flag));
+    *offset += sizeof(mem_str_flag);
+
+    /* String length */
+    memcpy(&mem_str_len, data + *offset, sizeof(mem_str_len));
+    *offset += sizeof(mem_str_len);
+    if(mem_str_flag != 0x01)
+        mem_str_len = 0;
+    if(mem_str_len > mem_len - PZL_MEM_REC_HDR_SIZE - 8 - 8)
+    {
+        printf("pzl_unpack_pool_mem_rec: string exceeds record length\n");
+        return false;
+    }
+
+    /* String */
+    if(mem_str_flag == 0x01)
+        mem_str = data + *offset;
+    *offset += mem_str_len;
+
+    /* Pool ID */
+    memcpy(&pool_id, data + *offset, sizeof(pool_id));
+    *offset += sizeof(pool_id);
+    if(pool_id != context->pool->id)
+    {
+        printf("pzl_unpack_pool_mem_rec: record belongs to a different page pool\n");
+        return false;
+    }
+
+    /* Page count must fill the record */
+    memcpy(&page_cnt, data + *offset, sizeof(page_cnt));
+    *offset += sizeof(page_cnt);
+    if(mem_size == 0 || page_cnt != PZL_PAGE_CNT(mem_size) ||
+       rec_start + mem_len - *offset != page_cnt * (8 + 8))
+    {
+        printf("pzl_unpack_pool_mem_rec: page index does not match record size\n");
+        return false;
+    }
+
+    /* Slots, hashes are kept for tools that rebuild pools */
+    slots = (uint64_t *) malloc(page_cnt * sizeof(uint64_t));
+    if(slots == NULL)
+    {
+        printf("pzl_unpack_pool_mem_rec: cannot allocate page index\n");
+        return false;
+    }
+    for(page = 0; page < page_cnt; page++)
+    {
+        memcpy(&(slots[page]), data + *offset, sizeof(uint64_t));
+        *offset += 8 + 8;
+        if(slots[page] > context->pool->page_cnt)
+        {
+            printf("pzl_unpack_pool_mem_rec: slot %lu is not in the pool\n", slots[page]);
+            free(slots);
+            return false;
+        }
+    }
+
+    /* Zero pages stay untouched anonymous memory */
+    mem_dat = (uint8_t *) mmap(NULL, mem_size, PROT_READ | PROT_WRITE,
+                               MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(mem_dat == MAP_FAILED)
+    {
+        printf("pzl_unpack_pool_mem_rec: cannot map data buffer\n");
+        free(slots);
+        return false;
+    }
+
+    /* Map runs of consecutive slots copy-on-write so unwritten pages are shared */
+    page = 0;
+    while(page < page_cnt)
+    {
+        if(slots[page] == 0)
+        {
+            page++;
+            continue;
+        }
+
+        uint64_t run_start = page;
+        while(page + 1 < page_cnt && slots[page + 1] == slots[page] + 1)
+            page++;
+        page++;
+
+        if(mmap(mem_dat + run_start * PZL_PAGE_SIZE,
+                (page - run_start) * PZL_PAGE_SIZE,
+                PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_FIXED,
+                context->pool->fd,
+                slots[run_start] * PZL_PAGE_SIZE) == MAP_FAILED)
+        {
+            printf("pzl_unpack_pool_mem_rec: cannot map pool pages of %p\n",
+                   (void *) mem_start);
+            munmap(mem_dat, mem_size);
+            free(slots);
+            return false;
+        }
+    }
+    free(slots);
+
+    /* Create memory record */
+    mem_rec_t *mem_rec = pzl_add_mem_rec(context,
+                                         mem_start,
+                                         mem_end,
+                                         mem_size,
+                                         mem_perms,
+                                         mem_dat,
+                                         false,
+                                         mem_str_len,
+                                         mem_str);
+    if(mem_rec == NULL)
+    {
+        printf("pzl_unpack_pool_mem_rec: cannot create memory record\n");
+        munmap(mem_dat, mem_size);
+        return false;
+    }
+    mem_rec->dat_map = true;
+
+    return true;
+}
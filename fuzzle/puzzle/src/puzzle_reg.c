@@ -20,14 +20,14 @@ bool pzl_create_reg_rec(pzl_ctx_t *context, void *usr_reg)
     reg_rec->type = 0x0002;
 
     /* Allocate and copy user registers */
+    uint64_t usr_reg_len;
     switch(context->hdr_rec.arch)
     {
         case X86_64:
-            reg_rec->usr_reg = (void *) malloc(sizeof(usr_regs_x86_64_t));
-            memcpy(reg_rec->usr_reg, usr_reg, sizeof(usr_regs_x86_64_t));
-            reg_rec->length = (2 + 8 + 8) + sizeof(usr_regs_x86_64_t);
-            reg_rec->usr_reg_len = sizeof(usr_regs_x86_64_t);
-            context->reg_rec = reg_rec;
+        case ARM:
+        case AARCH64:
+        case MIPS_32:
+            usr_reg_len = pzl_get_usr_reg_size(context);
             break;
 
         default:
@@ -37,5 +37,17 @@ bool pzl_create_reg_rec(pzl_ctx_t *context, void *usr_reg)
             return false;
     }
 
+    reg_rec->usr_reg = (void *) malloc(usr_reg_len);
+    if(reg_rec->usr_reg == NULL)
+    {
+        printf("pzl_create_reg_record: user registers cannot be allocated\n");
+        free(reg_rec);
+        return false;
+    }
+    memcpy(reg_rec->usr_reg, usr_reg, usr_reg_len);
+    reg_rec->length = (2 + 8 + 8) + usr_reg_len;
+    reg_rec->usr_reg_len = usr_reg_len;
+    context->reg_rec = reg_rec;
+
     return true;
 }
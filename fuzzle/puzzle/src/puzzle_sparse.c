@@ -0,0 +1,275 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <puzzle.h>
+
+
+/* Check record for a page of zeroes worth eliding */
+bool pzl_has_zero_page(mem_rec_t *mem_rec)
+{
+    CHECK_PTR(mem_rec, "pzl_has_zero_page - mem_rec");
+
+    uint64_t page;
+    for(page = 0; page < PZL_PAGE_CNT(mem_rec->size); page++)
+    {
+        if(pzl_is_zero(mem_rec->dat + page * PZL_PAGE_SIZE,
+                       PZL_PAGE_LEN(mem_rec->size, page)))
+            return true;
+    }
+
+    return false;
+}
+
+/* Pack memory record storing only its non-zero pages */
+bool pzl_pack_sparse_mem_rec(mem_rec_t *mem_rec, uint8_t *data, uint64_t *offset)
+{
+    CHECK_PTR(mem_rec, "pzl_pack_sparse_mem_rec - mem_rec");
+    CHECK_PTR(data, "pzl_pack_sparse_mem_rec - data");
+
+    /* Locals */
+    uint16_t type = 0x0003;
+    uint64_t rec_start = *offset;
+    uint64_t page_cnt = PZL_PAGE_CNT(mem_rec->size);
+    uint64_t page;
+
+    /* Type */
+    memcpy(data + *offset, &type, sizeof(type));
+    *offset += sizeof(type);
+
+    /* Length is written once the pages are stored */
+    uint64_t len_off = *offset;
+    *offset += sizeof(mem_rec->length);
+
+    /* Start */
+    memcpy(data + *offset, &(mem_rec->start), sizeof(mem_rec->start));
+    *offset += sizeof(mem_rec->start);
+
+    /* End */
+    memcpy(data + *offset, &(mem_rec->end), sizeof(mem_rec->end));
+    *offset += sizeof(mem_rec->end);
+
+    /* Size */
+    memcpy(data + *offset, &(mem_rec->size), sizeof(mem_rec->size));
+    *offset += sizeof(mem_rec->size);
+
+    /* Permissions */
+    memcpy(data + *offset, &(mem_rec->perms), sizeof(mem_rec->perms));
+    *offset += sizeof(mem_rec->perms);
+
+    /* String flag */
+    memcpy(data + *offset, &(mem_rec->str_flag), sizeof(mem_rec->str_flag));
+    *offset += sizeof(mem_rec->str_flag);
+
+    /* String size */
+    memcpy(data + *offset, &(mem_rec->str_size), sizeof(mem_rec->str_size));
+    *offset += sizeof(mem_rec->str_size);
+
+    /* Pack name string */
+    if(mem_rec->str_flag == 0x01)
+    {
+        memcpy(data + *offset, mem_rec->str, mem_rec->str_size);
+        *offset += mem_rec->str_size;
+    }
+
+    /* Page count */
+    memcpy(data + *offset, &page_cnt, sizeof(page_cnt));
+    *offset += sizeof(page_cnt);
+
+    /* Bitmap is filled in as pages are stored */
+    uint8_t *bmp = data + *offset;
+    memset(bmp, 0, PZL_BMP_SIZE(mem_rec->size));
+    *offset += PZL_BMP_SIZE(mem_rec->size);
+
+    /* Padding */
+    uint64_t dat_off = PZL_PAGE_ALIGN(*offset);
+    memset(data + *offset, 0, dat_off - *offset);
+    *offset = dat_off;
+
+    /* Non-zero pages */
+    for(page = 0; page < page_cnt; page++)
+    {
+        uint8_t *src = mem_rec->dat + page * PZL_PAGE_SIZE;
+        uint64_t src_len = PZL_PAGE_LEN(mem_rec->size, page);
+
+        if(pzl_is_zero(src, src_len))
+            continue;
+
+        bmp[page / 8] |= 1 << (page % 8);
+        memcpy(data + *offset, src, src_len);
+        *offset += src_len;
+    }
+
+    /* Length */
+    uint64_t length = *offset - rec_start;
+    memcpy(data + len_off, &length, sizeof(length));
+
+    return true;
+}
+
+/* Unpack sparse memory record into an anonymous mapping */
+bool pzl_unpack_sparse_mem_rec(pzl_ctx_t *context,
+                               uint8_t *data,
+                               uint64_t *offset,
+                               uint64_t size,
+                               bool ref)
+{
+    CHECK_PTR(context, "pzl_unpack_sparse_mem_rec - context");
+    CHECK_PTR(data, "pzl_unpack_sparse_mem_rec - data");
+    CHECK_PTR(offset, "pzl_unpack_sparse_mem_rec - offset");
+    CHECK_SIZE(size, *offset, PZL_MEM_REC_HDR_SIZE, "pzl_unpack_sparse_mem_rec - data");
+
+    /* Locals */
+    uint64_t rec_start = *offset;
+    uint16_t mem_type;
+    uint64_t mem_len, mem_start, mem_end, mem_size, mem_str_len, page_cnt, page;
+    uint8_t mem_perms, mem_str_flag;
+    uint8_t *mem_str = NULL;
+    uint8_t *mem_dat;
+    uint8_t *bmp;
+    uint64_t stored = 0;
+
+    /* Type */
+    memcpy(&mem_type, data + *offset, sizeof(mem_type));
+    *offset += sizeof(mem_type);
+    if(mem_type != 0x0003)
+    {
+        printf("pzl_unpack_sparse_mem_rec: cannot find sparse memory record\n");
+        return false;
+    }
+
+    /* Length */
+    memcpy(&mem_len, data + *offset, sizeof(mem_len));
+    *offset += sizeof(mem_len);
+    if(mem_len > size - rec_start || mem_len < PZL_MEM_REC_HDR_SIZE + sizeof(page_cnt))
+    {
+        printf("pzl_unpack_sparse_mem_rec: not enough data remaining\n");
+        return false;
+    }
+
+    /* Start */
+    memcpy(&mem_start, data + *offset, sizeof(mem_start));
+    *offset += sizeof(mem_start);
+
+    /* End */
+    memcpy(&mem_end, data + *offset, sizeof(mem_end));
+    *offset += sizeof(mem_end);
+
+    /* Size */
+    memcpy(&mem_size, data + *offset, sizeof(mem_size));
+    *offset += sizeof(mem_size);
+
+    /* Permissions */
+    memcpy(&mem_perms, data + *offset, sizeof(mem_perms));
+    *offset += sizeof(mem_perms);
+
+    /* String flag */
+    memcpy(&mem_str_flag, data + *offset, sizeof(mem_str_flag));
+    *offset += sizeof(mem_str_flag);
+
+    /* String length */
+    memcpy(&mem_str_len, data + *offset, sizeof(mem_str_len));
+    *offset += sizeof(mem_str_len);
+    if(mem_str_flag != 0x01)
+        mem_str_len = 0;
+    if(mem_str_len > mem_len - PZL_MEM_REC_HDR_SIZE - sizeof(page_cnt))
+    {
+        printf("pzl_unpack_sparse_mem_rec: string exceeds record length\n");
+        return false;
+    }
+
+    /* String */
+    if(mem_str_flag == 0x01)
+        mem_str = data + *offset;
+    *offset += mem_str_len;
+
+    /* Page count and bitmap */
+    memcpy(&page_cnt, data + *offset, sizeof(page_cnt));
+    *offset += sizeof(page_cnt);
+    if(mem_size == 0 || page_cnt != PZL_PAGE_CNT(mem_size) ||
+       PZL_BMP_SIZE(mem_size) > rec_start + mem_len - *offset)
+    {
+        printf("pzl_unpack_sparse_mem_rec: bitmap does not match record size\n");
+        return false;
+    }
+    bmp = data + *offset;
+    *offset = PZL_PAGE_ALIGN(*offset + PZL_BMP_SIZE(mem_size));
+
+    /* Stored pages must end the record */
+    for(page = 0; page < page_cnt; page++)
+    {
+        if(bmp[page / 8] & (1 << (page % 8)))
+            stored += PZL_PAGE_LEN(mem_size, page);
+    }
+    if(*offset + stored != rec_start + mem_len)
+    {
+        printf("pzl_unpack_sparse_mem_rec: pages do not match record length\n");
+        return false;
+    }
+
+    /* Zero pages stay untouched anonymous memory */
+    mem_dat = (uint8_t *) mmap(NULL, mem_size, PROT_READ | PROT_WRITE,
+                               MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(mem_dat == MAP_FAILED)
+    {
+        printf("pzl_unpack_sparse_mem_rec: cannot map data buffer\n");
+        return false;
+    }
+
+    /* Place runs of stored pages */
+    page = 0;
+    while(page < page_cnt)
+    {
+        if(!(bmp[page / 8] & (1 << (page % 8))))
+        {
+            page++;
+            continue;
+        }
+
+        /* Find end of run */
+        uint64_t run_start = page;
+        while(page < page_cnt && (bmp[page / 8] & (1 << (page % 8))))
+            page++;
+
+        uint8_t *dst = mem_dat + run_start * PZL_PAGE_SIZE;
+        uint64_t run_len = (page - run_start - 1) * PZL_PAGE_SIZE +
+                           PZL_PAGE_LEN(mem_size, page - 1);
+
+        /* Whole pages of a mapped file are mapped over the reservation */
+        uint64_t map_len = 0;
+        if(ref && data == context->map && context->map_fd >= 0)
+            map_len = run_len & ~((uint64_t) PZL_PAGE_SIZE - 1);
+        if(map_len > 0 &&
+           mmap(dst, map_len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED,
+                context->map_fd, *offset) == MAP_FAILED)
+        {
+            printf("pzl_unpack_sparse_mem_rec: cannot map pages of %p\n",
+                   (void *) mem_start);
+            munmap(mem_dat, mem_size);
+            return false;
+        }
+        memcpy(dst + map_len, data + *offset + map_len, run_len - map_len);
+        *offset += run_len;
+    }
+
+    /* Create memory record */
+    mem_rec_t *mem_rec = pzl_add_mem_rec(context,
+                                         mem_start,
+                                         mem_end,
+                                         mem_size,
+                                         mem_perms,
+                                         mem_dat,
+                                         false,
+                                         mem_str_len,
+                                         mem_str);
+    if(mem_rec == NULL)
+    {
+        printf("pzl_unpack_sparse_mem_rec: cannot create memory record\n");
+        munmap(mem_dat, mem_size);
+        return false;
+    }
+    mem_rec->dat_map = true;
+
+    return true;
+}
@@ -0,0 +1,774 @@
+#define MINIZ_HEADER_FILE_ONLY
+#include <miniz.c>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <puzzle.h>
+
+
+/* Compressed output buffered before each write */
+#define PZL_STREAM_OUT_SIZE 0x10000
+
+/* Largest input handed to miniz at once */
+#define PZL_STREAM_IN_MAX 0x40000000
+
+/* Append bytes at the end of the stream */
+static bool pzl_stream_write(pzl_stream_t *stream, uint8_t *dat, uint64_t len)
+{
+    while(len > 0)
+    {
+        ssize_t ret = write(stream->fd, dat, len);
+        if(ret < 0 && errno == EINTR)
+            continue;
+        if(ret <= 0)
+        {
+            printf("pzl_stream_write: cannot write to fd %d\n", stream->fd);
+            return false;
+        }
+
+        dat += ret;
+        len -= ret;
+        stream->offset += ret;
+    }
+
+    return true;
+}
+
+/* Overwrite bytes already reserved in the stream */
+static bool pzl_stream_pwrite(pzl_stream_t *stream, uint8_t *dat, uint64_t len, uint64_t off)
+{
+    while(len > 0)
+    {
+        ssize_t ret = pwrite(stream->fd, dat, len, stream->base + off);
+        if(ret < 0 && errno == EINTR)
+            continue;
+        if(ret <= 0)
+        {
+            printf("pzl_stream_pwrite: cannot write to fd %d\n", stream->fd);
+            return false;
+        }
+
+        dat += ret;
+        len -= ret;
+        off += ret;
+    }
+
+    return true;
+}
+
+/* Pack fixed memory record fields and optionally the name */
+static void pzl_stream_pack_rec(mem_rec_t *rec,
+                                uint16_t type,
+                                uint64_t length,
+                                uint8_t *data,
+                                uint64_t *offset,
+                                bool name)
+{
+    /* Type */
+    memcpy(data + *offset, &type, sizeof(type));
+    *offset += sizeof(type);
+
+    /* Length */
+    memcpy(data + *offset, &length, sizeof(length));
+    *offset += sizeof(length);
+
+    /* Start */
+    memcpy(data + *offset, &(rec->start), sizeof(rec->start));
+    *offset += sizeof(rec->start);
+
+    /* End */
+    memcpy(data + *offset, &(rec->end), sizeof(rec->end));
+    *offset += sizeof(rec->end);
+
+    /* Size */
+    memcpy(data + *offset, &(rec->size), sizeof(rec->size));
+    *offset += sizeof(rec->size);
+
+    /* Permissions */
+    memcpy(data + *offset, &(rec->perms), sizeof(rec->perms));
+    *offset += sizeof(rec->perms);
+
+    /* String flag */
+    memcpy(data + *offset, &(rec->str_flag), sizeof(rec->str_flag));
+    *offset += sizeof(rec->str_flag);
+
+    /* String size */
+    memcpy(data + *offset, &(rec->str_size), sizeof(rec->str_size));
+    *offset += sizeof(rec->str_size);
+
+    /* Pack name string */
+    if(name && rec->str_flag == 0x01)
+    {
+        memcpy(data + *offset, rec->str, rec->str_size);
+        *offset += rec->str_size;
+    }
+}
+
+/* Feed bytes through the DEFLATE stream, writing output as it is produced */
+static bool pzl_stream_deflate(pzl_stream_t *stream, uint8_t *dat, uint64_t len, int flush)
+{
+    mz_stream *zstrm = (mz_stream *) stream->zstrm;
+    int status;
+
+    if(len == 0 && flush == MZ_NO_FLUSH)
+        return true;
+
+    while(true)
+    {
+        /* Next piece of input */
+        if(zstrm->avail_in == 0 && len > 0)
+        {
+            uint64_t piece = len < PZL_STREAM_IN_MAX ? len : PZL_STREAM_IN_MAX;
+            zstrm->next_in = dat;
+            zstrm->avail_in = piece;
+            dat += piece;
+            len -= piece;
+        }
+
+        zstrm->next_out = stream->out;
+        zstrm->avail_out = stream->out_cap;
+        status = mz_deflate(zstrm, len == 0 ? flush : MZ_NO_FLUSH);
+        if(status != MZ_OK && status != MZ_STREAM_END && status != MZ_BUF_ERROR)
+        {
+            printf("pzl_stream_deflate: compression failed\n");
+            return false;
+        }
+        if(!pzl_stream_write(stream, stream->out, stream->out_cap - zstrm->avail_out))
+            return false;
+
+        /* Finishing runs until the stream ends, otherwise until input runs out */
+        if(flush == MZ_FINISH)
+        {
+            if(status == MZ_STREAM_END)
+                break;
+        }
+        else if(zstrm->avail_in == 0 && len == 0 && zstrm->avail_out != 0)
+            break;
+    }
+
+    return true;
+}
+
+/* Store one page or batch of chunks of the open record */
+static bool pzl_stream_blk(pzl_stream_t *stream, uint8_t *dat, uint64_t len)
+{
+    pzl_ctx_t *context = stream->context;
+
+    /* Pages matching the file are only hashed */
+    if(stream->clean != NULL)
+    {
+        uint64_t page = stream->blk_idx++;
+        if(stream->clean[page / 8] & (1 << (page % 8)))
+        {
+            stream->file_hash = pzl_hash_file_page(stream->file_hash, dat, len);
+            return true;
+        }
+        stream->bmp[page / 8] |= 1 << (page % 8);
+
+        return pzl_stream_write(stream, dat, len);
+    }
+
+    /* Page index entry */
+    if(context->hdr_rec.version == PZL_VERSION_MMAP && context->pool != NULL)
+    {
+        uint64_t ent[2];
+        if(!pzl_pool_add(context->pool, dat, len, &(ent[0]), &(ent[1])))
+        {
+            printf("pzl_stream_blk: cannot add page %lu of %p\n",
+                   stream->blk_idx, (void *) stream->rec.start);
+            return false;
+        }
+        stream->blk_idx++;
+
+        return pzl_stream_write(stream, (uint8_t *) ent, sizeof(ent));
+    }
+
+    /* Non-zero page */
+    if(context->hdr_rec.version == PZL_VERSION_MMAP)
+    {
+        uint64_t page = stream->blk_idx++;
+        if(pzl_is_zero(dat, len))
+        {
+            stream->zero_page = true;
+            return true;
+        }
+        stream->bmp[page / 8] |= 1 << (page % 8);
+
+        return pzl_stream_write(stream, dat, len);
+    }
+
+    /* Batch of chunks compressed across the workers */
+    uint64_t chk_size = context->hdr_rec.chk_size;
+    uint64_t chk_cnt = (len + chk_size - 1) / chk_size;
+    uint64_t slot = pzl_pack_chk_slot(context);
+    uint64_t chk_idx;
+
+    if(!pzl_pack_chk_batch(context, dat, len, stream->out, stream->chk_len + stream->blk_idx))
+    {
+        printf("pzl_stream_blk: cannot compress chunks of %p\n", (void *) stream->rec.start);
+        return false;
+    }
+    for(chk_idx = 0; chk_idx < chk_cnt; chk_idx++, stream->blk_idx++)
+    {
+        if(!pzl_stream_write(stream,
+                             stream->out + chk_idx * slot,
+                             stream->chk_len[stream->blk_idx]))
+            return false;
+    }
+
+    return true;
+}
+
+/* Finish the open record once all of its data has been stored */
+static bool pzl_stream_close_rec(pzl_stream_t *stream)
+{
+    pzl_ctx_t *context = stream->context;
+    mem_rec_t *rec = &(stream->rec);
+    uint64_t length = stream->offset - stream->rec_off;
+    bool ret = true;
+
+    if(stream->dat_len != rec->size)
+    {
+        printf("pzl_stream_close_rec: %p is missing %lu bytes of data\n",
+               (void *) rec->start, rec->size - stream->dat_len);
+        return false;
+    }
+
+    /* Name follows the data */
+    if(context->hdr_rec.version == PZL_VERSION_DEFLATE)
+    {
+        if(rec->str_flag == 0x01)
+            ret = pzl_stream_deflate(stream, rec->str, rec->str_size, MZ_NO_FLUSH);
+        stream->data_size += rec->length;
+    }
+
+    /* File record keeps its type whatever it stored */
+    else if(stream->clean != NULL)
+    {
+        ret = pzl_stream_pwrite(stream, stream->bmp, PZL_BMP_SIZE(rec->size), stream->idx_off) &&
+              pzl_stream_pwrite(stream, (uint8_t *) &(stream->file_hash), sizeof(stream->file_hash),
+                                stream->idx_off - 16) &&
+              pzl_stream_pwrite(stream, (uint8_t *) &length, sizeof(length), stream->rec_off + 2);
+    }
+
+    /* Bitmap or plain record header */
+    else if(context->hdr_rec.version == PZL_VERSION_MMAP && context->pool == NULL)
+    {
+        uint64_t plain_off = PZL_PAGE_ALIGN(stream->rec_off + PZL_MEM_REC_HDR_SIZE + rec->str_size);
+        uint64_t dat_off = PZL_PAGE_ALIGN(stream->idx_off + PZL_BMP_SIZE(rec->size));
+
+        if(!stream->zero_page && plain_off == dat_off)
+        {
+            uint64_t hdr_len = dat_off - stream->rec_off;
+            uint64_t offset = 0;
+            uint8_t *hdr = (uint8_t *) calloc(hdr_len, 1);
+            if(hdr == NULL)
+            {
+                printf("pzl_stream_close_rec: cannot allocate record header\n");
+                return false;
+            }
+            pzl_stream_pack_rec(rec, 0x0001, length, hdr, &offset, true);
+            ret = pzl_stream_pwrite(stream, hdr, hdr_len, stream->rec_off);
+            free(hdr);
+        }
+        else
+        {
+            ret = pzl_stream_pwrite(stream, stream->bmp, PZL_BMP_SIZE(rec->size), stream->idx_off) &&
+                  pzl_stream_pwrite(stream, (uint8_t *) &length, sizeof(length), stream->rec_off + 2);
+        }
+    }
+
+    /* Chunk index */
+    else if(context->hdr_rec.version == PZL_VERSION_CHUNKED)
+    {
+        ret = pzl_stream_pwrite(stream,
+                                (uint8_t *) stream->chk_len,
+                                rec->chk_cnt * sizeof(uint64_t),
+                                stream->idx_off) &&
+              pzl_stream_pwrite(stream, (uint8_t *) &length, sizeof(length), stream->rec_off + 2);
+        stream->data_size += rec->length;
+    }
+
+    /* Clean up */
+    free(rec->str);
+    rec->str = NULL;
+    free(stream->bmp);
+    stream->bmp = NULL;
+    free(stream->clean);
+    stream->clean = NULL;
+    free(stream->chk_len);
+    stream->chk_len = NULL;
+    stream->rec_open = false;
+
+    return ret;
+}
+
+/* Release stream resources */
+static void pzl_stream_free(pzl_stream_t *stream)
+{
+    if(stream->zstrm != NULL)
+    {
+        mz_deflateEnd((mz_stream *) stream->zstrm);
+        free(stream->zstrm);
+    }
+    free(stream->rec.str);
+    free(stream->bmp);
+    free(stream->clean);
+    free(stream->chk_len);
+    free(stream->buf);
+    free(stream->out);
+    free(stream);
+}
+
+/***************************************************************/
+/*                           PACKING                           */
+/***************************************************************/
+bool pzl_pack_stream_init(pzl_stream_t **stream, pzl_ctx_t *context, int32_t fd)
+{
+    CHECK_PTR(stream, "pzl_pack_stream_init - stream");
+    CHECK_PTR(context, "pzl_pack_stream_init - context");
+
+    /* Header is backfilled so fd must seek */
+    off_t base = lseek(fd, 0, SEEK_CUR);
+    if(base < 0)
+    {
+        printf("pzl_pack_stream_init: fd %d is not seekable\n", fd);
+        return false;
+    }
+
+    pzl_stream_t *new_stream = (pzl_stream_t *) calloc(1, sizeof(pzl_stream_t));
+    if(new_stream == NULL)
+    {
+        printf("pzl_pack_stream_init: cannot allocate stream\n");
+        return false;
+    }
+    new_stream->context = context;
+    new_stream->fd = fd;
+    new_stream->base = base;
+
+    /* Size buffers for the format */
+    switch(context->hdr_rec.version)
+    {
+        case PZL_VERSION_DEFLATE:
+            new_stream->out_cap = PZL_STREAM_OUT_SIZE;
+            new_stream->zstrm = calloc(1, sizeof(mz_stream));
+            if(new_stream->zstrm != NULL &&
+               mz_deflateInit((mz_stream *) new_stream->zstrm, MZ_DEFAULT_COMPRESSION) != MZ_OK)
+            {
+                free(new_stream->zstrm);
+                new_stream->zstrm = NULL;
+            }
+            if(new_stream->zstrm == NULL)
+            {
+                printf("pzl_pack_stream_init: cannot start compression\n");
+                pzl_stream_free(new_stream);
+                return false;
+            }
+            break;
+        case PZL_VERSION_MMAP:
+            new_stream->buf_cap = PZL_PAGE_SIZE;
+            break;
+        case PZL_VERSION_CHUNKED:
+            new_stream->buf_cap = context->hdr_rec.chk_size * (context->threads ? context->threads : 1);
+            new_stream->out_cap = pzl_pack_chk_slot(context) * (context->threads ? context->threads : 1);
+            break;
+        default:
+            printf("pzl_pack_stream_init: unknown version 0x%04x\n", context->hdr_rec.version);
+            pzl_stream_free(new_stream);
+            return false;
+    }
+    if(new_stream->buf_cap > 0)
+        new_stream->buf = (uint8_t *) malloc(new_stream->buf_cap);
+    if(new_stream->out_cap > 0)
+        new_stream->out = (uint8_t *) malloc(new_stream->out_cap);
+    if((new_stream->buf_cap > 0 && new_stream->buf == NULL) ||
+       (new_stream->out_cap > 0 && new_stream->out == NULL))
+    {
+        printf("pzl_pack_stream_init: cannot allocate stream buffers\n");
+        pzl_stream_free(new_stream);
+        return false;
+    }
+
+    /* Reserve magic and header */
+    uint64_t hdr_len = pzl_get_mgc_size(context) + pzl_get_hdr_size(context);
+    uint8_t hdr[64];
+    memset(hdr, 0, sizeof(hdr));
+    if(hdr_len > sizeof(hdr) || !pzl_stream_write(new_stream, hdr, hdr_len))
+    {
+        printf("pzl_pack_stream_init: cannot reserve header\n");
+        pzl_stream_free(new_stream);
+        return false;
+    }
+
+    *stream = new_stream;
+
+    return true;
+}
+
+/* Start a memory record, a file record when clean is given */
+static bool pzl_stream_mem(pzl_stream_t *stream,
+                           uint64_t start,
+                           uint64_t end,
+                           uint64_t size,
+                           uint8_t perms,
+                           uint64_t str_size,
+                           uint8_t *str,
+                           uint64_t file_off,
+                           uint8_t *clean)
+{
+    /* Locals */
+    pzl_ctx_t *context = stream->context;
+    mem_rec_t *rec = &(stream->rec);
+    uint64_t hdr_len, length = 0, offset = 0;
+    uint64_t cnt;
+    uint8_t *hdr;
+    bool ret;
+
+    if(stream->rec_open && !pzl_stream_close_rec(stream))
+    {
+        printf("pzl_pack_stream_mem: cannot finish memory record\n");
+        return false;
+    }
+
+    /* Describe record */
+    memset(rec, 0, sizeof(mem_rec_t));
+    rec->type = 0x0001;
+    rec->start = start;
+    rec->end = end;
+    rec->size = size;
+    rec->perms = perms;
+    if(str != NULL && str_size > 0)
+    {
+        rec->str = (uint8_t *) malloc(str_size);
+        if(rec->str == NULL)
+        {
+            printf("pzl_pack_stream_mem: cannot allocate space for string buffer\n");
+            return false;
+        }
+        memcpy(rec->str, str, str_size);
+        rec->str_flag = 0x01;
+        rec->str_size = str_size;
+    }
+    rec->length = PZL_MEM_REC_HDR_SIZE + rec->str_size + size;
+    stream->rec_open = true;
+    stream->rec_off = stream->offset;
+    stream->dat_len = 0;
+    stream->buf_len = 0;
+    stream->blk_idx = 0;
+    stream->zero_page = false;
+    stream->file_hash = PZL_FNV_OFFSET;
+    stream->rec_cnt++;
+
+    /* Name is compressed after the data */
+    if(context->hdr_rec.version == PZL_VERSION_DEFLATE)
+    {
+        uint8_t fix[PZL_MEM_REC_HDR_SIZE];
+        pzl_stream_pack_rec(rec, 0x0001, rec->length, fix, &offset, false);
+        return pzl_stream_deflate(stream, fix, offset, MZ_NO_FLUSH);
+    }
+
+    /* Header up to the first page or chunk, page and chunk indexes are backfilled */
+    cnt = PZL_PAGE_CNT(size);
+    stream->idx_off = stream->rec_off + PZL_MEM_REC_HDR_SIZE + rec->str_size + 8;
+    if(clean != NULL)
+    {
+        stream->bmp = (uint8_t *) calloc(PZL_BMP_SIZE(size) + 1, 1);
+        stream->clean = (uint8_t *) malloc(PZL_BMP_SIZE(size) + 1);
+        if(stream->clean != NULL)
+            memcpy(stream->clean, clean, PZL_BMP_SIZE(size));
+        stream->idx_off += 8 + 8;
+        hdr_len = PZL_PAGE_ALIGN(stream->idx_off + PZL_BMP_SIZE(size)) - stream->rec_off;
+    }
+    else if(context->hdr_rec.version == PZL_VERSION_MMAP && context->pool != NULL)
+    {
+        length = PZL_MEM_REC_HDR_SIZE + rec->str_size + 8 + 8 + cnt * (8 + 8);
+        hdr_len = PZL_MEM_REC_HDR_SIZE + rec->str_size + 8 + 8;
+    }
+    else if(context->hdr_rec.version == PZL_VERSION_MMAP)
+    {
+        stream->bmp = (uint8_t *) calloc(PZL_BMP_SIZE(size) + 1, 1);
+        hdr_len = PZL_PAGE_ALIGN(stream->rec_off + PZL_MEM_REC_HDR_SIZE + rec->str_size + 8 +
+                                 PZL_BMP_SIZE(size)) - stream->rec_off;
+    }
+    else
+    {
+        cnt = (size + context->hdr_rec.chk_size - 1) / context->hdr_rec.chk_size;
+        rec->chk_cnt = cnt;
+        stream->chk_len = (uint64_t *) calloc(cnt + 1, sizeof(uint64_t));
+        hdr_len = PZL_MEM_REC_HDR_SIZE + rec->str_size + 8 + cnt * sizeof(uint64_t);
+    }
+
+    hdr = (uint8_t *) calloc(hdr_len, 1);
+    if(hdr == NULL ||
+       (clean != NULL && (stream->bmp == NULL || stream->clean == NULL)) ||
+       (context->hdr_rec.version == PZL_VERSION_MMAP && context->pool == NULL && stream->bmp == NULL) ||
+       (context->hdr_rec.version == PZL_VERSION_CHUNKED && stream->chk_len == NULL))
+    {
+        printf("pzl_pack_stream_mem: cannot allocate record header\n");
+        free(hdr);
+        return false;
+    }
+    pzl_stream_pack_rec(rec,
+                        clean != NULL ? 0x0005 :
+                        context->hdr_rec.version == PZL_VERSION_MMAP ?
+                        (context->pool != NULL ? 0x0004 : 0x0003) : 0x0001,
+                        length,
+                        hdr,
+                        &offset,
+                        true);
+
+    /* File offset, the hash is backfilled */
+    if(clean != NULL)
+    {
+        memcpy(hdr + offset, &file_off, sizeof(file_off));
+        offset += sizeof(file_off) + sizeof(stream->file_hash);
+    }
+
+    /* Pool ID */
+    if(context->hdr_rec.version == PZL_VERSION_MMAP && context->pool != NULL)
+    {
+        memcpy(hdr + offset, &(context->pool->id), sizeof(context->pool->id));
+        offset += sizeof(context->pool->id);
+    }
+
+    /* Page or chunk count */
+    memcpy(hdr + offset, &cnt, sizeof(cnt));
+
+    ret = pzl_stream_write(stream, hdr, hdr_len);
+    free(hdr);
+
+    return ret;
+}
+
+/* Start the next memory record, finishing the open one */
+bool pzl_pack_stream_mem(pzl_stream_t *stream,
+                         uint64_t start,
+                         uint64_t end,
+                         uint64_t size,
+                         uint8_t perms,
+                         uint64_t str_size,
+                         uint8_t *str)
+{
+    CHECK_PTR(stream, "pzl_pack_stream_mem - stream");
+
+    return pzl_stream_mem(stream, start, end, size, perms, str_size, str, 0, NULL);
+}
+
+/* Start the next memory record as a file record, leaving clean pages to the file */
+bool pzl_pack_stream_mem_file(pzl_stream_t *stream,
+                              uint64_t start,
+                              uint64_t end,
+                              uint64_t size,
+                              uint8_t perms,
+                              uint64_t str_size,
+                              uint8_t *str,
+                              uint64_t file_off,
+                              uint8_t *clean)
+{
+    CHECK_PTR(stream, "pzl_pack_stream_mem_file - stream");
+    CHECK_PTR(clean, "pzl_pack_stream_mem_file - clean");
+
+    if(stream->context->hdr_rec.version != PZL_VERSION_MMAP)
+    {
+        printf("pzl_pack_stream_mem_file: file records need PZL_VERSION_MMAP\n");
+        return false;
+    }
+    if(str == NULL || str_size == 0 || size == 0 || file_off % PZL_PAGE_SIZE != 0)
+    {
+        printf("pzl_pack_stream_mem_file: needs a file name and page aligned offset\n");
+        return false;
+    }
+
+    return pzl_stream_mem(stream, start, end, size, perms, str_size, str, file_off, clean);
+}
+
+/* Append data to the open memory record */
+bool pzl_pack_stream_dat(pzl_stream_t *stream, uint8_t *dat, uint64_t len)
+{
+    CHECK_PTR(stream, "pzl_pack_stream_dat - stream");
+
+    /* Locals */
+    mem_rec_t *rec = &(stream->rec);
+    uint64_t blk, cpy;
+
+    if(!stream->rec_open)
+    {
+        printf("pzl_pack_stream_dat: no memory record started\n");
+        return false;
+    }
+    if(len > rec->size - stream->dat_len)
+    {
+        printf("pzl_pack_stream_dat: data exceeds size of %p\n", (void *) rec->start);
+        return false;
+    }
+    if(len == 0)
+        return true;
+    CHECK_PTR(dat, "pzl_pack_stream_dat - dat");
+
+    /* Compressed as it arrives */
+    if(stream->context->hdr_rec.version == PZL_VERSION_DEFLATE)
+    {
+        stream->dat_len += len;
+        return pzl_stream_deflate(stream, dat, len, MZ_NO_FLUSH);
+    }
+
+    /* Whole blocks skip the buffer, the last block of a record may be short */
+    while(len > 0)
+    {
+        blk = rec->size - (stream->dat_len - stream->buf_len);
+        if(blk > stream->buf_cap)
+            blk = stream->buf_cap;
+
+        if(stream->buf_len == 0 && len >= blk)
+        {
+            if(!pzl_stream_blk(stream, dat, blk))
+                return false;
+            dat += blk;
+            len -= blk;
+            stream->dat_len += blk;
+            continue;
+        }
+
+        cpy = blk - stream->buf_len < len ? blk - stream->buf_len : len;
+        memcpy(stream->buf + stream->buf_len, dat, cpy);
+        stream->buf_len += cpy;
+        stream->dat_len += cpy;
+        dat += cpy;
+        len -= cpy;
+
+        if(stream->buf_len == blk)
+        {
+            stream->buf_len = 0;
+            if(!pzl_stream_blk(stream, stream->buf, blk))
+                return false;
+        }
+    }
+
+    return true;
+}
+
+/* Write the register record and header, then free the stream */
+bool pzl_pack_stream_end(pzl_stream_t *stream)
+{
+    CHECK_PTR(stream, "pzl_pack_stream_end - stream");
+
+    /* Locals */
+    pzl_ctx_t *context = stream->context;
+    uint64_t hdr_len = pzl_get_mgc_size(context) + pzl_get_hdr_size(context);
+    uint64_t offset = 0;
+    uint8_t *reg = NULL;
+    uint8_t hdr[64];
+    bool ret = false;
+
+    if(stream->rec_open && !pzl_stream_close_rec(stream))
+    {
+        printf("pzl_pack_stream_end: cannot finish memory record\n");
+        goto cleanup;
+    }
+    if(stream->rec_cnt == 0 || context->reg_rec == NULL)
+    {
+        printf("pzl_pack_stream_end: needs memory and register records\n");
+        goto cleanup;
+    }
+
+    /* Register record */
+    reg = (uint8_t *) malloc(pzl_get_reg_size(context));
+    if(reg == NULL || !pzl_pack_reg_rec(context, reg, &offset))
+    {
+        printf("pzl_pack_stream_end: cannot pack register record\n");
+        goto cleanup;
+    }
+    if(context->hdr_rec.version == PZL_VERSION_DEFLATE)
+        ret = pzl_stream_deflate(stream, reg, offset, MZ_FINISH);
+    else
+        ret = pzl_stream_write(stream, reg, offset);
+    if(!ret)
+        goto cleanup;
+    stream->data_size += offset;
+
+    /* Uncompressed layout records the bytes on disk */
+    if(context->hdr_rec.version == PZL_VERSION_MMAP)
+        stream->data_size = stream->offset - hdr_len;
+
+    /* Header */
+    offset = 0;
+    context->hdr_rec.data_size = stream->data_size;
+    pzl_pack_mgc(context, hdr, &offset);
+    pzl_pack_hdr_rec(context, hdr, &offset);
+    ret = pzl_stream_pwrite(stream, hdr, hdr_len, 0);
+
+cleanup:
+    free(reg);
+    pzl_stream_free(stream);
+
+    return ret;
+}
+
+/* Drop a stream without finishing the file */
+bool pzl_pack_stream_abort(pzl_stream_t *stream)
+{
+    CHECK_PTR(stream, "pzl_pack_stream_abort - stream");
+
+    pzl_stream_free(stream);
+
+    return true;
+}
+
+/* Stream the whole context to fd */
+bool pzl_pack_to_fd(pzl_ctx_t *context, int32_t fd)
+{
+    CHECK_PTR(context, "pzl_pack_to_fd - context");
+    CHECK_PTR(context->mem_rec, "pzl_pack_to_fd - context->mem_rec");
+    CHECK_PTR(context->reg_rec, "pzl_pack_to_fd - context->reg_rec");
+
+    /* Locals */
+    pzl_stream_t *stream;
+    uint64_t idx;
+
+    /* Lazily opened records must be complete */
+    if(!pzl_load_mem_recs(context))
+    {
+        printf("pzl_pack_to_fd: cannot load memory records\n");
+        return false;
+    }
+
+    if(!pzl_pack_stream_init(&stream, context, fd))
+    {
+        printf("pzl_pack_to_fd: cannot start stream\n");
+        return false;
+    }
+
+    for(idx = 0; idx < context->mem_rec_cnt; idx++)
+    {
+        mem_rec_t *mem_rec = context->mem_rec[idx];
+        bool file = mem_rec->file_bmp != NULL && context->hdr_rec.version == PZL_VERSION_MMAP;
+        if(!(file ? pzl_pack_stream_mem_file(stream,
+                                             mem_rec->start,
+                                             mem_rec->end,
+                                             mem_rec->size,
+                                             mem_rec->perms,
+                                             mem_rec->str_size,
+                                             mem_rec->str,
+                                             mem_rec->file_off,
+                                             mem_rec->file_bmp) :
+                    pzl_pack_stream_mem(stream,
+                                        mem_rec->start,
+                                        mem_rec->end,
+                                        mem_rec->size,
+                                        mem_rec->perms,
+                                        mem_rec->str_size,
+                                        mem_rec->str)) ||
+           !pzl_pack_stream_dat(stream, mem_rec->dat, mem_rec->size))
+        {
+            printf("pzl_pack_to_fd: cannot stream memory record %p\n", (void *) mem_rec->start);
+            pzl_pack_stream_abort(stream);
+            return false;
+        }
+    }
+
+    return pzl_pack_stream_end(stream);
+}
@@ -0,0 +1,79 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <puzzle.h>
+
+
+/* Work shared by the pool */
+typedef struct pzl_jobs_struct
+{
+    bool (*job)(void *arg, uint64_t job_idx);
+    void *arg;
+    uint64_t job_cnt;
+    uint64_t next_idx;
+    bool failed;
+} pzl_jobs_t;
+
+/* Claim jobs until none remain or one fails */
+static void *pzl_run_worker(void *arg)
+{
+    pzl_jobs_t *jobs = (pzl_jobs_t *) arg;
+    uint64_t job_idx;
+
+    while(!__atomic_load_n(&(jobs->failed), __ATOMIC_RELAXED))
+    {
+        job_idx = __atomic_fetch_add(&(jobs->next_idx), 1, __ATOMIC_RELAXED);
+        if(job_idx >= jobs->job_cnt)
+            break;
+
+        if(!jobs->job(jobs->arg, job_idx))
+            __atomic_store_n(&(jobs->failed), true, __ATOMIC_RELAXED);
+    }
+
+    return NULL;
+}
+
+/* Run independent jobs across context->threads workers */
+bool pzl_run_jobs(pzl_ctx_t *context,
+                  uint64_t job_cnt,
+                  bool (*job)(void *arg, uint64_t job_idx),
+                  void *arg)
+{
+    CHECK_PTR(context, "pzl_run_jobs - context");
+    CHECK_PTR(job, "pzl_run_jobs - job");
+
+    /* Locals */
+    pzl_jobs_t jobs = {job, arg, job_cnt, 0, false};
+    pthread_t *workers = NULL;
+    uint64_t worker_cnt = context->threads;
+    uint64_t worker_idx;
+    uint64_t started = 0;
+
+    /* No more workers than jobs, the caller is one of them */
+    if(worker_cnt > job_cnt)
+        worker_cnt = job_cnt;
+    if(worker_cnt > 1)
+    {
+        workers = (pthread_t *) malloc((worker_cnt - 1) * sizeof(pthread_t));
+        if(workers == NULL)
+            worker_cnt = 1;
+    }
+
+    /* Fall back to fewer workers if threads cannot be created */
+    for(worker_idx = 0; worker_idx + 1 < worker_cnt; worker_idx++)
+    {
+        if(pthread_create(&(workers[worker_idx]), NULL, pzl_run_worker, &jobs) != 0)
+            break;
+        started++;
+    }
+
+    pzl_run_worker(&jobs);
+
+    for(worker_idx = 0; worker_idx < started; worker_idx++)
+        pthread_join(workers[worker_idx], NULL);
+    free(workers);
+
+    return !jobs.failed;
+}
@@ -1,4 +1,5 @@
 #include <stdio.h>
+#include <string.h>
 #include <puzzle.h>
 
 
@@ -25,14 +26,11 @@ uint64_t pzl_get_mem_size(pzl_ctx_t *context)
     CHECK_PTR(context, "pzl_get_mem_size - context");
     CHECK_PTR(context->mem_rec, "pzl_get_mem_size - context->mem_rec");
 
-    /* Walk list */
+    /* Walk records */
     uint64_t cum_size = 0;
-    mem_rec_t *mem_rec = context->mem_rec;
-    while(mem_rec != NULL)
-    {
-        cum_size += mem_rec->length;
-        mem_rec = mem_rec->next;
-    }
+    uint64_t idx;
+    for(idx = 0; idx < context->mem_rec_cnt; idx++)
+        cum_size += context->mem_rec[idx]->length;
 
     return cum_size;
 }
@@ -54,8 +52,36 @@ uint64_t pzl_get_usr_reg_size(pzl_ctx_t *context)
     {
         case X86_64:
             return sizeof(usr_regs_x86_64_t);
+        case ARM:
+            return sizeof(usr_regs_arm_t);
+        case AARCH64:
+            return sizeof(usr_regs_aarch64_t);
+        case MIPS_32:
+            return sizeof(usr_regs_mips_t);
         default:
             printf("pzl_get_usr_reg_size: unknow architecture\n");
             return false;
     }
 }
+
+/* Check for a buffer of zeroes */
+bool pzl_is_zero(uint8_t *dat, uint64_t size)
+{
+    uint64_t word;
+    uint64_t offset = 0;
+
+    /* Word at a time, memcpy keeps unaligned buffers safe */
+    for(; offset + sizeof(word) <= size; offset += sizeof(word))
+    {
+        memcpy(&word, dat + offset, sizeof(word));
+        if(word != 0)
+            return false;
+    }
+    for(; offset < size; offset++)
+    {
+        if(dat[offset] != 0x00)
+            return false;
+    }
+
+    return true;
+}
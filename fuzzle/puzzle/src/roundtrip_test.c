@@ -0,0 +1,505 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <puzzle.h>
+
+
+/*
+Round trip checks of the UZL layouts. Each case packs the same memory and
+register records, loads them back and compares every byte. Files are
+written to TMPDIR, /tmp when it is unset, and removed again.
+*/
+
+/* Memory records of the test context */
+#define RT_RECS 3
+
+/* Chunk size of chunked cases, records span several chunks */
+#define RT_CHK_SIZE 0x2000
+
+static const struct {
+    uint64_t start;
+    uint64_t size;
+    uint8_t perms;
+    const char *str;
+} rt_recs[RT_RECS] =
+{
+    { 0x400000, 5 * PZL_PAGE_SIZE + 0x123, PZL_READ | PZL_EXECUTE, "/bin/target" },
+    { 0x7f0000000000, 4 * PZL_PAGE_SIZE, PZL_READ | PZL_WRITE, "[heap]" },
+    { 0x7ffff000, 0x800, PZL_READ, NULL }
+};
+
+/* Directory of the files written by the cases */
+static const char *rt_dir(void)
+{
+    const char *dir = getenv("TMPDIR");
+    return dir != NULL && *dir != '\0' ? dir : "/tmp";
+}
+
+/* Path of a file written by a case */
+static void rt_path(char *path, size_t len, const char *name)
+{
+    snprintf(path, len, "%s/roundtrip-%d-%s", rt_dir(), (int) getpid(), name);
+}
+
+/* Register record filled with a byte pattern */
+static bool rt_build_reg(pzl_ctx_t *context)
+{
+    usr_regs_x86_64_t usr_reg;
+    uint64_t off;
+
+    for(off = 0; off < sizeof(usr_reg); off++)
+        ((uint8_t *) &usr_reg)[off] = (uint8_t) off;
+    if(!pzl_create_reg_rec(context, &usr_reg))
+    {
+        printf("rt_build_reg: cannot create register record\n");
+        return false;
+    }
+
+    return true;
+}
+
+/* Context holding the test records, zero leaves pages of the heap empty */
+static bool rt_build(pzl_ctx_t **context, uint16_t version, bool zero)
+{
+    uint64_t idx, off;
+
+    if(!pzl_init(context, X86_64))
+    {
+        printf("rt_build: cannot initialise context\n");
+        return false;
+    }
+    pzl_set_version(*context, version);
+
+    for(idx = 0; idx < RT_RECS; idx++)
+    {
+        uint8_t *dat = (uint8_t *) malloc(rt_recs[idx].size);
+        if(dat == NULL)
+        {
+            printf("rt_build: cannot allocate record data\n");
+            return false;
+        }
+
+        /* Distinct non-zero bytes per record and page */
+        for(off = 0; off < rt_recs[idx].size; off++)
+            dat[off] = (uint8_t) (off * 7 + (off >> 12) * 13 + idx * 31) | 0x01;
+        if(zero && idx == 1)
+        {
+            memset(dat + PZL_PAGE_SIZE, 0, PZL_PAGE_SIZE);
+            memset(dat + 3 * PZL_PAGE_SIZE, 0, PZL_PAGE_SIZE);
+        }
+
+        const char *str = rt_recs[idx].str;
+        bool ret = pzl_create_mem_rec(*context,
+                                      rt_recs[idx].start,
+                                      rt_recs[idx].start + PZL_PAGE_ALIGN(rt_recs[idx].size),
+                                      rt_recs[idx].size,
+                                      rt_recs[idx].perms,
+                                      dat,
+                                      str ? strlen(str) : 0,
+                                      (uint8_t *) str);
+        free(dat);
+        if(!ret)
+        {
+            printf("rt_build: cannot create memory record\n");
+            return false;
+        }
+    }
+
+    return rt_build_reg(*context);
+}
+
+/* Records loaded into dst must match src byte for byte */
+static bool rt_check(pzl_ctx_t *src, pzl_ctx_t *dst)
+{
+    uint64_t idx;
+
+    if(dst->mem_rec_cnt != src->mem_rec_cnt)
+    {
+        printf("rt_check: %lu memory records, expected %lu\n", dst->mem_rec_cnt, src->mem_rec_cnt);
+        return false;
+    }
+
+    for(idx = 0; idx < src->mem_rec_cnt; idx++)
+    {
+        mem_rec_t *a = src->mem_rec[idx];
+        mem_rec_t *b = dst->mem_rec[idx];
+        if(a->start != b->start || a->end != b->end || a->size != b->size || a->perms != b->perms ||
+           a->str_flag != b->str_flag || a->str_size != b->str_size ||
+           (a->str_size > 0 && memcmp(a->str, b->str, a->str_size) != 0))
+        {
+            printf("rt_check: fields of record %p differ\n", (void *) a->start);
+            return false;
+        }
+        if(memcmp(a->dat, b->dat, a->size) != 0)
+        {
+            printf("rt_check: data of record %p differs\n", (void *) a->start);
+            return false;
+        }
+    }
+
+    if(dst->reg_rec == NULL || dst->reg_rec->usr_reg_len != src->reg_rec->usr_reg_len ||
+       memcmp(dst->reg_rec->usr_reg, src->reg_rec->usr_reg, src->reg_rec->usr_reg_len) != 0)
+    {
+        printf("rt_check: register record differs\n");
+        return false;
+    }
+
+    return true;
+}
+
+/* Pack context into memory and write it to path */
+static bool rt_write(pzl_ctx_t *context, const char *path)
+{
+    uint64_t size = 0;
+    bool ret = false;
+
+    uint8_t *dat = (uint8_t *) malloc(pzl_pack_size(context));
+    if(dat == NULL)
+    {
+        printf("rt_write: cannot allocate pack buffer\n");
+        return false;
+    }
+
+    FILE *file = NULL;
+    if(!pzl_pack(context, dat, &size))
+        printf("rt_write: cannot pack context\n");
+    else if((file = fopen(path, "wb")) == NULL || fwrite(dat, 1, size, file) != size)
+        printf("rt_write: cannot write '%s'\n", path);
+    else
+        ret = true;
+
+    if(file != NULL && fclose(file) != 0)
+        ret = false;
+    free(dat);
+    return ret;
+}
+
+/* Map path into a new context, lazy leaves chunks compressed until loaded */
+static bool rt_load(pzl_ctx_t **context, const char *path, bool lazy, pzl_pool_t *pool)
+{
+    if(!pzl_init(context, UNKN_ARCH))
+    {
+        printf("rt_load: cannot initialise context\n");
+        return false;
+    }
+    pzl_set_pool(*context, pool);
+    if(!(lazy ? pzl_open_lazy(*context, path) : pzl_open_mmap(*context, path)))
+    {
+        printf("rt_load: cannot open '%s'\n", path);
+        return false;
+    }
+    return true;
+}
+
+/* Pack src to path, load it back and compare */
+static bool rt_roundtrip(pzl_ctx_t *src, const char *name, bool lazy)
+{
+    char path[4096];
+    pzl_ctx_t *dst = NULL;
+    bool ret;
+
+    rt_path(path, sizeof(path), name);
+    ret = rt_write(src, path) && rt_load(&dst, path, lazy, NULL) &&
+          (!lazy || pzl_load_mem_recs(dst)) && rt_check(src, dst);
+
+    if(dst != NULL)
+        pzl_free(dst);
+    unlink(path);
+    return ret;
+}
+
+/* Page aligned records referenced in place */
+static bool rt_case_raw(void)
+{
+    pzl_ctx_t *src = NULL;
+    bool ret = rt_build(&src, PZL_VERSION_MMAP, false) && rt_roundtrip(src, "raw.uzl", false);
+    if(src != NULL)
+        pzl_free(src);
+    return ret;
+}
+
+/* Zero pages of the heap left out of its record */
+static bool rt_case_sparse(void)
+{
+    pzl_ctx_t *src = NULL;
+    uint64_t idx;
+    bool ret = rt_build(&src, PZL_VERSION_MMAP, true);
+
+    /* Records are kept sorted, find the heap by its start */
+    for(idx = 0; ret && idx < src->mem_rec_cnt; idx++)
+    {
+        if(src->mem_rec[idx]->start == rt_recs[1].start && !pzl_has_zero_page(src->mem_rec[idx]))
+        {
+            printf("rt_case_sparse: heap is not sparse\n");
+            ret = false;
+        }
+    }
+    ret = ret && rt_roundtrip(src, "sparse.uzl", false);
+    if(src != NULL)
+        pzl_free(src);
+    return ret;
+}
+
+/* Pages shared through a pool, packing twice must not grow it */
+static bool rt_case_pooled(void)
+{
+    char path[4096], pool_path[4096];
+    pzl_ctx_t *src = NULL, *dst = NULL;
+    pzl_pool_t *pool = NULL;
+    uint64_t page_cnt = 0;
+    bool ret;
+
+    rt_path(path, sizeof(path), "pooled.uzl");
+    rt_path(pool_path, sizeof(pool_path), "pooled.pool");
+    unlink(pool_path);
+
+    ret = rt_build(&src, PZL_VERSION_MMAP, true) &&
+          pzl_pool_open(&pool, pool_path, true) &&
+          pzl_set_pool(src, pool) &&
+          rt_write(src, path);
+    if(ret)
+    {
+        page_cnt = pool->page_cnt;
+        ret = rt_write(src, path);
+    }
+    if(ret && page_cnt == 0)
+    {
+        printf("rt_case_pooled: no pages in pool\n");
+        ret = false;
+    }
+    if(ret && pool->page_cnt != page_cnt)
+    {
+        printf("rt_case_pooled: pool grew from %lu to %lu pages\n", page_cnt, pool->page_cnt);
+        ret = false;
+    }
+    pzl_pool_close(pool);
+    pool = NULL;
+
+    /* Load against the pool as a reader */
+    ret = ret && pzl_pool_open(&pool, pool_path, false) &&
+          rt_load(&dst, path, false, pool) && rt_check(src, dst);
+
+    if(dst != NULL)
+        pzl_free(dst);
+    if(src != NULL)
+        pzl_free(src);
+    pzl_pool_close(pool);
+    unlink(path);
+    unlink(pool_path);
+    return ret;
+}
+
+/* Records streamed to a file, which must match the packed buffer */
+static bool rt_case_stream(void)
+{
+    static const uint16_t versions[] = { PZL_VERSION_DEFLATE, PZL_VERSION_MMAP, PZL_VERSION_CHUNKED };
+    char path[4096];
+    uint64_t idx, size = 0;
+    bool ret = true;
+
+    rt_path(path, sizeof(path), "stream.uzl");
+    for(idx = 0; ret && idx < sizeof(versions) / sizeof(versions[0]); idx++)
+    {
+        pzl_ctx_t *src = NULL, *dst = NULL;
+        uint8_t *dat = NULL, *file_dat = NULL;
+        int32_t fd = -1;
+
+        ret = rt_build(&src, versions[idx], true) && pzl_set_chk_size(src, RT_CHK_SIZE);
+        if(ret && ((fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644)) < 0 || !pzl_pack_to_fd(src, fd)))
+        {
+            printf("rt_case_stream: cannot stream version %u\n", versions[idx]);
+            ret = false;
+        }
+        if(fd >= 0)
+            close(fd);
+
+        /* Stream and buffer are the same bytes */
+        if(ret)
+        {
+            dat = (uint8_t *) malloc(pzl_pack_size(src));
+            FILE *file = fopen(path, "rb");
+            ret = dat != NULL && file != NULL && pzl_pack(src, dat, &size);
+            if(ret)
+            {
+                file_dat = (uint8_t *) malloc(size + 1);
+                ret = file_dat != NULL && fread(file_dat, 1, size + 1, file) == size &&
+                      memcmp(dat, file_dat, size) == 0;
+                if(!ret)
+                    printf("rt_case_stream: version %u stream differs from pack\n", versions[idx]);
+            }
+            if(file != NULL)
+                fclose(file);
+        }
+
+        ret = ret && rt_load(&dst, path, false, NULL) && rt_check(src, dst);
+
+        free(dat);
+        free(file_dat);
+        if(dst != NULL)
+            pzl_free(dst);
+        if(src != NULL)
+            pzl_free(src);
+    }
+
+    unlink(path);
+    return ret;
+}
+
+/* Map path with file records resolved under the test directory */
+static bool rt_load_file(pzl_ctx_t **context, const char *path, bool verify)
+{
+    if(!pzl_init(context, UNKN_ARCH))
+    {
+        printf("rt_load_file: cannot initialise context\n");
+        return false;
+    }
+    pzl_set_root(*context, rt_dir());
+    pzl_set_verify(*context, verify);
+    return pzl_open_mmap(*context, path);
+}
+
+/* Record referencing the pages of a file, which must not load once changed */
+static bool rt_case_file(void)
+{
+    char path[4096], file_path[4096], name[64];
+    uint64_t size = 3 * PZL_PAGE_SIZE + 0x200, off;
+    uint8_t clean = 0x0d, byte = 0xff;
+    uint8_t file_dat[PZL_PAGE_SIZE + 3 * PZL_PAGE_SIZE + 0x200];
+    pzl_ctx_t *src = NULL, *dst = NULL;
+    int32_t fd;
+    bool ret;
+
+    rt_path(path, sizeof(path), "file.uzl");
+    snprintf(name, sizeof(name), "/roundtrip-%d-file.bin", (int) getpid());
+    snprintf(file_path, sizeof(file_path), "%s%s", rt_dir(), name);
+
+    /* File one page longer than the mapping, which starts at its second page */
+    for(off = 0; off < sizeof(file_dat); off++)
+        file_dat[off] = (uint8_t) (off * 5 + (off >> 12) * 11) | 0x01;
+    fd = open(file_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    ret = fd >= 0 && write(fd, file_dat, sizeof(file_dat)) == (ssize_t) sizeof(file_dat);
+    if(fd >= 0)
+        close(fd);
+    if(!ret)
+        printf("rt_case_file: cannot write '%s'\n", file_path);
+
+    /* Second page of the mapping written by the process */
+    memset(file_dat + 2 * PZL_PAGE_SIZE, 0xaa, PZL_PAGE_SIZE);
+    ret = ret && pzl_init(&src, X86_64) &&
+          pzl_set_version(src, PZL_VERSION_MMAP) &&
+          pzl_create_mem_rec(src, 0x7f0000000000, 0x7f0000000000 + PZL_PAGE_ALIGN(size), size,
+                             PZL_READ | PZL_WRITE, file_dat + PZL_PAGE_SIZE, strlen(name), (uint8_t *) name) &&
+          pzl_set_mem_rec_file(src, 0x7f0000000000, PZL_PAGE_SIZE, &clean) &&
+          rt_build_reg(src) &&
+          rt_write(src, path);
+
+    /* Unchanged file passes verification */
+    ret = ret && rt_load_file(&dst, path, true) && rt_check(src, dst);
+    if(dst != NULL)
+        pzl_free(dst);
+    dst = NULL;
+
+    /* Change a clean page of the file */
+    if(ret)
+    {
+        fd = open(file_path, O_WRONLY);
+        ret = fd >= 0 && pwrite(fd, &byte, 1, 3 * PZL_PAGE_SIZE + 5) == 1;
+        if(fd >= 0)
+            close(fd);
+    }
+
+    /* Verified load rejects the file, unverified load maps it as it is */
+    if(ret && rt_load_file(&dst, path, true))
+    {
+        printf("rt_case_file: changed file passed verification\n");
+        ret = false;
+    }
+    if(dst != NULL)
+        pzl_free(dst);
+    dst = NULL;
+    if(ret && (!rt_load_file(&dst, path, false) || dst->mem_rec_cnt != 1 ||
+               dst->mem_rec[0]->dat[2 * PZL_PAGE_SIZE + 5] != byte))
+    {
+        printf("rt_case_file: unverified load does not map the changed file\n");
+        ret = false;
+    }
+
+    if(dst != NULL)
+        pzl_free(dst);
+    if(src != NULL)
+        pzl_free(src);
+    unlink(path);
+    unlink(file_path);
+    return ret;
+}
+
+/* Chunked records inflated on load, on several threads */
+static bool rt_case_chunked(void)
+{
+    pzl_ctx_t *src = NULL;
+    bool ret = rt_build(&src, PZL_VERSION_CHUNKED, false) &&
+               pzl_set_chk_size(src, RT_CHK_SIZE) &&
+               pzl_set_codec(src, PZL_CODEC_DEFLATE, PZL_LEVEL_DEFAULT) &&
+               pzl_set_threads(src, 4) &&
+               rt_roundtrip(src, "chunked.uzl", false);
+    if(src != NULL)
+        pzl_free(src);
+    return ret;
+}
+
+/* Chunked records inflated on demand from the mapping */
+static bool rt_case_lazy(void)
+{
+    pzl_ctx_t *src = NULL;
+    bool ret = rt_build(&src, PZL_VERSION_CHUNKED, false) &&
+               pzl_set_chk_size(src, RT_CHK_SIZE) &&
+               pzl_set_codec(src, PZL_CODEC_DEFLATE, PZL_LEVEL_DEFAULT) &&
+               rt_roundtrip(src, "lazy.uzl", true);
+    if(src != NULL)
+        pzl_free(src);
+    return ret;
+}
+
+static const struct {
+    const char *name;
+    bool (*run)(void);
+} rt_cases[] =
+{
+    { "raw", rt_case_raw },
+    { "sparse", rt_case_sparse },
+    { "pooled", rt_case_pooled },
+    { "stream", rt_case_stream },
+    { "file", rt_case_file },
+    { "chunked", rt_case_chunked },
+    { "lazy", rt_case_lazy }
+};
+
+int main(int argc, char **argv, char **envp)
+{
+    uint64_t idx;
+    bool ret = true, found = false;
+
+    /* Named case, every case without one */
+    for(idx = 0; idx < sizeof(rt_cases) / sizeof(rt_cases[0]); idx++)
+    {
+        if(argc > 1 && strcmp(argv[1], rt_cases[idx].name) != 0)
+            continue;
+        found = true;
+
+        bool passed = rt_cases[idx].run();
+        printf("[%c] %s\n", passed ? '+' : '-', rt_cases[idx].name);
+        ret = ret && passed;
+    }
+
+    if(!found)
+    {
+        printf("[-] Unknown case '%s'\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+
+    return ret ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -3,8 +3,6 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <stdbool.h>
-#include <sys/stat.h>
-#include <sys/types.h>
 #include <puzzle.h>
 
 
@@ -18,53 +16,6 @@ int main(int argc, char **argv, char **envp)
         return false;
     }
 
-    /* Locals */
-    struct stat statbuf;
-    int32_t ret;
-
-    /* Stat */
-    ret = stat(argv[1], &statbuf);
-    if(ret != 0 || S_ISDIR(statbuf.st_mode))
-    {
-        printf("[-] Cannot read file '%s'\n", argv[1]);
-        return false;
-    }
-    const uint8_t *file_path = (uint8_t *) argv[1];
-    uint64_t file_size = statbuf.st_size;
-    if(file_size < 1)
-    {
-        printf("[-] Cannot read empty file '%s\n'", file_path);
-        return false;
-    }
-
-    /* Allocate data buffer */
-    uint8_t *in_data = (uint8_t *) malloc(file_size);
-
-    /* Read data */
-    FILE *in_file;
-    in_file = fopen((const char *) file_path, "r");
-    if(in_file == NULL)
-    {
-        printf("[-] Cannot read file '%s'\n", file_path);
-        free(in_data);
-        in_data = NULL;
-        return false;
-    }
-
-    /* Read data bytes */
-    uint64_t bytes_read = fread(in_data, 1, file_size, in_file);
-    if(bytes_read != file_size || bytes_read <= 0)
-    {
-        printf("[-] Cannot read file correctly\n");
-        free(in_data);
-        in_data = NULL;
-        fclose(in_file);
-        return false;
-    }
-
-    /* Clean up */
-    fclose(in_file);
-
     /* Unpack */
     pzl_ctx_t *context;
     pzl_init(&context, UNKN_ARCH);
@@ -75,7 +26,7 @@ int main(int argc, char **argv, char **envp)
     }
 
     /* Test */
-    if(pzl_unpack(context, in_data, bytes_read) == false)
+    if(pzl_open_mmap(context, argv[1]) == false)
     {
       printf("Cannot unpack data\n");
       goto cleanup;
@@ -102,10 +53,12 @@ int main(int argc, char **argv, char **envp)
     }
 
     printf("Architecture: %s\n", arch_str[context->hdr_rec.arch]);
+    printf("Version: 0x%04x\n", context->hdr_rec.version);
     printf("Data size: %lu\n", context->hdr_rec.data_size);
-    mem_rec_t *tmp_mem_rec = context->mem_rec;
-    while(tmp_mem_rec != NULL)
+    uint64_t idx;
+    for(idx = 0; idx < context->mem_rec_cnt; idx++)
     {
+        mem_rec_t *tmp_mem_rec = context->mem_rec[idx];
         printf("--- Memory record ---\n");
         printf("Start address: %p\n", (void *) tmp_mem_rec->start);
         printf("End address: %p\n", (void *) tmp_mem_rec->end);
@@ -122,8 +75,6 @@ int main(int argc, char **argv, char **envp)
             free(str);
             str = NULL;
         }
-
-        tmp_mem_rec = tmp_mem_rec->next;
     };
 
     printf("--- Register record ---\n");
@@ -161,6 +112,4 @@ int main(int argc, char **argv, char **envp)
     /* Free library */
     cleanup:
     pzl_free(context);
-    free(in_data);
-    in_data = NULL;
 }
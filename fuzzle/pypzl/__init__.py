@@ -14,11 +14,399 @@ MIPS_64 = 6
 MIPS_32 = 7
 UNKN_ARCH = 8
 
+# Format versions
+VERSION_DEFLATE = 0x0000
+VERSION_MMAP = 0x0001
+VERSION_CHUNKED = 0x0002
+
+# Chunk codecs and levels
+CODEC_NONE = 0x00
+CODEC_DEFLATE = 0x01
+LEVEL_FAST = 1
+LEVEL_DEFAULT = 6
+LEVEL_BEST = 9
+
 # Permissions
 READ = 0x04
 WRITE = 0x02
 EXECUTE = 0x01
 
+# Contiguous buffer request for PyObject_GetBuffer
+PYBUF_SIMPLE = 0
+
+# Mirror of Py_buffer
+class _PyBuffer(ctypes.Structure):
+    _fields_ = [('buf', ctypes.c_void_p),
+                ('obj', ctypes.c_void_p),
+                ('len', ctypes.c_ssize_t),
+                ('itemsize', ctypes.c_ssize_t),
+                ('readonly', ctypes.c_int),
+                ('ndim', ctypes.c_int),
+                ('format', ctypes.c_char_p),
+                ('shape', ctypes.c_void_p),
+                ('strides', ctypes.c_void_p),
+                ('suboffsets', ctypes.c_void_p),
+                ('internal', ctypes.c_void_p)]
+
+# Mirror of hdr_rec_t
+class _HdrRec(ctypes.Structure):
+    _fields_ = [('type', ctypes.c_uint16),
+                ('length', ctypes.c_uint64),
+                ('version', ctypes.c_uint16),
+                ('arch', ctypes.c_int),
+                ('data_size', ctypes.c_uint64),
+                ('chk_size', ctypes.c_uint64),
+                ('codec', ctypes.c_uint8),
+                ('level', ctypes.c_uint8)]
+
+# Mirror of mem_rec_t
+class _MemRec(ctypes.Structure):
+    _fields_ = [('type', ctypes.c_uint16),
+                ('length', ctypes.c_uint64),
+                ('start', ctypes.c_uint64),
+                ('end', ctypes.c_uint64),
+                ('size', ctypes.c_uint64),
+                ('perms', ctypes.c_uint8),
+                ('str_flag', ctypes.c_uint8),
+                ('str_size', ctypes.c_uint64),
+                ('dat', ctypes.c_void_p),
+                ('str', ctypes.c_void_p),
+                ('dat_ref', ctypes.c_bool),
+                ('dat_map', ctypes.c_bool),
+                ('chk_cnt', ctypes.c_uint64),
+                ('chk_off', ctypes.c_void_p),
+                ('chk_ld', ctypes.c_void_p),
+                ('cmp_dat', ctypes.c_void_p),
+                ('file_off', ctypes.c_uint64),
+                ('file_bmp', ctypes.c_void_p)]
+
+# Leading fields of pzl_ctx_t, enough to walk its memory records
+class _Ctx(ctypes.Structure):
+    _fields_ = [('mgc', ctypes.c_uint8 * 3),
+                ('hdr_rec', _HdrRec),
+                ('mem_rec', ctypes.POINTER(ctypes.POINTER(_MemRec))),
+                ('mem_rec_cnt', ctypes.c_uint64)]
+
+def load_libpuzzle():
+    """
+    Loads the installed puzzle library.
+
+    Returns:
+        ctypes handle to libpuzzle.so.
+    """
+
+    # Get file location
+    user_home = os.path.expanduser('~')
+    fuzzle_dir = os.path.join(os.path.abspath(user_home), '.fuzzle')
+    libpuzzle_path = os.path.join(fuzzle_dir, 'lib', 'libpuzzle.so')
+
+    # Load Puzzle library
+    try:
+        return ctypes.cdll.LoadLibrary(libpuzzle_path)
+    except OSError:
+        raise OSError('Cannot load Puzzle library')
+
+# Buffer protocol
+class Buffer(object):
+    """
+    Pins the memory of any contiguous buffer protocol object, such as bytes,
+    bytearray, mmap or memoryview, so C can use it in place without a copy.
+    """
+
+    def __init__(self, obj):
+        """
+        Acquire the buffer of obj, raises TypeError or BufferError if it has
+        none or it is not contiguous.
+
+        Args:
+            obj: Object exporting the buffer protocol.
+        """
+
+        # Set 'int PyObject_GetBuffer(PyObject *obj, Py_buffer *view, int flags)'
+        get_buffer = ctypes.pythonapi.PyObject_GetBuffer
+        get_buffer.argtypes = [ctypes.py_object,
+                               ctypes.POINTER(_PyBuffer),
+                               ctypes.c_int]
+        get_buffer.restype = ctypes.c_int
+
+        # Acquire, obj stays referenced and unresizable until release
+        self._view = _PyBuffer()
+        self._held = False
+        get_buffer(obj, ctypes.byref(self._view), PYBUF_SIMPLE)
+        self._held = True
+
+    @property
+    def address(self):
+        """
+        Address of the first byte.
+        """
+
+        return self._view.buf
+
+    def __len__(self):
+        return self._view.len
+
+    def release(self):
+        """
+        Release the buffer, C must no longer use its address.
+        """
+
+        # Set 'void PyBuffer_Release(Py_buffer *view)'
+        release_buffer = ctypes.pythonapi.PyBuffer_Release
+        release_buffer.argtypes = [ctypes.POINTER(_PyBuffer)]
+        release_buffer.restype = None
+
+        if self._held:
+            release_buffer(ctypes.byref(self._view))
+            self._held = False
+
+    def __del__(self):
+        self.release()
+
+def view(address, size):
+    """
+    Expose C memory as a writable memoryview without copying it.
+
+    Args:
+        address: Address of the first byte.
+        size: Byte count.
+
+    Returns:
+        memoryview valid for as long as the memory is.
+    """
+
+    if size == 0:
+        return memoryview(b'')
+    return memoryview((ctypes.c_uint8 * size).from_address(address)).cast('B')
+
+# Page pool
+class PagePool(object):
+    """
+    Shared page pool that stores each distinct page of pooled snapshots once.
+    """
+
+    def __init__(self, path, write=True):
+        """
+        Open or create page pool.
+
+        Args:
+            path: Pool file path.
+            write: Open for adding pages, readers pass False.
+        """
+
+        # Load Puzzle library
+        self._libpzl = load_libpuzzle()
+
+        # Set pool pointer
+        self._pool = ctypes.c_void_p()
+
+        # Set 'bool pzl_pool_open(pzl_pool_t **pool, const char *path, bool write)'
+        self._pzl_pool_open = self._libpzl.pzl_pool_open
+        self._pzl_pool_open.argtypes = [ctypes.POINTER(ctypes.c_void_p),
+                                        ctypes.c_char_p,
+                                        ctypes.c_bool]
+        self._pzl_pool_open.restype = ctypes.c_bool
+
+        # Open pool
+        if not self._pzl_pool_open(ctypes.byref(self._pool), str.encode(path), write):
+            raise Exception('Cannot open page pool')
+
+    def close(self):
+        """
+        Closes the page pool, recording the pages added.
+        """
+
+        # Set 'bool pzl_pool_close(pzl_pool_t *pool)'
+        self._pzl_pool_close = self._libpzl.pzl_pool_close
+        self._pzl_pool_close.argtypes = [ctypes.c_void_p]
+        self._pzl_pool_close.restype = ctypes.c_bool
+
+        # Close pool
+        if not self._pzl_pool_close(self._pool):
+            raise Exception('Cannot close page pool')
+        self._pool = ctypes.c_void_p()
+
+# Stream writer
+class PuzzleStream(object):
+    """
+    Writes memory records to a UZL file as their data arrives, so large dumps
+    are never held in memory. The register record is taken from the context
+    when the stream ends, so it may be added after the memory records.
+    """
+
+    def __init__(self, ctx, file):
+        """
+        Start streaming a puzzle context.
+
+        Args:
+            ctx: PuzzleContext holding the format settings and registers.
+            file: Seekable file object opened for binary writing.
+        """
+
+        # Load Puzzle library
+        self._libpzl = load_libpuzzle()
+
+        # Set stream pointer
+        self._stream = ctypes.c_void_p()
+        self._file = file
+
+        # Set 'bool pzl_pack_stream_init(pzl_stream_t **stream,
+        #                                pzl_ctx_t *context,
+        #                                int32_t fd)'
+        self._pzl_pack_stream_init = self._libpzl.pzl_pack_stream_init
+        self._pzl_pack_stream_init.argtypes = [ctypes.POINTER(ctypes.c_void_p),
+                                               ctypes.c_void_p,
+                                               ctypes.c_int32]
+        self._pzl_pack_stream_init.restype = ctypes.c_bool
+
+        # Start stream after anything already buffered
+        self._file.flush()
+        if not self._pzl_pack_stream_init(ctypes.byref(self._stream),
+                                          ctx._ctx,
+                                          self._file.fileno()):
+            raise Exception('Cannot start stream')
+
+    def add_mem_rec(self, start, end, perms, s_data=None, file_off=None, clean=None):
+        """
+        Start the next memory record, its data follows through write.
+
+        Args:
+            start: Memory segments start virtual address.
+            end: Memory segments end virtual address.
+            perms: Permissions of memory segment.
+            s_data: Optional string data.
+            file_off: File offset of a file mapping named by s_data.
+            clean: Bitmap bytes of the pages still matching the file, these
+                   are left to the file in a VERSION_MMAP file record.
+        """
+
+        # Pages left to the file
+        if clean is not None:
+            self._add_mem_file_rec(start, end, perms, s_data, file_off, clean)
+            return
+
+        # Check string data
+        if s_data is not None and type(s_data) != bytes:
+            raise Exception('String data must be of type bytes')
+
+        # Check string size
+        s_size = 0
+        if s_data is not None:
+            s_size = len(s_data)
+
+        # Set 'bool pzl_pack_stream_mem(pzl_stream_t *stream,
+        #                               uint64_t start,
+        #                               uint64_t end,
+        #                               uint64_t size,
+        #                               uint8_t perms,
+        #                               uint64_t str_size,
+        #                               uint8_t *str)'
+        self._pzl_pack_stream_mem = self._libpzl.pzl_pack_stream_mem
+        self._pzl_pack_stream_mem.argtypes = [ctypes.c_void_p,
+                                              ctypes.c_uint64,
+                                              ctypes.c_uint64,
+                                              ctypes.c_uint64,
+                                              ctypes.c_uint8,
+                                              ctypes.c_uint64,
+                                              ctypes.c_void_p]
+        self._pzl_pack_stream_mem.restype = ctypes.c_bool
+
+        # Start memory record
+        if not self._pzl_pack_stream_mem(self._stream,
+                                         start,
+                                         end,
+                                         end - start,
+                                         perms,
+                                         s_size,
+                                         s_data):
+            raise Exception('Cannot start memory record')
+
+    def _add_mem_file_rec(self, start, end, perms, s_data, file_off, clean):
+        """
+        Start the next memory record as a file record.
+        """
+
+        # Check string data
+        if type(s_data) != bytes or type(clean) != bytes:
+            raise Exception('File records need bytes name and bitmap')
+
+        # Set 'bool pzl_pack_stream_mem_file(pzl_stream_t *stream,
+        #                                    uint64_t start,
+        #                                    uint64_t end,
+        #                                    uint64_t size,
+        #                                    uint8_t perms,
+        #                                    uint64_t str_size,
+        #                                    uint8_t *str,
+        #                                    uint64_t file_off,
+        #                                    uint8_t *clean)'
+        self._pzl_pack_stream_mem_file = self._libpzl.pzl_pack_stream_mem_file
+        self._pzl_pack_stream_mem_file.argtypes = [ctypes.c_void_p,
+                                                   ctypes.c_uint64,
+                                                   ctypes.c_uint64,
+                                                   ctypes.c_uint64,
+                                                   ctypes.c_uint8,
+                                                   ctypes.c_uint64,
+                                                   ctypes.c_void_p,
+                                                   ctypes.c_uint64,
+                                                   ctypes.c_void_p]
+        self._pzl_pack_stream_mem_file.restype = ctypes.c_bool
+
+        # Start file record
+        if not self._pzl_pack_stream_mem_file(self._stream,
+                                              start,
+                                              end,
+                                              end - start,
+                                              perms,
+                                              len(s_data),
+                                              s_data,
+                                              file_off or 0,
+                                              clean):
+            raise Exception('Cannot start file memory record')
+
+    def write(self, data):
+        """
+        Append data to the current memory record.
+
+        Args:
+            data: Next piece of raw memory segment data, any contiguous buffer
+                  protocol object, it is read in place.
+        """
+
+        # Check data
+        if data is None:
+            raise Exception('Data must support the buffer protocol')
+        buf = Buffer(data)
+
+        # Set 'bool pzl_pack_stream_dat(pzl_stream_t *stream, uint8_t *dat, uint64_t len)'
+        self._pzl_pack_stream_dat = self._libpzl.pzl_pack_stream_dat
+        self._pzl_pack_stream_dat.argtypes = [ctypes.c_void_p,
+                                              ctypes.c_void_p,
+                                              ctypes.c_uint64]
+        self._pzl_pack_stream_dat.restype = ctypes.c_bool
+
+        # Append data
+        try:
+            if not self._pzl_pack_stream_dat(self._stream, buf.address, len(buf)):
+                raise Exception('Cannot write memory record data')
+        finally:
+            buf.release()
+
+    def end(self):
+        """
+        Writes the register record and header, finishing the file.
+        """
+
+        # Set 'bool pzl_pack_stream_end(pzl_stream_t *stream)'
+        self._pzl_pack_stream_end = self._libpzl.pzl_pack_stream_end
+        self._pzl_pack_stream_end.argtypes = [ctypes.c_void_p]
+        self._pzl_pack_stream_end.restype = ctypes.c_bool
+
+        # Finish stream, it is freed either way
+        stream = self._stream
+        self._stream = ctypes.c_void_p()
+        if not self._pzl_pack_stream_end(stream):
+            raise Exception('Cannot finish stream')
+
 # Main class
 class PuzzleContext(object):
     """
@@ -33,20 +421,18 @@ class PuzzleContext(object):
             arch: Processor archiecture.
         """
 
-        # Get file location
-        user_home = os.path.expanduser('~')
-        fuzzle_dir = os.path.join(os.path.abspath(user_home), '.fuzzle')
-        libpuzzle_path = os.path.join(fuzzle_dir, 'lib', 'libpuzzle.so')
-
         # Load Puzzle library
-        try:
-            self._libpzl = ctypes.cdll.LoadLibrary(libpuzzle_path)
-        except OSError:
-            raise OSError('Cannot load Puzzle library')
+        self._libpzl = load_libpuzzle()
 
         # Set context pointer
         self._ctx = ctypes.c_void_p()
 
+        # Buffers referenced by memory records until free
+        self._buffers = []
+
+        # Root prefix borrowed by the context
+        self._root = None
+
         # Set 'bool pzl_init(pzl_ctx_t **context, arch_t arch) function
         self._pzl_init = self._libpzl.pzl_init
         self._pzl_init.argtypes = [ctypes.POINTER(ctypes.c_void_p),
@@ -98,32 +484,139 @@ class PuzzleContext(object):
 
         return pack_size
 
+    def set_version(self, version):
+        """
+        Select the UZL format version written by pack.
+
+        Args:
+            version: One of the VERSION_* constants.
+        """
+
+        # Set 'bool pzl_set_version(pzl_ctx_t *context, uint16_t version)'
+        self._pzl_set_version = self._libpzl.pzl_set_version
+        self._pzl_set_version.argtypes = [ctypes.c_void_p, ctypes.c_uint16]
+        self._pzl_set_version.restype = ctypes.c_bool
+
+        # Set version
+        if not self._pzl_set_version(self._ctx, version):
+            raise Exception('Cannot set format version')
+
+    def set_codec(self, codec, level=LEVEL_DEFAULT):
+        """
+        Select the codec used for chunked memory records.
+
+        Args:
+            codec: One of the CODEC_* constants.
+            level: Compression level between LEVEL_FAST and LEVEL_BEST.
+        """
+
+        # Set 'bool pzl_set_codec(pzl_ctx_t *context, uint8_t codec, uint8_t level)'
+        self._pzl_set_codec = self._libpzl.pzl_set_codec
+        self._pzl_set_codec.argtypes = [ctypes.c_void_p, ctypes.c_uint8, ctypes.c_uint8]
+        self._pzl_set_codec.restype = ctypes.c_bool
+
+        # Set codec
+        if not self._pzl_set_codec(self._ctx, codec, level):
+            raise Exception('Cannot set codec')
+
+    def set_threads(self, threads):
+        """
+        Set the number of workers used for chunked memory records.
+
+        Args:
+            threads: Worker count, 0 uses every online CPU.
+        """
+
+        # Set 'bool pzl_set_threads(pzl_ctx_t *context, uint32_t threads)'
+        self._pzl_set_threads = self._libpzl.pzl_set_threads
+        self._pzl_set_threads.argtypes = [ctypes.c_void_p, ctypes.c_uint32]
+        self._pzl_set_threads.restype = ctypes.c_bool
+
+        # Set threads
+        if not self._pzl_set_threads(self._ctx, threads):
+            raise Exception('Cannot set thread count')
+
+    def set_pool(self, pool):
+        """
+        Store memory records in a page pool, used by VERSION_MMAP.
+
+        Args:
+            pool: Open PagePool, must stay open until pack returns.
+        """
+
+        # Set 'bool pzl_set_pool(pzl_ctx_t *context, pzl_pool_t *pool)'
+        self._pzl_set_pool = self._libpzl.pzl_set_pool
+        self._pzl_set_pool.argtypes = [ctypes.c_void_p, ctypes.c_void_p]
+        self._pzl_set_pool.restype = ctypes.c_bool
+
+        # Set pool
+        if not self._pzl_set_pool(self._ctx, pool._pool):
+            raise Exception('Cannot set page pool')
+
+    def set_root(self, root):
+        """
+        Prefix the paths of file records with a directory when loading.
+
+        Args:
+            root: Directory holding local copies of the mapped files.
+        """
+
+        # Set 'bool pzl_set_root(pzl_ctx_t *context, const char *root)'
+        self._pzl_set_root = self._libpzl.pzl_set_root
+        self._pzl_set_root.argtypes = [ctypes.c_void_p, ctypes.c_char_p]
+        self._pzl_set_root.restype = ctypes.c_bool
+
+        # Context only borrows the string
+        self._root = root.encode() if type(root) == str else root
+        if not self._pzl_set_root(self._ctx, self._root):
+            raise Exception('Cannot set root directory')
+
+    def set_verify(self, verify=True):
+        """
+        Check file records against their hash when loading, which reads every
+        referenced page of the mapped files.
+
+        Args:
+            verify: Whether to hash the referenced pages.
+        """
+
+        # Set 'bool pzl_set_verify(pzl_ctx_t *context, bool verify)'
+        self._pzl_set_verify = self._libpzl.pzl_set_verify
+        self._pzl_set_verify.argtypes = [ctypes.c_void_p, ctypes.c_bool]
+        self._pzl_set_verify.restype = ctypes.c_bool
+
+        if not self._pzl_set_verify(self._ctx, verify):
+            raise Exception('Cannot set verification')
+
     def add_mem_rec(self, start, end, perms, data, s_data=None):
         """
-        Add memory record to puzzle context.
+        Add memory record to puzzle context. The record references data in
+        place, which is held until free and must not change before packing.
 
         Args:
             start: Memory segments start virtual address.
             end: Memory segments end virtual address.
-            size: Size of memory segment.
             perms: Permissions of memory segment.
-            dat: Raw memory segment data.
-            s_size: Size of optional string.
-            s_dat: Optional string data.
+            data: Raw memory segment data, any contiguous buffer protocol
+                  object such as bytes, an mmap of a dump or a memoryview.
+            s_data: Optional string data.
         """
 
         # Check data
-        if data is None or type(data) != bytes:
-            raise Exception('Data must be of type bytes')
+        if data is None:
+            raise Exception('Data must support the buffer protocol')
 
         # Check string data
         if s_data is not None and type(s_data) != bytes:
             raise Exception('String data must be of type bytes')
 
+        # Pin data
+        buf = Buffer(data)
+
         # Check data size
-        data_len = len(data)
         size = end - start
-        if size != data_len:
+        if size != len(buf):
+            buf.release()
             raise Exception('Memory/data length mismatch')
 
         # Check string size
@@ -131,35 +624,37 @@ class PuzzleContext(object):
         if s_data is not None:
             s_size = len(s_data)
 
-        # Set 'bool pzl_create_mem_rec(pzl_ctx_t *context,
-        #                              uint64_t start,
-        #                              uint64_t end,
-        #                              uint64_t size,0x4400
-        #                              uint8_t perms,
-        #                              uint8_t *data,
-        #                              uint64_t str_size,
-        #                              uint8_t *str)
-        self._pzl_create_mem_rec = self._libpzl.pzl_create_mem_rec
-        self._pzl_create_mem_rec.argtypes = [ctypes.c_void_p,
-                                             ctypes.c_uint64,
-                                             ctypes.c_uint64,
-                                             ctypes.c_uint64,
-                                             ctypes.c_uint8,
-                                             ctypes.c_void_p,
-                                             ctypes.c_uint64,
-                                             ctypes.c_void_p]
-        self._pzl_create_mem_rec.restype = ctypes.c_bool
+        # Set 'bool pzl_create_mem_rec_ref(pzl_ctx_t *context,
+        #                                  uint64_t start,
+        #                                  uint64_t end,
+        #                                  uint64_t size,
+        #                                  uint8_t perms,
+        #                                  uint8_t *data,
+        #                                  uint64_t str_size,
+        #                                  uint8_t *str)
+        self._pzl_create_mem_rec_ref = self._libpzl.pzl_create_mem_rec_ref
+        self._pzl_create_mem_rec_ref.argtypes = [ctypes.c_void_p,
+                                                 ctypes.c_uint64,
+                                                 ctypes.c_uint64,
+                                                 ctypes.c_uint64,
+                                                 ctypes.c_uint8,
+                                                 ctypes.c_void_p,
+                                                 ctypes.c_uint64,
+                                                 ctypes.c_void_p]
+        self._pzl_create_mem_rec_ref.restype = ctypes.c_bool
 
         # Add memory record
-        if not self._pzl_create_mem_rec(self._ctx,
-                                        start,
-                                        end,
-                                        size,
-                                        perms,
-                                        data,
-                                        s_size,
-                                        s_data):
+        if not self._pzl_create_mem_rec_ref(self._ctx,
+                                            start,
+                                            end,
+                                            size,
+                                            perms,
+                                            buf.address,
+                                            s_size,
+                                            s_data):
+            buf.release()
             raise Exception('Cannot create memory record')
+        self._buffers.append(buf)
 
     def add_reg_rec(self, reg_data):
         """
@@ -193,7 +688,7 @@ class PuzzleContext(object):
         Packs the puzzle context into UZL format.
 
         Returns:
-            Packed data as a byte array.
+            Packed data as a memoryview over the buffer it was packed into.
         """
 
         # Get size
@@ -212,7 +707,89 @@ class PuzzleContext(object):
         if not self._pzl_pack(self._ctx, dat, ctypes.byref(size)):
             raise Exception('Cannot pack data')
 
-        return bytes(dat[0:size.value])
+        return memoryview(dat).cast('B')[:size.value]
+
+    def pack_to_file(self, path):
+        """
+        Packs the puzzle context straight into a file without building the
+        packed data in memory.
+
+        Args:
+            path: Output file path.
+        """
+
+        # Set 'bool pzl_pack_to_fd(pzl_ctx_t *context, int32_t fd)'
+        self._pzl_pack_to_fd = self._libpzl.pzl_pack_to_fd
+        self._pzl_pack_to_fd.argtypes = [ctypes.c_void_p, ctypes.c_int32]
+        self._pzl_pack_to_fd.restype = ctypes.c_bool
+
+        # Pack
+        with open(path, 'wb') as file:
+            if not self._pzl_pack_to_fd(self._ctx, file.fileno()):
+                raise Exception('Cannot pack data')
+
+    def open(self, path):
+        """
+        Maps a UZL file into the context. Records of VERSION_MMAP files
+        reference the mapping in place, other versions are decoded.
+
+        Args:
+            path: UZL file path.
+        """
+
+        # Set 'bool pzl_open_mmap(pzl_ctx_t *context, const char *path)'
+        self._pzl_open_mmap = self._libpzl.pzl_open_mmap
+        self._pzl_open_mmap.argtypes = [ctypes.c_void_p, ctypes.c_char_p]
+        self._pzl_open_mmap.restype = ctypes.c_bool
+
+        # Open
+        if not self._pzl_open_mmap(self._ctx, str.encode(path)):
+            raise Exception('Cannot open "{}"'.format(path))
+
+    def unpack(self, data):
+        """
+        Unpacks UZL data into the context.
+
+        Args:
+            data: Packed data, any contiguous buffer protocol object, it is
+                  read in place.
+        """
+
+        # Set 'bool pzl_unpack(pzl_ctx_t *context, uint8_t *data, uint64_t size)'
+        self._pzl_unpack = self._libpzl.pzl_unpack
+        self._pzl_unpack.argtypes = [ctypes.c_void_p, ctypes.c_void_p, ctypes.c_uint64]
+        self._pzl_unpack.restype = ctypes.c_bool
+
+        # Unpack, records own copies so data is released straight away
+        buf = Buffer(data)
+        try:
+            if not self._pzl_unpack(self._ctx, buf.address, len(buf)):
+                raise Exception('Cannot unpack data')
+        finally:
+            buf.release()
+
+    def mem_recs(self):
+        """
+        Lists the memory records of the context in address order.
+
+        Returns:
+            List of dictionaries with start, end, perms, name and data, a
+            memoryview over the record held by the C context. Views are only
+            valid until free.
+        """
+
+        ctx = ctypes.cast(self._ctx, ctypes.POINTER(_Ctx)).contents
+        recs = []
+        for idx in range(ctx.mem_rec_cnt):
+            rec = ctx.mem_rec[idx].contents
+            recs.append({'start': rec.start,
+                         'end': rec.end,
+                         'perms': rec.perms,
+                         'name': ctypes.string_at(rec.str, rec.str_size) \
+                                 if rec.str_flag else None,
+                         'data': view(rec.dat, rec.size)})
+
+        return recs
 
     def free(self):
         """
@@ -228,6 +805,11 @@ class PuzzleContext(object):
         if not self._pzl_free(self._ctx):
             raise Exception('Cannot free puzzle library')
 
+        # Records no longer reference caller buffers
+        for buf in self._buffers:
+            buf.release()
+        self._buffers = []
+
 
 if __name__ == '__main__':
     """
@@ -0,0 +1,55 @@
+#include <stdint.h>
+#include <unicorn.h>
+
+
+#ifndef __LINUX_H__
+#define __LINUX_H__
+
+/*
+Syscall number and arguments as the arch layers read them. Handlers are
+shared by every linux abi, 32 bit abis leave the upper halves clear and
+map their flag values onto the ones below before dispatching.
+*/
+typedef struct linux_sys_args {
+  uint64_t nr;
+  uint64_t arg[6];
+} linux_sys_args_t;
+
+/* Handlers return the syscall result, -errno on failure */
+typedef uint64_t (*linux_sys_fn_t)(uzl_sys_t *sys, linux_sys_args_t *args);
+
+/* mmap flags */
+#define LINUX_MAP_FIXED 0x10
+#define LINUX_MAP_ANONYMOUS 0x20
+
+/* mmap2 offset unit */
+#define LINUX_MMAP2_UNIT 0x1000
+
+/* futex operations */
+#define LINUX_FUTEX_WAIT 0x00
+#define LINUX_FUTEX_CMD_MASK 0x7f
+
+/* Largest errno, results above -LINUX_MAX_ERRNO are errors */
+#define LINUX_MAX_ERRNO 4095
+
+/* Prototypes */
+uint64_t linux_sys_read(uzl_sys_t *sys, linux_sys_args_t *args);
+uint64_t linux_sys_write(uzl_sys_t *sys, linux_sys_args_t *args);
+uint64_t linux_sys_open(uzl_sys_t *sys, linux_sys_args_t *args);
+uint64_t linux_sys_openat(uzl_sys_t *sys, linux_sys_args_t *args);
+uint64_t linux_sys_close(uzl_sys_t *sys, linux_sys_args_t *args);
+uint64_t linux_sys_mmap(uzl_sys_t *sys, linux_sys_args_t *args);
+uint64_t linux_sys_mmap2(uzl_sys_t *sys, linux_sys_args_t *args);
+uint64_t linux_sys_mprotect(uzl_sys_t *sys, linux_sys_args_t *args);
+uint64_t linux_sys_munmap(uzl_sys_t *sys, linux_sys_args_t *args);
+uint64_t linux_sys_brk(uzl_sys_t *sys, linux_sys_args_t *args);
+uint64_t linux_sys_socket(uzl_sys_t *sys, linux_sys_args_t *args);
+uint64_t linux_sys_accept(uzl_sys_t *sys, linux_sys_args_t *args);
+uint64_t linux_sys_sendto(uzl_sys_t *sys, linux_sys_args_t *args);
+uint64_t linux_sys_recvfrom(uzl_sys_t *sys, linux_sys_args_t *args);
+uint64_t linux_sys_sock_ok(uzl_sys_t *sys, linux_sys_args_t *args);
+uint64_t linux_sys_fork(uzl_sys_t *sys, linux_sys_args_t *args);
+uint64_t linux_sys_clone(uzl_sys_t *sys, linux_sys_args_t *args);
+uint64_t linux_sys_futex(uzl_sys_t *sys, linux_sys_args_t *args);
+uint64_t linux_sys_exit_group(uzl_sys_t *sys, linux_sys_args_t *args);
+#endif
@@ -0,0 +1,39 @@
+#include <stdint.h>
+#include <unicorn.h>
+
+
+#ifndef __LINUX_AARCH64_H__
+#define __LINUX_AARCH64_H__
+
+/* Syscall table enum, generic numbering */
+enum linux_aarch64_sys_table {
+  LINUX_AARCH64_SYS_OPENAT = 56,
+  LINUX_AARCH64_SYS_CLOSE = 57,
+  LINUX_AARCH64_SYS_READ = 63,
+  LINUX_AARCH64_SYS_WRITE = 64,
+  LINUX_AARCH64_SYS_EXIT = 93,
+  LINUX_AARCH64_SYS_EXIT_GROUP = 94,
+  LINUX_AARCH64_SYS_FUTEX = 98,
+  LINUX_AARCH64_SYS_SOCKET = 198,
+  LINUX_AARCH64_SYS_BIND = 200,
+  LINUX_AARCH64_SYS_LISTEN = 201,
+  LINUX_AARCH64_SYS_ACCEPT = 202,
+  LINUX_AARCH64_SYS_SENDTO = 206,
+  LINUX_AARCH64_SYS_RECVFROM = 207,
+  LINUX_AARCH64_SYS_SETSOCKOPT = 208,
+  LINUX_AARCH64_SYS_BRK = 214,
+  LINUX_AARCH64_SYS_MUNMAP = 215,
+  LINUX_AARCH64_SYS_CLONE = 220,
+  LINUX_AARCH64_SYS_MMAP = 222,
+  LINUX_AARCH64_SYS_MPROTECT = 226,
+  LINUX_AARCH64_SYS_ACCEPT4 = 242,
+  LINUX_AARCH64_SYS_MAX
+};
+
+/* Interrupt number unicorn raises for svc */
+#define LINUX_AARCH64_INTR_SWI 2
+
+/* Prototypes */
+void linux_aarch64_sys_hook_cb(uc_engine *uc, uint32_t intno,
+                               void *user_data);
+#endif
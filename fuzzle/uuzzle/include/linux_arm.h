@@ -0,0 +1,40 @@
+#include <stdint.h>
+#include <unicorn.h>
+
+
+#ifndef __LINUX_ARM_H__
+#define __LINUX_ARM_H__
+
+/* Syscall table enum, eabi numbering */
+enum linux_arm_sys_table {
+  LINUX_ARM_SYS_EXIT = 1,
+  LINUX_ARM_SYS_FORK = 2,
+  LINUX_ARM_SYS_READ = 3,
+  LINUX_ARM_SYS_WRITE = 4,
+  LINUX_ARM_SYS_OPEN = 5,
+  LINUX_ARM_SYS_CLOSE = 6,
+  LINUX_ARM_SYS_BRK = 45,
+  LINUX_ARM_SYS_MUNMAP = 91,
+  LINUX_ARM_SYS_CLONE = 120,
+  LINUX_ARM_SYS_MPROTECT = 125,
+  LINUX_ARM_SYS_MMAP2 = 192,
+  LINUX_ARM_SYS_FUTEX = 240,
+  LINUX_ARM_SYS_EXIT_GROUP = 248,
+  LINUX_ARM_SYS_SOCKET = 281,
+  LINUX_ARM_SYS_BIND = 282,
+  LINUX_ARM_SYS_LISTEN = 284,
+  LINUX_ARM_SYS_ACCEPT = 285,
+  LINUX_ARM_SYS_SENDTO = 290,
+  LINUX_ARM_SYS_RECVFROM = 292,
+  LINUX_ARM_SYS_SETSOCKOPT = 294,
+  LINUX_ARM_SYS_OPENAT = 322,
+  LINUX_ARM_SYS_ACCEPT4 = 366,
+  LINUX_ARM_SYS_MAX
+};
+
+/* Interrupt number unicorn raises for svc */
+#define LINUX_ARM_INTR_SWI 2
+
+/* Prototypes */
+void linux_arm_sys_hook_cb(uc_engine *uc, uint32_t intno, void *user_data);
+#endif
@@ -0,0 +1,49 @@
+#include <stdint.h>
+#include <unicorn.h>
+
+
+#ifndef __LINUX_MIPS_H__
+#define __LINUX_MIPS_H__
+
+/* o32 numbers start at LINUX_MIPS_SYS_BASE */
+#define LINUX_MIPS_SYS_BASE 4000
+
+/* Syscall table enum, offsets from LINUX_MIPS_SYS_BASE */
+enum linux_mips_sys_table {
+  LINUX_MIPS_SYS_EXIT = 1,
+  LINUX_MIPS_SYS_FORK = 2,
+  LINUX_MIPS_SYS_READ = 3,
+  LINUX_MIPS_SYS_WRITE = 4,
+  LINUX_MIPS_SYS_OPEN = 5,
+  LINUX_MIPS_SYS_CLOSE = 6,
+  LINUX_MIPS_SYS_BRK = 45,
+  LINUX_MIPS_SYS_MMAP = 90,
+  LINUX_MIPS_SYS_MUNMAP = 91,
+  LINUX_MIPS_SYS_CLONE = 120,
+  LINUX_MIPS_SYS_MPROTECT = 125,
+  LINUX_MIPS_SYS_ACCEPT = 168,
+  LINUX_MIPS_SYS_BIND = 169,
+  LINUX_MIPS_SYS_LISTEN = 174,
+  LINUX_MIPS_SYS_RECVFROM = 176,
+  LINUX_MIPS_SYS_SENDTO = 180,
+  LINUX_MIPS_SYS_SETSOCKOPT = 181,
+  LINUX_MIPS_SYS_SOCKET = 183,
+  LINUX_MIPS_SYS_MMAP2 = 210,
+  LINUX_MIPS_SYS_FUTEX = 238,
+  LINUX_MIPS_SYS_EXIT_GROUP = 246,
+  LINUX_MIPS_SYS_OPENAT = 288,
+  LINUX_MIPS_SYS_ACCEPT4 = 334,
+  LINUX_MIPS_SYS_MAX
+};
+
+/* Interrupt number unicorn raises for syscall */
+#define LINUX_MIPS_INTR_SYSCALL 17
+
+/* mmap flags that differ from the generic values */
+#define LINUX_MIPS_MAP_ANONYMOUS 0x800
+
+/* Prototypes */
+void linux_mips_sys_hook_cb(uc_engine *uc, uint32_t intno, void *user_data);
+uint64_t linux_mips_sys_mmap(uzl_sys_t *sys, linux_sys_args_t *args);
+uint64_t linux_mips_sys_mmap2(uzl_sys_t *sys, linux_sys_args_t *args);
+#endif
@@ -5,30 +5,33 @@
 #ifndef __LINUX_X86_64_H__
 #define __LINUX_X86_64_H__
 
-/* Structs */
-typedef struct linux_x86_64_sys_regs {
-  uint64_t rax;
-  uint64_t rdi;
-  uint64_t rsi;
-  uint64_t rdx;
-  uint64_t r10;
-  uint64_t r8;
-  uint64_t r9;
-} linux_x86_64_sys_regs_t;
-
 /* Syscall table enum */
 enum linux_x86_64_sys_table {
+  LINUX_X86_64_SYS_READ = 0x00,
   LINUX_X86_64_SYS_WRITE = 0x01,
+  LINUX_X86_64_SYS_OPEN = 0x02,
+  LINUX_X86_64_SYS_CLOSE = 0x03,
+  LINUX_X86_64_SYS_MMAP = 0x09,
+  LINUX_X86_64_SYS_MPROTECT = 0x0a,
+  LINUX_X86_64_SYS_MUNMAP = 0x0b,
+  LINUX_X86_64_SYS_BRK = 0x0c,
+  LINUX_X86_64_SYS_SOCKET = 0x29,
+  LINUX_X86_64_SYS_ACCEPT = 0x2b,
+  LINUX_X86_64_SYS_SENDTO = 0x2c,
+  LINUX_X86_64_SYS_RECVFROM = 0x2d,
+  LINUX_X86_64_SYS_BIND = 0x31,
+  LINUX_X86_64_SYS_LISTEN = 0x32,
+  LINUX_X86_64_SYS_SETSOCKOPT = 0x36,
   LINUX_X86_64_SYS_CLONE = 0x38,
-  LINUX_X86_64_SYS_FORK = 0x39
+  LINUX_X86_64_SYS_FORK = 0x39,
+  LINUX_X86_64_SYS_EXIT = 0x3c,
+  LINUX_X86_64_SYS_FUTEX = 0xca,
+  LINUX_X86_64_SYS_EXIT_GROUP = 0xe7,
+  LINUX_X86_64_SYS_OPENAT = 0x101,
+  LINUX_X86_64_SYS_ACCEPT4 = 0x120,
+  LINUX_X86_64_SYS_MAX
 };
 
 /* Prototypes */
-void linux_x86_64_sys_hook_cb(uc_engine *uc, void *user_data, uzl_opts_t *opts);
-void linux_x86_64_sys_write(uc_engine *uc, linux_x86_64_sys_regs_t *sys_regs,
-                            uzl_opts_t *opts);
-void linux_x86_64_sys_fork(uc_engine *uc, linux_x86_64_sys_regs_t *sys_regs,
-                           uzl_opts_t *opts);
-void linux_x86_64_sys_clone(uc_engine *uc, linux_x86_64_sys_regs_t *sys_regs,
-                            uzl_opts_t *opts);
+void linux_x86_64_sys_hook_cb(uc_engine *uc, void *user_data);
 #endif
@@ -2,6 +2,9 @@
 #include <puzzle.h>
 #include <stdbool.h>
 #include <unicorn.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <capstone.h>
 
 
 #ifndef __UUZZLE_H__
@@ -13,37 +16,790 @@
   | (__perms & 0x2) \
   | ((__perms &0x4) >> 2)
 
+/* Bytes mapped per fault in lazy mode, chunked records use their chunk size */
+#define UZL_LAZY_WINDOW 0x10000
+
+/* AFL control pipe, the status pipe is the next descriptor */
+#define UZL_FORKSRV_FD 198
+
+/* AFL edge bitmap and the variable naming its shared memory */
+#define UZL_COV_MAP_SIZE 0x10000
+#define UZL_COV_SHM_ENV "__AFL_SHM_ID"
+
+/* Dirty pages a snapshot makes room for up front */
+#define UZL_SNAP_PAGES 64
+
+/* Instruction cache slots and ring records, both powers of two */
+#define UZL_TRACE_CACHE_SIZE 0x1000
+#define UZL_TRACE_RING_SIZE 0x10000
+#define UZL_TRACE_FILE "uuzzle.trace"
+
+/* Blocks run between watchdog clock reads, a power of two */
+#define UZL_WATCH_CLOCK_BLOCKS 0x400
+
+/* Summarised addresses, call arguments read for them and the malloc arena */
+#define UZL_SUM_MAX 64
+#define UZL_SUM_ARGS 4
+#define UZL_SUM_HEAP_SIZE 0x4000000
+#define UZL_SUM_HEAP_BASE 0x300000000000
+#define UZL_SUM_HEAP_BASE_32 0x68000000
+
+/* Comparison log sites, pairs kept per site, routine prefix and routines */
+#define UZL_CMP_MAP_W 0x4000
+#define UZL_CMP_MAP_H 0x10
+#define UZL_CMP_RTN_LEN 31
+#define UZL_CMP_RTNS 8
+#define UZL_CMP_CACHE_SIZE 0x1000
+#define UZL_CMP_SHM_ENV "__UZL_CMP_SHM_ID"
+
+/* Taint register slots, registers per instruction, caches and shadow pages */
+#define UZL_TAINT_REGS 80
+#define UZL_TAINT_INS_REGS 12
+#define UZL_TAINT_CACHE_SIZE 0x1000
+#define UZL_TAINT_SINKS 0x100
+#define UZL_TAINT_PAGES 64
+
+/* Register slots of the backends, data registers start at UZL_TAINT_REG */
+#define UZL_TAINT_REG_NONE 0
+#define UZL_TAINT_REG_FLAGS 1
+#define UZL_TAINT_REG 2
+
+/*
+Taint tags span the input offsets reaching a byte, first and last plus
+one in the low and high half, so 0 is untainted. Later offsets share the
+last tag.
+*/
+#define UZL_TAINT_OFF_MAX 0xfffe
+#define UZL_TAINT_TAG(__off) \
+  ((uint32_t) ((__off) < UZL_TAINT_OFF_MAX ? (__off) + 1 : UZL_TAINT_OFF_MAX + 1) * 0x10001)
+#define UZL_TAINT_FIRST(__tag) (((__tag) & 0xffff) - 1)
+#define UZL_TAINT_LAST(__tag) (((__tag) >> 16) - 1)
+
+/* Virtual descriptors, fallback program break and anonymous mapping base */
+#define UZL_SYS_FDS 256
+#define UZL_SYS_BRK_BASE 0x10000000
+#define UZL_SYS_MMAP_BASE 0x200000000000
+#define UZL_SYS_MMAP_BASE_32 0x70000000
+
+/* Largest test case served through designated descriptors */
+#define UZL_SYS_INPUT_MAX 0x10000
+
+/* Mappings tracked per iteration before the list grows */
+#define UZL_SYS_MAPS 16
+
+/* Virtual descriptor types */
+enum uzl_fd_type {
+  UZL_FD_FREE,
+  UZL_FD_STD,
+  UZL_FD_FILE,
+  UZL_FD_SOCKET,
+  UZL_FD_CONN
+};
+
+/* Shared corpus slots, each holding one test case of at most UZL_SYS_INPUT_MAX */
+#define UZL_PAR_QUEUE 0x400
+#define UZL_PAR_PARENT 0xffffffff
+
+/* Register set capacity and x86_64 fs/gs base msrs */
+#define UZL_REGS_MAX 40
+#define UZL_REGS_MSRS 4
+#define UZL_X86_64_MSR_FS_BASE 0xc0000100
+#define UZL_X86_64_MSR_GS_BASE 0xc0000101
+
 /* Structures */
 typedef struct uzl_options {
   bool verbose;
   bool follow_child;
   bool quiet;
+  bool lazy;
+  bool fork_server;
+  bool summaries;
+  bool cmplog;
+  bool taint;
+  bool verify;
   char *uzl_file_name;
+  char *pool_file_name;
+  char *root_dir_name;
+  char *input_dir_name;
+  char *trace_file_name;
+  int64_t input_fd;
+  char *output_dir_name;
+  uint32_t jobs;
+  uint64_t max_execs;
+  uint64_t timeout;
+  uint64_t budget;
+  uint64_t end_addr;
+  uint64_t cov_start;
+  uint64_t cov_end;
 } uzl_opts_t;
 
+/*
+Snapshot of emulator state between fuzzing iterations. Pages are saved the
+first time they are written in an iteration and put back by
+uzl_snap_restore along with the registers, so an iteration only pays for
+the memory it touches. tbl indexes dirty_addr by page, entries hold the
+list index plus one. failed is set when a page could not be saved, the
+iteration is stopped and cannot be restored.
+*/
+typedef struct uzl_snapshot {
+  pzl_ctx_t *pzl_ctx;
+  uc_engine *uc;
+  uc_context *uc_ctx;
+  uc_hook write_hook;
+  bool hooked;
+  uint64_t dirty_cnt;
+  uint64_t dirty_cap;
+  uint64_t *dirty_addr;
+  uint8_t *dirty_dat;
+  uint64_t tbl_cap;
+  uint64_t *tbl;
+  bool failed;
+} uzl_snap_t;
+
+/*
+Edge coverage in AFL's bitmap layout. Each basic block hashes its address
+to cur_loc and bumps map[cur_loc ^ prev_loc]. One block hook covers each
+traced range, the executable records unless a range is given.
+*/
+typedef struct uzl_coverage {
+  uc_engine *uc;
+  uint8_t *map;
+  bool shm;
+  uint64_t prev_loc;
+  uint64_t hook_cnt;
+  uc_hook *hooks;
+} uzl_cov_t;
+
+/*
+Instruction trace record as written to disk, 32 bytes each. id is the
+capstone instruction id, 0 when the bytes do not decode.
+*/
+typedef struct uzl_trace_record {
+  uint64_t addr;
+  uint32_t id;
+  uint16_t size;
+  uint16_t pad;
+  uint8_t bytes[16];
+} uzl_trace_rec_t;
+
+typedef struct uzl_trace_entry {
+  uint64_t addr;
+  cs_insn *insn;
+} uzl_trace_ent_t;
+
+/*
+Instruction trace. Each address is disassembled once into ent, an open
+addressed cache of cs_malloc'd instructions, so the code hook never
+allocates. Records go through ring, a single producer single consumer
+queue indexed by the free running head and tail, and the writer thread
+flushes them to fd. The hook waits on a full ring instead of dropping.
+failed is set when the writer cannot write, the hook then stops emulation
+at the next full ring and uzl_trace_free reports it.
+*/
+typedef struct uzl_trace {
+  uc_engine *uc;
+  uc_hook hook;
+  bool hooked;
+  csh handle;
+  bool cs_open;
+  uint8_t code[16];
+  uint64_t ent_cnt;
+  uint64_t ent_cap;
+  uzl_trace_ent_t *ent;
+  uzl_trace_rec_t *ring;
+  uint64_t head;
+  uint64_t tail;
+  bool stop;
+  bool failed;
+  bool running;
+  pthread_t writer;
+  int32_t fd;
+} uzl_trace_t;
+
+/*
+Watchdog bounding a run to timeout nanoseconds of wall clock and budget
+basic blocks, 0 leaving either unbounded. A block hook counts blocks and
+reads the clock every UZL_WATCH_CLOCK_BLOCKS, so no timer thread is
+started per run. A tripped run is stopped with hung set and hang_pc the
+block it was in, which for a hang is inside the loop.
+*/
+typedef struct uzl_watch {
+  uc_engine *uc;
+  uc_hook hook;
+  bool hooked;
+  uint64_t timeout;
+  uint64_t budget;
+  uint64_t blocks;
+  uint64_t deadline;
+  bool hung;
+  uint64_t hang_pc;
+} uzl_watch_t;
+
+/* Corpus entry, ready is set once dat and len are written */
+typedef struct uzl_par_entry {
+  uint64_t len;
+  uint8_t ready;
+  uint8_t dat[UZL_SYS_INPUT_MAX];
+} uzl_par_entry_t;
+
+/* Memory shared by the parallel driver and its workers */
+typedef struct uzl_par_shm {
+  uint64_t execs;
+  uint64_t crashes;
+  uint64_t hangs;
+  uint64_t edges;
+  uint64_t queue_cnt;
+  uint8_t map[UZL_COV_MAP_SIZE];
+  uzl_par_entry_t queue[UZL_PAR_QUEUE];
+} uzl_par_shm_t;
+
+/*
+Parallel driver. The snapshot is loaded once and every worker is a fork,
+so each gets copy-on-write pages of the records and its own unicorn
+engine. shm is mapped shared before forking and holds the corpus queue,
+the coverage merged from every worker and the counters. worker is the
+index of this process, UZL_PAR_PARENT in the driver.
+*/
+typedef struct uzl_parallel {
+  uzl_par_shm_t *shm;
+  uint32_t jobs;
+  uint32_t worker;
+  pid_t *pids;
+  uint64_t rng;
+} uzl_par_t;
+
+/*
+Register set built once from the register record and loaded with a single
+uc_reg_write_batch, ptrs points each id at its slot in vals. msrs follow
+the batch and are written directly instead of emulating wrmsr. 32 bit
+targets read the low half of each slot.
+*/
+typedef struct uzl_registers {
+  const struct uzl_arch *arch;
+  uint32_t cnt;
+  int ids[UZL_REGS_MAX];
+  uint64_t vals[UZL_REGS_MAX];
+  void *ptrs[UZL_REGS_MAX];
+  uint32_t msr_cnt;
+  uint32_t msr_ids[UZL_REGS_MSRS];
+  uint64_t msr_vals[UZL_REGS_MSRS];
+} uzl_regs_t;
+
+/*
+Virtual descriptor, files are backed by a read only host_fd read at off.
+Input descriptors read from the test case and write to the output sink.
+*/
+typedef struct uzl_fd {
+  uint8_t type;
+  bool input;
+  int32_t host_fd;
+  uint64_t off;
+} uzl_fd_t;
+
+/* Guest range mapped by a syscall */
+typedef struct uzl_sys_map {
+  uint64_t addr;
+  uint64_t size;
+} uzl_sys_map_t;
+
+/*
+Emulated process state for syscall handlers. fds is the process's
+descriptor table, brk the program break, continuing from the captured
+[heap] when there is one, with pages mapped up to brk_end, and mmap_next
+the next address tried for mappings without a usable hint.
+
+input is the current test case, consumed from input_off by every input
+descriptor. Only one connection is accepted per test case, input_conns
+counts them. Writes to input descriptors are appended to output when
+capture is set and dropped otherwise. uzl_sys_save keeps the descriptors,
+break and mmap_next so uzl_sys_restore can rewind them between iterations,
+and maps lists the ranges mapped since so they are unmapped again. Host
+writes to guest memory save their pages in snap first when there is one.
+*/
+typedef struct uzl_sys {
+  pzl_ctx_t *pzl_ctx;
+  uc_engine *uc;
+  uzl_opts_t *opts;
+  uc_hook hook;
+  bool hooked;
+  uint64_t brk;
+  uint64_t brk_end;
+  uint64_t mmap_next;
+  bool exited;
+  int64_t exit_code;
+  uzl_fd_t fds[UZL_SYS_FDS];
+  uint8_t *input;
+  uint64_t input_len;
+  uint64_t input_off;
+  uint64_t input_conns;
+  bool capture;
+  uint8_t *output;
+  uint64_t output_len;
+  uint64_t output_cap;
+  uint64_t saved_brk;
+  uint64_t saved_mmap_next;
+  uzl_fd_t saved_fds[UZL_SYS_FDS];
+  uint64_t map_cnt;
+  uint64_t map_cap;
+  uzl_sys_map_t *maps;
+  uzl_snap_t *snap;
+  struct uzl_taint *taint;
+} uzl_sys_t;
+
+/* Comparison operand kinds */
+enum uzl_cmp_op_type {
+  UZL_CMP_OP_NONE,
+  UZL_CMP_OP_REG,
+  UZL_CMP_OP_IMM,
+  UZL_CMP_OP_MEM
+};
+
+/* Comparison log entry types */
+enum uzl_cmp_type {
+  UZL_CMP_NONE,
+  UZL_CMP_INS,
+  UZL_CMP_RTN
+};
+
+/*
+Comparison operand in unicorn terms. Registers are read from reg and
+immediates are val, memory is read at reg + index * scale + val with
+either register left zero when absent.
+*/
+typedef struct uzl_cmp_operand {
+  uint8_t type;
+  int reg;
+  int index;
+  int32_t scale;
+  int64_t val;
+} uzl_cmp_op_t;
+
+/*
+Decoded instruction in the comparison cache, size is zero for
+instructions that compare nothing. neg marks a compare against the
+negated second operand, as with cmn.
+*/
+typedef struct uzl_cmp_instruction {
+  uint64_t addr;
+  bool used;
+  uint8_t size;
+  bool neg;
+  uzl_cmp_op_t op[2];
+} uzl_cmp_ins_t;
+
+/* What a decoded instruction does with taint */
+enum uzl_taint_ins_kind {
+  UZL_TAINT_INS_NONE,
+  UZL_TAINT_INS_FLOW,
+  UZL_TAINT_INS_CLEAR,
+  UZL_TAINT_INS_BRANCH,
+  UZL_TAINT_INS_SYSCALL
+};
+
+/*
+Decoded instruction in the taint cache. Data read from the src register
+slots and from memory flows into the dst slots and any memory written,
+registers only addressing memory are not sources. Branches report their
+sources and clear dst, syscalls report src as arguments in order and
+clear dst, kind is preset from the instruction groups for the backend.
+*/
+typedef struct uzl_taint_instruction {
+  uint64_t addr;
+  bool used;
+  uint8_t kind;
+  uint8_t src_cnt;
+  uint8_t dst_cnt;
+  uint8_t src[UZL_TAINT_INS_REGS];
+  uint8_t dst[UZL_TAINT_INS_REGS];
+} uzl_taint_ins_t;
+
+/* Call arguments the examples read from the snapshot registers */
+#define UZL_ARCH_ARGS 3
+
+/*
+Architecture backend. Everything that depends on the target goes through
+one of these, looked up once from the header by uzl_get_arch so nothing
+switches on the architecture per call. Modes depend on the registers, as
+with arm's thumb bit, so they are read from the snapshot. set_ret leaves
+a syscall style return value where the snapshot's caller expects it.
+get_call_args and ret_call read the arguments of a function being entered
+and return from it to its caller, sum_heap is where summaries place their
+malloc arena. get_ret_addr reads where a function being entered returns
+to and get_cmp decodes the operands of a comparison instruction and get_taint
+the register slots an instruction moves taint between.
+*/
+typedef struct uzl_arch {
+  uc_arch uc_arch;
+  cs_arch cs_arch;
+  bool (*get_uc_mode)(pzl_ctx_t *pzl_ctx, uint32_t *mode);
+  bool (*get_cs_mode)(pzl_ctx_t *pzl_ctx, uint32_t *mode);
+  bool (*get_pc)(pzl_ctx_t *pzl_ctx, uint64_t *pc);
+  bool (*get_sp)(pzl_ctx_t *pzl_ctx, uint64_t *sp);
+  bool (*get_args)(pzl_ctx_t *pzl_ctx, uint64_t *args);
+  bool (*get_regs)(pzl_ctx_t *pzl_ctx, uzl_regs_t *regs, uzl_opts_t *opts);
+  bool (*load_regs)(uzl_regs_t *regs, uc_engine *uc);
+  bool (*set_ret)(uc_engine *uc, uint64_t ret);
+  bool (*reg_sys)(pzl_ctx_t *pzl_ctx, uc_engine *uc, uzl_sys_t *sys,
+                  uzl_opts_t *opts);
+  bool (*get_call_args)(uc_engine *uc, uint64_t *args);
+  bool (*ret_call)(uc_engine *uc, uint64_t ret);
+  bool (*get_ret_addr)(uc_engine *uc, uint64_t *addr);
+  bool (*get_cmp)(cs_insn *insn, uzl_cmp_ins_t *ins);
+  bool (*get_taint)(cs_insn *insn, uzl_taint_ins_t *ins);
+  uint64_t sum_heap;
+} uzl_arch_t;
+
+/* Native replacement of a routine, false runs the original instead */
+struct uzl_summary;
+typedef bool (*uzl_sum_fn_t)(struct uzl_summary *sum, uint64_t *args,
+                             uint64_t *ret);
+
+/* Summarised address and the hook catching calls to it */
+typedef struct uzl_summary_entry {
+  struct uzl_summary *sum;
+  uint64_t addr;
+  uzl_sum_fn_t fn;
+  uc_hook hook;
+} uzl_sum_ent_t;
+
+/*
+Function summaries. Each summarised address has a code hook covering only
+that address; a call landing there runs fn natively against the records
+backing guest memory and returns straight to the caller. Summaries decline
+anything outside a single record or the arena, and accesses the mapping
+permissions would fault, so the original runs and keeps its emulated
+behaviour. Host writes save their pages in snap first when there is one.
+The malloc family allocates from heap, an arena mapped at the backend's
+sum_heap, which uzl_sum_reset zeroes and rewinds between runs. Blocks
+from before the snapshot are left to the original free and realloc.
+*/
+typedef struct uzl_summary {
+  pzl_ctx_t *pzl_ctx;
+  uc_engine *uc;
+  uzl_opts_t *opts;
+  const uzl_arch_t *arch;
+  uzl_snap_t *snap;
+  uint32_t ent_cnt;
+  uzl_sum_ent_t ent[UZL_SUM_MAX];
+  uint8_t *heap;
+  uint64_t heap_base;
+  uint64_t heap_top;
+} uzl_sum_t;
+
+/* Comparison site, hits counts every pair logged there this run */
+typedef struct uzl_cmp_header {
+  uint64_t addr;
+  uint32_t hits;
+  uint8_t type;
+  uint8_t size;
+  uint16_t pad;
+} uzl_cmp_hdr_t;
+
+/* Logged pair, integers for instructions and prefixes for routines */
+typedef union uzl_cmp_operands {
+  struct {
+    uint64_t v0;
+    uint64_t v1;
+  } ins;
+  struct {
+    uint8_t v0[UZL_CMP_RTN_LEN];
+    uint8_t v0_len;
+    uint8_t v1[UZL_CMP_RTN_LEN];
+    uint8_t v1_len;
+  } rtn;
+} uzl_cmp_ops_t;
+
+/*
+Comparison table, shared with the fuzzer when UZL_CMP_SHM_ENV names a
+segment. A site is the comparing instruction or the caller of a comparing
+routine hashed into hdr, its last UZL_CMP_MAP_H pairs are kept in log
+at hits modulo UZL_CMP_MAP_H. Colliding sites share a slot.
+*/
+typedef struct uzl_cmp_map {
+  uzl_cmp_hdr_t hdr[UZL_CMP_MAP_W];
+  uzl_cmp_ops_t log[UZL_CMP_MAP_W][UZL_CMP_MAP_H];
+} uzl_cmp_map_t;
+
+/* Hooked comparison routine */
+typedef struct uzl_cmp_routine {
+  struct uzl_cmplog *cmp;
+  uint64_t addr;
+  uint8_t kind;
+  uc_hook hook;
+} uzl_cmp_rtn_t;
+
+/*
+Comparison logging. One code hook covers each logged range, the same
+ranges as coverage, and looks every instruction up in ent, an open
+addressed cache decoded once per address, so only comparisons pay for
+reading operands. Routines comparing memory are hooked on entry and log
+prefixes of both buffers against their caller. Pairs that already match
+are not logged. sites lists the slots hit this run so uzl_cmp_reset only
+clears those. Logging is enabled after uzl_cmp_init, between
+uzl_cmp_disable and uzl_cmp_enable the hooks return before the lookup.
+They stay registered, unicorn only instruments blocks when translating
+them.
+*/
+typedef struct uzl_cmplog {
+  uc_engine *uc;
+  const uzl_arch_t *arch;
+  csh handle;
+  bool cs_open;
+  cs_insn *insn;
+  uint8_t code[16];
+  uzl_cmp_map_t *map;
+  bool shm;
+  uint32_t site_cnt;
+  uint32_t *sites;
+  uint64_t ent_cnt;
+  uint64_t ent_cap;
+  uzl_cmp_ins_t *ent;
+  uint64_t hook_cnt;
+  uc_hook *hooks;
+  uint32_t rtn_cnt;
+  uzl_cmp_rtn_t rtn[UZL_CMP_RTNS];
+  bool enabled;
+} uzl_cmp_t;
+
+/* Taint sink types */
+enum uzl_taint_sink_type {
+  UZL_TAINT_SINK_BRANCH,
+  UZL_TAINT_SINK_SYSCALL
+};
+
+/* Branch or syscall argument input reached, tag spans all its hits */
+typedef struct uzl_taint_sink {
+  uint64_t addr;
+  uint8_t type;
+  uint8_t arg;
+  uint32_t tag;
+  uint64_t hits;
+} uzl_taint_sink_t;
+
+/*
+Taint tracking. Guest pages get a shadow of one tag per byte the first
+time a tainted byte is written to them, so only the pages input reaches
+cost memory however large the snapshot. tbl indexes page_addr by page,
+entries hold the list index plus one. Registers carry one tag per slot.
+One code hook looks every instruction up in ent, decoded once per
+address, and memory hooks move tags at the exact addresses accessed;
+register results land when the next instruction starts, so pend is the
+instruction in flight with its register and memory sources. sink lists
+branches and syscall arguments reached this run, indexed by sink_tbl.
+*/
+typedef struct uzl_taint {
+  uc_engine *uc;
+  const uzl_arch_t *arch;
+  uzl_sys_t *sys;
+  csh handle;
+  bool cs_open;
+  cs_insn *insn;
+  uint8_t code[16];
+  uint32_t hook_cnt;
+  uc_hook hooks[2];
+  uint64_t ent_cnt;
+  uint64_t ent_cap;
+  uzl_taint_ins_t *ent;
+  uzl_taint_ins_t *pend;
+  uint32_t pend_src;
+  uint32_t pend_mem;
+  uint32_t regs[UZL_TAINT_REGS];
+  uint64_t page_cnt;
+  uint64_t page_cap;
+  uint64_t *page_addr;
+  uint32_t **page_tags;
+  uint64_t tbl_cap;
+  uint64_t *tbl;
+  uint64_t last_page;
+  uint32_t *last_tags;
+  uint64_t sink_cnt;
+  uint64_t sink_cap;
+  uzl_taint_sink_t *sink;
+  uint64_t sink_tbl_cap;
+  uint64_t *sink_tbl;
+} uzl_taint_t;
+
 /* Prototypes */
 /* Core */
-bool uzl_get_uc_arch(pzl_ctx_t *pzl_ctx, uint8_t *arch);
-bool uzl_get_uc_mode(pzl_ctx_t *pzl_ctx, uint8_t *mode);
-bool uzl_get_cs_arch(pzl_ctx_t *pzl_ctx, uint8_t *arch);
-bool uzl_get_cs_mode(pzl_ctx_t *pzl_ctx, uint8_t *mode);
+const uzl_arch_t *uzl_get_arch(pzl_ctx_t *pzl_ctx);
+bool uzl_get_uc_arch(pzl_ctx_t *pzl_ctx, uint32_t *arch);
+bool uzl_get_uc_mode(pzl_ctx_t *pzl_ctx, uint32_t *mode);
+bool uzl_get_cs_arch(pzl_ctx_t *pzl_ctx, uint32_t *arch);
+bool uzl_get_cs_mode(pzl_ctx_t *pzl_ctx, uint32_t *mode);
 bool uzl_get_pc(pzl_ctx_t *pzl_ctx, uint64_t *pc);
+bool uzl_get_sp(pzl_ctx_t *pzl_ctx, uint64_t *sp);
+bool uzl_get_args(pzl_ctx_t *pzl_ctx, uint64_t *args);
 bool uzl_get_usr_regs(pzl_ctx_t *pzl_ctx, void **usr_regs, uzl_opts_t *opts);
 bool uzl_set_registers(pzl_ctx_t *pzl_ctx, uc_engine *uc, uzl_opts_t *opts);
+bool uzl_regs_init(uzl_regs_t **regs, pzl_ctx_t *pzl_ctx, uzl_opts_t *opts);
+bool uzl_regs_load(uzl_regs_t *regs, uc_engine *uc);
+bool uzl_regs_write(uzl_regs_t *regs, uc_engine *uc);
+bool uzl_regs_free(uzl_regs_t *regs);
+uint8_t *uzl_get_mem(pzl_ctx_t *pzl_ctx, uint64_t addr, uint64_t len,
+                     mem_rec_t **rec);
 bool uzl_map_memory(pzl_ctx_t *pzl_ctx, uc_engine *uc, uzl_opts_t *opts);
-bool uzl_reg_sys(pzl_ctx_t *pzl_ctx, uc_engine *uc, uc_hook *sys_hook,
+bool uzl_map_memory_lazy(pzl_ctx_t *pzl_ctx, uc_engine *uc, uc_hook *mem_hook,
+                         uzl_opts_t *opts);
+bool uzl_reg_sys(pzl_ctx_t *pzl_ctx, uc_engine *uc, uzl_sys_t **sys,
                  uzl_opts_t *opts);
 bool uzl_parse_opts(int argc, char **argv, uzl_opts_t *opts);
 
+/* Syscall state */
+bool uzl_sys_init(uzl_sys_t **sys, pzl_ctx_t *pzl_ctx, uc_engine *uc,
+                  uzl_opts_t *opts);
+int32_t uzl_sys_fd_alloc(uzl_sys_t *sys, uint8_t type, int32_t host_fd);
+uzl_fd_t *uzl_sys_fd_get(uzl_sys_t *sys, uint64_t fd);
+bool uzl_sys_fd_close(uzl_sys_t *sys, uint64_t fd);
+bool uzl_sys_set_input(uzl_sys_t *sys, uint8_t *input, uint64_t len);
+uint64_t uzl_sys_input_read(uzl_sys_t *sys, uint64_t addr, uint64_t len);
+uint64_t uzl_sys_output_write(uzl_sys_t *sys, uint64_t addr, uint64_t len);
+bool uzl_sys_mem_write(uzl_sys_t *sys, uint64_t addr, void *dat, uint64_t len);
+bool uzl_sys_mem_map(uzl_sys_t *sys, uint64_t addr, uint64_t size,
+                     uint32_t perms);
+bool uzl_sys_save(uzl_sys_t *sys);
+bool uzl_sys_restore(uzl_sys_t *sys);
+bool uzl_sys_free(uzl_sys_t *sys);
+
+/* Snapshot */
+bool uzl_snap_init(uzl_snap_t **snap, pzl_ctx_t *pzl_ctx, uc_engine *uc,
+                   uzl_opts_t *opts);
+bool uzl_snap_touch(uzl_snap_t *snap, uint64_t addr, uint64_t len);
+bool uzl_snap_write(uzl_snap_t *snap, uint64_t addr, void *dat, uint64_t len);
+bool uzl_snap_restore(uzl_snap_t *snap);
+bool uzl_snap_free(uzl_snap_t *snap);
+
+/* Coverage */
+bool uzl_cov_init(uzl_cov_t **cov, pzl_ctx_t *pzl_ctx, uc_engine *uc,
+                  uzl_opts_t *opts);
+bool uzl_cov_reset(uzl_cov_t *cov);
+uint64_t uzl_cov_count(uzl_cov_t *cov);
+uint64_t uzl_cov_merge(uzl_cov_t *cov, uint8_t *merged);
+bool uzl_cov_free(uzl_cov_t *cov);
+
+/* Trace */
+bool uzl_trace_init(uzl_trace_t **trace, pzl_ctx_t *pzl_ctx, uc_engine *uc,
+                    uzl_opts_t *opts);
+bool uzl_trace_free(uzl_trace_t *trace);
+
+/* Watchdog */
+bool uzl_watch_init(uzl_watch_t **watch, uc_engine *uc, uzl_opts_t *opts);
+bool uzl_watch_reset(uzl_watch_t *watch);
+bool uzl_watch_free(uzl_watch_t *watch);
+
+/* Symbols */
+bool uzl_sym_resolve(pzl_ctx_t *pzl_ctx, const char *lib, const char *sym,
+                     uint64_t *addr, uzl_opts_t *opts);
+
+/* Summaries */
+bool uzl_sum_init(uzl_sum_t **sum, pzl_ctx_t *pzl_ctx, uc_engine *uc,
+                  uzl_snap_t *snap, uzl_opts_t *opts);
+bool uzl_sum_add(uzl_sum_t *sum, uint64_t addr, uzl_sum_fn_t fn);
+uint8_t *uzl_sum_ptr(uzl_sum_t *sum, uint64_t addr, uint64_t len, bool write);
+bool uzl_sum_reset(uzl_sum_t *sum);
+bool uzl_sum_free(uzl_sum_t *sum);
+
+/* Comparison logging */
+bool uzl_cmp_init(uzl_cmp_t **cmp, pzl_ctx_t *pzl_ctx, uc_engine *uc,
+                  uzl_opts_t *opts);
+bool uzl_cmp_enable(uzl_cmp_t *cmp);
+bool uzl_cmp_disable(uzl_cmp_t *cmp);
+bool uzl_cmp_reset(uzl_cmp_t *cmp);
+bool uzl_cmp_solve(uzl_cmp_t *cmp, uint8_t *dat, uint64_t *len, uint64_t max,
+                   uint64_t rnd);
+bool uzl_cmp_free(uzl_cmp_t *cmp);
+
+/* Taint */
+bool uzl_taint_init(uzl_taint_t **taint, pzl_ctx_t *pzl_ctx, uc_engine *uc,
+                    uzl_sys_t *sys, uzl_opts_t *opts);
+bool uzl_taint_ins_add(uzl_taint_ins_t *ins, bool dst, uint8_t reg);
+bool uzl_taint_input(uzl_taint_t *taint, uint64_t addr, uint64_t off,
+                     uint64_t len);
+uint32_t uzl_taint_mem(uzl_taint_t *taint, uint64_t addr, uint64_t len);
+bool uzl_taint_reset(uzl_taint_t *taint);
+bool uzl_taint_report(uzl_taint_t *taint);
+bool uzl_taint_free(uzl_taint_t *taint);
+
+/* Parallel */
+bool uzl_par_init(uzl_par_t **par, uzl_opts_t *opts);
+bool uzl_par_add(uzl_par_t *par, uint8_t *dat, uint64_t len);
+bool uzl_par_pick(uzl_par_t *par, uint8_t *dat, uint64_t *len);
+uint64_t uzl_par_rand(uzl_par_t *par);
+bool uzl_par_fork(uzl_par_t *par, uzl_opts_t *opts);
+bool uzl_par_free(uzl_par_t *par);
+
+/* Fork server */
+bool uzl_fork_server(uzl_opts_t *opts);
+
 /* x86_64 */
-bool uzl_get_usr_regs_x86_64(pzl_ctx_t *pzl_ctx, void **usr_regs,
-                             uzl_opts_t *opts);
+extern const uzl_arch_t uzl_arch_x86_64;
+bool uzl_get_x86_64_uc_mode(pzl_ctx_t *pzl_ctx, uint32_t *mode);
+bool uzl_get_x86_64_cs_mode(pzl_ctx_t *pzl_ctx, uint32_t *mode);
 bool uzl_get_x86_64_pc(pzl_ctx_t *pzl_ctx, uint64_t *pc);
-bool uzl_set_x86_64_registers(pzl_ctx_t *pzl_ctx, uc_engine *uc,
-                              uzl_opts_t *opts);
-bool uzl_set_x86_64_msr(pzl_ctx_t *pzl_ctx, uc_engine *uc,
-                        usr_regs_x86_64_t usr_reg, uzl_opts_t *opts);
+bool uzl_get_x86_64_sp(pzl_ctx_t *pzl_ctx, uint64_t *sp);
+bool uzl_get_x86_64_args(pzl_ctx_t *pzl_ctx, uint64_t *args);
+bool uzl_get_x86_64_regs(pzl_ctx_t *pzl_ctx, uzl_regs_t *regs,
+                         uzl_opts_t *opts);
+bool uzl_load_x86_64_regs(uzl_regs_t *regs, uc_engine *uc);
+bool uzl_set_x86_64_ret(uc_engine *uc, uint64_t ret);
+bool uzl_get_x86_64_call_args(uc_engine *uc, uint64_t *args);
+bool uzl_ret_x86_64_call(uc_engine *uc, uint64_t ret);
+bool uzl_get_x86_64_ret_addr(uc_engine *uc, uint64_t *addr);
+bool uzl_get_x86_64_cmp(cs_insn *insn, uzl_cmp_ins_t *ins);
+bool uzl_get_x86_64_taint(cs_insn *insn, uzl_taint_ins_t *ins);
 bool uzl_reg_linux_x86_64_sys(pzl_ctx_t *pzl_ctx, uc_engine *uc,
-                              uc_hook *sys_hook, uzl_opts_t *opts);
+                              uzl_sys_t *sys, uzl_opts_t *opts);
+
+/* arm */
+extern const uzl_arch_t uzl_arch_arm;
+bool uzl_get_arm_uc_mode(pzl_ctx_t *pzl_ctx, uint32_t *mode);
+bool uzl_get_arm_cs_mode(pzl_ctx_t *pzl_ctx, uint32_t *mode);
+bool uzl_get_arm_pc(pzl_ctx_t *pzl_ctx, uint64_t *pc);
+bool uzl_get_arm_sp(pzl_ctx_t *pzl_ctx, uint64_t *sp);
+bool uzl_get_arm_args(pzl_ctx_t *pzl_ctx, uint64_t *args);
+bool uzl_get_arm_regs(pzl_ctx_t *pzl_ctx, uzl_regs_t *regs, uzl_opts_t *opts);
+bool uzl_set_arm_ret(uc_engine *uc, uint64_t ret);
+bool uzl_get_arm_call_args(uc_engine *uc, uint64_t *args);
+bool uzl_ret_arm_call(uc_engine *uc, uint64_t ret);
+bool uzl_get_arm_ret_addr(uc_engine *uc, uint64_t *addr);
+bool uzl_get_arm_cmp(cs_insn *insn, uzl_cmp_ins_t *ins);
+bool uzl_get_arm_taint(cs_insn *insn, uzl_taint_ins_t *ins);
+bool uzl_reg_linux_arm_sys(pzl_ctx_t *pzl_ctx, uc_engine *uc, uzl_sys_t *sys,
+                           uzl_opts_t *opts);
+
+/* aarch64 */
+extern const uzl_arch_t uzl_arch_aarch64;
+bool uzl_get_aarch64_uc_mode(pzl_ctx_t *pzl_ctx, uint32_t *mode);
+bool uzl_get_aarch64_cs_mode(pzl_ctx_t *pzl_ctx, uint32_t *mode);
+bool uzl_get_aarch64_pc(pzl_ctx_t *pzl_ctx, uint64_t *pc);
+bool uzl_get_aarch64_sp(pzl_ctx_t *pzl_ctx, uint64_t *sp);
+bool uzl_get_aarch64_args(pzl_ctx_t *pzl_ctx, uint64_t *args);
+bool uzl_get_aarch64_regs(pzl_ctx_t *pzl_ctx, uzl_regs_t *regs,
+                          uzl_opts_t *opts);
+bool uzl_set_aarch64_ret(uc_engine *uc, uint64_t ret);
+bool uzl_get_aarch64_call_args(uc_engine *uc, uint64_t *args);
+bool uzl_ret_aarch64_call(uc_engine *uc, uint64_t ret);
+bool uzl_get_aarch64_ret_addr(uc_engine *uc, uint64_t *addr);
+bool uzl_get_aarch64_cmp(cs_insn *insn, uzl_cmp_ins_t *ins);
+bool uzl_get_aarch64_taint(cs_insn *insn, uzl_taint_ins_t *ins);
+bool uzl_reg_linux_aarch64_sys(pzl_ctx_t *pzl_ctx, uc_engine *uc,
+                               uzl_sys_t *sys, uzl_opts_t *opts);
+
+/* mips */
+extern const uzl_arch_t uzl_arch_mips;
+bool uzl_get_mips_uc_mode(pzl_ctx_t *pzl_ctx, uint32_t *mode);
+bool uzl_get_mips_cs_mode(pzl_ctx_t *pzl_ctx, uint32_t *mode);
+bool uzl_get_mips_pc(pzl_ctx_t *pzl_ctx, uint64_t *pc);
+bool uzl_get_mips_sp(pzl_ctx_t *pzl_ctx, uint64_t *sp);
+bool uzl_get_mips_args(pzl_ctx_t *pzl_ctx, uint64_t *args);
+bool uzl_get_mips_regs(pzl_ctx_t *pzl_ctx, uzl_regs_t *regs,
+                       uzl_opts_t *opts);
+bool uzl_set_mips_ret(uc_engine *uc, uint64_t ret);
+bool uzl_get_mips_call_args(uc_engine *uc, uint64_t *args);
+bool uzl_ret_mips_call(uc_engine *uc, uint64_t ret);
+bool uzl_get_mips_ret_addr(uc_engine *uc, uint64_t *addr);
+bool uzl_get_mips_cmp(cs_insn *insn, uzl_cmp_ins_t *ins);
+bool uzl_get_mips_taint(cs_insn *insn, uzl_taint_ins_t *ins);
+bool uzl_reg_linux_mips_sys(pzl_ctx_t *pzl_ctx, uc_engine *uc,
+                            uzl_sys_t *sys, uzl_opts_t *opts);
 
 #endif
@@ -0,0 +1,311 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <puzzle.h>
+#include <uuzzle.h>
+#include <unicorn.h>
+#include <capstone.h>
+#include <stdbool.h>
+
+
+/* Backend */
+const uzl_arch_t uzl_arch_aarch64 =
+{
+  .uc_arch = UC_ARCH_ARM64,
+  .cs_arch = CS_ARCH_ARM64,
+  .get_uc_mode = uzl_get_aarch64_uc_mode,
+  .get_cs_mode = uzl_get_aarch64_cs_mode,
+  .get_pc = uzl_get_aarch64_pc,
+  .get_sp = uzl_get_aarch64_sp,
+  .get_args = uzl_get_aarch64_args,
+  .get_regs = uzl_get_aarch64_regs,
+  .load_regs = uzl_regs_write,
+  .set_ret = uzl_set_aarch64_ret,
+  .reg_sys = uzl_reg_linux_aarch64_sys,
+  .get_call_args = uzl_get_aarch64_call_args,
+  .ret_call = uzl_ret_aarch64_call,
+  .get_ret_addr = uzl_get_aarch64_ret_addr,
+  .get_cmp = uzl_get_aarch64_cmp,
+  .get_taint = uzl_get_aarch64_taint,
+  .sum_heap = UZL_SUM_HEAP_BASE
+};
+
+/* Get unicorn mode */
+bool uzl_get_aarch64_uc_mode(pzl_ctx_t *pzl_ctx, uint32_t *mode)
+{
+  *mode = UC_MODE_ARM;
+  return true;
+}
+
+/* Get capstone mode */
+bool uzl_get_aarch64_cs_mode(pzl_ctx_t *pzl_ctx, uint32_t *mode)
+{
+  *mode = CS_MODE_ARM;
+  return true;
+}
+
+/* Get program counter */
+bool uzl_get_aarch64_pc(pzl_ctx_t *pzl_ctx, uint64_t *pc)
+{
+  usr_regs_aarch64_t usr_reg;
+  memcpy(&usr_reg, pzl_ctx->reg_rec->usr_reg, pzl_ctx->reg_rec->usr_reg_len);
+  *pc = usr_reg.pc;
+  return true;
+}
+
+/* Get stack pointer */
+bool uzl_get_aarch64_sp(pzl_ctx_t *pzl_ctx, uint64_t *sp)
+{
+  usr_regs_aarch64_t usr_reg;
+  memcpy(&usr_reg, pzl_ctx->reg_rec->usr_reg, pzl_ctx->reg_rec->usr_reg_len);
+  *sp = usr_reg.sp;
+  return true;
+}
+
+/* Get first call arguments */
+bool uzl_get_aarch64_args(pzl_ctx_t *pzl_ctx, uint64_t *args)
+{
+  usr_regs_aarch64_t usr_reg;
+  memcpy(&usr_reg, pzl_ctx->reg_rec->usr_reg, pzl_ctx->reg_rec->usr_reg_len);
+  args[0] = usr_reg.x[0];
+  args[1] = usr_reg.x[1];
+  args[2] = usr_reg.x[2];
+  return true;
+}
+
+/* Build aarch64 register set from the register record */
+bool uzl_get_aarch64_regs(pzl_ctx_t *pzl_ctx, uzl_regs_t *regs,
+                          uzl_opts_t *opts)
+{
+  usr_regs_aarch64_t usr_reg;
+  memcpy(&usr_reg, pzl_ctx->reg_rec->usr_reg, pzl_ctx->reg_rec->usr_reg_len);
+
+  /* x0 to x28 are numbered in order, x29 and x30 are not */
+  uint32_t idx;
+  for(idx = 0; idx <= 28; idx++)
+  {
+    regs->ids[idx] = UC_ARM64_REG_X0 + idx;
+    regs->vals[idx] = usr_reg.x[idx];
+  }
+  regs->ids[idx] = UC_ARM64_REG_X29;
+  regs->vals[idx++] = usr_reg.x[29];
+  regs->ids[idx] = UC_ARM64_REG_X30;
+  regs->vals[idx++] = usr_reg.x[30];
+  regs->ids[idx] = UC_ARM64_REG_SP;
+  regs->vals[idx++] = usr_reg.sp;
+  regs->ids[idx] = UC_ARM64_REG_PC;
+  regs->vals[idx++] = usr_reg.pc;
+
+  /* Only the flags of pstate are visible at el0 */
+  regs->ids[idx] = UC_ARM64_REG_NZCV;
+  regs->vals[idx++] = usr_reg.pstate;
+  regs->ids[idx] = UC_ARM64_REG_TPIDR_EL0;
+  regs->vals[idx++] = usr_reg.tls;
+  regs->cnt = idx;
+
+  for(idx = 0; idx < regs->cnt; idx++)
+    regs->ptrs[idx] = &(regs->vals[idx]);
+  return true;
+}
+
+/* Set return value */
+bool uzl_set_aarch64_ret(uc_engine *uc, uint64_t ret)
+{
+  return uc_reg_write(uc, UC_ARM64_REG_X0, &ret) == UC_ERR_OK;
+}
+
+/* Integer arguments of a call, in the order they are passed */
+static int uzl_aarch64_call_arg_ids[UZL_SUM_ARGS] =
+{
+  UC_ARM64_REG_X0,
+  UC_ARM64_REG_X1,
+  UC_ARM64_REG_X2,
+  UC_ARM64_REG_X3
+};
+
+/* Read the arguments of the function being entered */
+bool uzl_get_aarch64_call_args(uc_engine *uc, uint64_t *args)
+{
+  void *vals[UZL_SUM_ARGS];
+  uint32_t idx;
+  for(idx = 0; idx < UZL_SUM_ARGS; idx++)
+  {
+    args[idx] = 0;
+    vals[idx] = &(args[idx]);
+  }
+  return uc_reg_read_batch(uc, uzl_aarch64_call_arg_ids, vals, UZL_SUM_ARGS) ==
+         UC_ERR_OK;
+}
+
+/* Return from the function being entered */
+bool uzl_ret_aarch64_call(uc_engine *uc, uint64_t ret)
+{
+  uint64_t lr;
+  if(uc_reg_read(uc, UC_ARM64_REG_X30, &lr) != UC_ERR_OK)
+    return false;
+  return uc_reg_write(uc, UC_ARM64_REG_X0, &ret) == UC_ERR_OK &&
+         uc_reg_write(uc, UC_ARM64_REG_PC, &lr) == UC_ERR_OK;
+}
+
+/* Return address of the function being entered */
+bool uzl_get_aarch64_ret_addr(uc_engine *uc, uint64_t *addr)
+{
+  return uc_reg_read(uc, UC_ARM64_REG_X30, addr) == UC_ERR_OK;
+}
+
+/* Unicorn id of a capstone general purpose register, size in bytes */
+static bool uzl_aarch64_cs_reg(uint32_t cs_reg, int *reg, uint8_t *size)
+{
+  *size = sizeof(uint64_t);
+  if(cs_reg >= ARM64_REG_X0 && cs_reg <= ARM64_REG_X28)
+    *reg = UC_ARM64_REG_X0 + (cs_reg - ARM64_REG_X0);
+  else if(cs_reg == ARM64_REG_X29)
+    *reg = UC_ARM64_REG_X29;
+  else if(cs_reg == ARM64_REG_X30)
+    *reg = UC_ARM64_REG_X30;
+  else if(cs_reg == ARM64_REG_SP)
+    *reg = UC_ARM64_REG_SP;
+  else if(cs_reg == ARM64_REG_XZR)
+    *reg = UC_ARM64_REG_XZR;
+  else
+  {
+    *size = sizeof(uint32_t);
+    if(cs_reg >= ARM64_REG_W0 && cs_reg <= ARM64_REG_W30)
+      *reg = UC_ARM64_REG_W0 + (cs_reg - ARM64_REG_W0);
+    else if(cs_reg == ARM64_REG_WZR)
+      *reg = UC_ARM64_REG_WZR;
+    else
+      return false;
+  }
+  return true;
+}
+
+/* Operands of cmp, cmn and tst, immediates may be shifted left */
+bool uzl_get_aarch64_cmp(cs_insn *insn, uzl_cmp_ins_t *ins)
+{
+  cs_arm64 *arm64 = &(insn->detail->arm64);
+  uint8_t size = 0;
+  uint32_t idx;
+
+  if((insn->id != ARM64_INS_CMP && insn->id != ARM64_INS_CMN &&
+      insn->id != ARM64_INS_TST) || arm64->op_count != 2)
+    return false;
+  for(idx = 0; idx < 2; idx++)
+  {
+    cs_arm64_op *op = &(arm64->operands[idx]);
+    uzl_cmp_op_t *cmp_op = &(ins->op[idx]);
+    memset(cmp_op, 0, sizeof(uzl_cmp_op_t));
+    if(op->type == ARM64_OP_REG)
+    {
+      uint8_t reg_size;
+      cmp_op->type = UZL_CMP_OP_REG;
+      if(op->shift.type != ARM64_SFT_INVALID ||
+         op->ext != ARM64_EXT_INVALID ||
+         !uzl_aarch64_cs_reg(op->reg, &(cmp_op->reg), &reg_size))
+        return false;
+      if(idx == 0)
+        size = reg_size;
+    }
+    else if(op->type == ARM64_OP_IMM)
+    {
+      cmp_op->type = UZL_CMP_OP_IMM;
+      cmp_op->val = op->imm;
+      if(op->shift.type == ARM64_SFT_LSL)
+        cmp_op->val <<= op->shift.value;
+      else if(op->shift.type != ARM64_SFT_INVALID)
+        return false;
+    }
+    else
+      return false;
+  }
+  if(insn->id == ARM64_INS_TST && arm64->operands[1].type == ARM64_OP_REG &&
+     arm64->operands[0].reg == arm64->operands[1].reg)
+  {
+    memset(&(ins->op[1]), 0, sizeof(uzl_cmp_op_t));
+    ins->op[1].type = UZL_CMP_OP_IMM;
+  }
+  ins->size = size;
+  ins->neg = insn->id == ARM64_INS_CMN;
+  return size != 0;
+}
+
+/* Taint slot of a capstone register, sp and the zero registers carry none */
+static uint8_t uzl_aarch64_taint_reg(uint32_t cs_reg)
+{
+  if(cs_reg >= ARM64_REG_X0 && cs_reg <= ARM64_REG_X28)
+    return UZL_TAINT_REG + (cs_reg - ARM64_REG_X0);
+  if(cs_reg == ARM64_REG_X29)
+    return UZL_TAINT_REG + 29;
+  if(cs_reg == ARM64_REG_X30)
+    return UZL_TAINT_REG + 30;
+  if(cs_reg >= ARM64_REG_W0 && cs_reg <= ARM64_REG_W30)
+    return UZL_TAINT_REG + (cs_reg - ARM64_REG_W0);
+  if(cs_reg == ARM64_REG_NZCV)
+    return UZL_TAINT_REG_FLAGS;
+
+  /* SIMD registers carry copies, every view shares its register's slot */
+  if(cs_reg >= ARM64_REG_D0 && cs_reg <= ARM64_REG_D31)
+    return UZL_TAINT_REG + 31 + (cs_reg - ARM64_REG_D0);
+  if(cs_reg >= ARM64_REG_Q0 && cs_reg <= ARM64_REG_Q31)
+    return UZL_TAINT_REG + 31 + (cs_reg - ARM64_REG_Q0);
+  if(cs_reg >= ARM64_REG_S0 && cs_reg <= ARM64_REG_S31)
+    return UZL_TAINT_REG + 31 + (cs_reg - ARM64_REG_S0);
+  if(cs_reg >= ARM64_REG_V0 && cs_reg <= ARM64_REG_V31)
+    return UZL_TAINT_REG + 31 + (cs_reg - ARM64_REG_V0);
+  return UZL_TAINT_REG_NONE;
+}
+
+/* Register slots an instruction reads data from and writes */
+bool uzl_get_aarch64_taint(cs_insn *insn, uzl_taint_ins_t *ins)
+{
+  cs_detail *detail = insn->detail;
+  cs_arm64 *arm64 = &(detail->arm64);
+  uint32_t idx;
+
+  /* svc takes arguments in x0 to x5 and returns in x0 */
+  if(ins->kind == UZL_TAINT_INS_SYSCALL)
+  {
+    for(idx = 0; idx < 6; idx++)
+      uzl_taint_ins_add(ins, false,
+                        uzl_aarch64_taint_reg(ARM64_REG_X0 + idx));
+    return uzl_taint_ins_add(ins, true, uzl_aarch64_taint_reg(ARM64_REG_X0));
+  }
+
+  /* Conditional branches decide on the flags, cbz and tbz on a register */
+  if(ins->kind == UZL_TAINT_INS_BRANCH && arm64->cc != ARM64_CC_INVALID &&
+     arm64->cc != ARM64_CC_AL && arm64->cc != ARM64_CC_NV &&
+     !uzl_taint_ins_add(ins, false, UZL_TAINT_REG_FLAGS))
+    return false;
+  if(arm64->update_flags &&
+     !uzl_taint_ins_add(ins, true, UZL_TAINT_REG_FLAGS))
+    return false;
+
+  /* Explicit register operands, address registers are no sources */
+  for(idx = 0; idx < arm64->op_count; idx++)
+  {
+    cs_arm64_op *op = &(arm64->operands[idx]);
+    if(op->type != ARM64_OP_REG)
+      continue;
+    uint8_t reg = uzl_aarch64_taint_reg(op->reg);
+    if((op->access & CS_AC_READ) && !uzl_taint_ins_add(ins, false, reg))
+      return false;
+    if((op->access & CS_AC_WRITE) && !uzl_taint_ins_add(ins, true, reg))
+      return false;
+  }
+
+  /* Implicit registers, bl links x30 */
+  for(idx = 0; idx < detail->regs_read_count; idx++)
+  {
+    if(!uzl_taint_ins_add(ins, false,
+                          uzl_aarch64_taint_reg(detail->regs_read[idx])))
+      return false;
+  }
+  for(idx = 0; idx < detail->regs_write_count; idx++)
+  {
+    if(!uzl_taint_ins_add(ins, true,
+                          uzl_aarch64_taint_reg(detail->regs_write[idx])))
+      return false;
+  }
+  return true;
+}
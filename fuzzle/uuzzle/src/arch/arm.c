@@ -0,0 +1,303 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <puzzle.h>
+#include <uuzzle.h>
+#include <unicorn.h>
+#include <capstone.h>
+#include <stdbool.h>
+
+
+/* cpsr thumb state bit */
+#define UZL_ARM_CPSR_T 0x20
+
+/* Backend */
+const uzl_arch_t uzl_arch_arm =
+{
+  .uc_arch = UC_ARCH_ARM,
+  .cs_arch = CS_ARCH_ARM,
+  .get_uc_mode = uzl_get_arm_uc_mode,
+  .get_cs_mode = uzl_get_arm_cs_mode,
+  .get_pc = uzl_get_arm_pc,
+  .get_sp = uzl_get_arm_sp,
+  .get_args = uzl_get_arm_args,
+  .get_regs = uzl_get_arm_regs,
+  .load_regs = uzl_regs_write,
+  .set_ret = uzl_set_arm_ret,
+  .reg_sys = uzl_reg_linux_arm_sys,
+  .get_call_args = uzl_get_arm_call_args,
+  .ret_call = uzl_ret_arm_call,
+  .get_ret_addr = uzl_get_arm_ret_addr,
+  .get_cmp = uzl_get_arm_cmp,
+  .get_taint = uzl_get_arm_taint,
+  .sum_heap = UZL_SUM_HEAP_BASE_32
+};
+
+/* Get unicorn mode, thumb when the snapshot stopped in thumb state */
+bool uzl_get_arm_uc_mode(pzl_ctx_t *pzl_ctx, uint32_t *mode)
+{
+  usr_regs_arm_t usr_reg;
+  memcpy(&usr_reg, pzl_ctx->reg_rec->usr_reg, pzl_ctx->reg_rec->usr_reg_len);
+  *mode = usr_reg.cpsr & UZL_ARM_CPSR_T ? UC_MODE_THUMB : UC_MODE_ARM;
+  return true;
+}
+
+/* Get capstone mode */
+bool uzl_get_arm_cs_mode(pzl_ctx_t *pzl_ctx, uint32_t *mode)
+{
+  usr_regs_arm_t usr_reg;
+  memcpy(&usr_reg, pzl_ctx->reg_rec->usr_reg, pzl_ctx->reg_rec->usr_reg_len);
+  *mode = usr_reg.cpsr & UZL_ARM_CPSR_T ? CS_MODE_THUMB : CS_MODE_ARM;
+  return true;
+}
+
+/* Get program counter, odd in thumb state so uc_emu_start keeps it */
+bool uzl_get_arm_pc(pzl_ctx_t *pzl_ctx, uint64_t *pc)
+{
+  usr_regs_arm_t usr_reg;
+  memcpy(&usr_reg, pzl_ctx->reg_rec->usr_reg, pzl_ctx->reg_rec->usr_reg_len);
+  *pc = usr_reg.pc | (usr_reg.cpsr & UZL_ARM_CPSR_T ? 1 : 0);
+  return true;
+}
+
+/* Get stack pointer */
+bool uzl_get_arm_sp(pzl_ctx_t *pzl_ctx, uint64_t *sp)
+{
+  usr_regs_arm_t usr_reg;
+  memcpy(&usr_reg, pzl_ctx->reg_rec->usr_reg, pzl_ctx->reg_rec->usr_reg_len);
+  *sp = usr_reg.sp;
+  return true;
+}
+
+/* Get first call arguments */
+bool uzl_get_arm_args(pzl_ctx_t *pzl_ctx, uint64_t *args)
+{
+  usr_regs_arm_t usr_reg;
+  memcpy(&usr_reg, pzl_ctx->reg_rec->usr_reg, pzl_ctx->reg_rec->usr_reg_len);
+  args[0] = usr_reg.r0;
+  args[1] = usr_reg.r1;
+  args[2] = usr_reg.r2;
+  return true;
+}
+
+/* Registers in the order they are loaded, cpsr ahead of pc */
+#define UZL_ARM_REG(__reg, __field) \
+  { __reg, offsetof(usr_regs_arm_t, __field) }
+
+static const struct {
+  int id;
+  size_t off;
+} uzl_arm_regs[] =
+{
+  UZL_ARM_REG(UC_ARM_REG_R0, r0),
+  UZL_ARM_REG(UC_ARM_REG_R1, r1),
+  UZL_ARM_REG(UC_ARM_REG_R2, r2),
+  UZL_ARM_REG(UC_ARM_REG_R3, r3),
+  UZL_ARM_REG(UC_ARM_REG_R4, r4),
+  UZL_ARM_REG(UC_ARM_REG_R5, r5),
+  UZL_ARM_REG(UC_ARM_REG_R6, r6),
+  UZL_ARM_REG(UC_ARM_REG_R7, r7),
+  UZL_ARM_REG(UC_ARM_REG_R8, r8),
+  UZL_ARM_REG(UC_ARM_REG_R9, r9),
+  UZL_ARM_REG(UC_ARM_REG_R10, r10),
+  UZL_ARM_REG(UC_ARM_REG_R11, r11),
+  UZL_ARM_REG(UC_ARM_REG_R12, r12),
+  UZL_ARM_REG(UC_ARM_REG_SP, sp),
+  UZL_ARM_REG(UC_ARM_REG_LR, lr),
+  UZL_ARM_REG(UC_ARM_REG_CPSR, cpsr),
+  UZL_ARM_REG(UC_ARM_REG_PC, pc),
+  UZL_ARM_REG(UC_ARM_REG_C13_C0_3, tls)
+};
+
+/* Build arm register set from the register record */
+bool uzl_get_arm_regs(pzl_ctx_t *pzl_ctx, uzl_regs_t *regs, uzl_opts_t *opts)
+{
+  usr_regs_arm_t usr_reg;
+  memcpy(&usr_reg, pzl_ctx->reg_rec->usr_reg, pzl_ctx->reg_rec->usr_reg_len);
+
+  uint32_t idx;
+  for(idx = 0; idx < sizeof(uzl_arm_regs) / sizeof(uzl_arm_regs[0]); idx++)
+  {
+    uint32_t val;
+    memcpy(&val, (uint8_t *) &usr_reg + uzl_arm_regs[idx].off, sizeof(val));
+    regs->ids[idx] = uzl_arm_regs[idx].id;
+    regs->vals[idx] = val;
+    regs->ptrs[idx] = &(regs->vals[idx]);
+
+    /* Writing pc picks the instruction set from its low bit */
+    if(regs->ids[idx] == UC_ARM_REG_PC)
+      uzl_get_arm_pc(pzl_ctx, &(regs->vals[idx]));
+  }
+  regs->cnt = idx;
+  return true;
+}
+
+/* Set return value */
+bool uzl_set_arm_ret(uc_engine *uc, uint64_t ret)
+{
+  return uc_reg_write(uc, UC_ARM_REG_R0, &ret) == UC_ERR_OK;
+}
+
+/* Integer arguments of a call, in the order they are passed */
+static int uzl_arm_call_arg_ids[UZL_SUM_ARGS] =
+{
+  UC_ARM_REG_R0,
+  UC_ARM_REG_R1,
+  UC_ARM_REG_R2,
+  UC_ARM_REG_R3
+};
+
+/* Read the arguments of the function being entered */
+bool uzl_get_arm_call_args(uc_engine *uc, uint64_t *args)
+{
+  void *vals[UZL_SUM_ARGS];
+  uint32_t idx;
+  for(idx = 0; idx < UZL_SUM_ARGS; idx++)
+  {
+    args[idx] = 0;
+    vals[idx] = &(args[idx]);
+  }
+  return uc_reg_read_batch(uc, uzl_arm_call_arg_ids, vals, UZL_SUM_ARGS) ==
+         UC_ERR_OK;
+}
+
+/* Return from the function being entered, lr keeps the caller's thumb bit */
+bool uzl_ret_arm_call(uc_engine *uc, uint64_t ret)
+{
+  uint64_t lr = 0;
+  if(uc_reg_read(uc, UC_ARM_REG_LR, &lr) != UC_ERR_OK)
+    return false;
+  return uc_reg_write(uc, UC_ARM_REG_R0, &ret) == UC_ERR_OK &&
+         uc_reg_write(uc, UC_ARM_REG_PC, &lr) == UC_ERR_OK;
+}
+
+/* Return address of the function being entered */
+bool uzl_get_arm_ret_addr(uc_engine *uc, uint64_t *addr)
+{
+  *addr = 0;
+  if(uc_reg_read(uc, UC_ARM_REG_LR, addr) != UC_ERR_OK)
+    return false;
+  *addr &= ~(uint64_t) 1;
+  return true;
+}
+
+/* Unicorn id of a capstone core register, pc reads differently */
+static bool uzl_arm_cs_reg(uint32_t cs_reg, int *reg)
+{
+  if(cs_reg >= ARM_REG_R0 && cs_reg <= ARM_REG_R12)
+    *reg = UC_ARM_REG_R0 + (cs_reg - ARM_REG_R0);
+  else if(cs_reg == ARM_REG_SP)
+    *reg = UC_ARM_REG_SP;
+  else if(cs_reg == ARM_REG_LR)
+    *reg = UC_ARM_REG_LR;
+  else
+    return false;
+  return true;
+}
+
+/* Operands of cmp, cmn and tst without shifted registers */
+bool uzl_get_arm_cmp(cs_insn *insn, uzl_cmp_ins_t *ins)
+{
+  cs_arm *arm = &(insn->detail->arm);
+  uint32_t idx;
+
+  if((insn->id != ARM_INS_CMP && insn->id != ARM_INS_CMN &&
+      insn->id != ARM_INS_TST) || arm->op_count != 2)
+    return false;
+  for(idx = 0; idx < 2; idx++)
+  {
+    cs_arm_op *op = &(arm->operands[idx]);
+    uzl_cmp_op_t *cmp_op = &(ins->op[idx]);
+    memset(cmp_op, 0, sizeof(uzl_cmp_op_t));
+    if(op->shift.type != ARM_SFT_INVALID)
+      return false;
+    if(op->type == ARM_OP_REG)
+    {
+      cmp_op->type = UZL_CMP_OP_REG;
+      if(!uzl_arm_cs_reg(op->reg, &(cmp_op->reg)))
+        return false;
+    }
+    else if(op->type == ARM_OP_IMM)
+    {
+      cmp_op->type = UZL_CMP_OP_IMM;
+      cmp_op->val = (uint32_t) op->imm;
+    }
+    else
+      return false;
+  }
+  if(insn->id == ARM_INS_TST && arm->operands[1].type == ARM_OP_REG &&
+     arm->operands[0].reg == arm->operands[1].reg)
+  {
+    memset(&(ins->op[1]), 0, sizeof(uzl_cmp_op_t));
+    ins->op[1].type = UZL_CMP_OP_IMM;
+  }
+  ins->size = sizeof(uint32_t);
+  ins->neg = insn->id == ARM_INS_CMN;
+  return true;
+}
+
+/* Taint slot of a capstone register, sp and pc only address */
+static uint8_t uzl_arm_taint_reg(uint32_t cs_reg)
+{
+  if(cs_reg >= ARM_REG_R0 && cs_reg <= ARM_REG_R12)
+    return UZL_TAINT_REG + (cs_reg - ARM_REG_R0);
+  if(cs_reg == ARM_REG_LR)
+    return UZL_TAINT_REG + 14;
+  if(cs_reg == ARM_REG_CPSR)
+    return UZL_TAINT_REG_FLAGS;
+  return UZL_TAINT_REG_NONE;
+}
+
+/* Register slots an instruction reads data from and writes */
+bool uzl_get_arm_taint(cs_insn *insn, uzl_taint_ins_t *ins)
+{
+  cs_detail *detail = insn->detail;
+  cs_arm *arm = &(detail->arm);
+  uint32_t idx;
+
+  /* svc takes arguments in r0 to r5 and returns in r0 */
+  if(ins->kind == UZL_TAINT_INS_SYSCALL)
+  {
+    for(idx = 0; idx < 6; idx++)
+      uzl_taint_ins_add(ins, false, uzl_arm_taint_reg(ARM_REG_R0 + idx));
+    return uzl_taint_ins_add(ins, true, uzl_arm_taint_reg(ARM_REG_R0));
+  }
+
+  /* Conditional branches decide on the flags */
+  if(ins->kind == UZL_TAINT_INS_BRANCH && arm->cc != ARM_CC_INVALID &&
+     arm->cc != ARM_CC_AL && !uzl_taint_ins_add(ins, false,
+                                                UZL_TAINT_REG_FLAGS))
+    return false;
+  if(arm->update_flags &&
+     !uzl_taint_ins_add(ins, true, UZL_TAINT_REG_FLAGS))
+    return false;
+
+  /* Explicit register operands, address registers are no sources */
+  for(idx = 0; idx < arm->op_count; idx++)
+  {
+    cs_arm_op *op = &(arm->operands[idx]);
+    if(op->type != ARM_OP_REG)
+      continue;
+    uint8_t reg = uzl_arm_taint_reg(op->reg);
+    if((op->access & CS_AC_READ) && !uzl_taint_ins_add(ins, false, reg))
+      return false;
+    if((op->access & CS_AC_WRITE) && !uzl_taint_ins_add(ins, true, reg))
+      return false;
+  }
+
+  /* Implicit registers, bl links lr */
+  for(idx = 0; idx < detail->regs_read_count; idx++)
+  {
+    if(!uzl_taint_ins_add(ins, false,
+                          uzl_arm_taint_reg(detail->regs_read[idx])))
+      return false;
+  }
+  for(idx = 0; idx < detail->regs_write_count; idx++)
+  {
+    if(!uzl_taint_ins_add(ins, true,
+                          uzl_arm_taint_reg(detail->regs_write[idx])))
+      return false;
+  }
+  return true;
+}
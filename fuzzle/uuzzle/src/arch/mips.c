@@ -0,0 +1,292 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <puzzle.h>
+#include <uuzzle.h>
+#include <unicorn.h>
+#include <capstone.h>
+#include <stdbool.h>
+
+
+/* Backend */
+const uzl_arch_t uzl_arch_mips =
+{
+  .uc_arch = UC_ARCH_MIPS,
+  .cs_arch = CS_ARCH_MIPS,
+  .get_uc_mode = uzl_get_mips_uc_mode,
+  .get_cs_mode = uzl_get_mips_cs_mode,
+  .get_pc = uzl_get_mips_pc,
+  .get_sp = uzl_get_mips_sp,
+  .get_args = uzl_get_mips_args,
+  .get_regs = uzl_get_mips_regs,
+  .load_regs = uzl_regs_write,
+  .set_ret = uzl_set_mips_ret,
+  .reg_sys = uzl_reg_linux_mips_sys,
+  .get_call_args = uzl_get_mips_call_args,
+  .ret_call = uzl_ret_mips_call,
+  .get_ret_addr = uzl_get_mips_ret_addr,
+  .get_cmp = uzl_get_mips_cmp,
+  .get_taint = uzl_get_mips_taint,
+  .sum_heap = UZL_SUM_HEAP_BASE_32
+};
+
+/* Get unicorn mode, byte order comes from the register record */
+bool uzl_get_mips_uc_mode(pzl_ctx_t *pzl_ctx, uint32_t *mode)
+{
+  usr_regs_mips_t usr_reg;
+  memcpy(&usr_reg, pzl_ctx->reg_rec->usr_reg, pzl_ctx->reg_rec->usr_reg_len);
+  *mode = UC_MODE_MIPS32 |
+          (usr_reg.big_endian ? UC_MODE_BIG_ENDIAN : UC_MODE_LITTLE_ENDIAN);
+  return true;
+}
+
+/* Get capstone mode */
+bool uzl_get_mips_cs_mode(pzl_ctx_t *pzl_ctx, uint32_t *mode)
+{
+  usr_regs_mips_t usr_reg;
+  memcpy(&usr_reg, pzl_ctx->reg_rec->usr_reg, pzl_ctx->reg_rec->usr_reg_len);
+  *mode = CS_MODE_MIPS32 |
+          (usr_reg.big_endian ? CS_MODE_BIG_ENDIAN : CS_MODE_LITTLE_ENDIAN);
+  return true;
+}
+
+/* Get program counter */
+bool uzl_get_mips_pc(pzl_ctx_t *pzl_ctx, uint64_t *pc)
+{
+  usr_regs_mips_t usr_reg;
+  memcpy(&usr_reg, pzl_ctx->reg_rec->usr_reg, pzl_ctx->reg_rec->usr_reg_len);
+  *pc = usr_reg.pc;
+  return true;
+}
+
+/* Get stack pointer */
+bool uzl_get_mips_sp(pzl_ctx_t *pzl_ctx, uint64_t *sp)
+{
+  usr_regs_mips_t usr_reg;
+  memcpy(&usr_reg, pzl_ctx->reg_rec->usr_reg, pzl_ctx->reg_rec->usr_reg_len);
+  *sp = usr_reg.r[29];
+  return true;
+}
+
+/* Get first call arguments, a0 to a2 */
+bool uzl_get_mips_args(pzl_ctx_t *pzl_ctx, uint64_t *args)
+{
+  usr_regs_mips_t usr_reg;
+  memcpy(&usr_reg, pzl_ctx->reg_rec->usr_reg, pzl_ctx->reg_rec->usr_reg_len);
+  args[0] = usr_reg.r[4];
+  args[1] = usr_reg.r[5];
+  args[2] = usr_reg.r[6];
+  return true;
+}
+
+/* Build mips register set from the register record */
+bool uzl_get_mips_regs(pzl_ctx_t *pzl_ctx, uzl_regs_t *regs,
+                       uzl_opts_t *opts)
+{
+  usr_regs_mips_t usr_reg;
+  memcpy(&usr_reg, pzl_ctx->reg_rec->usr_reg, pzl_ctx->reg_rec->usr_reg_len);
+
+  /* $zero is hardwired */
+  uint32_t idx, cnt = 0;
+  for(idx = 1; idx < 32; idx++)
+  {
+    regs->ids[cnt] = UC_MIPS_REG_0 + idx;
+    regs->vals[cnt++] = usr_reg.r[idx];
+  }
+  regs->ids[cnt] = UC_MIPS_REG_LO;
+  regs->vals[cnt++] = usr_reg.lo;
+  regs->ids[cnt] = UC_MIPS_REG_HI;
+  regs->vals[cnt++] = usr_reg.hi;
+  regs->ids[cnt] = UC_MIPS_REG_PC;
+  regs->vals[cnt++] = usr_reg.pc;
+  regs->ids[cnt] = UC_MIPS_REG_CP0_USERLOCAL;
+  regs->vals[cnt++] = usr_reg.tls;
+  regs->cnt = cnt;
+
+  for(idx = 0; idx < regs->cnt; idx++)
+    regs->ptrs[idx] = &(regs->vals[idx]);
+  return true;
+}
+
+/* Set return value, a3 clear marks success */
+bool uzl_set_mips_ret(uc_engine *uc, uint64_t ret)
+{
+  uint64_t err = 0;
+  return uc_reg_write(uc, UC_MIPS_REG_V0, &ret) == UC_ERR_OK &&
+         uc_reg_write(uc, UC_MIPS_REG_A3, &err) == UC_ERR_OK;
+}
+
+/* Integer arguments of a call, in the order they are passed */
+static int uzl_mips_call_arg_ids[UZL_SUM_ARGS] =
+{
+  UC_MIPS_REG_A0,
+  UC_MIPS_REG_A1,
+  UC_MIPS_REG_A2,
+  UC_MIPS_REG_A3
+};
+
+/* Read the arguments of the function being entered */
+bool uzl_get_mips_call_args(uc_engine *uc, uint64_t *args)
+{
+  void *vals[UZL_SUM_ARGS];
+  uint32_t idx;
+  for(idx = 0; idx < UZL_SUM_ARGS; idx++)
+  {
+    args[idx] = 0;
+    vals[idx] = &(args[idx]);
+  }
+  return uc_reg_read_batch(uc, uzl_mips_call_arg_ids, vals, UZL_SUM_ARGS) ==
+         UC_ERR_OK;
+}
+
+/* Return from the function being entered, unlike syscalls a3 is kept */
+bool uzl_ret_mips_call(uc_engine *uc, uint64_t ret)
+{
+  uint64_t ra = 0;
+  if(uc_reg_read(uc, UC_MIPS_REG_RA, &ra) != UC_ERR_OK)
+    return false;
+  return uc_reg_write(uc, UC_MIPS_REG_V0, &ret) == UC_ERR_OK &&
+         uc_reg_write(uc, UC_MIPS_REG_PC, &ra) == UC_ERR_OK;
+}
+
+/* Return address of the function being entered */
+bool uzl_get_mips_ret_addr(uc_engine *uc, uint64_t *addr)
+{
+  *addr = 0;
+  return uc_reg_read(uc, UC_MIPS_REG_RA, addr) == UC_ERR_OK;
+}
+
+/* Comparison operand from a general purpose register or an immediate */
+static bool uzl_mips_cmp_op(cs_mips_op *op, uzl_cmp_op_t *cmp_op)
+{
+  memset(cmp_op, 0, sizeof(uzl_cmp_op_t));
+  if(op->type == MIPS_OP_REG && op->reg >= MIPS_REG_0 &&
+     op->reg <= MIPS_REG_31)
+  {
+    cmp_op->type = UZL_CMP_OP_REG;
+    cmp_op->reg = UC_MIPS_REG_0 + (op->reg - MIPS_REG_0);
+  }
+  else if(op->type == MIPS_OP_IMM)
+  {
+    cmp_op->type = UZL_CMP_OP_IMM;
+    cmp_op->val = op->imm;
+  }
+  else
+    return false;
+  return true;
+}
+
+/*
+Operands of the instructions mips compares with, there are no flags.
+Equality branches compare their first two operands, set on less than
+its two sources and the zero branches their register against 0.
+*/
+bool uzl_get_mips_cmp(cs_insn *insn, uzl_cmp_ins_t *ins)
+{
+  cs_mips *mips = &(insn->detail->mips);
+  cs_mips_op *ops = mips->operands;
+
+  switch(insn->id)
+  {
+    case MIPS_INS_BEQ:
+    case MIPS_INS_BNE:
+      if(mips->op_count < 2 || !uzl_mips_cmp_op(&(ops[0]), &(ins->op[0])) ||
+         !uzl_mips_cmp_op(&(ops[1]), &(ins->op[1])))
+        return false;
+      break;
+    case MIPS_INS_BEQZ:
+    case MIPS_INS_BNEZ:
+      if(mips->op_count < 1 || !uzl_mips_cmp_op(&(ops[0]), &(ins->op[0])))
+        return false;
+      memset(&(ins->op[1]), 0, sizeof(uzl_cmp_op_t));
+      ins->op[1].type = UZL_CMP_OP_IMM;
+      break;
+    case MIPS_INS_SLT:
+    case MIPS_INS_SLTU:
+    case MIPS_INS_SLTI:
+    case MIPS_INS_SLTIU:
+      if(mips->op_count != 3 || !uzl_mips_cmp_op(&(ops[1]), &(ins->op[0])) ||
+         !uzl_mips_cmp_op(&(ops[2]), &(ins->op[1])))
+        return false;
+      break;
+    default:
+      return false;
+  }
+  ins->size = sizeof(uint32_t);
+  ins->neg = false;
+  return true;
+}
+
+/* Taint slot of a capstone register, zero and sp carry none */
+static uint8_t uzl_mips_taint_reg(uint32_t cs_reg)
+{
+  if(cs_reg > MIPS_REG_0 && cs_reg <= MIPS_REG_31 &&
+     cs_reg != MIPS_REG_0 + 29)
+    return UZL_TAINT_REG + (cs_reg - MIPS_REG_0);
+  return UZL_TAINT_REG_NONE;
+}
+
+/* Instructions without a destination register among their operands */
+static const uint32_t uzl_mips_no_dst[] =
+{
+  MIPS_INS_SB, MIPS_INS_SH, MIPS_INS_SW, MIPS_INS_SD, MIPS_INS_SWL,
+  MIPS_INS_SWR, MIPS_INS_SDL, MIPS_INS_SDR, MIPS_INS_SC, MIPS_INS_SCD,
+  MIPS_INS_MULT, MIPS_INS_MULTU, MIPS_INS_DIV, MIPS_INS_DIVU,
+  MIPS_INS_DMULT, MIPS_INS_DMULTU, MIPS_INS_DDIV, MIPS_INS_DDIVU,
+  MIPS_INS_MTHI, MIPS_INS_MTLO
+};
+
+/*
+Register slots an instruction reads data from and writes. Capstone has
+no operand access for mips, so the first register is taken as written
+unless the instruction stores, branches or only sets hi and lo.
+*/
+bool uzl_get_mips_taint(cs_insn *insn, uzl_taint_ins_t *ins)
+{
+  cs_detail *detail = insn->detail;
+  cs_mips *mips = &(detail->mips);
+  bool dst = ins->kind == UZL_TAINT_INS_FLOW;
+  uint32_t idx;
+
+  /* syscall takes arguments in a0 to a3 and returns in v0 and a3 */
+  if(ins->kind == UZL_TAINT_INS_SYSCALL)
+  {
+    for(idx = 4; idx < 8; idx++)
+      uzl_taint_ins_add(ins, false, uzl_mips_taint_reg(MIPS_REG_0 + idx));
+    return uzl_taint_ins_add(ins, true, uzl_mips_taint_reg(MIPS_REG_0 + 2)) &&
+           uzl_taint_ins_add(ins, true, uzl_mips_taint_reg(MIPS_REG_0 + 7));
+  }
+
+  for(idx = 0; idx < sizeof(uzl_mips_no_dst) / sizeof(uzl_mips_no_dst[0]);
+      idx++)
+  {
+    if(insn->id == uzl_mips_no_dst[idx])
+      dst = false;
+  }
+
+  /* Explicit register operands, address registers are no sources */
+  for(idx = 0; idx < mips->op_count; idx++)
+  {
+    cs_mips_op *op = &(mips->operands[idx]);
+    if(op->type != MIPS_OP_REG)
+      continue;
+    if(!uzl_taint_ins_add(ins, idx == 0 && dst, uzl_mips_taint_reg(op->reg)))
+      return false;
+  }
+
+  /* Implicit registers, jal links ra */
+  for(idx = 0; idx < detail->regs_read_count; idx++)
+  {
+    if(!uzl_taint_ins_add(ins, false,
+                          uzl_mips_taint_reg(detail->regs_read[idx])))
+      return false;
+  }
+  for(idx = 0; idx < detail->regs_write_count; idx++)
+  {
+    if(!uzl_taint_ins_add(ins, true,
+                          uzl_mips_taint_reg(detail->regs_write[idx])))
+      return false;
+  }
+  return true;
+}
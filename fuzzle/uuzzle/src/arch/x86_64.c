@@ -1,18 +1,49 @@
+#include <stdio.h>
 #include <stdint.h>
+#include <stddef.h>
 #include <string.h>
 #include <puzzle.h>
 #include <uuzzle.h>
 #include <unicorn.h>
+#include <capstone.h>
 #include <stdbool.h>
 
 
-/* Get user registers */
-bool uzl_get_usr_regs_x86_64(pzl_ctx_t *pzl_ctx, void **usr_regs,
-  uzl_opts_t *opts)
-  {
-    *usr_regs = pzl_ctx->reg_rec->usr_reg;
-    return true;
-  }
+/* Backend */
+const uzl_arch_t uzl_arch_x86_64 =
+{
+  .uc_arch = UC_ARCH_X86,
+  .cs_arch = CS_ARCH_X86,
+  .get_uc_mode = uzl_get_x86_64_uc_mode,
+  .get_cs_mode = uzl_get_x86_64_cs_mode,
+  .get_pc = uzl_get_x86_64_pc,
+  .get_sp = uzl_get_x86_64_sp,
+  .get_args = uzl_get_x86_64_args,
+  .get_regs = uzl_get_x86_64_regs,
+  .load_regs = uzl_load_x86_64_regs,
+  .set_ret = uzl_set_x86_64_ret,
+  .reg_sys = uzl_reg_linux_x86_64_sys,
+  .get_call_args = uzl_get_x86_64_call_args,
+  .ret_call = uzl_ret_x86_64_call,
+  .get_ret_addr = uzl_get_x86_64_ret_addr,
+  .get_cmp = uzl_get_x86_64_cmp,
+  .get_taint = uzl_get_x86_64_taint,
+  .sum_heap = UZL_SUM_HEAP_BASE
+};
+
+/* Get unicorn mode */
+bool uzl_get_x86_64_uc_mode(pzl_ctx_t *pzl_ctx, uint32_t *mode)
+{
+  *mode = UC_MODE_64;
+  return true;
+}
+
+/* Get capstone mode */
+bool uzl_get_x86_64_cs_mode(pzl_ctx_t *pzl_ctx, uint32_t *mode)
+{
+  *mode = CS_MODE_64;
+  return true;
+}
 
 /* Get program counter */
 bool uzl_get_x86_64_pc(pzl_ctx_t *pzl_ctx, uint64_t *pc)
@@ -23,94 +54,381 @@ bool uzl_get_x86_64_pc(pzl_ctx_t *pzl_ctx, uint64_t *pc)
   return true;
 }
 
-/* Set x86_64 specific registers */
-bool uzl_set_x86_64_registers(pzl_ctx_t *pzl_ctx, uc_engine *uc,
-                              uzl_opts_t *opts)
+/* Get stack pointer */
+bool uzl_get_x86_64_sp(pzl_ctx_t *pzl_ctx, uint64_t *sp)
 {
   usr_regs_x86_64_t usr_reg;
   memcpy(&usr_reg, pzl_ctx->reg_rec->usr_reg, pzl_ctx->reg_rec->usr_reg_len);
+  *sp = usr_reg.rsp;
+  return true;
+}
 
-  /* Set up msrs */
-  if(!uzl_set_x86_64_msr(pzl_ctx, uc, usr_reg, opts))
-    return false;
+/* Get first call arguments */
+bool uzl_get_x86_64_args(pzl_ctx_t *pzl_ctx, uint64_t *args)
+{
+  usr_regs_x86_64_t usr_reg;
+  memcpy(&usr_reg, pzl_ctx->reg_rec->usr_reg, pzl_ctx->reg_rec->usr_reg_len);
+  args[0] = usr_reg.rdi;
+  args[1] = usr_reg.rsi;
+  args[2] = usr_reg.rdx;
+  return true;
+}
 
-  /* Set up registers */
-  uc_reg_write(uc, UC_X86_REG_R15, &(usr_reg.r15));
-  uc_reg_write(uc, UC_X86_REG_R14, &(usr_reg.r14));
-  uc_reg_write(uc, UC_X86_REG_R13, &(usr_reg.r13));
-  uc_reg_write(uc, UC_X86_REG_R12, &(usr_reg.r12));
-  uc_reg_write(uc, UC_X86_REG_RBP, &(usr_reg.rbp));
-  uc_reg_write(uc, UC_X86_REG_RBX, &(usr_reg.rbx));
-  uc_reg_write(uc, UC_X86_REG_R11, &(usr_reg.r11));
-  uc_reg_write(uc, UC_X86_REG_R10, &(usr_reg.r10));
-  uc_reg_write(uc, UC_X86_REG_R9, &(usr_reg.r9));
-  uc_reg_write(uc, UC_X86_REG_R8, &(usr_reg.r8));
-  uc_reg_write(uc, UC_X86_REG_RAX, &(usr_reg.rax));
-  uc_reg_write(uc, UC_X86_REG_RCX, &(usr_reg.rcx));
-  uc_reg_write(uc, UC_X86_REG_RDX, &(usr_reg.rdx));
-  uc_reg_write(uc, UC_X86_REG_RSI, &(usr_reg.rsi));
-  uc_reg_write(uc, UC_X86_REG_RDI, &(usr_reg.rdi));
-  uc_reg_write(uc, UC_X86_REG_RIP, &(usr_reg.rip));
-  uc_reg_write(uc, UC_X86_REG_CS, &(usr_reg.cs));
-  uc_reg_write(uc, UC_X86_REG_EFLAGS, &(usr_reg.eflags));
-  uc_reg_write(uc, UC_X86_REG_RSP, &(usr_reg.rsp));
-  uc_reg_write(uc, UC_X86_REG_SS, &(usr_reg.ss));
-  uc_reg_write(uc, UC_X86_REG_DS, &(usr_reg.ds));
-  uc_reg_write(uc, UC_X86_REG_ES, &(usr_reg.es));
-  uc_reg_write(uc, UC_X86_REG_FS, &(usr_reg.fs));
-  uc_reg_write(uc, UC_X86_REG_GS, &(usr_reg.gs));
+/* Registers in the order they are loaded, one per usr_regs_x86_64_t field */
+#define UZL_X86_64_REG(__reg, __field) \
+  { __reg, offsetof(usr_regs_x86_64_t, __field) }
+
+static const struct {
+  int id;
+  size_t off;
+} uzl_x86_64_regs[] =
+{
+  UZL_X86_64_REG(UC_X86_REG_R15, r15),
+  UZL_X86_64_REG(UC_X86_REG_R14, r14),
+  UZL_X86_64_REG(UC_X86_REG_R13, r13),
+  UZL_X86_64_REG(UC_X86_REG_R12, r12),
+  UZL_X86_64_REG(UC_X86_REG_RBP, rbp),
+  UZL_X86_64_REG(UC_X86_REG_RBX, rbx),
+  UZL_X86_64_REG(UC_X86_REG_R11, r11),
+  UZL_X86_64_REG(UC_X86_REG_R10, r10),
+  UZL_X86_64_REG(UC_X86_REG_R9, r9),
+  UZL_X86_64_REG(UC_X86_REG_R8, r8),
+  UZL_X86_64_REG(UC_X86_REG_RAX, rax),
+  UZL_X86_64_REG(UC_X86_REG_RCX, rcx),
+  UZL_X86_64_REG(UC_X86_REG_RDX, rdx),
+  UZL_X86_64_REG(UC_X86_REG_RSI, rsi),
+  UZL_X86_64_REG(UC_X86_REG_RDI, rdi),
+  UZL_X86_64_REG(UC_X86_REG_RIP, rip),
+  UZL_X86_64_REG(UC_X86_REG_CS, cs),
+  UZL_X86_64_REG(UC_X86_REG_EFLAGS, eflags),
+  UZL_X86_64_REG(UC_X86_REG_RSP, rsp),
+  UZL_X86_64_REG(UC_X86_REG_SS, ss),
+  UZL_X86_64_REG(UC_X86_REG_DS, ds),
+  UZL_X86_64_REG(UC_X86_REG_ES, es),
+  UZL_X86_64_REG(UC_X86_REG_FS, fs),
+  UZL_X86_64_REG(UC_X86_REG_GS, gs)
+};
 
+/* Build x86_64 register set from the register record */
+bool uzl_get_x86_64_regs(pzl_ctx_t *pzl_ctx, uzl_regs_t *regs,
+                         uzl_opts_t *opts)
+{
+  usr_regs_x86_64_t usr_reg;
+  memcpy(&usr_reg, pzl_ctx->reg_rec->usr_reg, pzl_ctx->reg_rec->usr_reg_len);
+
+  /* General purpose and segment registers */
+  uint32_t idx;
+  for(idx = 0; idx < sizeof(uzl_x86_64_regs) / sizeof(uzl_x86_64_regs[0]);
+      idx++)
+  {
+    regs->ids[idx] = uzl_x86_64_regs[idx].id;
+    memcpy(&(regs->vals[idx]),
+           (uint8_t *) &usr_reg + uzl_x86_64_regs[idx].off, sizeof(uint64_t));
+    regs->ptrs[idx] = &(regs->vals[idx]);
+  }
+  regs->cnt = idx;
+
+  /* fs and gs bases, after the selectors */
+  regs->msr_ids[0] = UZL_X86_64_MSR_FS_BASE;
+  regs->msr_vals[0] = usr_reg.fs_base;
+  regs->msr_ids[1] = UZL_X86_64_MSR_GS_BASE;
+  regs->msr_vals[1] = usr_reg.gs_base;
+  regs->msr_cnt = 2;
   return true;
 }
 
-/* Set up msrs */
-bool uzl_set_x86_64_msr(pzl_ctx_t *pzl_ctx, uc_engine *uc,
-                        usr_regs_x86_64_t usr_reg, uzl_opts_t *opts)
+/* Load x86_64 register set without running the emulator */
+bool uzl_load_x86_64_regs(uzl_regs_t *regs, uc_engine *uc)
 {
-  uc_err err;
-  uint8_t write_msr[] = "\x0f\x30";
-  uint64_t w_rax, w_rdx, w_rcx;
+  if(!uzl_regs_write(regs, uc))
+    return false;
 
-  /* Map scratch space */
-  uc_mem_map(uc, 0x1000, 2 * 1024 * 1024, UC_PROT_ALL);
-  if(uc_mem_write(uc, 0x1000, write_msr, sizeof(write_msr) - 1))
+  uint32_t idx;
+  for(idx = 0; idx < regs->msr_cnt; idx++)
   {
-    printf("uzl_set_x86_64_msr: cannot write msr instructions\n");
-    return false;
+    uc_x86_msr msr = { regs->msr_ids[idx], regs->msr_vals[idx] };
+    if(uc_reg_write(uc, UC_X86_REG_MSR, &msr) != UC_ERR_OK)
+    {
+      printf("uzl_load_x86_64_regs: cannot write msr %x\n", msr.rid);
+      return false;
+    }
   }
+  return true;
+}
 
-  /* Set fs msr */
-  w_rax = usr_reg.fs_base & 0xffffffff;
-  uc_reg_write(uc, UC_X86_REG_RAX, &w_rax);
-  w_rdx = (usr_reg.fs_base >> 32) & 0xffffffff;
-  uc_reg_write(uc, UC_X86_REG_RDX, &w_rdx);
-  w_rcx = 0xc0000100;
-  uc_reg_write(uc, UC_X86_REG_RCX, &w_rcx);
+/* Set return value */
+bool uzl_set_x86_64_ret(uc_engine *uc, uint64_t ret)
+{
+  return uc_reg_write(uc, UC_X86_REG_RAX, &ret) == UC_ERR_OK;
+}
 
-  err = uc_emu_start(uc, 0x1000, 0x1000 + sizeof(write_msr) - 1, 0, 0);
-  if(err != UC_ERR_OK)
+/* Integer arguments of a call, in the order they are passed */
+static int uzl_x86_64_call_arg_ids[UZL_SUM_ARGS] =
+{
+  UC_X86_REG_RDI,
+  UC_X86_REG_RSI,
+  UC_X86_REG_RDX,
+  UC_X86_REG_RCX
+};
+
+/* Read the arguments of the function being entered */
+bool uzl_get_x86_64_call_args(uc_engine *uc, uint64_t *args)
+{
+  void *vals[UZL_SUM_ARGS];
+  uint32_t idx;
+  for(idx = 0; idx < UZL_SUM_ARGS; idx++)
   {
-    printf("uzl_set_x86_64_msr: cannot initialise fs_base\n");
-    return false;
+    args[idx] = 0;
+    vals[idx] = &(args[idx]);
   }
+  return uc_reg_read_batch(uc, uzl_x86_64_call_arg_ids, vals, UZL_SUM_ARGS) ==
+         UC_ERR_OK;
+}
 
-  /* Set gs msr */
-  w_rax = usr_reg.gs_base & 0xffffffff;
-  uc_reg_write(uc, UC_X86_REG_RAX, &w_rax);
-  w_rdx = (usr_reg.gs_base >> 32) & 0xffffffff;
-  uc_reg_write(uc, UC_X86_REG_RDX, &w_rdx);
-  w_rcx = 0xc0000101;
-  uc_reg_write(uc, UC_X86_REG_RCX, &w_rcx);
+/* Return from the function being entered, popping the return address */
+bool uzl_ret_x86_64_call(uc_engine *uc, uint64_t ret)
+{
+  uint64_t rsp, rip;
+  if(uc_reg_read(uc, UC_X86_REG_RSP, &rsp) != UC_ERR_OK ||
+     uc_mem_read(uc, rsp, &rip, sizeof(rip)) != UC_ERR_OK)
+    return false;
+  rsp += sizeof(rip);
+  return uc_reg_write(uc, UC_X86_REG_RAX, &ret) == UC_ERR_OK &&
+         uc_reg_write(uc, UC_X86_REG_RSP, &rsp) == UC_ERR_OK &&
+         uc_reg_write(uc, UC_X86_REG_RIP, &rip) == UC_ERR_OK;
+}
 
-  err = uc_emu_start(uc, 0x1000, 0x1000 + sizeof(write_msr) - 1, 0, 0);
-  if(err != UC_ERR_OK)
+/* Return address of the function being entered, on top of the stack */
+bool uzl_get_x86_64_ret_addr(uc_engine *uc, uint64_t *addr)
+{
+  uint64_t rsp;
+  return uc_reg_read(uc, UC_X86_REG_RSP, &rsp) == UC_ERR_OK &&
+         uc_mem_read(uc, rsp, addr, sizeof(*addr)) == UC_ERR_OK;
+}
+
+/*
+General purpose registers by capstone id, sub-registers read directly. The
+last column numbers the full register a sub-register belongs to.
+*/
+#define UZL_X86_64_GPR(__reg, __num) \
+  { X86_REG_##__reg, UC_X86_REG_##__reg, __num }
+static const int uzl_x86_64_gprs[][3] =
+{
+  UZL_X86_64_GPR(RAX, 0), UZL_X86_64_GPR(EAX, 0), UZL_X86_64_GPR(AX, 0),
+  UZL_X86_64_GPR(AL, 0), UZL_X86_64_GPR(AH, 0),
+  UZL_X86_64_GPR(RBX, 1), UZL_X86_64_GPR(EBX, 1), UZL_X86_64_GPR(BX, 1),
+  UZL_X86_64_GPR(BL, 1), UZL_X86_64_GPR(BH, 1),
+  UZL_X86_64_GPR(RCX, 2), UZL_X86_64_GPR(ECX, 2), UZL_X86_64_GPR(CX, 2),
+  UZL_X86_64_GPR(CL, 2), UZL_X86_64_GPR(CH, 2),
+  UZL_X86_64_GPR(RDX, 3), UZL_X86_64_GPR(EDX, 3), UZL_X86_64_GPR(DX, 3),
+  UZL_X86_64_GPR(DL, 3), UZL_X86_64_GPR(DH, 3),
+  UZL_X86_64_GPR(RSI, 4), UZL_X86_64_GPR(ESI, 4), UZL_X86_64_GPR(SI, 4),
+  UZL_X86_64_GPR(SIL, 4),
+  UZL_X86_64_GPR(RDI, 5), UZL_X86_64_GPR(EDI, 5), UZL_X86_64_GPR(DI, 5),
+  UZL_X86_64_GPR(DIL, 5),
+  UZL_X86_64_GPR(RBP, 6), UZL_X86_64_GPR(EBP, 6), UZL_X86_64_GPR(BP, 6),
+  UZL_X86_64_GPR(BPL, 6),
+  UZL_X86_64_GPR(RSP, 7), UZL_X86_64_GPR(ESP, 7), UZL_X86_64_GPR(SP, 7),
+  UZL_X86_64_GPR(SPL, 7),
+  UZL_X86_64_GPR(R8, 8), UZL_X86_64_GPR(R8D, 8), UZL_X86_64_GPR(R8W, 8),
+  UZL_X86_64_GPR(R8B, 8),
+  UZL_X86_64_GPR(R9, 9), UZL_X86_64_GPR(R9D, 9), UZL_X86_64_GPR(R9W, 9),
+  UZL_X86_64_GPR(R9B, 9),
+  UZL_X86_64_GPR(R10, 10), UZL_X86_64_GPR(R10D, 10), UZL_X86_64_GPR(R10W, 10),
+  UZL_X86_64_GPR(R10B, 10),
+  UZL_X86_64_GPR(R11, 11), UZL_X86_64_GPR(R11D, 11), UZL_X86_64_GPR(R11W, 11),
+  UZL_X86_64_GPR(R11B, 11),
+  UZL_X86_64_GPR(R12, 12), UZL_X86_64_GPR(R12D, 12), UZL_X86_64_GPR(R12W, 12),
+  UZL_X86_64_GPR(R12B, 12),
+  UZL_X86_64_GPR(R13, 13), UZL_X86_64_GPR(R13D, 13), UZL_X86_64_GPR(R13W, 13),
+  UZL_X86_64_GPR(R13B, 13),
+  UZL_X86_64_GPR(R14, 14), UZL_X86_64_GPR(R14D, 14), UZL_X86_64_GPR(R14W, 14),
+  UZL_X86_64_GPR(R14B, 14),
+  UZL_X86_64_GPR(R15, 15), UZL_X86_64_GPR(R15D, 15), UZL_X86_64_GPR(R15W, 15),
+  UZL_X86_64_GPR(R15B, 15),
+  UZL_X86_64_GPR(RIP, 16)
+};
+
+/* Unicorn id of a capstone register, zero for none */
+static bool uzl_x86_64_cs_reg(uint32_t cs_reg, int *reg)
+{
+  uint32_t idx;
+  *reg = 0;
+  if(cs_reg == X86_REG_INVALID)
+    return true;
+  for(idx = 0; idx < sizeof(uzl_x86_64_gprs) / sizeof(uzl_x86_64_gprs[0]);
+      idx++)
   {
-    printf("uzl_set_x86_64_msr: cannot initialise gs_base\n");
+    if(uzl_x86_64_gprs[idx][0] == cs_reg)
+    {
+      *reg = uzl_x86_64_gprs[idx][1];
+      return true;
+    }
+  }
+  return false;
+}
+
+/* Operands of cmp, sub and test, test of a register with itself is against 0 */
+bool uzl_get_x86_64_cmp(cs_insn *insn, uzl_cmp_ins_t *ins)
+{
+  cs_x86 *x86 = &(insn->detail->x86);
+  uint32_t idx;
+
+  if((insn->id != X86_INS_CMP && insn->id != X86_INS_SUB &&
+      insn->id != X86_INS_TEST) || x86->op_count != 2)
     return false;
+  for(idx = 0; idx < 2; idx++)
+  {
+    cs_x86_op *op = &(x86->operands[idx]);
+    uzl_cmp_op_t *cmp_op = &(ins->op[idx]);
+    memset(cmp_op, 0, sizeof(uzl_cmp_op_t));
+    switch(op->type)
+    {
+      case X86_OP_REG:
+        cmp_op->type = UZL_CMP_OP_REG;
+        if(!uzl_x86_64_cs_reg(op->reg, &(cmp_op->reg)) || cmp_op->reg == 0)
+          return false;
+        break;
+      case X86_OP_IMM:
+        cmp_op->type = UZL_CMP_OP_IMM;
+        cmp_op->val = op->imm;
+        break;
+      case X86_OP_MEM:
+
+        /* fs and gs relative operands need the segment base */
+        if(op->mem.segment == X86_REG_FS || op->mem.segment == X86_REG_GS)
+          return false;
+        cmp_op->type = UZL_CMP_OP_MEM;
+        if(!uzl_x86_64_cs_reg(op->mem.base, &(cmp_op->reg)) ||
+           !uzl_x86_64_cs_reg(op->mem.index, &(cmp_op->index)))
+          return false;
+        cmp_op->scale = op->mem.scale;
+        cmp_op->val = op->mem.disp;
+
+        /* rip reads as this instruction, operands are relative to the next */
+        if(op->mem.base == X86_REG_RIP)
+          cmp_op->val += insn->size;
+        break;
+      default:
+        return false;
+    }
+  }
+  if(insn->id == X86_INS_TEST && x86->operands[0].type == X86_OP_REG &&
+     x86->operands[1].type == X86_OP_REG &&
+     x86->operands[0].reg == x86->operands[1].reg)
+  {
+    memset(&(ins->op[1]), 0, sizeof(uzl_cmp_op_t));
+    ins->op[1].type = UZL_CMP_OP_IMM;
+  }
+  ins->size = x86->operands[0].size;
+  ins->neg = false;
+  return ins->size > 0 && ins->size <= sizeof(uint64_t);
+}
+
+/* Taint slot of a capstone register, the stack pointer only addresses */
+static uint8_t uzl_x86_64_taint_reg(uint32_t cs_reg)
+{
+  uint32_t idx;
+  if(cs_reg == X86_REG_EFLAGS)
+    return UZL_TAINT_REG_FLAGS;
+
+  /* Vector registers carry copies, ymm shares its xmm half's slot */
+  if(cs_reg >= X86_REG_XMM0 && cs_reg <= X86_REG_XMM15)
+    return UZL_TAINT_REG + 16 + cs_reg - X86_REG_XMM0;
+  if(cs_reg >= X86_REG_YMM0 && cs_reg <= X86_REG_YMM15)
+    return UZL_TAINT_REG + 16 + cs_reg - X86_REG_YMM0;
+
+  for(idx = 0; idx < sizeof(uzl_x86_64_gprs) / sizeof(uzl_x86_64_gprs[0]);
+      idx++)
+  {
+    if(uzl_x86_64_gprs[idx][0] != cs_reg)
+      continue;
+    if(cs_reg == X86_REG_RIP || uzl_x86_64_gprs[idx][2] == 7)
+      return UZL_TAINT_REG_NONE;
+    return UZL_TAINT_REG + uzl_x86_64_gprs[idx][2];
   }
+  return UZL_TAINT_REG_NONE;
+}
 
-  /* Unmap scratch space */
-  uc_mem_unmap(uc, 0x1000,  2 * 1024 * 1024);
+/* Syscall arguments in order */
+static const uint32_t uzl_x86_64_sys_args[] =
+{
+  X86_REG_RDI, X86_REG_RSI, X86_REG_RDX, X86_REG_R10, X86_REG_R8, X86_REG_R9
+};
 
+/* Register slots an instruction reads data from and writes */
+bool uzl_get_x86_64_taint(cs_insn *insn, uzl_taint_ins_t *ins)
+{
+  cs_detail *detail = insn->detail;
+  cs_x86 *x86 = &(detail->x86);
+  uint32_t idx;
+
+  /* syscall returns in rax and clobbers rcx and r11 */
+  if(insn->id == X86_INS_SYSCALL || ins->kind == UZL_TAINT_INS_SYSCALL)
+  {
+    ins->kind = UZL_TAINT_INS_SYSCALL;
+    for(idx = 0; idx < sizeof(uzl_x86_64_sys_args) /
+                       sizeof(uzl_x86_64_sys_args[0]); idx++)
+      uzl_taint_ins_add(ins, false,
+                        uzl_x86_64_taint_reg(uzl_x86_64_sys_args[idx]));
+    return uzl_taint_ins_add(ins, true, uzl_x86_64_taint_reg(X86_REG_RAX)) &&
+           uzl_taint_ins_add(ins, true, uzl_x86_64_taint_reg(X86_REG_RCX)) &&
+           uzl_taint_ins_add(ins, true, uzl_x86_64_taint_reg(X86_REG_R11));
+  }
+
+  /* Zeroing idioms leave nothing of their operand */
+  if((insn->id == X86_INS_XOR || insn->id == X86_INS_SUB ||
+      insn->id == X86_INS_PXOR || insn->id == X86_INS_XORPS) &&
+     x86->op_count == 2 && x86->operands[0].type == X86_OP_REG &&
+     x86->operands[1].type == X86_OP_REG &&
+     x86->operands[0].reg == x86->operands[1].reg)
+  {
+    ins->kind = UZL_TAINT_INS_CLEAR;
+    if(insn->id == X86_INS_XOR || insn->id == X86_INS_SUB)
+      uzl_taint_ins_add(ins, true, UZL_TAINT_REG_FLAGS);
+    return uzl_taint_ins_add(ins, true,
+                             uzl_x86_64_taint_reg(x86->operands[0].reg));
+  }
+
+  /* Explicit operands, lea computes with its address registers */
+  for(idx = 0; idx < x86->op_count; idx++)
+  {
+    cs_x86_op *op = &(x86->operands[idx]);
+    if(op->type == X86_OP_MEM)
+    {
+      if(insn->id == X86_INS_LEA &&
+         (!uzl_taint_ins_add(ins, false,
+                             uzl_x86_64_taint_reg(op->mem.base)) ||
+          !uzl_taint_ins_add(ins, false,
+                             uzl_x86_64_taint_reg(op->mem.index))))
+        return false;
+      continue;
+    }
+    if(op->type != X86_OP_REG)
+      continue;
+
+    /* Byte and word writes keep the rest of the register */
+    uint8_t reg = uzl_x86_64_taint_reg(op->reg);
+    if(((op->access & CS_AC_READ) ||
+        ((op->access & CS_AC_WRITE) && op->size < 4)) &&
+       !uzl_taint_ins_add(ins, false, reg))
+      return false;
+    if((op->access & CS_AC_WRITE) && !uzl_taint_ins_add(ins, true, reg))
+      return false;
+  }
+
+  /* Implicit registers, flags among them */
+  for(idx = 0; idx < detail->regs_read_count; idx++)
+  {
+    if(!uzl_taint_ins_add(ins, false,
+                          uzl_x86_64_taint_reg(detail->regs_read[idx])))
+      return false;
+  }
+  for(idx = 0; idx < detail->regs_write_count; idx++)
+  {
+    if(!uzl_taint_ins_add(ins, true,
+                          uzl_x86_64_taint_reg(detail->regs_write[idx])))
+      return false;
+  }
   return true;
 }
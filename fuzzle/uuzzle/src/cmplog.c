@@ -0,0 +1,549 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/shm.h>
+#include <puzzle.h>
+#include <uuzzle.h>
+#include <unicorn.h>
+#include <capstone.h>
+
+
+/* How a hooked routine bounds the buffers it compares */
+enum uzl_cmp_rtn_kind {
+  UZL_CMP_RTN_STR,
+  UZL_CMP_RTN_STRN,
+  UZL_CMP_RTN_MEM
+};
+
+/* Comparing routines of libc */
+static const struct {
+  const char *sym;
+  uint8_t kind;
+} uzl_cmp_routines[] =
+{
+  { "strcmp", UZL_CMP_RTN_STR },
+  { "strncmp", UZL_CMP_RTN_STRN },
+  { "strcasecmp", UZL_CMP_RTN_STR },
+  { "strncasecmp", UZL_CMP_RTN_STRN },
+  { "memcmp", UZL_CMP_RTN_MEM },
+  { "bcmp", UZL_CMP_RTN_MEM }
+};
+
+/* Slot of an address in the instruction cache */
+static uint64_t uzl_cmp_slot(uzl_cmp_t *cmp, uint64_t addr)
+{
+  uint64_t slot = (addr * 0x9e3779b97f4a7c15) & (cmp->ent_cap - 1);
+  while(cmp->ent[slot].used && cmp->ent[slot].addr != addr)
+    slot = (slot + 1) & (cmp->ent_cap - 1);
+  return slot;
+}
+
+/* Double the instruction cache */
+static bool uzl_cmp_grow(uzl_cmp_t *cmp)
+{
+  uzl_cmp_ins_t *old_ent = cmp->ent;
+  uint64_t old_cap = cmp->ent_cap;
+  uint64_t idx;
+
+  cmp->ent = calloc(old_cap * 2, sizeof(uzl_cmp_ins_t));
+  if(cmp->ent == NULL)
+  {
+    cmp->ent = old_ent;
+    return false;
+  }
+  cmp->ent_cap = old_cap * 2;
+  for(idx = 0; idx < old_cap; idx++)
+  {
+    if(old_ent[idx].used)
+      cmp->ent[uzl_cmp_slot(cmp, old_ent[idx].addr)] = old_ent[idx];
+  }
+  free(old_ent);
+  return true;
+}
+
+/* Decoded instruction at addr, disassembled once */
+static uzl_cmp_ins_t *uzl_cmp_ins(uzl_cmp_t *cmp, uc_engine *uc, uint64_t addr,
+                                  uint32_t size)
+{
+  uint64_t slot = uzl_cmp_slot(cmp, addr);
+  if(cmp->ent[slot].used)
+    return &(cmp->ent[slot]);
+
+  /* Table stays at most half full */
+  if((cmp->ent_cnt + 1) * 2 > cmp->ent_cap)
+  {
+    if(!uzl_cmp_grow(cmp))
+      return NULL;
+    slot = uzl_cmp_slot(cmp, addr);
+  }
+
+  /* Undecodable bytes and other instructions are kept with size 0 */
+  uzl_cmp_ins_t *ins = &(cmp->ent[slot]);
+  const uint8_t *code = cmp->code;
+  size_t code_size = size < sizeof(cmp->code) ? size : sizeof(cmp->code);
+  uint64_t code_addr = addr;
+  if(uc_mem_read(uc, addr, cmp->code, code_size) != UC_ERR_OK ||
+     !cs_disasm_iter(cmp->handle, &code, &code_size, &code_addr, cmp->insn) ||
+     !cmp->arch->get_cmp(cmp->insn, ins))
+    memset(ins, 0, sizeof(uzl_cmp_ins_t));
+
+  ins->addr = addr;
+  ins->used = true;
+  cmp->ent_cnt++;
+  return ins;
+}
+
+/* Next pair slot of the site at addr, NULL when a site of another type has it */
+static uzl_cmp_ops_t *uzl_cmp_log(uzl_cmp_t *cmp, uint64_t addr, uint8_t type,
+                                  uint8_t size)
+{
+  uint32_t site = ((addr >> 4) ^ (addr << 8) ^ addr) & (UZL_CMP_MAP_W - 1);
+  uzl_cmp_hdr_t *hdr = &(cmp->map->hdr[site]);
+
+  if(hdr->hits == 0)
+  {
+    /* Sites cleared by an external fuzzer are seen again */
+    if(cmp->site_cnt < UZL_CMP_MAP_W)
+      cmp->sites[cmp->site_cnt++] = site;
+    hdr->addr = addr;
+    hdr->type = type;
+    hdr->size = size;
+  }
+  else if(hdr->type != type)
+    return NULL;
+  if(size > hdr->size)
+    hdr->size = size;
+  return &(cmp->map->log[site][hdr->hits++ % UZL_CMP_MAP_H]);
+}
+
+/* Value of an operand about to be compared */
+static bool uzl_cmp_read_op(uc_engine *uc, uzl_cmp_ins_t *ins,
+                            uzl_cmp_op_t *op, uint64_t *val)
+{
+  uint64_t base = 0, index = 0;
+  *val = 0;
+  switch(op->type)
+  {
+    case UZL_CMP_OP_REG:
+      return uc_reg_read(uc, op->reg, val) == UC_ERR_OK;
+    case UZL_CMP_OP_IMM:
+      *val = op->val;
+      return true;
+    case UZL_CMP_OP_MEM:
+
+      /* Only x86 compares memory, its bytes load as a little endian host's */
+      if((op->reg != 0 && uc_reg_read(uc, op->reg, &base) != UC_ERR_OK) ||
+         (op->index != 0 && uc_reg_read(uc, op->index, &index) != UC_ERR_OK))
+        return false;
+      return uc_mem_read(uc, base + index * op->scale + op->val, val,
+                         ins->size) == UC_ERR_OK;
+  }
+  return false;
+}
+
+/* Instruction callback, everything but comparisons returns after the lookup */
+static void uzl_cmp_hook_code(uc_engine *uc, uint64_t address, uint32_t size,
+                              void *user_data)
+{
+  uzl_cmp_t *cmp = (uzl_cmp_t *) user_data;
+  if(!cmp->enabled)
+    return;
+
+  uzl_cmp_ins_t *ins = uzl_cmp_ins(cmp, uc, address, size);
+  uint64_t v0, v1;
+  if(ins == NULL || ins->size == 0 ||
+     !uzl_cmp_read_op(uc, ins, &(ins->op[0]), &v0) ||
+     !uzl_cmp_read_op(uc, ins, &(ins->op[1]), &v1))
+    return;
+
+  /* Truncate to the compared width */
+  uint64_t mask = ins->size < sizeof(uint64_t) ?
+                  ((uint64_t) 1 << (ins->size * 8)) - 1 : UINT64_MAX;
+  if(ins->neg)
+    v1 = -v1;
+  v0 &= mask;
+  v1 &= mask;
+  if(v0 == v1)
+    return;
+
+  uzl_cmp_ops_t *ops = uzl_cmp_log(cmp, address, UZL_CMP_INS, ins->size);
+  if(ops == NULL)
+    return;
+  ops->ins.v0 = v0;
+  ops->ins.v1 = v1;
+}
+
+/* Read up to len bytes at addr, stopping at the first unmapped page */
+static uint64_t uzl_cmp_read(uc_engine *uc, uint64_t addr, uint8_t *dat,
+                             uint64_t len)
+{
+  if(uc_mem_read(uc, addr, dat, len) == UC_ERR_OK)
+    return len;
+
+  uint64_t head = PZL_PAGE_SIZE - addr % PZL_PAGE_SIZE;
+  if(head < len && uc_mem_read(uc, addr, dat, head) == UC_ERR_OK)
+    return head;
+  return 0;
+}
+
+/* Routine callback, logs prefixes of both buffers against the caller */
+static void uzl_cmp_hook_rtn(uc_engine *uc, uint64_t address, uint32_t size,
+                             void *user_data)
+{
+  uzl_cmp_rtn_t *rtn = (uzl_cmp_rtn_t *) user_data;
+  uzl_cmp_t *cmp = rtn->cmp;
+  uint64_t args[UZL_SUM_ARGS];
+  uint64_t site;
+
+  if(!cmp->enabled || !cmp->arch->get_call_args(uc, args) ||
+     !cmp->arch->get_ret_addr(uc, &site))
+    return;
+
+  /* Bounded routines read no further than their count */
+  uint64_t max = UZL_CMP_RTN_LEN;
+  if(rtn->kind != UZL_CMP_RTN_STR && args[2] < max)
+    max = args[2];
+  if(max == 0)
+    return;
+
+  uint8_t v0[UZL_CMP_RTN_LEN], v1[UZL_CMP_RTN_LEN];
+  uint64_t v0_len = uzl_cmp_read(uc, args[0], v0, max);
+  uint64_t v1_len = uzl_cmp_read(uc, args[1], v1, max);
+  if(rtn->kind == UZL_CMP_RTN_MEM)
+  {
+    if(v0_len != max || v1_len != max)
+      return;
+  }
+  else
+  {
+    v0_len = strnlen((char *) v0, v0_len);
+    v1_len = strnlen((char *) v1, v1_len);
+  }
+  if(v0_len == 0 || v1_len == 0 ||
+     (v0_len == v1_len && memcmp(v0, v1, v0_len) == 0))
+    return;
+
+  uzl_cmp_ops_t *ops = uzl_cmp_log(cmp, site, UZL_CMP_RTN,
+                                   v0_len > v1_len ? v0_len : v1_len);
+  if(ops == NULL)
+    return;
+  memcpy(ops->rtn.v0, v0, v0_len);
+  ops->rtn.v0_len = v0_len;
+  memcpy(ops->rtn.v1, v1, v1_len);
+  ops->rtn.v1_len = v1_len;
+}
+
+/* Add instruction hook over one address range */
+static bool uzl_cmp_add_range(uzl_cmp_t *cmp, uc_engine *uc, uint64_t begin,
+                              uint64_t end)
+{
+  uc_hook *hooks = realloc(cmp->hooks, (cmp->hook_cnt + 1) * sizeof(uc_hook));
+  if(hooks == NULL)
+    return false;
+  cmp->hooks = hooks;
+
+  if(uc_hook_add(uc, &(cmp->hooks[cmp->hook_cnt]), UC_HOOK_CODE,
+                 uzl_cmp_hook_code, cmp, begin, end - 1) != UC_ERR_OK)
+    return false;
+  cmp->hook_cnt++;
+  return true;
+}
+
+/* Hook the comparing routines the snapshot's libc has */
+static bool uzl_cmp_add_routines(uzl_cmp_t *cmp, pzl_ctx_t *pzl_ctx,
+                                 uc_engine *uc, uzl_opts_t *opts)
+{
+  uint32_t idx, dup;
+  for(idx = 0; idx < sizeof(uzl_cmp_routines) / sizeof(uzl_cmp_routines[0]);
+      idx++)
+  {
+    uint64_t addr;
+    if(!uzl_sym_resolve(pzl_ctx, "libc", uzl_cmp_routines[idx].sym, &addr,
+                        opts))
+      continue;
+
+    /* Aliases such as bcmp share an implementation */
+    for(dup = 0; dup < cmp->rtn_cnt; dup++)
+    {
+      if(cmp->rtn[dup].addr == addr)
+        break;
+    }
+    if(dup < cmp->rtn_cnt)
+      continue;
+
+    uzl_cmp_rtn_t *rtn = &(cmp->rtn[cmp->rtn_cnt]);
+    rtn->cmp = cmp;
+    rtn->addr = addr;
+    rtn->kind = uzl_cmp_routines[idx].kind;
+    if(uc_hook_add(uc, &(rtn->hook), UC_HOOK_CODE, uzl_cmp_hook_rtn, rtn,
+                   addr, addr) != UC_ERR_OK)
+    {
+      printf("uzl_cmp_add_routines: cannot register hook for %s\n",
+             uzl_cmp_routines[idx].sym);
+      return false;
+    }
+    cmp->rtn_cnt++;
+    if(opts->verbose)
+      printf("uzl_cmp_add_routines: %s at %p\n", uzl_cmp_routines[idx].sym,
+             (void *) addr);
+  }
+  return true;
+}
+
+/*
+Log comparisons with --cmplog, in the table named by UZL_CMP_SHM_ENV when
+set. Initialise before summaries so routines are logged before a summary
+returns from them.
+*/
+bool uzl_cmp_init(uzl_cmp_t **cmp, pzl_ctx_t *pzl_ctx, uc_engine *uc,
+                  uzl_opts_t *opts)
+{
+  uint32_t arch, mode;
+  uzl_cmp_t *new_cmp = calloc(1, sizeof(uzl_cmp_t));
+  if(new_cmp == NULL)
+  {
+    printf("uzl_cmp_init: cannot allocate comparison log\n");
+    return false;
+  }
+  new_cmp->uc = uc;
+  new_cmp->arch = uzl_get_arch(pzl_ctx);
+  if(new_cmp->arch == NULL)
+  {
+    printf("uzl_cmp_init: unknown architecture\n");
+    uzl_cmp_free(new_cmp);
+    return false;
+  }
+  if(!opts->cmplog)
+  {
+    *cmp = new_cmp;
+    return true;
+  }
+
+  /* Capstone with operand details */
+  if(!uzl_get_cs_arch(pzl_ctx, &arch) || !uzl_get_cs_mode(pzl_ctx, &mode) ||
+     cs_open(arch, mode, &(new_cmp->handle)) != CS_ERR_OK)
+  {
+    printf("uzl_cmp_init: cannot initialise capstone\n");
+    uzl_cmp_free(new_cmp);
+    return false;
+  }
+  new_cmp->cs_open = true;
+  if(cs_option(new_cmp->handle, CS_OPT_DETAIL, CS_OPT_ON) != CS_ERR_OK ||
+     (new_cmp->insn = cs_malloc(new_cmp->handle)) == NULL)
+  {
+    printf("uzl_cmp_init: cannot enable capstone details\n");
+    uzl_cmp_free(new_cmp);
+    return false;
+  }
+
+  /* Table */
+  char *shm_id = getenv(UZL_CMP_SHM_ENV);
+  if(shm_id != NULL)
+  {
+    struct shmid_ds shm_ds;
+    if(shmctl(atoi(shm_id), IPC_STAT, &shm_ds) != 0 ||
+       shm_ds.shm_segsz < sizeof(uzl_cmp_map_t))
+    {
+      printf("uzl_cmp_init: shared table %s is missing or too small\n",
+             shm_id);
+      uzl_cmp_free(new_cmp);
+      return false;
+    }
+    new_cmp->map = shmat(atoi(shm_id), NULL, 0);
+    if(new_cmp->map == (void *) -1)
+    {
+      printf("uzl_cmp_init: cannot attach shared table %s\n", shm_id);
+      new_cmp->map = NULL;
+      uzl_cmp_free(new_cmp);
+      return false;
+    }
+    new_cmp->shm = true;
+  }
+  else
+    new_cmp->map = calloc(1, sizeof(uzl_cmp_map_t));
+
+  /* Instruction cache and sites hit */
+  new_cmp->ent_cap = UZL_CMP_CACHE_SIZE;
+  new_cmp->ent = calloc(new_cmp->ent_cap, sizeof(uzl_cmp_ins_t));
+  new_cmp->sites = calloc(UZL_CMP_MAP_W, sizeof(uint32_t));
+  if(new_cmp->map == NULL || new_cmp->ent == NULL || new_cmp->sites == NULL)
+  {
+    printf("uzl_cmp_init: cannot allocate comparison buffers\n");
+    uzl_cmp_free(new_cmp);
+    return false;
+  }
+
+  /* Requested range, otherwise every executable record */
+  if(opts->cov_end > opts->cov_start)
+  {
+    if(!uzl_cmp_add_range(new_cmp, uc, opts->cov_start, opts->cov_end))
+    {
+      printf("uzl_cmp_init: cannot register instruction hook\n");
+      uzl_cmp_free(new_cmp);
+      return false;
+    }
+  }
+  else
+  {
+    uint64_t idx;
+    for(idx = 0; idx < pzl_ctx->mem_rec_cnt; idx++)
+    {
+      mem_rec_t *mem_rec = pzl_ctx->mem_rec[idx];
+      if(!(mem_rec->perms & PZL_EXECUTE))
+        continue;
+
+      if(!uzl_cmp_add_range(new_cmp, uc, mem_rec->start,
+                            mem_rec->start + mem_rec->size))
+      {
+        printf("uzl_cmp_init: cannot register instruction hook for %p\n",
+               (void *) mem_rec->start);
+        uzl_cmp_free(new_cmp);
+        return false;
+      }
+    }
+  }
+
+  if(!uzl_cmp_add_routines(new_cmp, pzl_ctx, uc, opts))
+  {
+    uzl_cmp_free(new_cmp);
+    return false;
+  }
+
+  new_cmp->enabled = true;
+  *cmp = new_cmp;
+  return true;
+}
+
+/* Log comparisons of the following runs */
+bool uzl_cmp_enable(uzl_cmp_t *cmp)
+{
+  cmp->enabled = true;
+  return true;
+}
+
+/*
+Stop logging, the hooks return at once. They stay registered since blocks
+already translated keep the hooks they were translated with.
+*/
+bool uzl_cmp_disable(uzl_cmp_t *cmp)
+{
+  cmp->enabled = false;
+  return true;
+}
+
+/* Start a new run, only the sites the last one hit are cleared */
+bool uzl_cmp_reset(uzl_cmp_t *cmp)
+{
+  uint32_t idx;
+  for(idx = 0; idx < cmp->site_cnt; idx++)
+    memset(&(cmp->map->hdr[cmp->sites[idx]]), 0, sizeof(uzl_cmp_hdr_t));
+  cmp->site_cnt = 0;
+  return true;
+}
+
+/* Offset of the first len bytes of pat in dat from start on, wrapping */
+static bool uzl_cmp_find(uint8_t *dat, uint64_t len, uint8_t *pat,
+                         uint64_t pat_len, uint64_t start, uint64_t *pos)
+{
+  uint64_t idx;
+  if(pat_len == 0 || pat_len > len)
+    return false;
+  for(idx = 0; idx <= len - pat_len; idx++)
+  {
+    *pos = (start + idx) % (len - pat_len + 1);
+    if(memcmp(dat + *pos, pat, pat_len) == 0)
+      return true;
+  }
+  return false;
+}
+
+/* Integer in size bytes of either byte order */
+static void uzl_cmp_encode(uint64_t val, uint8_t size, bool be, uint8_t *dat)
+{
+  uint8_t idx;
+  for(idx = 0; idx < size; idx++)
+    dat[be ? size - 1 - idx : idx] = val >> (8 * idx);
+}
+
+/*
+Input to state replacement from the last run's log. A pair is picked
+from a logged site and wherever dat holds one operand, as an integer of
+either byte order or a routine's prefix, it is overwritten with the
+other. False when no pair of the sites tried appears in dat.
+*/
+bool uzl_cmp_solve(uzl_cmp_t *cmp, uint8_t *dat, uint64_t *len, uint64_t max,
+                   uint64_t rnd)
+{
+  uint32_t tries;
+  for(tries = 0; tries < cmp->site_cnt && tries < UZL_CMP_MAP_H; tries++)
+  {
+    uint32_t site = cmp->sites[(rnd + tries) % cmp->site_cnt];
+    uzl_cmp_hdr_t *hdr = &(cmp->map->hdr[site]);
+    uint32_t cnt = hdr->hits < UZL_CMP_MAP_H ? hdr->hits : UZL_CMP_MAP_H;
+    if(cnt == 0)
+      continue;
+    uzl_cmp_ops_t *ops = &(cmp->map->log[site][(rnd >> 16) % cnt]);
+    uint8_t from[UZL_CMP_RTN_LEN], to[UZL_CMP_RTN_LEN];
+    uint64_t from_len, to_len, pos;
+    uint32_t dir;
+
+    /* Either operand may be the one taken from the input */
+    for(dir = 0; dir < 4; dir++)
+    {
+      if(hdr->type == UZL_CMP_INS)
+      {
+        uzl_cmp_encode(dir & 1 ? ops->ins.v1 : ops->ins.v0, hdr->size,
+                       dir & 2, from);
+        uzl_cmp_encode(dir & 1 ? ops->ins.v0 : ops->ins.v1, hdr->size,
+                       dir & 2, to);
+        from_len = to_len = hdr->size;
+      }
+      else
+      {
+        if(dir & 2)
+          break;
+        memcpy(from, dir & 1 ? ops->rtn.v1 : ops->rtn.v0, UZL_CMP_RTN_LEN);
+        memcpy(to, dir & 1 ? ops->rtn.v0 : ops->rtn.v1, UZL_CMP_RTN_LEN);
+        from_len = dir & 1 ? ops->rtn.v1_len : ops->rtn.v0_len;
+        to_len = dir & 1 ? ops->rtn.v0_len : ops->rtn.v1_len;
+      }
+      if(!uzl_cmp_find(dat, *len, from, from_len, rnd >> 24, &pos) ||
+         pos + to_len > max)
+        continue;
+
+      memcpy(dat + pos, to, to_len);
+      if(pos + to_len > *len)
+        *len = pos + to_len;
+      return true;
+    }
+  }
+  return false;
+}
+
+/* Remove hooks, detach the table and free the cache */
+bool uzl_cmp_free(uzl_cmp_t *cmp)
+{
+  if(cmp == NULL)
+    return false;
+
+  uint64_t idx;
+  for(idx = 0; idx < cmp->hook_cnt; idx++)
+    uc_hook_del(cmp->uc, cmp->hooks[idx]);
+  free(cmp->hooks);
+  for(idx = 0; idx < cmp->rtn_cnt; idx++)
+    uc_hook_del(cmp->uc, cmp->rtn[idx].hook);
+
+  if(cmp->shm)
+    shmdt(cmp->map);
+  else
+    free(cmp->map);
+  free(cmp->ent);
+  free(cmp->sites);
+  if(cmp->insn != NULL)
+    cs_free(cmp->insn, 1);
+  if(cmp->cs_open)
+    cs_close(&(cmp->handle));
+  free(cmp);
+  return true;
+}
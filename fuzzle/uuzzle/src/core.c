@@ -1,4 +1,5 @@
 #include <getopt.h>
+#include <stdlib.h>
 #include <stdint.h>
 #include <uuzzle.h>
 #include <puzzle.h>
@@ -6,167 +7,198 @@
 #include <capstone.h>
 
 
-/* Return unicorn architecture */
-bool uzl_get_uc_arch(pzl_ctx_t *pzl_ctx, uint8_t *arch)
+/* Backends by arch_t, NULL where the emulator has none */
+static const uzl_arch_t *uzl_archs[UNKN_ARCH + 1] =
 {
-  switch(pzl_ctx->hdr_rec.arch)
-  {
-    case X86_64:
-      *arch = UC_ARCH_X86;
-      return true;
-    case X86_32:
-    case ARM:
-    case AARCH64:
-    case PPC_64:
-    case PPC_32:
-    case MIPS_64:
-    case MIPS_32:
-    case UNKN_ARCH:
-    default:
-      printf("uzl_uc_arch: unknown arch\n");
-      return -1;
-  }
-}
+  [X86_64] = &uzl_arch_x86_64,
+  [ARM] = &uzl_arch_arm,
+  [AARCH64] = &uzl_arch_aarch64,
+  [MIPS_32] = &uzl_arch_mips
+};
 
-/* Return unicorn mode */
-bool uzl_get_uc_mode(pzl_ctx_t *pzl_ctx, uint8_t *mode)
+/* Return architecture backend */
+const uzl_arch_t *uzl_get_arch(pzl_ctx_t *pzl_ctx)
 {
-  switch(pzl_ctx->hdr_rec.arch)
+  arch_t arch = pzl_ctx->hdr_rec.arch;
+  if(arch > UNKN_ARCH || uzl_archs[arch] == NULL)
   {
-    case X86_64:
-      *mode = UC_MODE_64;
-      return true;
-    case X86_32:
-    case ARM:
-    case AARCH64:
-    case PPC_64:
-    case PPC_32:
-    case MIPS_64:
-    case MIPS_32:
-    case UNKN_ARCH:
-    default:
-      printf("uzl_uc_mode: unknown mode\n");
-      return -1;
+    printf("uzl_get_arch: unknown arch\n");
+    return NULL;
   }
+  return uzl_archs[arch];
 }
 
 /* Return unicorn architecture */
-bool uzl_get_cs_arch(pzl_ctx_t *pzl_ctx, uint8_t *arch)
+bool uzl_get_uc_arch(pzl_ctx_t *pzl_ctx, uint32_t *arch)
 {
-  switch(pzl_ctx->hdr_rec.arch)
-  {
-    case X86_64:
-      *arch = CS_ARCH_X86;
-      return true;
-    case X86_32:
-    case ARM:
-    case AARCH64:
-    case PPC_64:
-    case PPC_32:
-    case MIPS_64:
-    case MIPS_32:
-    case UNKN_ARCH:
-    default:
-      printf("uzl_cs_arch: unknown arch\n");
-      return -1;
-  }
+  const uzl_arch_t *uzl_arch = uzl_get_arch(pzl_ctx);
+  if(uzl_arch == NULL)
+    return false;
+  *arch = uzl_arch->uc_arch;
+  return true;
 }
 
 /* Return unicorn mode */
-bool uzl_get_cs_mode(pzl_ctx_t *pzl_ctx, uint8_t *mode)
+bool uzl_get_uc_mode(pzl_ctx_t *pzl_ctx, uint32_t *mode)
 {
-  switch(pzl_ctx->hdr_rec.arch)
-  {
-    case X86_64:
-      *mode = CS_MODE_64;
-      return true;
-    case X86_32:
-    case ARM:
-    case AARCH64:
-    case PPC_64:
-    case PPC_32:
-    case MIPS_64:
-    case MIPS_32:
-    case UNKN_ARCH:
-    default:
-      printf("uzl_cs_mode: unknown mode\n");
-      return -1;
-  }
+  const uzl_arch_t *uzl_arch = uzl_get_arch(pzl_ctx);
+  if(uzl_arch == NULL)
+    return false;
+  return uzl_arch->get_uc_mode(pzl_ctx, mode);
 }
 
-/* Set registers base on architecture */
+/* Return capstone architecture */
+bool uzl_get_cs_arch(pzl_ctx_t *pzl_ctx, uint32_t *arch)
+{
+  const uzl_arch_t *uzl_arch = uzl_get_arch(pzl_ctx);
+  if(uzl_arch == NULL)
+    return false;
+  *arch = uzl_arch->cs_arch;
+  return true;
+}
+
+/* Return capstone mode */
+bool uzl_get_cs_mode(pzl_ctx_t *pzl_ctx, uint32_t *mode)
+{
+  const uzl_arch_t *uzl_arch = uzl_get_arch(pzl_ctx);
+  if(uzl_arch == NULL)
+    return false;
+  return uzl_arch->get_cs_mode(pzl_ctx, mode);
+}
+
+/* Get program counter */
 bool uzl_get_pc(pzl_ctx_t *pzl_ctx, uint64_t *pc)
 {
-  switch(pzl_ctx->hdr_rec.arch)
+  const uzl_arch_t *uzl_arch = uzl_get_arch(pzl_ctx);
+  if(uzl_arch == NULL)
+    return false;
+  return uzl_arch->get_pc(pzl_ctx, pc);
+}
+
+/* Get stack pointer */
+bool uzl_get_sp(pzl_ctx_t *pzl_ctx, uint64_t *sp)
+{
+  const uzl_arch_t *uzl_arch = uzl_get_arch(pzl_ctx);
+  if(uzl_arch == NULL)
+    return false;
+  return uzl_arch->get_sp(pzl_ctx, sp);
+}
+
+/* Get the first UZL_ARCH_ARGS call arguments */
+bool uzl_get_args(pzl_ctx_t *pzl_ctx, uint64_t *args)
+{
+  const uzl_arch_t *uzl_arch = uzl_get_arch(pzl_ctx);
+  if(uzl_arch == NULL)
+    return false;
+  return uzl_arch->get_args(pzl_ctx, args);
+}
+
+/* Get user registers, laid out as the arch's usr_regs struct */
+bool uzl_get_usr_regs(pzl_ctx_t *pzl_ctx, void **usr_regs, uzl_opts_t *opts)
+{
+  if(uzl_get_arch(pzl_ctx) == NULL)
+    return false;
+  *usr_regs = pzl_ctx->reg_rec->usr_reg;
+  return true;
+}
+
+/* Set registers base on architecture */
+bool uzl_set_registers(pzl_ctx_t *pzl_ctx, uc_engine *uc, uzl_opts_t *opts)
+{
+  uzl_regs_t *regs;
+  if(!uzl_regs_init(&regs, pzl_ctx, opts))
+    return false;
+
+  bool ret = uzl_regs_load(regs, uc);
+  uzl_regs_free(regs);
+  return ret;
+}
+
+/* Build register set once, for loading on every reset */
+bool uzl_regs_init(uzl_regs_t **regs, pzl_ctx_t *pzl_ctx, uzl_opts_t *opts)
+{
+  const uzl_arch_t *uzl_arch = uzl_get_arch(pzl_ctx);
+  if(uzl_arch == NULL)
+    return false;
+
+  uzl_regs_t *new_regs = calloc(1, sizeof(uzl_regs_t));
+  if(new_regs == NULL)
   {
-    case X86_64:
-      return uzl_get_x86_64_pc(pzl_ctx, pc);
-      break;
-    case X86_32:
-    case ARM:
-    case AARCH64:
-    case PPC_64:
-    case PPC_32:
-    case MIPS_64:
-    case MIPS_32:
-    case UNKN_ARCH:
-    default:
-      printf("uzl_get_pc: unknown arch\n");
-      return false;
+    printf("uzl_regs_init: cannot allocate registers\n");
+    return false;
+  }
+  new_regs->arch = uzl_arch;
+
+  if(!uzl_arch->get_regs(pzl_ctx, new_regs, opts))
+  {
+    free(new_regs);
+    return false;
   }
+  *regs = new_regs;
+  return true;
 }
 
-/* Get user registers */
-bool uzl_get_usr_regs(pzl_ctx_t *pzl_ctx, void **usr_regs, uzl_opts_t *opts)
+/* Load register set into unicorn */
+bool uzl_regs_load(uzl_regs_t *regs, uc_engine *uc)
+{
+  return regs->arch->load_regs(regs, uc);
+}
+
+/* Write the batch, enough for every arch without extra state */
+bool uzl_regs_write(uzl_regs_t *regs, uc_engine *uc)
 {
-  switch(pzl_ctx->hdr_rec.arch)
+  if(uc_reg_write_batch(uc, regs->ids, regs->ptrs, regs->cnt) != UC_ERR_OK)
   {
-    case X86_64:
-      return uzl_get_usr_regs_x86_64(pzl_ctx, usr_regs, opts);
-      break;
-    case X86_32:
-    case ARM:
-    case AARCH64:
-    case PPC_64:
-    case PPC_32:
-    case MIPS_64:
-    case MIPS_32:
-    case UNKN_ARCH:
-    default:
-      printf("uzl_reg_sys: unknown arch\n");
-      return false;
+    printf("uzl_regs_write: cannot write registers\n");
+    return false;
   }
+  return true;
 }
 
-/* Set registers base on architecture */
-bool uzl_set_registers(pzl_ctx_t *pzl_ctx, uc_engine *uc, uzl_opts_t *opts)
+/* Free register set */
+bool uzl_regs_free(uzl_regs_t *regs)
+{
+  if(regs == NULL)
+    return false;
+  free(regs);
+  return true;
+}
+
+/* Host copy of len guest bytes held by a single record */
+uint8_t *uzl_get_mem(pzl_ctx_t *pzl_ctx, uint64_t addr, uint64_t len,
+                     mem_rec_t **rec)
 {
-  switch(pzl_ctx->hdr_rec.arch)
+  mem_rec_t *mem_rec = pzl_find_mem_rec(pzl_ctx, addr);
+  if(mem_rec == NULL || len > mem_rec->start + mem_rec->size - addr)
+    return NULL;
+
+  /* Lazily opened chunked records only inflate the chunks read */
+  uint64_t off = addr - mem_rec->start;
+  if(mem_rec->chk_off != NULL && len > 0)
   {
-    case X86_64:
-      return uzl_set_x86_64_registers(pzl_ctx, uc, opts);
-      break;
-    case X86_32:
-    case ARM:
-    case AARCH64:
-    case PPC_64:
-    case PPC_32:
-    case MIPS_64:
-    case MIPS_32:
-    case UNKN_ARCH:
-    default:
-      printf("uzl_set_registers: unknown arch\n");
-      return false;
+    uint64_t chk_size = pzl_ctx->hdr_rec.chk_size;
+    uint64_t idx;
+    for(idx = off / chk_size; idx <= (off + len - 1) / chk_size; idx++)
+    {
+      if(!pzl_load_mem_chk(pzl_ctx, mem_rec, idx))
+        return NULL;
+    }
   }
+
+  *rec = mem_rec;
+  return mem_rec->dat + off;
 }
 
 /* Map memory regions from uuzzle file to unicorn */
 bool uzl_map_memory(pzl_ctx_t *pzl_ctx, uc_engine *uc, uzl_opts_t *opts)
 {
   uc_err err;
-  mem_rec_t *tmp_mem_rec = pzl_ctx->mem_rec;
-  while(tmp_mem_rec != NULL)
+  uint64_t idx;
+  for(idx = 0; idx < pzl_ctx->mem_rec_cnt; idx++)
   {
+    mem_rec_t *tmp_mem_rec = pzl_ctx->mem_rec[idx];
+
+    /* Sparse records arrive as anonymous mappings, zero pages stay unbacked */
     err = uc_mem_map_ptr(uc, tmp_mem_rec->start, tmp_mem_rec->size,
                          PERMS(tmp_mem_rec->perms), tmp_mem_rec->dat);
     if(err != UC_ERR_OK)
@@ -175,33 +207,102 @@ bool uzl_map_memory(pzl_ctx_t *pzl_ctx, uc_engine *uc, uzl_opts_t *opts)
              (void *) tmp_mem_rec->start);
       return false;
     }
+  }
+  return true;
+}
+
+/* Map the window of a memory record holding addr */
+static bool uzl_map_window(pzl_ctx_t *pzl_ctx, uc_engine *uc,
+                           mem_rec_t *mem_rec, uint64_t addr)
+{
+  uc_err err;
+  uint64_t win = UZL_LAZY_WINDOW;
+  uint64_t off, len;
+
+  /* Chunked records fault in a whole chunk at a time */
+  if(mem_rec->chk_off != NULL)
+    win = pzl_ctx->hdr_rec.chk_size;
+  off = (addr - mem_rec->start) / win * win;
+  len = mem_rec->size - off < win ? mem_rec->size - off : win;
+
+  /* Inflate only the chunk being touched */
+  if(mem_rec->chk_off != NULL &&
+     !pzl_load_mem_chk(pzl_ctx, mem_rec, off / win))
+  {
+    printf("uzl_map_window: cannot load %p\n", (void *) addr);
+    return false;
+  }
+
+  /* UC_ERR_MAP means the window is already mapped */
+  err = uc_mem_map_ptr(uc, mem_rec->start + off, len,
+                       PERMS(mem_rec->perms), mem_rec->dat + off);
+  if(err != UC_ERR_OK && err != UC_ERR_MAP)
+  {
+    printf("uzl_map_window: cannot map memory region %p\n",
+           (void *) (mem_rec->start + off));
+    return false;
+  }
+  return true;
+}
+
+/* Fault snapshot memory in on first touch */
+static bool uzl_map_fault(uc_engine *uc, uc_mem_type type, uint64_t address,
+                          int size, int64_t value, void *user_data)
+{
+  pzl_ctx_t *pzl_ctx = (pzl_ctx_t *) user_data;
+
+  /* Addresses outside the snapshot stay unmapped */
+  mem_rec_t *mem_rec = pzl_find_mem_rec(pzl_ctx, address);
+  if(mem_rec == NULL)
+    return false;
+
+  return uzl_map_window(pzl_ctx, uc, mem_rec, address);
+}
 
-    tmp_mem_rec = tmp_mem_rec->next;
+/* Map memory around the program counter and stack, the rest on demand */
+bool uzl_map_memory_lazy(pzl_ctx_t *pzl_ctx, uc_engine *uc, uc_hook *mem_hook,
+                         uzl_opts_t *opts)
+{
+  uint64_t addr[2];
+  uint64_t idx;
+
+  /* Windows the first instructions need */
+  if(!uzl_get_pc(pzl_ctx, &(addr[0])) || !uzl_get_sp(pzl_ctx, &(addr[1])))
+    return false;
+  for(idx = 0; idx < 2; idx++)
+  {
+    mem_rec_t *mem_rec = pzl_find_mem_rec(pzl_ctx, addr[idx]);
+    if(mem_rec != NULL && !uzl_map_window(pzl_ctx, uc, mem_rec, addr[idx]))
+      return false;
+  }
+
+  /* Everything else is faulted in */
+  if(uc_hook_add(uc, mem_hook, UC_HOOK_MEM_UNMAPPED, uzl_map_fault, pzl_ctx,
+                 1, 0) != UC_ERR_OK)
+  {
+    printf("uzl_map_memory_lazy: cannot register memory hook\n");
+    return false;
   }
   return true;
 }
 
 /* Register syscall handlers */
-bool uzl_reg_sys(pzl_ctx_t *pzl_ctx, uc_engine *uc, uc_hook *sys_hook,
+bool uzl_reg_sys(pzl_ctx_t *pzl_ctx, uc_engine *uc, uzl_sys_t **sys,
                  uzl_opts_t *opts)
 {
-  switch(pzl_ctx->hdr_rec.arch)
+  const uzl_arch_t *uzl_arch = uzl_get_arch(pzl_ctx);
+  if(uzl_arch == NULL)
+    return false;
+
+  if(!uzl_sys_init(sys, pzl_ctx, uc, opts))
+    return false;
+  if(!uzl_arch->reg_sys(pzl_ctx, uc, *sys, opts))
   {
-    case X86_64:
-      return uzl_reg_linux_x86_64_sys(pzl_ctx, uc, sys_hook, opts);
-      break;
-    case X86_32:
-    case ARM:
-    case AARCH64:
-    case PPC_64:
-    case PPC_32:
-    case MIPS_64:
-    case MIPS_32:
-    case UNKN_ARCH:
-    default:
-      printf("uzl_reg_sys: unknown arch\n");
-      return false;
+    uzl_sys_free(*sys);
+    *sys = NULL;
+    return false;
   }
+  return true;
 }
 
 /* Parse uuzzle arguments */
@@ -212,7 +313,26 @@ bool uzl_parse_opts(int argc, char **argv, uzl_opts_t *opts)
   opts->verbose = false;
   opts->follow_child = false;
   opts->quiet = false;
+  opts->lazy = false;
+  opts->fork_server = false;
+  opts->summaries = false;
+  opts->cmplog = false;
+  opts->taint = false;
+  opts->verify = false;
   opts->uzl_file_name = NULL;
+  opts->pool_file_name = NULL;
+  opts->root_dir_name = NULL;
+  opts->input_dir_name = NULL;
+  opts->trace_file_name = NULL;
+  opts->input_fd = -1;
+  opts->output_dir_name = NULL;
+  opts->jobs = 0;
+  opts->max_execs = 0;
+  opts->timeout = 0;
+  opts->budget = 0;
+  opts->end_addr = 0;
+  opts->cov_start = 0;
+  opts->cov_end = 0;
 
   /* Parse arguments */
   int8_t c;
@@ -221,11 +341,29 @@ bool uzl_parse_opts(int argc, char **argv, uzl_opts_t *opts)
     {"verbose", no_argument, 0, 'v'},
     {"follow_child", no_argument, 0, 'f'},
     {"quiet", no_argument, 0, 'q'},
+    {"pool", required_argument, 0, 'p'},
+    {"root", required_argument, 0, 'r'},
+    {"verify", no_argument, 0, 'y'},
+    {"lazy", no_argument, 0, 'l'},
+    {"inputs", required_argument, 0, 'i'},
+    {"end", required_argument, 0, 'e'},
+    {"fork_server", no_argument, 0, 's'},
+    {"summaries", no_argument, 0, 'u'},
+    {"cmplog", no_argument, 0, 'g'},
+    {"taint", no_argument, 0, 'a'},
+    {"cover", required_argument, 0, 'c'},
+    {"trace", required_argument, 0, 't'},
+    {"input_fd", required_argument, 0, 'n'},
+    {"output", required_argument, 0, 'o'},
+    {"jobs", required_argument, 0, 'j'},
+    {"execs", required_argument, 0, 'x'},
+    {"timeout", required_argument, 0, 'm'},
+    {"budget", required_argument, 0, 'b'},
     {0, 0, 0, 0}
   };
 
   uint64_t option_index = 0;
-  while((c = getopt_long(argc, argv, "fvq", long_options,
+  while((c = getopt_long(argc, argv, "fvqp:r:yugali:e:sc:t:n:o:j:x:m:b:", long_options,
                         (int *) &option_index)) != -1)
   {
     switch(c)
@@ -239,6 +377,75 @@ bool uzl_parse_opts(int argc, char **argv, uzl_opts_t *opts)
       case 'q':
         opts->quiet = true;
         break;
+      case 'p':
+        opts->pool_file_name = optarg;
+        break;
+      case 'r':
+        opts->root_dir_name = optarg;
+        break;
+      case 'y':
+        opts->verify = true;
+        break;
+      case 'l':
+        opts->lazy = true;
+        break;
+      case 'i':
+        opts->input_dir_name = optarg;
+        break;
+      case 'e':
+        opts->end_addr = strtoull(optarg, NULL, 0);
+        break;
+      case 's':
+        opts->fork_server = true;
+        break;
+      case 'u':
+        opts->summaries = true;
+        break;
+      case 'g':
+        opts->cmplog = true;
+        break;
+      case 'a':
+        opts->taint = true;
+        break;
+      case 'c':
+        {
+          /* start-end */
+          char *end;
+          opts->cov_start = strtoull(optarg, &end, 0);
+          opts->cov_end = *end == '-' ? strtoull(end + 1, NULL, 0) : 0;
+          if(opts->cov_end <= opts->cov_start)
+          {
+            printf("uzl_parse_opts: coverage range must be start-end\n");
+            return false;
+          }
+        }
+        break;
+      case 't':
+        opts->trace_file_name = optarg;
+        break;
+      case 'n':
+        opts->input_fd = strtoll(optarg, NULL, 0);
+        if(opts->input_fd < 0 || opts->input_fd >= UZL_SYS_FDS)
+        {
+          printf("uzl_parse_opts: input descriptor out of range\n");
+          return false;
+        }
+        break;
+      case 'o':
+        opts->output_dir_name = optarg;
+        break;
+      case 'j':
+        opts->jobs = strtoul(optarg, NULL, 0);
+        break;
+      case 'x':
+        opts->max_execs = strtoull(optarg, NULL, 0);
+        break;
+      case 'm':
+        opts->timeout = strtoull(optarg, NULL, 0);
+        break;
+      case 'b':
+        opts->budget = strtoull(optarg, NULL, 0);
+        break;
       case '?':
         return false;
     }
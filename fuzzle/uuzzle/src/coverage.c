@@ -0,0 +1,166 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/shm.h>
+#include <puzzle.h>
+#include <uuzzle.h>
+#include <unicorn.h>
+
+
+/* Block callback, one edge per basic block */
+static void uzl_cov_hook_block(uc_engine *uc, uint64_t address, uint32_t size,
+                               void *user_data)
+{
+  uzl_cov_t *cov = (uzl_cov_t *) user_data;
+  uint64_t cur_loc = ((address >> 4) ^ (address << 8)) & (UZL_COV_MAP_SIZE - 1);
+
+  cov->map[cur_loc ^ cov->prev_loc]++;
+  cov->prev_loc = cur_loc >> 1;
+}
+
+/* Add block hook over one address range */
+static bool uzl_cov_add_range(uzl_cov_t *cov, uc_engine *uc, uint64_t begin,
+                              uint64_t end)
+{
+  uc_hook *hooks = realloc(cov->hooks, (cov->hook_cnt + 1) * sizeof(uc_hook));
+  if(hooks == NULL)
+    return false;
+  cov->hooks = hooks;
+
+  if(uc_hook_add(uc, &(cov->hooks[cov->hook_cnt]), UC_HOOK_BLOCK,
+                 uzl_cov_hook_block, cov, begin, end - 1) != UC_ERR_OK)
+    return false;
+  cov->hook_cnt++;
+  return true;
+}
+
+/* Attach edge bitmap, shared with AFL when __AFL_SHM_ID is set */
+bool uzl_cov_init(uzl_cov_t **cov, pzl_ctx_t *pzl_ctx, uc_engine *uc,
+                  uzl_opts_t *opts)
+{
+  uzl_cov_t *new_cov = calloc(1, sizeof(uzl_cov_t));
+  if(new_cov == NULL)
+  {
+    printf("uzl_cov_init: cannot allocate coverage\n");
+    return false;
+  }
+  new_cov->uc = uc;
+
+  /* Bitmap */
+  char *shm_id = getenv(UZL_COV_SHM_ENV);
+  if(shm_id != NULL)
+  {
+    new_cov->map = shmat(atoi(shm_id), NULL, 0);
+    if(new_cov->map == (void *) -1)
+    {
+      printf("uzl_cov_init: cannot attach shared bitmap %s\n", shm_id);
+      new_cov->map = NULL;
+      uzl_cov_free(new_cov);
+      return false;
+    }
+    new_cov->shm = true;
+  }
+  else
+  {
+    new_cov->map = calloc(1, UZL_COV_MAP_SIZE);
+    if(new_cov->map == NULL)
+    {
+      printf("uzl_cov_init: cannot allocate bitmap\n");
+      uzl_cov_free(new_cov);
+      return false;
+    }
+  }
+
+  /* Requested range, otherwise every executable record */
+  if(opts->cov_end > opts->cov_start)
+  {
+    if(!uzl_cov_add_range(new_cov, uc, opts->cov_start, opts->cov_end))
+    {
+      printf("uzl_cov_init: cannot register block hook\n");
+      uzl_cov_free(new_cov);
+      return false;
+    }
+  }
+  else
+  {
+    uint64_t idx;
+    for(idx = 0; idx < pzl_ctx->mem_rec_cnt; idx++)
+    {
+      mem_rec_t *mem_rec = pzl_ctx->mem_rec[idx];
+      if(!(mem_rec->perms & PZL_EXECUTE))
+        continue;
+
+      if(!uzl_cov_add_range(new_cov, uc, mem_rec->start,
+                            mem_rec->start + mem_rec->size))
+      {
+        printf("uzl_cov_init: cannot register block hook for %p\n",
+               (void *) mem_rec->start);
+        uzl_cov_free(new_cov);
+        return false;
+      }
+    }
+  }
+
+  *cov = new_cov;
+  return true;
+}
+
+/* Start a new run, edges do not carry over from the last block */
+bool uzl_cov_reset(uzl_cov_t *cov)
+{
+  cov->prev_loc = 0;
+  return true;
+}
+
+/* Count edges hit so far */
+uint64_t uzl_cov_count(uzl_cov_t *cov)
+{
+  uint64_t idx, cnt = 0;
+  for(idx = 0; idx < UZL_COV_MAP_SIZE; idx++)
+    cnt += cov->map[idx] != 0;
+  return cnt;
+}
+
+/* Fold this run's edges into merged, count new ones and clear for the next */
+uint64_t uzl_cov_merge(uzl_cov_t *cov, uint8_t *merged)
+{
+  uint64_t *words = (uint64_t *) cov->map;
+  uint64_t idx, cnt = 0;
+
+  /* Most of the bitmap is empty */
+  for(idx = 0; idx < UZL_COV_MAP_SIZE / sizeof(uint64_t); idx++)
+  {
+    if(words[idx] == 0)
+      continue;
+
+    uint64_t byte;
+    for(byte = idx * sizeof(uint64_t); byte < (idx + 1) * sizeof(uint64_t);
+        byte++)
+    {
+      if(cov->map[byte] != 0 && merged[byte] == 0 &&
+         __atomic_exchange_n(&(merged[byte]), 1, __ATOMIC_RELAXED) == 0)
+        cnt++;
+    }
+    words[idx] = 0;
+  }
+  return cnt;
+}
+
+/* Remove hooks and detach bitmap */
+bool uzl_cov_free(uzl_cov_t *cov)
+{
+  if(cov == NULL)
+    return false;
+
+  uint64_t idx;
+  for(idx = 0; idx < cov->hook_cnt; idx++)
+    uc_hook_del(cov->uc, cov->hooks[idx]);
+  free(cov->hooks);
+
+  if(cov->shm)
+    shmdt(cov->map);
+  else
+    free(cov->map);
+  free(cov);
+  return true;
+}
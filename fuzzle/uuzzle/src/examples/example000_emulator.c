@@ -3,21 +3,11 @@
 #include <unistd.h>
 #include <stdlib.h>
 #include <stdbool.h>
-#include <sys/stat.h>
-#include <sys/types.h>
 #include <puzzle.h>
 #include <uuzzle.h>
 #include <unicorn.h>
-#include <examples.h>
-#include <capstone.h>
 
 
-#if defined __WITH_TRACE__
-/* Capston globals */
-csh handle;
-cs_insn *insn;
-#endif
-
 /* Entry point */
 int main(int argc, char **argv, char **envp)
 {
@@ -30,54 +20,6 @@ int main(int argc, char **argv, char **envp)
     return false;
   }
 
-  /* Locals */
-  struct stat statbuf;
-  int32_t ret;
-
-  /* Stat */
-  ret = stat(opts.uzl_file_name, &statbuf);
-  if(ret != 0 || S_ISDIR(statbuf.st_mode))
-  {
-      printf("example000_emulator: cannot read file '%s'\n",
-             opts.uzl_file_name);
-      return false;
-  }
-  const uint8_t *file_path = (uint8_t *) opts.uzl_file_name;
-  uint64_t file_size = statbuf.st_size;
-  if(file_size < 1)
-  {
-      printf("example000_emulator: cannot read empty file '%s\n'", file_path);
-      return false;
-  }
-
-  /* Allocate data buffer */
-  uint8_t *in_data = (uint8_t *) malloc(file_size);
-
-  /* Read data */
-  FILE *in_file;
-  in_file = fopen((const char *) file_path, "r");
-  if(in_file == NULL)
-  {
-      printf("example000_emulator: cannot read file '%s'\n", file_path);
-      free(in_data);
-      in_data = NULL;
-      return false;
-  }
-
-  /* Read data bytes */
-  uint64_t bytes_read = fread(in_data, 1, file_size, in_file);
-  if(bytes_read != file_size || bytes_read <= 0)
-  {
-      printf("example000_emulator: cannot read file correctly\n");
-      free(in_data);
-      in_data = NULL;
-      fclose(in_file);
-      return false;
-  }
-
-  /* Clean up */
-  fclose(in_file);
-
   /* Initialise puzzle */
   pzl_ctx_t *pzl_ctx;
   pzl_init(&pzl_ctx, UNKN_ARCH);
@@ -87,8 +29,29 @@ int main(int argc, char **argv, char **envp)
     return false;
   }
 
-  /* Unpack fuzzle file */
-  if(pzl_unpack(pzl_ctx, in_data, bytes_read) == false)
+  /* Emulator locals */
+  pzl_pool_t *pzl_pool = NULL;
+  uzl_trace_t *trace = NULL;
+  uzl_sys_t *sys = NULL;
+
+  /* Attach page pool shared by pooled snapshots */
+  if(opts.pool_file_name != NULL)
+  {
+    if(!pzl_pool_open(&pzl_pool, opts.pool_file_name, false))
+    {
+      printf("example000_emulator: cannot open page pool\n");
+      goto error;
+    }
+    pzl_set_pool(pzl_ctx, pzl_pool);
+  }
+
+  /* Local copies of the files behind file memory records */
+  pzl_set_root(pzl_ctx, opts.root_dir_name);
+  pzl_set_verify(pzl_ctx, opts.verify);
+
+  /* Map fuzzle file, lazily chunked records inflate on first touch */
+  if((opts.lazy ? pzl_open_lazy(pzl_ctx, opts.uzl_file_name) :
+                  pzl_open_mmap(pzl_ctx, opts.uzl_file_name)) == false)
   {
     printf("example000_emulator: cannot unpack data\n");
     goto error;
@@ -99,8 +62,8 @@ int main(int argc, char **argv, char **envp)
   uc_err err;
 
   /* Initialise unicorn */
-  uint8_t uc_arch;
-  uint8_t uc_mode;
+  uint32_t uc_arch;
+  uint32_t uc_mode;
   uzl_get_uc_arch(pzl_ctx, &uc_arch);
   uzl_get_uc_mode(pzl_ctx, &uc_mode);
   err = uc_open(uc_arch, uc_mode, &uc);
@@ -111,7 +74,9 @@ int main(int argc, char **argv, char **envp)
   }
 
   /* Map memory */
-  if(!uzl_map_memory(pzl_ctx, uc, &opts))
+  uc_hook mem_hook;
+  if(!(opts.lazy ? uzl_map_memory_lazy(pzl_ctx, uc, &mem_hook, &opts) :
+                   uzl_map_memory(pzl_ctx, uc, &opts)))
   {
     printf("example000_emulator: cannot map memory regions\n");
     goto error;
@@ -126,19 +91,16 @@ int main(int argc, char **argv, char **envp)
 
 #if defined __WITH_TRACE__
 
-  /* Initialise capstone */
-  if(!init_capstone(pzl_ctx))
+  /* Trace executed instructions */
+  if(!uzl_trace_init(&trace, pzl_ctx, uc, &opts))
+  {
+    printf("example000_emulator: cannot initialise trace\n");
     goto error;
-
-  /* Register trace hook */
-  uc_hook trace_hook;
-  uc_hook_add(uc, &trace_hook,UC_HOOK_CODE, example000_emulator_hook_code,
-              NULL, 1, 0);
+  }
 #endif
 
   /* Register syscalls */
-  uc_hook sys_hook;
-  if(!uzl_reg_sys(pzl_ctx, uc, &sys_hook, &opts))
+  if(!uzl_reg_sys(pzl_ctx, uc, &sys, &opts))
   {
     printf("example000_emulator: cannot register syscalls\n");
     goto error;
@@ -156,59 +118,16 @@ int main(int argc, char **argv, char **envp)
   }
 
   /* Cleanup */
+  uzl_trace_free(trace);
+  uzl_sys_free(sys);
   pzl_free(pzl_ctx);
-  free(in_data);
-  in_data = NULL;
+  pzl_pool_close(pzl_pool);
   return true;
 
   error:
+    uzl_trace_free(trace);
+    uzl_sys_free(sys);
     pzl_free(pzl_ctx);
-    free(in_data);
-    in_data = NULL;
+    pzl_pool_close(pzl_pool);
     return false;
 }
-
-/* Tracing hook */
-#if defined __WITH_TRACE__
-
-/* Initialise capstone */
-bool init_capstone(pzl_ctx_t *pzl_ctx)
-{
-  uint8_t arch, mode;
-  uzl_get_cs_arch(pzl_ctx, &arch);
-  uzl_get_cs_mode(pzl_ctx, &mode);
-  if(cs_open(arch, mode, &handle) != CS_ERR_OK)
-    {
-      printf("init_capstone: cannot initialise capstone\n");
-      return false;
-    }
-
-    return true;
-}
-
-/* Capstone globals */
-void example000_emulator_hook_code(uc_engine *uc, uint64_t address,
-                                   uint32_t size, void *usr_data)
-{
-  uint64_t count;
-  uint8_t *data = (void *) malloc(size);
-
-  /* Read instruction memory */
-  if(uc_mem_read(uc, address, data, size))
-  {
-    printf("example000_emulator_hook_code: cannot read instruction\n");
-    return;
-  }
-  /* Disassemble */
-  count = cs_disasm(handle, data, size, address, 0, &insn);
-  if(count > 0)
-  {
-    for(int i = 0; i < count; i ++)
-    {
-      printf("%p: %s %s\n", (void *) address, insn[i].mnemonic,
-             insn[i].op_str);
-    }
-  }
-  free(data);
-}
-#endif
@@ -3,21 +3,11 @@
 #include <unistd.h>
 #include <stdlib.h>
 #include <stdbool.h>
-#include <sys/stat.h>
-#include <sys/types.h>
 #include <puzzle.h>
 #include <uuzzle.h>
 #include <unicorn.h>
-#include <examples.h>
-#include <capstone.h>
 
 
-#if defined __WITH_TRACE__
-/* Capston globals */
-csh handle;
-cs_insn *insn;
-#endif
-
 /* Entry point */
 int main(int argc, char **argv, char **envp)
 {
@@ -30,54 +20,6 @@ int main(int argc, char **argv, char **envp)
     return false;
   }
 
-  /* Locals */
-  struct stat statbuf;
-  int32_t ret;
-
-  /* Stat */
-  ret = stat(opts.uzl_file_name, &statbuf);
-  if(ret != 0 || S_ISDIR(statbuf.st_mode))
-  {
-      printf("example001_emulator: cannot read file '%s'\n",
-             opts.uzl_file_name);
-      return false;
-  }
-  const uint8_t *file_path = (uint8_t *) opts.uzl_file_name;
-  uint64_t file_size = statbuf.st_size;
-  if(file_size < 1)
-  {
-      printf("example001_emulator: cannot read empty file '%s\n'", file_path);
-      return false;
-  }
-
-  /* Allocate data buffer */
-  uint8_t *in_data = (uint8_t *) malloc(file_size);
-
-  /* Read data */
-  FILE *in_file;
-  in_file = fopen((const char *) file_path, "r");
-  if(in_file == NULL)
-  {
-      printf("example001_emulator: cannot read file '%s'\n", file_path);
-      free(in_data);
-      in_data = NULL;
-      return false;
-  }
-
-  /* Read data bytes */
-  uint64_t bytes_read = fread(in_data, 1, file_size, in_file);
-  if(bytes_read != file_size || bytes_read <= 0)
-  {
-      printf("example001_emulator: cannot read file correctly\n");
-      free(in_data);
-      in_data = NULL;
-      fclose(in_file);
-      return false;
-  }
-
-  /* Clean up */
-  fclose(in_file);
-
   /* Initialise puzzle */
   pzl_ctx_t *pzl_ctx;
   pzl_init(&pzl_ctx, UNKN_ARCH);
@@ -87,8 +29,32 @@ int main(int argc, char **argv, char **envp)
     return false;
   }
 
-  /* Unpack fuzzle file */
-  if(pzl_unpack(pzl_ctx, in_data, bytes_read) == false)
+  /* Emulator locals */
+  pzl_pool_t *pzl_pool = NULL;
+  uzl_trace_t *trace = NULL;
+  uzl_watch_t *watch = NULL;
+  uzl_sum_t *sum = NULL;
+  uzl_taint_t *taint = NULL;
+  uzl_sys_t *sys = NULL;
+
+  /* Attach page pool shared by pooled snapshots */
+  if(opts.pool_file_name != NULL)
+  {
+    if(!pzl_pool_open(&pzl_pool, opts.pool_file_name, false))
+    {
+      printf("example001_emulator: cannot open page pool\n");
+      goto error;
+    }
+    pzl_set_pool(pzl_ctx, pzl_pool);
+  }
+
+  /* Local copies of the files behind file memory records */
+  pzl_set_root(pzl_ctx, opts.root_dir_name);
+  pzl_set_verify(pzl_ctx, opts.verify);
+
+  /* Map fuzzle file, lazily chunked records inflate on first touch */
+  if((opts.lazy ? pzl_open_lazy(pzl_ctx, opts.uzl_file_name) :
+                  pzl_open_mmap(pzl_ctx, opts.uzl_file_name)) == false)
   {
     printf("example001_emulator: cannot unpack data\n");
     goto error;
@@ -99,7 +65,7 @@ int main(int argc, char **argv, char **envp)
   uc_err err;
 
   /* Initialise unicorn */
-  uint8_t arch, mode;
+  uint32_t arch, mode;
   uzl_get_uc_arch(pzl_ctx, &arch);
   uzl_get_uc_mode(pzl_ctx, &mode);
   err = uc_open(arch, mode, &uc);
@@ -110,7 +76,9 @@ int main(int argc, char **argv, char **envp)
   }
 
   /* Map memory */
-  if(!uzl_map_memory(pzl_ctx, uc, &opts))
+  uc_hook mem_hook;
+  if(!(opts.lazy ? uzl_map_memory_lazy(pzl_ctx, uc, &mem_hook, &opts) :
+                   uzl_map_memory(pzl_ctx, uc, &opts)))
   {
     printf("example001_emulator: cannot map memory regions\n");
     goto error;
@@ -123,43 +91,61 @@ int main(int argc, char **argv, char **envp)
     goto error;
   }
 
-  /* Get user registers */
-  usr_regs_x86_64_t *usr_regs = NULL;
-  if(!uzl_get_usr_regs(pzl_ctx, (void **) &usr_regs, &opts))
+  /* Get call arguments and program counter */
+  uint64_t args[UZL_ARCH_ARGS], pc;
+  if(!uzl_get_args(pzl_ctx, args) || !uzl_get_pc(pzl_ctx, &pc))
   {
       printf("example001_emulator: cannot get user registers\n");
       goto error;
   }
 
   /* Debug */
-  printf("buf: %p\n", (void *) usr_regs->rsi);
-  printf("sze: %p\n", (void *) usr_regs->rdx);
-  printf("rip: %p\n", (void *) usr_regs->rip);
+  printf("buf: %p\n", (void *) args[1]);
+  printf("sze: %p\n", (void *) args[2]);
+  printf("pc:  %p\n", (void *) pc);
 
 
 #if defined __WITH_TRACE__
 
-  /* Initialise capstone */
-  if(!init_capstone(pzl_ctx))
+  /* Trace executed instructions */
+  if(!uzl_trace_init(&trace, pzl_ctx, uc, &opts))
+  {
+    printf("example001_emulator: cannot initialise trace\n");
     goto error;
-
-  /* Register trace hook */
-  uc_hook trace_hook;
-  uc_hook_add(uc, &trace_hook, UC_HOOK_CODE, example000_emulator_hook_code,
-              NULL, 1, 0);
+  }
 #endif
 
   /* Register syscalls */
-  uc_hook sys_hook;
-  if(!uzl_reg_sys(pzl_ctx, uc, &sys_hook, &opts))
+  if(!uzl_reg_sys(pzl_ctx, uc, &sys, &opts))
   {
     printf("example001_emulator: cannot register syscalls\n");
     goto error;
   }
 
+  /* Bound the run by --timeout and --budget */
+  if(!uzl_watch_init(&watch, uc, &opts))
+  {
+    printf("example001_emulator: cannot initialise watchdog\n");
+    goto error;
+  }
+
+  /* Track the snapshot's buffer with --taint */
+  if(!uzl_taint_init(&taint, pzl_ctx, uc, sys, &opts) ||
+     !uzl_taint_input(taint, args[1], 0, args[2]))
+  {
+    printf("example001_emulator: cannot initialise taint tracking\n");
+    goto error;
+  }
+
+  /* Run libc routines natively with --summaries */
+  if(!uzl_sum_init(&sum, pzl_ctx, uc, NULL, &opts))
+  {
+    printf("example001_emulator: cannot initialise summaries\n");
+    goto error;
+  }
+
   /* Emulate */
-  uint64_t pc;
-  uzl_get_pc(pzl_ctx, &pc);
+  uzl_watch_reset(watch);
   err = uc_emu_start(uc, pc, 0, 0, 0);
   if(err != UC_ERR_OK)
   {
@@ -167,65 +153,28 @@ int main(int argc, char **argv, char **envp)
            uc_strerror(err));
     goto error;
   }
+  if(watch->hung)
+    printf("example001_emulator: hang at %p after %lu blocks\n",
+           (void *) watch->hang_pc, watch->blocks);
+  uzl_taint_report(taint);
 
   /* Cleanup */
+  uzl_sum_free(sum);
+  uzl_taint_free(taint);
+  uzl_watch_free(watch);
+  uzl_trace_free(trace);
+  uzl_sys_free(sys);
   pzl_free(pzl_ctx);
-  free(in_data);
-  in_data = NULL;
+  pzl_pool_close(pzl_pool);
   return true;
 
   error:
+    uzl_sum_free(sum);
+    uzl_taint_free(taint);
+    uzl_watch_free(watch);
+    uzl_trace_free(trace);
+    uzl_sys_free(sys);
     pzl_free(pzl_ctx);
-    free(in_data);
-    in_data = NULL;
-    return false;
-}
-
-/* Tracing hook */
-#if defined __WITH_TRACE__
-
-/* Initialise capstone */
-bool init_capstone(pzl_ctx_t *pzl_ctx)
-{
-  uint8_t arch, mode;
-  uzl_get_cs_arch(pzl_ctx, &arch);
-  uzl_get_cs_mode(pzl_ctx, &mode);
-  if(cs_open(arch, mode, &handle) != CS_ERR_OK)
-  {
-    printf("init_capstone: cannot initialise capstone\n");
+    pzl_pool_close(pzl_pool);
     return false;
-  }
-
-  return true;
 }
-
-/* Capstone globals */
-void example000_emulator_hook_code(uc_engine *uc,
-                                          uint64_t address,
-                                          uint32_t size,
-                                          void *usr_data)
-{
-  uint64_t count;
-  uint8_t *data = (void *) malloc(size);
-
-  /* Read instruction memory */
-  if(uc_mem_read(uc, address, data, size))
-  {
-    printf("example000_emulator_hook_code: cannot read instruction\n");
-    return;
-  }
-  /* Disassemble */
-  count = cs_disasm(handle, data, size, address, 0, &insn);
-  if(count > 0)
-  {
-    for(int i = 0; i < count; i ++)
-    {
-      printf("%p: %s %s\n",
-             (void *) address,
-             insn[i].mnemonic,
-             insn[i].op_str);
-    }
-  }
-  free(data);
-}
-#endif
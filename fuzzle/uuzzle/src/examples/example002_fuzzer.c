@@ -0,0 +1,318 @@
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <stdbool.h>
+#include <puzzle.h>
+#include <uuzzle.h>
+#include <unicorn.h>
+
+
+/*
+Persistent fuzzer for snapshots taken on return from a read, with the
+buffer and its size as the second and third call arguments. Every file in
+the input directory is written to the buffer and run to the end address,
+then the snapshot is restored for the next.
+
+With --fork_server the test case is read from stdin instead and every run
+happens in a fresh fork of the mapped snapshot, crashes abort the child.
+
+With --input_fd the test case is not written to the buffer, it is served
+by the syscall layer to reads of that descriptor and of connections
+accepted on it. Runs then also end when the target exits or waits for
+another connection.
+
+Runs exceeding --timeout milliseconds or --budget basic blocks are
+stopped and counted as hangs, with the address they looped at.
+*/
+int main(int argc, char **argv, char **envp)
+{
+
+  /* Parse args */
+  uzl_opts_t opts;
+  if(!uzl_parse_opts(argc, argv, &opts))
+  {
+    printf("example002_fuzzer: cannot parse arguments\n");
+    return false;
+  }
+  if((opts.input_dir_name == NULL && !opts.fork_server) ||
+     (opts.end_addr == 0 && opts.input_fd < 0))
+  {
+    printf("example002_fuzzer: needs --inputs or --fork_server and --end or "
+           "--input_fd\n");
+    return false;
+  }
+
+  /* Initialise puzzle */
+  pzl_ctx_t *pzl_ctx;
+  pzl_init(&pzl_ctx, UNKN_ARCH);
+  if(pzl_ctx == false)
+  {
+    printf("example002_fuzzer: initialise pzl_ctx\n");
+    return false;
+  }
+
+  /* Fuzzer locals */
+  pzl_pool_t *pzl_pool = NULL;
+  uzl_snap_t *snap = NULL;
+  uzl_cov_t *cov = NULL;
+  uzl_watch_t *watch = NULL;
+  uzl_cmp_t *cmp = NULL;
+  uzl_sum_t *sum = NULL;
+  uzl_sys_t *sys = NULL;
+  uint8_t *input = NULL;
+  DIR *input_dir = NULL;
+
+  /* Attach page pool shared by pooled snapshots */
+  if(opts.pool_file_name != NULL)
+  {
+    if(!pzl_pool_open(&pzl_pool, opts.pool_file_name, false))
+    {
+      printf("example002_fuzzer: cannot open page pool\n");
+      goto error;
+    }
+    pzl_set_pool(pzl_ctx, pzl_pool);
+  }
+
+  /* Local copies of the files behind file memory records */
+  pzl_set_root(pzl_ctx, opts.root_dir_name);
+  pzl_set_verify(pzl_ctx, opts.verify);
+
+  /* Map fuzzle file, lazily chunked records inflate on first touch */
+  if((opts.lazy ? pzl_open_lazy(pzl_ctx, opts.uzl_file_name) :
+                  pzl_open_mmap(pzl_ctx, opts.uzl_file_name)) == false)
+  {
+    printf("example002_fuzzer: cannot unpack data\n");
+    goto error;
+  }
+
+  /* Unicorn locals */
+  uc_engine *uc;
+  uc_err err;
+
+  /* Initialise unicorn */
+  uint32_t arch, mode;
+  uzl_get_uc_arch(pzl_ctx, &arch);
+  uzl_get_uc_mode(pzl_ctx, &mode);
+  err = uc_open(arch, mode, &uc);
+  if(err != UC_ERR_OK)
+  {
+    printf("example002_fuzzer: cannot initialise unicorn engine\n");
+    goto error;
+  }
+
+  /* Map memory */
+  uc_hook mem_hook;
+  if(!(opts.lazy ? uzl_map_memory_lazy(pzl_ctx, uc, &mem_hook, &opts) :
+                   uzl_map_memory(pzl_ctx, uc, &opts)))
+  {
+    printf("example002_fuzzer: cannot map memory regions\n");
+    goto error;
+  }
+
+  /* Map registers */
+  if(!uzl_set_registers(pzl_ctx, uc, &opts))
+  {
+    printf("example002_fuzzer: cannot map registers\n");
+    goto error;
+  }
+
+  /* Register syscalls */
+  if(!uzl_reg_sys(pzl_ctx, uc, &sys, &opts))
+  {
+    printf("example002_fuzzer: cannot register syscalls\n");
+    goto error;
+  }
+
+  /* Read buffer, its size and the program counter of the snapshot */
+  const uzl_arch_t *uzl_arch = uzl_get_arch(pzl_ctx);
+  uint64_t args[UZL_ARCH_ARGS], pc;
+  if(uzl_arch == NULL || !uzl_arch->get_args(pzl_ctx, args) ||
+     !uzl_arch->get_pc(pzl_ctx, &pc))
+  {
+    printf("example002_fuzzer: cannot get user registers\n");
+    goto error;
+  }
+
+  /* Input buffer */
+  uint64_t input_max = opts.input_fd < 0 ? args[2] : UZL_SYS_INPUT_MAX;
+  input = malloc(input_max ? input_max : 1);
+  if(input == NULL)
+  {
+    printf("example002_fuzzer: cannot allocate input\n");
+    goto error;
+  }
+
+  /* Edge coverage, hooks are inherited by forks */
+  if(!uzl_cov_init(&cov, pzl_ctx, uc, &opts))
+  {
+    printf("example002_fuzzer: cannot initialise coverage\n");
+    goto error;
+  }
+
+  /* Stop runs over --timeout or --budget, hooks are inherited by forks */
+  if(!uzl_watch_init(&watch, uc, &opts))
+  {
+    printf("example002_fuzzer: cannot initialise watchdog\n");
+    goto error;
+  }
+
+  /* Log comparisons with --cmplog, before summaries take over routines */
+  if(!uzl_cmp_init(&cmp, pzl_ctx, uc, &opts))
+  {
+    printf("example002_fuzzer: cannot initialise comparison log\n");
+    goto error;
+  }
+
+  /* Run libc routines natively with --summaries, forks need no snapshot */
+  if(!uzl_sum_init(&sum, pzl_ctx, uc, NULL, &opts))
+  {
+    printf("example002_fuzzer: cannot initialise summaries\n");
+    goto error;
+  }
+
+  /* Each run gets its own copy of the snapshot */
+  if(opts.fork_server)
+  {
+    if(!uzl_fork_server(&opts))
+      goto error;
+
+    /* Read test case */
+    lseek(STDIN_FILENO, 0, SEEK_SET);
+    ssize_t len = read(STDIN_FILENO, input, input_max);
+    uint64_t ret = len < 0 ? 0 : len;
+    if(opts.input_fd >= 0)
+      uzl_sys_set_input(sys, input, ret);
+    else
+    {
+      if(uc_mem_write(uc, args[1], input, ret) != UC_ERR_OK)
+        goto error;
+      uzl_arch->set_ret(uc, ret);
+    }
+
+    /* Crashes are reported to the fork server as signals */
+    uzl_watch_reset(watch);
+    err = uc_emu_start(uc, pc, opts.end_addr, 0, 0);
+    if(err != UC_ERR_OK)
+    {
+      printf("example002_fuzzer: crashed '%s'\n", uc_strerror(err));
+      abort();
+    }
+    if(watch->hung)
+      printf("example002_fuzzer: hang at %p\n", (void *) watch->hang_pc);
+    uzl_sum_free(sum);
+    uzl_cmp_free(cmp);
+    uzl_watch_free(watch);
+    uzl_cov_free(cov);
+    uzl_sys_free(sys);
+    free(input);
+    pzl_free(pzl_ctx);
+    pzl_pool_close(pzl_pool);
+    return true;
+  }
+
+  /* Snapshot after the registers are set */
+  if(!uzl_snap_init(&snap, pzl_ctx, uc, &opts))
+  {
+    printf("example002_fuzzer: cannot snapshot emulator\n");
+    goto error;
+  }
+  uzl_sys_save(sys);
+
+  /* Summaries and syscalls save pages before writing guest memory */
+  sum->snap = snap;
+  sys->snap = snap;
+
+  /* Inputs */
+  input_dir = opendir(opts.input_dir_name);
+  if(input_dir == NULL)
+  {
+    printf("example002_fuzzer: cannot open inputs\n");
+    goto error;
+  }
+
+  /* Fuzz */
+  uint64_t execs = 0, crashes = 0, hangs = 0;
+  struct dirent *ent;
+  while((ent = readdir(input_dir)) != NULL)
+  {
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/%s", opts.input_dir_name, ent->d_name);
+    if(ent->d_name[0] == '.')
+      continue;
+
+    /* Read test case */
+    int fd = open(path, O_RDONLY);
+    if(fd < 0)
+      continue;
+    ssize_t len = read(fd, input, input_max);
+    close(fd);
+    if(len < 0)
+      continue;
+
+    /* Deliver through the syscall layer or as the result of the read */
+    uint64_t ret = len;
+    if(opts.input_fd >= 0)
+      uzl_sys_set_input(sys, input, len);
+    else
+    {
+      if(!uzl_snap_write(snap, args[1], input, len))
+        goto error;
+      uzl_arch->set_ret(uc, ret);
+    }
+
+    /* Run to end address */
+    uzl_cov_reset(cov);
+    uzl_cmp_reset(cmp);
+    uzl_watch_reset(watch);
+    err = uc_emu_start(uc, pc, opts.end_addr, 0, 0);
+    if(err != UC_ERR_OK)
+    {
+      printf("example002_fuzzer: %s crashed '%s'\n", path, uc_strerror(err));
+      crashes++;
+    }
+    else if(watch->hung)
+    {
+      printf("example002_fuzzer: %s hung at %p\n", path,
+             (void *) watch->hang_pc);
+      hangs++;
+    }
+    execs++;
+
+    /* Reset for the next input */
+    if(!uzl_snap_restore(snap) || !uzl_sys_restore(sys) ||
+       !uzl_sum_reset(sum))
+      goto error;
+  }
+  printf("example002_fuzzer: %lu execs, %lu crashes, %lu hangs, %lu edges\n",
+         execs, crashes, hangs, uzl_cov_count(cov));
+
+  /* Cleanup */
+  closedir(input_dir);
+  free(input);
+  uzl_sum_free(sum);
+  uzl_cmp_free(cmp);
+  uzl_watch_free(watch);
+  uzl_cov_free(cov);
+  uzl_sys_free(sys);
+  uzl_snap_free(snap);
+  pzl_free(pzl_ctx);
+  pzl_pool_close(pzl_pool);
+  return true;
+
+  error:
+    if(input_dir != NULL)
+      closedir(input_dir);
+    free(input);
+    uzl_sum_free(sum);
+    uzl_cmp_free(cmp);
+    uzl_watch_free(watch);
+    uzl_cov_free(cov);
+    uzl_sys_free(sys);
+    uzl_snap_free(snap);
+    pzl_free(pzl_ctx);
+    pzl_pool_close(pzl_pool);
+    return false;
+}
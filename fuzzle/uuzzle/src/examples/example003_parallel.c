@@ -0,0 +1,384 @@
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <stdbool.h>
+#include <puzzle.h>
+#include <uuzzle.h>
+#include <unicorn.h>
+
+
+/* Consecutive runs spent solving comparisons of one test case */
+#define EXAMPLE003_SOLVES 8
+
+/* Byte values that tend to hit boundaries */
+static const uint8_t interesting[] = { 0x00, 0x01, 0x10, 0x20, 0x40, 0x7f,
+                                       0x80, 0xff };
+
+/* Apply a few random byte level mutations in place */
+static uint64_t example003_mutate(uzl_par_t *par, uint8_t *dat, uint64_t len,
+                                  uint64_t max)
+{
+  uint64_t ops = 1 + uzl_par_rand(par) % 8;
+  while(ops--)
+  {
+    uint64_t rnd = uzl_par_rand(par);
+    uint64_t pos = len ? (rnd >> 8) % len : 0;
+    switch(rnd % 6)
+    {
+      case 0:
+        if(len)
+          dat[pos] ^= 1 << ((rnd >> 4) % 8);
+        break;
+      case 1:
+        if(len)
+          dat[pos] = rnd >> 16;
+        break;
+      case 2:
+        if(len)
+          dat[pos] = interesting[(rnd >> 4) % sizeof(interesting)];
+        break;
+      case 3:
+        if(len)
+          dat[pos] += 1 + (rnd >> 4) % 16;
+        break;
+      case 4:
+        if(len < max)
+          dat[len++] = rnd >> 16;
+        break;
+      case 5:
+        if(len > 1)
+          len = 1 + pos;
+        break;
+    }
+  }
+  return len;
+}
+
+/*
+Parallel fuzzer for the same snapshots as example002. The snapshot is
+loaded once, then --jobs workers, one per core by default, are forked
+each with its own engine over copy-on-write records. Workers mutate test
+cases from a shared queue seeded with --inputs, queue those reaching new
+edges of the merged coverage and write crashes and runs over --timeout or
+--budget to --output. With --cmplog a test case reaching new edges is run
+again with its comparisons logged and the operands are patched into it
+for the next few runs, other runs are not logged. Each worker stops after
+--execs runs, otherwise they run until interrupted.
+*/
+int main(int argc, char **argv, char **envp)
+{
+
+  /* Parse args */
+  uzl_opts_t opts;
+  if(!uzl_parse_opts(argc, argv, &opts))
+  {
+    printf("example003_parallel: cannot parse arguments\n");
+    return false;
+  }
+  if(opts.input_dir_name == NULL ||
+     (opts.end_addr == 0 && opts.input_fd < 0))
+  {
+    printf("example003_parallel: needs --inputs and --end or --input_fd\n");
+    return false;
+  }
+
+  /* Initialise puzzle */
+  pzl_ctx_t *pzl_ctx;
+  pzl_init(&pzl_ctx, UNKN_ARCH);
+  if(pzl_ctx == false)
+  {
+    printf("example003_parallel: initialise pzl_ctx\n");
+    return false;
+  }
+
+  /* Fuzzer locals */
+  pzl_pool_t *pzl_pool = NULL;
+  uzl_par_t *par = NULL;
+  uzl_snap_t *snap = NULL;
+  uzl_cov_t *cov = NULL;
+  uzl_watch_t *watch = NULL;
+  uzl_cmp_t *cmp = NULL;
+  uzl_sum_t *sum = NULL;
+  uzl_sys_t *sys = NULL;
+  uint8_t *input = NULL;
+  DIR *input_dir = NULL;
+
+  /* Attach page pool shared by pooled snapshots */
+  if(opts.pool_file_name != NULL)
+  {
+    if(!pzl_pool_open(&pzl_pool, opts.pool_file_name, false))
+    {
+      printf("example003_parallel: cannot open page pool\n");
+      goto error;
+    }
+    pzl_set_pool(pzl_ctx, pzl_pool);
+  }
+
+  /* Local copies of the files behind file memory records */
+  pzl_set_root(pzl_ctx, opts.root_dir_name);
+  pzl_set_verify(pzl_ctx, opts.verify);
+
+  /* Map fuzzle file once, workers share its pages until they write */
+  if((opts.lazy ? pzl_open_lazy(pzl_ctx, opts.uzl_file_name) :
+                  pzl_open_mmap(pzl_ctx, opts.uzl_file_name)) == false)
+  {
+    printf("example003_parallel: cannot unpack data\n");
+    goto error;
+  }
+
+  /* Read buffer, its size and the program counter of the snapshot */
+  const uzl_arch_t *uzl_arch = uzl_get_arch(pzl_ctx);
+  uint64_t args[UZL_ARCH_ARGS], pc;
+  if(uzl_arch == NULL || !uzl_arch->get_args(pzl_ctx, args) ||
+     !uzl_arch->get_pc(pzl_ctx, &pc))
+  {
+    printf("example003_parallel: cannot get user registers\n");
+    goto error;
+  }
+
+  /* Input buffer */
+  uint64_t input_max = UZL_SYS_INPUT_MAX;
+  if(opts.input_fd < 0 && args[2] < input_max)
+    input_max = args[2];
+  input = malloc(input_max ? input_max : 1);
+  if(input == NULL)
+  {
+    printf("example003_parallel: cannot allocate input\n");
+    goto error;
+  }
+
+  /* Shared queue and coverage */
+  if(!uzl_par_init(&par, &opts))
+  {
+    printf("example003_parallel: cannot initialise parallel driver\n");
+    goto error;
+  }
+
+  /* Seed queue */
+  input_dir = opendir(opts.input_dir_name);
+  if(input_dir == NULL)
+  {
+    printf("example003_parallel: cannot open inputs\n");
+    goto error;
+  }
+  struct dirent *ent;
+  while((ent = readdir(input_dir)) != NULL)
+  {
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/%s", opts.input_dir_name, ent->d_name);
+    if(ent->d_name[0] == '.')
+      continue;
+
+    int fd = open(path, O_RDONLY);
+    if(fd < 0)
+      continue;
+    ssize_t len = read(fd, input, input_max);
+    close(fd);
+    if(len >= 0)
+      uzl_par_add(par, input, len);
+  }
+  closedir(input_dir);
+  input_dir = NULL;
+  if(par->shm->queue_cnt == 0)
+    uzl_par_add(par, input, 0);
+
+  /* Workers return here, the driver once they are all done */
+  if(!uzl_par_fork(par, &opts))
+    goto error;
+  if(par->worker == UZL_PAR_PARENT)
+  {
+    free(input);
+    uzl_par_free(par);
+    pzl_free(pzl_ctx);
+    pzl_pool_close(pzl_pool);
+    return true;
+  }
+
+  /* Unicorn locals */
+  uc_engine *uc;
+  uc_err err;
+
+  /* Initialise unicorn */
+  uint32_t arch, mode;
+  uzl_get_uc_arch(pzl_ctx, &arch);
+  uzl_get_uc_mode(pzl_ctx, &mode);
+  err = uc_open(arch, mode, &uc);
+  if(err != UC_ERR_OK)
+  {
+    printf("example003_parallel: cannot initialise unicorn engine\n");
+    goto error;
+  }
+
+  /* Map memory */
+  uc_hook mem_hook;
+  if(!(opts.lazy ? uzl_map_memory_lazy(pzl_ctx, uc, &mem_hook, &opts) :
+                   uzl_map_memory(pzl_ctx, uc, &opts)))
+  {
+    printf("example003_parallel: cannot map memory regions\n");
+    goto error;
+  }
+
+  /* Map registers */
+  if(!uzl_set_registers(pzl_ctx, uc, &opts))
+  {
+    printf("example003_parallel: cannot map registers\n");
+    goto error;
+  }
+
+  /* Register syscalls */
+  if(!uzl_reg_sys(pzl_ctx, uc, &sys, &opts))
+  {
+    printf("example003_parallel: cannot register syscalls\n");
+    goto error;
+  }
+
+  /* Edge coverage, merged into the shared map after every run */
+  if(!uzl_cov_init(&cov, pzl_ctx, uc, &opts))
+  {
+    printf("example003_parallel: cannot initialise coverage\n");
+    goto error;
+  }
+
+  /* Stop runs over --timeout or --budget */
+  if(!uzl_watch_init(&watch, uc, &opts))
+  {
+    printf("example003_parallel: cannot initialise watchdog\n");
+    goto error;
+  }
+
+  /* Snapshot after the registers are set */
+  if(!uzl_snap_init(&snap, pzl_ctx, uc, &opts))
+  {
+    printf("example003_parallel: cannot snapshot emulator\n");
+    goto error;
+  }
+  uzl_sys_save(sys);
+
+  /* Syscalls writing guest memory from the host must save pages first */
+  sys->snap = snap;
+
+  /* Log comparisons with --cmplog, before summaries take over routines */
+  if(!uzl_cmp_init(&cmp, pzl_ctx, uc, &opts))
+  {
+    printf("example003_parallel: cannot initialise comparison log\n");
+    goto error;
+  }
+
+  /* Only runs chasing comparisons are logged */
+  uzl_cmp_disable(cmp);
+
+  /* Run libc routines natively with --summaries */
+  if(!uzl_sum_init(&sum, pzl_ctx, uc, snap, &opts))
+  {
+    printf("example003_parallel: cannot initialise summaries\n");
+    goto error;
+  }
+
+  /* Fuzz */
+  uint64_t execs, crashes = 0, hangs = 0, len = 0, solves = 0;
+  bool chase = false;
+  for(execs = 0; opts.max_execs == 0 || execs < opts.max_execs; execs++)
+  {
+
+    /* New test cases run again logged, then get patched from the log */
+    if(chase)
+    {
+      if(!uzl_cmp_enable(cmp))
+        goto error;
+      chase = false;
+      solves = 0;
+    }
+    else if(cmp->enabled && solves < EXAMPLE003_SOLVES &&
+            uzl_cmp_solve(cmp, input, &len, input_max, uzl_par_rand(par)))
+      solves++;
+    else
+    {
+      uzl_cmp_disable(cmp);
+      if(!uzl_par_pick(par, input, &len))
+        continue;
+      len = example003_mutate(par, input, len, input_max);
+    }
+
+    /* Deliver through the syscall layer or as the result of the read */
+    if(opts.input_fd >= 0)
+      uzl_sys_set_input(sys, input, len);
+    else
+    {
+      if(!uzl_snap_write(snap, args[1], input, len))
+        goto error;
+      uzl_arch->set_ret(uc, len);
+    }
+
+    /* Run to end address */
+    uzl_cov_reset(cov);
+    uzl_cmp_reset(cmp);
+    uzl_watch_reset(watch);
+    err = uc_emu_start(uc, pc, opts.end_addr, 0, 0);
+    if(err != UC_ERR_OK || watch->hung)
+    {
+      bool hung = err == UC_ERR_OK;
+      __atomic_fetch_add(hung ? &(par->shm->hangs) : &(par->shm->crashes), 1,
+                         __ATOMIC_RELAXED);
+      if(opts.output_dir_name != NULL)
+      {
+        char path[4096];
+        snprintf(path, sizeof(path), "%s/%s-%u-%lu", opts.output_dir_name,
+                 hung ? "hang" : "crash", par->worker,
+                 hung ? hangs++ : crashes++);
+        int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if(fd >= 0)
+        {
+          if(write(fd, input, len) != len)
+            printf("example003_parallel: cannot save %s\n", path);
+          close(fd);
+        }
+      }
+    }
+    __atomic_fetch_add(&(par->shm->execs), 1, __ATOMIC_RELAXED);
+
+    /* Keep test cases reaching new edges */
+    uint64_t edges = uzl_cov_merge(cov, par->shm->map);
+    if(edges > 0)
+    {
+      __atomic_fetch_add(&(par->shm->edges), edges, __ATOMIC_RELAXED);
+      uzl_par_add(par, input, len);
+      chase = opts.cmplog;
+    }
+
+    /* Reset for the next input */
+    if(!uzl_snap_restore(snap) || !uzl_sys_restore(sys) ||
+       !uzl_sum_reset(sum))
+      goto error;
+  }
+
+  /* Cleanup */
+  free(input);
+  uzl_sum_free(sum);
+  uzl_cmp_free(cmp);
+  uzl_watch_free(watch);
+  uzl_cov_free(cov);
+  uzl_snap_free(snap);
+  uzl_sys_free(sys);
+  uzl_par_free(par);
+  pzl_free(pzl_ctx);
+  pzl_pool_close(pzl_pool);
+  return true;
+
+  error:
+    if(input_dir != NULL)
+      closedir(input_dir);
+    free(input);
+    uzl_sum_free(sum);
+    uzl_cmp_free(cmp);
+    uzl_watch_free(watch);
+    uzl_cov_free(cov);
+    uzl_snap_free(snap);
+    uzl_sys_free(sys);
+    uzl_par_free(par);
+    pzl_free(pzl_ctx);
+    pzl_pool_close(pzl_pool);
+    return false;
+}
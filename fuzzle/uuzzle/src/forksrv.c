@@ -0,0 +1,56 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <uuzzle.h>
+
+
+/* Serve forks over the AFL control and status pipes */
+bool uzl_fork_server(uzl_opts_t *opts)
+{
+  uint32_t msg = 0;
+  int32_t status;
+  pid_t pid;
+
+  /* Nobody listening, run the single test case in this process */
+  if(write(UZL_FORKSRV_FD + 1, &msg, sizeof(msg)) != sizeof(msg))
+  {
+    if(opts->verbose)
+      printf("uzl_fork_server: no fork server pipes, running once\n");
+    return true;
+  }
+
+  while(true)
+  {
+    /* Wait for the next test case */
+    if(read(UZL_FORKSRV_FD, &msg, sizeof(msg)) != sizeof(msg))
+      _exit(0);
+
+    pid = fork();
+    if(pid < 0)
+    {
+      printf("uzl_fork_server: cannot fork\n");
+      _exit(1);
+    }
+
+    /* Child runs the test case on a copy-on-write snapshot */
+    if(pid == 0)
+    {
+      close(UZL_FORKSRV_FD);
+      close(UZL_FORKSRV_FD + 1);
+      return true;
+    }
+
+    /* Report pid then status */
+    if(write(UZL_FORKSRV_FD + 1, &pid, sizeof(pid)) != sizeof(pid))
+      _exit(1);
+    if(waitpid(pid, &status, 0) < 0)
+    {
+      printf("uzl_fork_server: cannot wait for %d\n", pid);
+      _exit(1);
+    }
+    if(write(UZL_FORKSRV_FD + 1, &status, sizeof(status)) != sizeof(status))
+      _exit(1);
+  }
+}
@@ -0,0 +1,161 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <uuzzle.h>
+
+
+/* Map the corpus, merged coverage and counters shared with workers */
+bool uzl_par_init(uzl_par_t **par, uzl_opts_t *opts)
+{
+  uzl_par_t *new_par = calloc(1, sizeof(uzl_par_t));
+  if(new_par == NULL)
+  {
+    printf("uzl_par_init: cannot allocate driver\n");
+    return false;
+  }
+  new_par->worker = UZL_PAR_PARENT;
+  new_par->rng = getpid() | 1;
+
+  /* One worker per online core unless told otherwise */
+  new_par->jobs = opts->jobs;
+  if(new_par->jobs == 0)
+  {
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    new_par->jobs = cores > 0 ? cores : 1;
+  }
+
+  new_par->pids = calloc(new_par->jobs, sizeof(pid_t));
+  if(new_par->pids == NULL)
+  {
+    printf("uzl_par_init: cannot allocate workers\n");
+    uzl_par_free(new_par);
+    return false;
+  }
+
+  /* Pages are only backed once the queue reaches them */
+  new_par->shm = mmap(NULL, sizeof(uzl_par_shm_t), PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if(new_par->shm == MAP_FAILED)
+  {
+    printf("uzl_par_init: cannot map shared memory\n");
+    new_par->shm = NULL;
+    uzl_par_free(new_par);
+    return false;
+  }
+
+  *par = new_par;
+  return true;
+}
+
+/* Queue a test case for every worker, false once the queue is full */
+bool uzl_par_add(uzl_par_t *par, uint8_t *dat, uint64_t len)
+{
+  uint64_t idx = __atomic_fetch_add(&(par->shm->queue_cnt), 1,
+                                    __ATOMIC_ACQ_REL);
+  if(idx >= UZL_PAR_QUEUE)
+    return false;
+
+  uzl_par_entry_t *entry = &(par->shm->queue[idx]);
+  entry->len = len < UZL_SYS_INPUT_MAX ? len : UZL_SYS_INPUT_MAX;
+  memcpy(entry->dat, dat, entry->len);
+  __atomic_store_n(&(entry->ready), 1, __ATOMIC_RELEASE);
+  return true;
+}
+
+/* Copy a random queued test case into dat */
+bool uzl_par_pick(uzl_par_t *par, uint8_t *dat, uint64_t *len)
+{
+  uint64_t cnt = __atomic_load_n(&(par->shm->queue_cnt), __ATOMIC_ACQUIRE);
+  if(cnt > UZL_PAR_QUEUE)
+    cnt = UZL_PAR_QUEUE;
+  if(cnt == 0)
+    return false;
+
+  /* Entries still being written are skipped */
+  uzl_par_entry_t *entry = &(par->shm->queue[uzl_par_rand(par) % cnt]);
+  if(!__atomic_load_n(&(entry->ready), __ATOMIC_ACQUIRE))
+    entry = &(par->shm->queue[0]);
+  if(!__atomic_load_n(&(entry->ready), __ATOMIC_ACQUIRE))
+    return false;
+
+  memcpy(dat, entry->dat, entry->len);
+  *len = entry->len;
+  return true;
+}
+
+/* Per worker xorshift generator */
+uint64_t uzl_par_rand(uzl_par_t *par)
+{
+  par->rng ^= par->rng >> 12;
+  par->rng ^= par->rng << 25;
+  par->rng ^= par->rng >> 27;
+  return par->rng * 0x2545f4914f6cdd1d;
+}
+
+/* Fork workers, returns in each worker and in the driver once they exit */
+bool uzl_par_fork(uzl_par_t *par, uzl_opts_t *opts)
+{
+  uint32_t idx, running = 0;
+
+  /* Buffered output would be printed by every worker */
+  fflush(NULL);
+  for(idx = 0; idx < par->jobs; idx++)
+  {
+    pid_t pid = fork();
+    if(pid < 0)
+    {
+      printf("uzl_par_fork: cannot fork worker %u\n", idx);
+      break;
+    }
+
+    /* Worker */
+    if(pid == 0)
+    {
+      par->worker = idx;
+      par->rng = ((uint64_t) getpid() << 32) ^ (idx + 1);
+      return true;
+    }
+    par->pids[idx] = pid;
+    running++;
+  }
+  if(running == 0)
+    return false;
+
+  /* Report until every worker is done */
+  uint64_t last = 0;
+  while(running > 0)
+  {
+    sleep(1);
+    while(waitpid(-1, NULL, WNOHANG) > 0)
+      running--;
+
+    uint64_t execs = __atomic_load_n(&(par->shm->execs), __ATOMIC_RELAXED);
+    if(!opts->quiet)
+      printf("uzl_par_fork: %u workers, %lu execs, %lu/s, %lu crashes, "
+             "%lu hangs, %lu edges, %lu queued\n", running, execs,
+             execs - last,
+             __atomic_load_n(&(par->shm->crashes), __ATOMIC_RELAXED),
+             __atomic_load_n(&(par->shm->hangs), __ATOMIC_RELAXED),
+             __atomic_load_n(&(par->shm->edges), __ATOMIC_RELAXED),
+             __atomic_load_n(&(par->shm->queue_cnt), __ATOMIC_RELAXED));
+    last = execs;
+  }
+  return true;
+}
+
+/* Unmap shared memory */
+bool uzl_par_free(uzl_par_t *par)
+{
+  if(par == NULL)
+    return false;
+
+  if(par->shm != NULL)
+    munmap(par->shm, sizeof(uzl_par_shm_t));
+  free(par->pids);
+  free(par);
+  return true;
+}
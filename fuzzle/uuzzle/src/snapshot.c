@@ -0,0 +1,249 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <puzzle.h>
+#include <uuzzle.h>
+#include <unicorn.h>
+
+
+/* Slot of a dirty page in the table */
+static uint64_t uzl_snap_slot(uzl_snap_t *snap, uint64_t page)
+{
+  uint64_t slot = ((page >> 12) * 0x9e3779b97f4a7c15) & (snap->tbl_cap - 1);
+  while(snap->tbl[slot] != 0 && snap->dirty_addr[snap->tbl[slot] - 1] != page)
+    slot = (slot + 1) & (snap->tbl_cap - 1);
+  return slot;
+}
+
+/* Grow page list and table ahead of another dirty page */
+static bool uzl_snap_grow(uzl_snap_t *snap)
+{
+  uint64_t idx;
+
+  /* Page list and saved contents */
+  if(snap->dirty_cnt == snap->dirty_cap)
+  {
+    uint64_t cap = snap->dirty_cap * 2;
+    uint64_t *addr = realloc(snap->dirty_addr, cap * sizeof(uint64_t));
+    if(addr == NULL)
+      return false;
+    snap->dirty_addr = addr;
+    uint8_t *dat = realloc(snap->dirty_dat, cap * PZL_PAGE_SIZE);
+    if(dat == NULL)
+      return false;
+    snap->dirty_dat = dat;
+    snap->dirty_cap = cap;
+  }
+
+  /* Table stays at most half full */
+  if((snap->dirty_cnt + 1) * 2 > snap->tbl_cap)
+  {
+    uint64_t *tbl = calloc(snap->tbl_cap * 2, sizeof(uint64_t));
+    if(tbl == NULL)
+      return false;
+    free(snap->tbl);
+    snap->tbl = tbl;
+    snap->tbl_cap *= 2;
+    for(idx = 0; idx < snap->dirty_cnt; idx++)
+      snap->tbl[uzl_snap_slot(snap, snap->dirty_addr[idx])] = idx + 1;
+  }
+  return true;
+}
+
+/* Save a page before its first write of the iteration */
+static bool uzl_snap_dirty(uzl_snap_t *snap, uint64_t page)
+{
+  uint64_t slot = uzl_snap_slot(snap, page);
+  if(snap->tbl[slot] != 0)
+    return true;
+
+  if(!uzl_snap_grow(snap))
+  {
+    printf("uzl_snap_dirty: cannot track page %p\n", (void *) page);
+    return false;
+  }
+  slot = uzl_snap_slot(snap, page);
+  uint8_t *dst = snap->dirty_dat + snap->dirty_cnt * PZL_PAGE_SIZE;
+
+  /* Snapshot pages are still pristine in their record */
+  mem_rec_t *mem_rec = pzl_find_mem_rec(snap->pzl_ctx, page);
+  if(mem_rec != NULL)
+  {
+    uint64_t off = page - mem_rec->start;
+    if(mem_rec->chk_off != NULL &&
+       !pzl_load_mem_chk(snap->pzl_ctx, mem_rec,
+                         off / snap->pzl_ctx->hdr_rec.chk_size))
+      return false;
+    memcpy(dst, mem_rec->dat + off, PZL_PAGE_LEN(mem_rec->size, off / PZL_PAGE_SIZE));
+  }
+
+  /* Pages mapped outside the snapshot, writes to unmapped pages fault */
+  else if(uc_mem_read(snap->uc, page, dst, PZL_PAGE_SIZE) != UC_ERR_OK)
+    return true;
+
+  snap->dirty_addr[snap->dirty_cnt] = page;
+  snap->tbl[slot] = ++snap->dirty_cnt;
+  return true;
+}
+
+/* Memory write callback */
+static void uzl_snap_hook_write(uc_engine *uc, uc_mem_type type,
+                                uint64_t address, int size, int64_t value,
+                                void *user_data)
+{
+  uzl_snap_t *snap = (uzl_snap_t *) user_data;
+  uint64_t page = address & ~((uint64_t) PZL_PAGE_SIZE - 1);
+  uint64_t last = (address + size - 1) & ~((uint64_t) PZL_PAGE_SIZE - 1);
+
+  /* Unsaved pages could not be put back, stop before they are written */
+  for(; page <= last; page += PZL_PAGE_SIZE)
+  {
+    if(!uzl_snap_dirty(snap, page))
+    {
+      printf("uzl_snap_hook_write: stopping at %p\n", (void *) address);
+      snap->failed = true;
+      uc_emu_stop(uc);
+      return;
+    }
+  }
+}
+
+/* Snapshot registers and start tracking written pages */
+bool uzl_snap_init(uzl_snap_t **snap, pzl_ctx_t *pzl_ctx, uc_engine *uc,
+                   uzl_opts_t *opts)
+{
+  uzl_snap_t *new_snap = calloc(1, sizeof(uzl_snap_t));
+  if(new_snap == NULL)
+  {
+    printf("uzl_snap_init: cannot allocate snapshot\n");
+    return false;
+  }
+  new_snap->pzl_ctx = pzl_ctx;
+  new_snap->uc = uc;
+
+  /* Dirty page list and table */
+  new_snap->dirty_cap = UZL_SNAP_PAGES;
+  new_snap->tbl_cap = UZL_SNAP_PAGES * 2;
+  new_snap->dirty_addr = malloc(new_snap->dirty_cap * sizeof(uint64_t));
+  new_snap->dirty_dat = malloc(new_snap->dirty_cap * PZL_PAGE_SIZE);
+  new_snap->tbl = calloc(new_snap->tbl_cap, sizeof(uint64_t));
+  if(new_snap->dirty_addr == NULL || new_snap->dirty_dat == NULL ||
+     new_snap->tbl == NULL)
+  {
+    printf("uzl_snap_init: cannot allocate dirty pages\n");
+    uzl_snap_free(new_snap);
+    return false;
+  }
+
+  /* Registers */
+  if(uc_context_alloc(uc, &(new_snap->uc_ctx)) != UC_ERR_OK ||
+     uc_context_save(uc, new_snap->uc_ctx) != UC_ERR_OK)
+  {
+    printf("uzl_snap_init: cannot save registers\n");
+    uzl_snap_free(new_snap);
+    return false;
+  }
+
+  /* Track writes */
+  if(uc_hook_add(uc, &(new_snap->write_hook), UC_HOOK_MEM_WRITE,
+                 uzl_snap_hook_write, new_snap, 1, 0) != UC_ERR_OK)
+  {
+    printf("uzl_snap_init: cannot register write hook\n");
+    uzl_snap_free(new_snap);
+    return false;
+  }
+  new_snap->hooked = true;
+
+  *snap = new_snap;
+  return true;
+}
+
+/* Save pages the host is about to write, its writes bypass the hook */
+bool uzl_snap_touch(uzl_snap_t *snap, uint64_t addr, uint64_t len)
+{
+  if(len == 0)
+    return true;
+
+  uint64_t page = addr & ~((uint64_t) PZL_PAGE_SIZE - 1);
+  uint64_t last = (addr + len - 1) & ~((uint64_t) PZL_PAGE_SIZE - 1);
+  for(; page <= last; page += PZL_PAGE_SIZE)
+  {
+    if(!uzl_snap_dirty(snap, page))
+      return false;
+  }
+  return true;
+}
+
+/* Write emulator memory from the host as part of the iteration */
+bool uzl_snap_write(uzl_snap_t *snap, uint64_t addr, void *dat, uint64_t len)
+{
+  if(len == 0)
+    return true;
+
+  if(!uzl_snap_touch(snap, addr, len))
+    return false;
+  if(uc_mem_write(snap->uc, addr, dat, len) != UC_ERR_OK)
+  {
+    printf("uzl_snap_write: cannot write %p\n", (void *) addr);
+    return false;
+  }
+  return true;
+}
+
+/* Put dirty pages and registers back */
+bool uzl_snap_restore(uzl_snap_t *snap)
+{
+  if(snap->failed)
+  {
+    printf("uzl_snap_restore: pages written in the iteration were not saved\n");
+    return false;
+  }
+
+  uint64_t idx;
+  for(idx = 0; idx < snap->dirty_cnt; idx++)
+  {
+    uint64_t page = snap->dirty_addr[idx];
+    uint8_t *src = snap->dirty_dat + idx * PZL_PAGE_SIZE;
+
+    /* Snapshot pages are mapped from their record */
+    mem_rec_t *mem_rec = pzl_find_mem_rec(snap->pzl_ctx, page);
+    if(mem_rec != NULL)
+    {
+      uint64_t off = page - mem_rec->start;
+      memcpy(mem_rec->dat + off, src,
+             PZL_PAGE_LEN(mem_rec->size, off / PZL_PAGE_SIZE));
+    }
+    else if(uc_mem_write(snap->uc, page, src, PZL_PAGE_SIZE) != UC_ERR_OK)
+    {
+      printf("uzl_snap_restore: cannot restore %p\n", (void *) page);
+      return false;
+    }
+  }
+  memset(snap->tbl, 0, snap->tbl_cap * sizeof(uint64_t));
+  snap->dirty_cnt = 0;
+
+  if(uc_context_restore(snap->uc, snap->uc_ctx) != UC_ERR_OK)
+  {
+    printf("uzl_snap_restore: cannot restore registers\n");
+    return false;
+  }
+  return true;
+}
+
+/* Stop tracking and free snapshot */
+bool uzl_snap_free(uzl_snap_t *snap)
+{
+  if(snap == NULL)
+    return false;
+
+  if(snap->hooked)
+    uc_hook_del(snap->uc, snap->write_hook);
+  if(snap->uc_ctx != NULL)
+    uc_free(snap->uc_ctx);
+  free(snap->dirty_addr);
+  free(snap->dirty_dat);
+  free(snap->tbl);
+  free(snap);
+  return true;
+}
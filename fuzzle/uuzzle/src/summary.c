@@ -0,0 +1,428 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <puzzle.h>
+#include <uuzzle.h>
+#include <unicorn.h>
+
+
+/* Arena block header holding the requested size, keeps blocks 16 aligned */
+#define UZL_SUM_HDR 0x10
+
+/* Host pointer to len guest bytes in the arena or a record, NULL to decline */
+uint8_t *uzl_sum_ptr(uzl_sum_t *sum, uint64_t addr, uint64_t len, bool write)
+{
+  mem_rec_t *mem_rec;
+
+  /* Arena */
+  if(sum->heap != NULL && addr - sum->heap_base < UZL_SUM_HEAP_SIZE)
+  {
+    if(len > UZL_SUM_HEAP_SIZE - (addr - sum->heap_base))
+      return NULL;
+    return sum->heap + (addr - sum->heap_base);
+  }
+
+  /* Accesses the mapping would refuse are left to fault in emulation */
+  uint8_t *dat = uzl_get_mem(sum->pzl_ctx, addr, len, &mem_rec);
+  if(dat == NULL ||
+     !((PERMS(mem_rec->perms)) & (write ? UC_PROT_WRITE : UC_PROT_READ)))
+    return NULL;
+  if(write && sum->snap != NULL && !uzl_snap_touch(sum->snap, addr, len))
+    return NULL;
+  return dat;
+}
+
+/* String at addr, at most max bytes, NULL when its region ends first */
+static uint8_t *uzl_sum_str(uzl_sum_t *sum, uint64_t addr, uint64_t max,
+                            uint64_t *len)
+{
+  mem_rec_t *mem_rec = NULL;
+  uint64_t chk_size = 0;
+  uint64_t avail, pos;
+  uint8_t *dat;
+
+  /* Arena or readable record */
+  if(sum->heap != NULL && addr - sum->heap_base < UZL_SUM_HEAP_SIZE)
+  {
+    dat = sum->heap + (addr - sum->heap_base);
+    avail = UZL_SUM_HEAP_SIZE - (addr - sum->heap_base);
+  }
+  else
+  {
+    mem_rec = pzl_find_mem_rec(sum->pzl_ctx, addr);
+    if(mem_rec == NULL || !((PERMS(mem_rec->perms)) & UC_PROT_READ))
+      return NULL;
+    dat = mem_rec->dat + (addr - mem_rec->start);
+    avail = mem_rec->start + mem_rec->size - addr;
+    if(mem_rec->chk_off != NULL)
+      chk_size = sum->pzl_ctx->hdr_rec.chk_size;
+  }
+  if(avail > max)
+    avail = max;
+
+  /* Chunked records are scanned a chunk at a time */
+  for(pos = 0; pos < avail;)
+  {
+    uint64_t piece = avail - pos;
+    if(chk_size != 0)
+    {
+      uint64_t off = addr - mem_rec->start + pos;
+      if(!pzl_load_mem_chk(sum->pzl_ctx, mem_rec, off / chk_size))
+        return NULL;
+      if(piece > chk_size - off % chk_size)
+        piece = chk_size - off % chk_size;
+    }
+
+    uint8_t *nul = memchr(dat + pos, 0, piece);
+    if(nul != NULL)
+    {
+      *len = nul - dat;
+      return dat;
+    }
+    pos += piece;
+  }
+  if(avail < max)
+    return NULL;
+  *len = max;
+  return dat;
+}
+
+/* Comparison result as the callee would return it, sign extended */
+static uint64_t uzl_sum_cmp_ret(int cmp)
+{
+  return (uint64_t) (int64_t) cmp;
+}
+
+/* Size of an arena block, false for addresses the arena did not hand out */
+static bool uzl_sum_block(uzl_sum_t *sum, uint64_t addr, uint64_t *size)
+{
+  uint64_t off = addr - sum->heap_base;
+  if(sum->heap == NULL || off < UZL_SUM_HDR || off > sum->heap_top ||
+     off % UZL_SUM_HDR != 0)
+    return false;
+  memcpy(size, sum->heap + off - UZL_SUM_HDR, sizeof(*size));
+  return true;
+}
+
+/* Bump allocate from the arena, false once it is full */
+static bool uzl_sum_alloc(uzl_sum_t *sum, uint64_t size, uint64_t *addr)
+{
+  if(sum->heap == NULL || size > UZL_SUM_HEAP_SIZE)
+    return false;
+  uint64_t need = UZL_SUM_HDR + ((size + UZL_SUM_HDR - 1) & ~((uint64_t) UZL_SUM_HDR - 1));
+  if(need > UZL_SUM_HEAP_SIZE - sum->heap_top)
+    return false;
+
+  memcpy(sum->heap + sum->heap_top, &size, sizeof(size));
+  *addr = sum->heap_base + sum->heap_top + UZL_SUM_HDR;
+  sum->heap_top += need;
+  return true;
+}
+
+/* memcpy and memmove, overlap is handled for both */
+static bool uzl_sum_fn_memmove(uzl_sum_t *sum, uint64_t *args, uint64_t *ret)
+{
+  if(args[2] != 0)
+  {
+    uint8_t *src = uzl_sum_ptr(sum, args[1], args[2], false);
+    uint8_t *dst = src != NULL ? uzl_sum_ptr(sum, args[0], args[2], true) : NULL;
+    if(dst == NULL)
+      return false;
+    memmove(dst, src, args[2]);
+  }
+  *ret = args[0];
+  return true;
+}
+
+/* memset */
+static bool uzl_sum_fn_memset(uzl_sum_t *sum, uint64_t *args, uint64_t *ret)
+{
+  if(args[2] != 0)
+  {
+    uint8_t *dst = uzl_sum_ptr(sum, args[0], args[2], true);
+    if(dst == NULL)
+      return false;
+    memset(dst, (uint8_t) args[1], args[2]);
+  }
+  *ret = args[0];
+  return true;
+}
+
+/* memcmp */
+static bool uzl_sum_fn_memcmp(uzl_sum_t *sum, uint64_t *args, uint64_t *ret)
+{
+  *ret = 0;
+  if(args[2] == 0)
+    return true;
+
+  uint8_t *lhs = uzl_sum_ptr(sum, args[0], args[2], false);
+  uint8_t *rhs = uzl_sum_ptr(sum, args[1], args[2], false);
+  if(lhs == NULL || rhs == NULL)
+    return false;
+  *ret = uzl_sum_cmp_ret(memcmp(lhs, rhs, args[2]));
+  return true;
+}
+
+/* strlen */
+static bool uzl_sum_fn_strlen(uzl_sum_t *sum, uint64_t *args, uint64_t *ret)
+{
+  return uzl_sum_str(sum, args[0], UINT64_MAX, ret) != NULL;
+}
+
+/* strcmp */
+static bool uzl_sum_fn_strcmp(uzl_sum_t *sum, uint64_t *args, uint64_t *ret)
+{
+  uint64_t lhs_len, rhs_len;
+  uint8_t *lhs = uzl_sum_str(sum, args[0], UINT64_MAX, &lhs_len);
+  uint8_t *rhs = uzl_sum_str(sum, args[1], UINT64_MAX, &rhs_len);
+  if(lhs == NULL || rhs == NULL)
+    return false;
+  *ret = uzl_sum_cmp_ret(strcmp((char *) lhs, (char *) rhs));
+  return true;
+}
+
+/* strncmp, neither string is read past n */
+static bool uzl_sum_fn_strncmp(uzl_sum_t *sum, uint64_t *args, uint64_t *ret)
+{
+  uint64_t lhs_len, rhs_len;
+  *ret = 0;
+  if(args[2] == 0)
+    return true;
+
+  uint8_t *lhs = uzl_sum_str(sum, args[0], args[2], &lhs_len);
+  uint8_t *rhs = uzl_sum_str(sum, args[1], args[2], &rhs_len);
+  if(lhs == NULL || rhs == NULL)
+    return false;
+  *ret = uzl_sum_cmp_ret(strncmp((char *) lhs, (char *) rhs, args[2]));
+  return true;
+}
+
+/* malloc */
+static bool uzl_sum_fn_malloc(uzl_sum_t *sum, uint64_t *args, uint64_t *ret)
+{
+  return uzl_sum_alloc(sum, args[0], ret);
+}
+
+/* calloc, the guest may have written past its blocks so clear anyway */
+static bool uzl_sum_fn_calloc(uzl_sum_t *sum, uint64_t *args, uint64_t *ret)
+{
+  if(args[1] != 0 && args[0] > UZL_SUM_HEAP_SIZE / args[1])
+    return false;
+  if(!uzl_sum_alloc(sum, args[0] * args[1], ret))
+    return false;
+  memset(sum->heap + (*ret - sum->heap_base), 0, args[0] * args[1]);
+  return true;
+}
+
+/* realloc of arena blocks, blocks from before the snapshot go to libc */
+static bool uzl_sum_fn_realloc(uzl_sum_t *sum, uint64_t *args, uint64_t *ret)
+{
+  uint64_t size;
+  if(args[0] == 0)
+    return uzl_sum_alloc(sum, args[1], ret);
+  if(!uzl_sum_block(sum, args[0], &size))
+    return false;
+
+  /* Shrinking to nothing frees */
+  *ret = 0;
+  if(args[1] == 0)
+    return true;
+  if(!uzl_sum_alloc(sum, args[1], ret))
+    return false;
+  memmove(sum->heap + (*ret - sum->heap_base),
+          sum->heap + (args[0] - sum->heap_base),
+          size < args[1] ? size : args[1]);
+  return true;
+}
+
+/* free, arena blocks are only reclaimed by uzl_sum_reset */
+static bool uzl_sum_fn_free(uzl_sum_t *sum, uint64_t *args, uint64_t *ret)
+{
+  uint64_t size;
+  *ret = 0;
+  return args[0] == 0 || uzl_sum_block(sum, args[0], &size);
+}
+
+/* Built in summaries of libc, the malloc family only work together */
+static const struct {
+  const char *sym;
+  uzl_sum_fn_t fn;
+} uzl_sum_builtins[] =
+{
+  { "memcpy", uzl_sum_fn_memmove },
+  { "memmove", uzl_sum_fn_memmove },
+  { "memset", uzl_sum_fn_memset },
+  { "memcmp", uzl_sum_fn_memcmp },
+  { "strlen", uzl_sum_fn_strlen },
+  { "strcmp", uzl_sum_fn_strcmp },
+  { "strncmp", uzl_sum_fn_strncmp },
+  { "malloc", uzl_sum_fn_malloc },
+  { "calloc", uzl_sum_fn_calloc },
+  { "realloc", uzl_sum_fn_realloc },
+  { "free", uzl_sum_fn_free }
+};
+
+/* Code callback, declined calls fall through to the original */
+static void uzl_sum_hook_code(uc_engine *uc, uint64_t address, uint32_t size,
+                              void *user_data)
+{
+  uzl_sum_ent_t *ent = (uzl_sum_ent_t *) user_data;
+  uzl_sum_t *sum = ent->sum;
+  uint64_t args[UZL_SUM_ARGS];
+  uint64_t ret = 0;
+
+  if(!sum->arch->get_call_args(uc, args) || !ent->fn(sum, args, &ret))
+    return;
+  sum->arch->ret_call(uc, ret);
+}
+
+/* Map the malloc arena unless the snapshot already uses its range */
+static bool uzl_sum_map_heap(uzl_sum_t *sum)
+{
+  uint64_t base = sum->arch->sum_heap;
+  uint64_t idx;
+  for(idx = 0; idx < sum->pzl_ctx->mem_rec_cnt; idx++)
+  {
+    mem_rec_t *mem_rec = sum->pzl_ctx->mem_rec[idx];
+    if(mem_rec->start < base + UZL_SUM_HEAP_SIZE &&
+       mem_rec->start + mem_rec->size > base)
+    {
+      printf("uzl_sum_map_heap: snapshot overlaps the arena, malloc is emulated\n");
+      return true;
+    }
+  }
+
+  /* Pages are only backed once touched */
+  uint8_t *heap = mmap(NULL, UZL_SUM_HEAP_SIZE, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if(heap == MAP_FAILED)
+  {
+    printf("uzl_sum_map_heap: cannot allocate arena\n");
+    return false;
+  }
+  if(uc_mem_map_ptr(sum->uc, base, UZL_SUM_HEAP_SIZE,
+                    UC_PROT_READ | UC_PROT_WRITE, heap) != UC_ERR_OK)
+  {
+    printf("uzl_sum_map_heap: cannot map arena at %p\n", (void *) base);
+    munmap(heap, UZL_SUM_HEAP_SIZE);
+    return false;
+  }
+  sum->heap = heap;
+  sum->heap_base = base;
+  return true;
+}
+
+/* Summarise libc when --summaries is given, otherwise only custom ones */
+bool uzl_sum_init(uzl_sum_t **sum, pzl_ctx_t *pzl_ctx, uc_engine *uc,
+                  uzl_snap_t *snap, uzl_opts_t *opts)
+{
+  uzl_sum_t *new_sum = calloc(1, sizeof(uzl_sum_t));
+  if(new_sum == NULL)
+  {
+    printf("uzl_sum_init: cannot allocate summaries\n");
+    return false;
+  }
+  new_sum->pzl_ctx = pzl_ctx;
+  new_sum->uc = uc;
+  new_sum->opts = opts;
+  new_sum->snap = snap;
+  new_sum->arch = uzl_get_arch(pzl_ctx);
+  if(new_sum->arch == NULL)
+  {
+    printf("uzl_sum_init: unknown architecture\n");
+    free(new_sum);
+    return false;
+  }
+  *sum = new_sum;
+
+  /* Native copies would bypass taint tracking */
+  if(!opts->summaries || opts->taint)
+    return true;
+
+  /* Arena first so the malloc family has somewhere to allocate */
+  if(!uzl_sum_map_heap(new_sum))
+  {
+    uzl_sum_free(new_sum);
+    *sum = NULL;
+    return false;
+  }
+
+  /* Routines the snapshot's libc has */
+  uint32_t idx;
+  for(idx = 0; idx < sizeof(uzl_sum_builtins) / sizeof(uzl_sum_builtins[0]);
+      idx++)
+  {
+    uint64_t addr;
+    if(!uzl_sym_resolve(pzl_ctx, "libc", uzl_sum_builtins[idx].sym, &addr,
+                        opts))
+      continue;
+    if(!uzl_sum_add(new_sum, addr, uzl_sum_builtins[idx].fn))
+    {
+      uzl_sum_free(new_sum);
+      *sum = NULL;
+      return false;
+    }
+    if(opts->verbose)
+      printf("uzl_sum_init: %s at %p\n", uzl_sum_builtins[idx].sym,
+             (void *) addr);
+  }
+  return true;
+}
+
+/* Run fn natively whenever addr is called, an address is summarised once */
+bool uzl_sum_add(uzl_sum_t *sum, uint64_t addr, uzl_sum_fn_t fn)
+{
+  uint32_t idx;
+  for(idx = 0; idx < sum->ent_cnt; idx++)
+  {
+    if(sum->ent[idx].addr == addr)
+      return true;
+  }
+  if(sum->ent_cnt == UZL_SUM_MAX)
+  {
+    printf("uzl_sum_add: too many summaries\n");
+    return false;
+  }
+
+  uzl_sum_ent_t *ent = &(sum->ent[sum->ent_cnt]);
+  ent->sum = sum;
+  ent->addr = addr;
+  ent->fn = fn;
+  if(uc_hook_add(sum->uc, &(ent->hook), UC_HOOK_CODE, uzl_sum_hook_code, ent,
+                 addr, addr) != UC_ERR_OK)
+  {
+    printf("uzl_sum_add: cannot register code hook at %p\n", (void *) addr);
+    return false;
+  }
+  sum->ent_cnt++;
+  return true;
+}
+
+/* Rewind the arena between runs, call after uzl_snap_restore */
+bool uzl_sum_reset(uzl_sum_t *sum)
+{
+  if(sum->heap != NULL)
+    memset(sum->heap, 0, sum->heap_top);
+  sum->heap_top = 0;
+  return true;
+}
+
+/* Remove hooks and unmap the arena */
+bool uzl_sum_free(uzl_sum_t *sum)
+{
+  if(sum == NULL)
+    return false;
+
+  uint32_t idx;
+  for(idx = 0; idx < sum->ent_cnt; idx++)
+    uc_hook_del(sum->uc, sum->ent[idx].hook);
+  if(sum->heap != NULL)
+  {
+    uc_mem_unmap(sum->uc, sum->heap_base, UZL_SUM_HEAP_SIZE);
+    munmap(sum->heap, UZL_SUM_HEAP_SIZE);
+  }
+  free(sum);
+  return true;
+}
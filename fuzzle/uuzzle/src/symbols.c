@@ -0,0 +1,340 @@
+#include <elf.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <puzzle.h>
+#include <uuzzle.h>
+#include <unicorn.h>
+
+
+/* Dynamic entries read before giving up on DT_NULL */
+#define UZL_SYM_DYN_MAX 0x200
+
+/* Dynamic section of a library in the snapshot, pointers are absolute */
+typedef struct uzl_sym_elf {
+  pzl_ctx_t *pzl_ctx;
+  bool is64;
+  bool be;
+  uint16_t machine;
+  uint64_t base;
+  uint64_t symtab;
+  uint64_t strtab;
+  uint64_t hash;
+  uint64_t gnu_hash;
+  uint64_t versym;
+  uint64_t rela;
+  uint64_t rela_sz;
+  uint64_t jmprel;
+  uint64_t jmprel_sz;
+  uint64_t pltrel;
+} uzl_sym_elf_t;
+
+/* Integer of len bytes in the library's byte order */
+static bool uzl_sym_elf_get(uzl_sym_elf_t *elf, uint64_t addr, uint32_t len,
+                            uint64_t *val)
+{
+  mem_rec_t *mem_rec;
+  uint8_t *dat = uzl_get_mem(elf->pzl_ctx, addr, len, &mem_rec);
+  if(dat == NULL)
+    return false;
+
+  uint32_t idx;
+  *val = 0;
+  for(idx = 0; idx < len; idx++)
+    *val |= (uint64_t) dat[elf->be ? len - 1 - idx : idx] << (8 * idx);
+  return true;
+}
+
+/* Record name ends in lib followed by a version, as libc.so.6 or libc-2.31.so */
+static bool uzl_sym_lib_match(mem_rec_t *mem_rec, const char *lib)
+{
+  uint64_t len = strlen(lib);
+  uint64_t name = 0;
+  uint64_t idx;
+
+  if(mem_rec->str_flag != 0x01)
+    return false;
+  for(idx = 0; idx < mem_rec->str_size; idx++)
+  {
+    if(mem_rec->str[idx] == '/')
+      name = idx + 1;
+  }
+  return mem_rec->str_size - name > len &&
+         memcmp(mem_rec->str + name, lib, len) == 0 &&
+         (mem_rec->str[name + len] == '.' || mem_rec->str[name + len] == '-');
+}
+
+/* Find the dynamic section of lib from its ELF header in the first record */
+static bool uzl_sym_elf_open(uzl_sym_elf_t *elf, pzl_ctx_t *pzl_ctx,
+                             const char *lib)
+{
+  mem_rec_t *mem_rec = NULL;
+  uint64_t idx;
+
+  /* Records are sorted, the first one holds the header */
+  for(idx = 0; idx < pzl_ctx->mem_rec_cnt; idx++)
+  {
+    if(uzl_sym_lib_match(pzl_ctx->mem_rec[idx], lib))
+    {
+      mem_rec = pzl_ctx->mem_rec[idx];
+      break;
+    }
+  }
+  if(mem_rec == NULL)
+    return false;
+
+  /* Identification */
+  mem_rec_t *hdr_rec;
+  uint8_t *ident = uzl_get_mem(pzl_ctx, mem_rec->start, EI_NIDENT, &hdr_rec);
+  if(ident == NULL || memcmp(ident, ELFMAG, SELFMAG) != 0)
+    return false;
+  memset(elf, 0, sizeof(uzl_sym_elf_t));
+  elf->pzl_ctx = pzl_ctx;
+  elf->is64 = ident[EI_CLASS] == ELFCLASS64;
+  elf->be = ident[EI_DATA] == ELFDATA2MSB;
+
+  /* Program headers */
+  uint64_t start = mem_rec->start;
+  uint64_t machine, phoff, phentsize, phnum;
+  if(!uzl_sym_elf_get(elf, start + 18, 2, &machine) ||
+     !uzl_sym_elf_get(elf, start + (elf->is64 ? 0x20 : 0x1c),
+                      elf->is64 ? 8 : 4, &phoff) ||
+     !uzl_sym_elf_get(elf, start + (elf->is64 ? 0x36 : 0x2a), 2, &phentsize) ||
+     !uzl_sym_elf_get(elf, start + (elf->is64 ? 0x38 : 0x2c), 2, &phnum))
+    return false;
+  elf->machine = machine;
+
+  /* Load bias from the lowest segment, dynamic section from PT_DYNAMIC */
+  uint64_t load = UINT64_MAX, dyn = 0;
+  for(idx = 0; idx < phnum; idx++)
+  {
+    uint64_t ph = start + phoff + idx * phentsize;
+    uint64_t type, vaddr;
+    if(!uzl_sym_elf_get(elf, ph, 4, &type) ||
+       !uzl_sym_elf_get(elf, ph + (elf->is64 ? 16 : 8), elf->is64 ? 8 : 4,
+                        &vaddr))
+      return false;
+    if(type == PT_LOAD && vaddr < load)
+      load = vaddr;
+    else if(type == PT_DYNAMIC)
+      dyn = vaddr;
+  }
+  if(load == UINT64_MAX || dyn == 0)
+    return false;
+  elf->base = start - (load & ~((uint64_t) PZL_PAGE_SIZE - 1));
+
+  /* Loaders relocate the entries in place unless the section is read only */
+  uint32_t word = elf->is64 ? 8 : 4;
+  for(idx = 0; idx < UZL_SYM_DYN_MAX; idx++)
+  {
+    uint64_t tag, val;
+    uint64_t ent = elf->base + dyn + idx * 2 * word;
+    if(!uzl_sym_elf_get(elf, ent, word, &tag) ||
+       !uzl_sym_elf_get(elf, ent + word, word, &val))
+      return false;
+    if(tag == DT_NULL)
+      break;
+
+    uint64_t ptr = val < elf->base ? val + elf->base : val;
+    switch(tag)
+    {
+      case DT_SYMTAB:
+        elf->symtab = ptr;
+        break;
+      case DT_STRTAB:
+        elf->strtab = ptr;
+        break;
+      case DT_HASH:
+        elf->hash = ptr;
+        break;
+      case DT_GNU_HASH:
+        elf->gnu_hash = ptr;
+        break;
+      case DT_VERSYM:
+        elf->versym = ptr;
+        break;
+      case DT_RELA:
+        elf->rela = ptr;
+        break;
+      case DT_RELASZ:
+        elf->rela_sz = val;
+        break;
+      case DT_JMPREL:
+        elf->jmprel = ptr;
+        break;
+      case DT_PLTRELSZ:
+        elf->jmprel_sz = val;
+        break;
+      case DT_PLTREL:
+        elf->pltrel = val;
+        break;
+    }
+  }
+  return elf->symtab != 0 && elf->strtab != 0 &&
+         (elf->hash != 0 || elf->gnu_hash != 0);
+}
+
+/* Symbol idx is the default version of sym, old compat versions are hidden */
+static bool uzl_sym_elf_name(uzl_sym_elf_t *elf, uint64_t idx, const char *sym)
+{
+  mem_rec_t *mem_rec;
+  uint64_t name, ver;
+  uint64_t len = strlen(sym) + 1;
+
+  if(!uzl_sym_elf_get(elf, elf->symtab + idx * (elf->is64 ? 24 : 16), 4, &name))
+    return false;
+  if(elf->versym != 0 &&
+     (!uzl_sym_elf_get(elf, elf->versym + idx * 2, 2, &ver) || (ver & 0x8000)))
+    return false;
+  uint8_t *str = uzl_get_mem(elf->pzl_ctx, elf->strtab + name, len, &mem_rec);
+  return str != NULL && memcmp(str, sym, len) == 0;
+}
+
+/* Index of sym through the GNU hash table */
+static bool uzl_sym_elf_gnu_lookup(uzl_sym_elf_t *elf, const char *sym,
+                                   uint64_t *idx)
+{
+  uint32_t hash = 5381;
+  const uint8_t *chr;
+  for(chr = (const uint8_t *) sym; *chr != 0; chr++)
+    hash = hash * 33 + *chr;
+
+  uint64_t nbuckets, symoffset, bloom_size, bucket, chain;
+  if(!uzl_sym_elf_get(elf, elf->gnu_hash, 4, &nbuckets) ||
+     !uzl_sym_elf_get(elf, elf->gnu_hash + 4, 4, &symoffset) ||
+     !uzl_sym_elf_get(elf, elf->gnu_hash + 8, 4, &bloom_size) ||
+     nbuckets == 0)
+    return false;
+  bucket = elf->gnu_hash + 16 + bloom_size * (elf->is64 ? 8 : 4);
+  chain = bucket + nbuckets * 4;
+
+  /* Chain ends at the entry with its low bit set */
+  if(!uzl_sym_elf_get(elf, bucket + (hash % nbuckets) * 4, 4, idx) ||
+     *idx < symoffset)
+    return false;
+  for(;; (*idx)++)
+  {
+    uint64_t chain_hash;
+    if(!uzl_sym_elf_get(elf, chain + (*idx - symoffset) * 4, 4, &chain_hash))
+      return false;
+    if((chain_hash | 1) == (hash | 1) && uzl_sym_elf_name(elf, *idx, sym))
+      return true;
+    if(chain_hash & 1)
+      return false;
+  }
+}
+
+/* Index of sym through the SysV hash table */
+static bool uzl_sym_elf_sysv_lookup(uzl_sym_elf_t *elf, const char *sym,
+                                    uint64_t *idx)
+{
+  uint32_t hash = 0;
+  const uint8_t *chr;
+  for(chr = (const uint8_t *) sym; *chr != 0; chr++)
+  {
+    hash = (hash << 4) + *chr;
+    hash ^= (hash & 0xf0000000) >> 24;
+    hash &= 0x0fffffff;
+  }
+
+  uint64_t nbucket, nchain;
+  if(!uzl_sym_elf_get(elf, elf->hash, 4, &nbucket) ||
+     !uzl_sym_elf_get(elf, elf->hash + 4, 4, &nchain) || nbucket == 0 ||
+     !uzl_sym_elf_get(elf, elf->hash + 8 + (hash % nbucket) * 4, 4, idx))
+    return false;
+  while(*idx != 0 && *idx < nchain)
+  {
+    if(uzl_sym_elf_name(elf, *idx, sym))
+      return true;
+    if(!uzl_sym_elf_get(elf, elf->hash + 8 + (nbucket + *idx) * 4, 4, idx))
+      return false;
+  }
+  return false;
+}
+
+/* Implementation an IFUNC resolver picked, from its IRELATIVE slot */
+static bool uzl_sym_elf_ifunc(uzl_sym_elf_t *elf, uint64_t resolver,
+                              uint64_t *addr)
+{
+  uint32_t irelative;
+  switch(elf->machine)
+  {
+    case EM_X86_64:
+      irelative = R_X86_64_IRELATIVE;
+      break;
+    case EM_AARCH64:
+      irelative = R_AARCH64_IRELATIVE;
+      break;
+    default:
+      return false;
+  }
+
+  /* Only RELA tables name the resolver, REL ones overwrite it in the slot */
+  uint64_t tbl[2][2] = { { elf->rela, elf->rela_sz },
+                         { elf->pltrel == DT_RELA ? elf->jmprel : 0,
+                           elf->jmprel_sz } };
+  uint32_t word = elf->is64 ? 8 : 4;
+  uint64_t idx, off;
+  for(idx = 0; idx < 2; idx++)
+  {
+    for(off = 0; tbl[idx][0] != 0 && off + 3 * word <= tbl[idx][1];
+        off += 3 * word)
+    {
+      uint64_t r_offset, r_info, r_addend;
+      if(!uzl_sym_elf_get(elf, tbl[idx][0] + off, word, &r_offset) ||
+         !uzl_sym_elf_get(elf, tbl[idx][0] + off + word, word, &r_info) ||
+         !uzl_sym_elf_get(elf, tbl[idx][0] + off + 2 * word, word, &r_addend))
+        return false;
+      if((elf->is64 ? r_info & 0xffffffff : r_info & 0xff) == irelative &&
+         r_addend == resolver)
+        return uzl_sym_elf_get(elf, elf->base + r_offset, word, addr);
+    }
+  }
+  return false;
+}
+
+/* Address of the code sym runs in lib, resolved from the snapshot's records */
+bool uzl_sym_resolve(pzl_ctx_t *pzl_ctx, const char *lib, const char *sym,
+                     uint64_t *addr, uzl_opts_t *opts)
+{
+  uzl_sym_elf_t elf;
+  uint64_t idx, info, shndx, value;
+
+  if(!uzl_sym_elf_open(&elf, pzl_ctx, lib))
+  {
+    if(opts->verbose)
+      printf("uzl_sym_resolve: cannot find dynamic section of %s\n", lib);
+    return false;
+  }
+  if(!(elf.gnu_hash != 0 && uzl_sym_elf_gnu_lookup(&elf, sym, &idx)) &&
+     !(elf.hash != 0 && uzl_sym_elf_sysv_lookup(&elf, sym, &idx)))
+  {
+    if(opts->verbose)
+      printf("uzl_sym_resolve: cannot find %s in %s\n", sym, lib);
+    return false;
+  }
+
+  /* Symbol fields */
+  uint64_t ent = elf.symtab + idx * (elf.is64 ? 24 : 16);
+  if(!uzl_sym_elf_get(&elf, ent + (elf.is64 ? 4 : 12), 1, &info) ||
+     !uzl_sym_elf_get(&elf, ent + (elf.is64 ? 6 : 14), 2, &shndx) ||
+     !uzl_sym_elf_get(&elf, ent + (elf.is64 ? 8 : 4), elf.is64 ? 8 : 4,
+                      &value) ||
+     shndx == SHN_UNDEF || value == 0)
+    return false;
+  *addr = elf.base + value;
+
+  /* IFUNC symbols point at their resolver */
+  if(ELF32_ST_TYPE(info) == STT_GNU_IFUNC &&
+     !uzl_sym_elf_ifunc(&elf, value, addr))
+  {
+    if(opts->verbose)
+      printf("uzl_sym_resolve: cannot find implementation of %s\n", sym);
+    return false;
+  }
+
+  /* Thumb functions have the low bit set */
+  if(elf.machine == EM_ARM)
+    *addr &= ~(uint64_t) 1;
+  return true;
+}
@@ -0,0 +1,254 @@
+#include <stdio.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <puzzle.h>
+#include <uuzzle.h>
+#include <unicorn.h>
+
+
+/* Emulated process state shared by every syscall ABI */
+bool uzl_sys_init(uzl_sys_t **sys, pzl_ctx_t *pzl_ctx, uc_engine *uc,
+                  uzl_opts_t *opts)
+{
+  uzl_sys_t *new_sys = calloc(1, sizeof(uzl_sys_t));
+  if(new_sys == NULL)
+  {
+    printf("uzl_sys_init: cannot allocate syscall state\n");
+    return false;
+  }
+  new_sys->pzl_ctx = pzl_ctx;
+  new_sys->uc = uc;
+  new_sys->opts = opts;
+  new_sys->brk = UZL_SYS_BRK_BASE;
+  new_sys->mmap_next = UZL_SYS_MMAP_BASE;
+
+  /* Program break continues from the captured heap */
+  uint64_t idx;
+  for(idx = 0; idx < pzl_ctx->mem_rec_cnt; idx++)
+  {
+    mem_rec_t *mem_rec = pzl_ctx->mem_rec[idx];
+    if(mem_rec->str_flag == 0x01 && mem_rec->str_size >= 6 &&
+       memcmp(mem_rec->str, "[heap]", 6) == 0)
+      new_sys->brk = mem_rec->end;
+  }
+  new_sys->brk_end = (new_sys->brk + PZL_PAGE_SIZE - 1) &
+                     ~((uint64_t) PZL_PAGE_SIZE - 1);
+
+  /* Standard streams */
+  for(idx = 0; idx < UZL_SYS_FDS; idx++)
+    new_sys->fds[idx].host_fd = -1;
+  for(idx = STDIN_FILENO; idx <= STDERR_FILENO; idx++)
+    new_sys->fds[idx].type = UZL_FD_STD;
+
+  /* Designated test case descriptor, a socket unless it is a stream */
+  if(opts->input_fd >= 0 && opts->input_fd < UZL_SYS_FDS)
+  {
+    if(new_sys->fds[opts->input_fd].type == UZL_FD_FREE)
+      new_sys->fds[opts->input_fd].type = UZL_FD_SOCKET;
+    new_sys->fds[opts->input_fd].input = true;
+  }
+  uzl_sys_save(new_sys);
+
+  *sys = new_sys;
+  return true;
+}
+
+/* Lowest free descriptor, -1 when the table is full */
+int32_t uzl_sys_fd_alloc(uzl_sys_t *sys, uint8_t type, int32_t host_fd)
+{
+  int32_t fd;
+  for(fd = 0; fd < UZL_SYS_FDS; fd++)
+  {
+    if(sys->fds[fd].type == UZL_FD_FREE)
+    {
+      sys->fds[fd].type = type;
+      sys->fds[fd].input = false;
+      sys->fds[fd].host_fd = host_fd;
+      sys->fds[fd].off = 0;
+      return fd;
+    }
+  }
+  return -1;
+}
+
+/* Open descriptor, NULL when fd is not in use */
+uzl_fd_t *uzl_sys_fd_get(uzl_sys_t *sys, uint64_t fd)
+{
+  if(fd >= UZL_SYS_FDS || sys->fds[fd].type == UZL_FD_FREE)
+    return NULL;
+  return &(sys->fds[fd]);
+}
+
+/* Release descriptor and its host file */
+bool uzl_sys_fd_close(uzl_sys_t *sys, uint64_t fd)
+{
+  uzl_fd_t *vfd = uzl_sys_fd_get(sys, fd);
+  if(vfd == NULL)
+    return false;
+
+  /* Host files open at the snapshot come back on restore */
+  if(vfd->host_fd >= 0 && vfd->host_fd != sys->saved_fds[fd].host_fd)
+    close(vfd->host_fd);
+  vfd->type = UZL_FD_FREE;
+  vfd->input = false;
+  vfd->host_fd = -1;
+  return true;
+}
+
+/* Serve len bytes of a new test case, the caller keeps input alive */
+bool uzl_sys_set_input(uzl_sys_t *sys, uint8_t *input, uint64_t len)
+{
+  sys->input = input;
+  sys->input_len = len;
+  sys->input_off = 0;
+  sys->input_conns = 0;
+  sys->output_len = 0;
+  return true;
+}
+
+/* Copy the next test case bytes straight from input to addr */
+uint64_t uzl_sys_input_read(uzl_sys_t *sys, uint64_t addr, uint64_t len)
+{
+  uint64_t left = sys->input_len - sys->input_off;
+  if(len > left)
+    len = left;
+  if(len == 0)
+    return 0;
+
+  if(!uzl_sys_mem_write(sys, addr, sys->input + sys->input_off, len))
+    return (uint64_t) -EFAULT;
+
+  /* Tracked bytes are tagged with their offset in the test case */
+  if(sys->taint != NULL &&
+     !uzl_taint_input(sys->taint, addr, sys->input_off, len))
+    return (uint64_t) -ENOMEM;
+  sys->input_off += len;
+  return len;
+}
+
+/* Sink for writes to input descriptors */
+uint64_t uzl_sys_output_write(uzl_sys_t *sys, uint64_t addr, uint64_t len)
+{
+  if(!sys->capture || len == 0)
+    return len;
+
+  if(sys->output_len + len > sys->output_cap)
+  {
+    uint64_t cap = sys->output_cap ? sys->output_cap : UZL_SYS_INPUT_MAX;
+    while(cap < sys->output_len + len)
+      cap *= 2;
+    uint8_t *output = realloc(sys->output, cap);
+    if(output == NULL)
+      return (uint64_t) -ENOMEM;
+    sys->output = output;
+    sys->output_cap = cap;
+  }
+
+  if(uc_mem_read(sys->uc, addr, sys->output + sys->output_len, len) !=
+     UC_ERR_OK)
+    return (uint64_t) -EFAULT;
+  sys->output_len += len;
+  return len;
+}
+
+/* Write guest memory from a handler, bypassing the snapshot's hook */
+bool uzl_sys_mem_write(uzl_sys_t *sys, uint64_t addr, void *dat, uint64_t len)
+{
+  if(sys->snap != NULL && !uzl_snap_touch(sys->snap, addr, len))
+    return false;
+  return uc_mem_write(sys->uc, addr, dat, len) == UC_ERR_OK;
+}
+
+/* Map a guest range, remembered so uzl_sys_restore unmaps it again */
+bool uzl_sys_mem_map(uzl_sys_t *sys, uint64_t addr, uint64_t size,
+                     uint32_t perms)
+{
+  if(sys->map_cnt == sys->map_cap)
+  {
+    uint64_t cap = sys->map_cap ? sys->map_cap * 2 : UZL_SYS_MAPS;
+    uzl_sys_map_t *maps = realloc(sys->maps, cap * sizeof(uzl_sys_map_t));
+    if(maps == NULL)
+      return false;
+    sys->maps = maps;
+    sys->map_cap = cap;
+  }
+
+  if(uc_mem_map(sys->uc, addr, size, perms) != UC_ERR_OK)
+    return false;
+  sys->maps[sys->map_cnt].addr = addr;
+  sys->maps[sys->map_cnt].size = size;
+  sys->map_cnt++;
+  return true;
+}
+
+/* Remember descriptors, break and mappings as they are at the snapshot */
+bool uzl_sys_save(uzl_sys_t *sys)
+{
+  memcpy(sys->saved_fds, sys->fds, sizeof(sys->fds));
+  sys->saved_brk = sys->brk;
+  sys->saved_mmap_next = sys->mmap_next;
+  sys->map_cnt = 0;
+  return true;
+}
+
+/*
+Close descriptors opened since uzl_sys_save, rewind offsets and break and
+unmap what was mapped since. Call after uzl_snap_restore, which may still
+write back pages of those mappings.
+*/
+bool uzl_sys_restore(uzl_sys_t *sys)
+{
+  uint64_t fd;
+  for(fd = 0; fd < UZL_SYS_FDS; fd++)
+  {
+    if(sys->fds[fd].host_fd >= 0 &&
+       sys->fds[fd].host_fd != sys->saved_fds[fd].host_fd)
+      close(sys->fds[fd].host_fd);
+  }
+  memcpy(sys->fds, sys->saved_fds, sizeof(sys->fds));
+
+  /* Pages past the break stay mapped for the next iteration */
+  sys->brk = sys->saved_brk;
+
+  /* Mappings go, so their addresses are reused */
+  while(sys->map_cnt > 0)
+  {
+    uzl_sys_map_t *map = &(sys->maps[--sys->map_cnt]);
+    if(uc_mem_unmap(sys->uc, map->addr, map->size) != UC_ERR_OK)
+    {
+      printf("uzl_sys_restore: cannot unmap %p\n", (void *) map->addr);
+      return false;
+    }
+  }
+  sys->mmap_next = sys->saved_mmap_next;
+  sys->exited = false;
+  sys->exit_code = 0;
+  return true;
+}
+
+/* Remove syscall hook and close descriptors */
+bool uzl_sys_free(uzl_sys_t *sys)
+{
+  if(sys == NULL)
+    return false;
+
+  if(sys->hooked)
+    uc_hook_del(sys->uc, sys->hook);
+
+  uint64_t fd;
+  for(fd = 0; fd < UZL_SYS_FDS; fd++)
+  {
+    if(sys->fds[fd].host_fd >= 0)
+      close(sys->fds[fd].host_fd);
+    if(sys->saved_fds[fd].host_fd >= 0 &&
+       sys->saved_fds[fd].host_fd != sys->fds[fd].host_fd)
+      close(sys->saved_fds[fd].host_fd);
+  }
+  free(sys->output);
+  free(sys->maps);
+  free(sys);
+  return true;
+}
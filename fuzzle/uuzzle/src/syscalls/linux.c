@@ -0,0 +1,410 @@
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <puzzle.h>
+#include <uuzzle.h>
+#include <unicorn.h>
+#include <stdbool.h>
+#include <linux.h>
+
+
+/* Bytes copied between host and emulator per step */
+#define LINUX_SYS_BUF 0x1000
+
+/* Page rounding */
+#define LINUX_PAGE_UP(__addr) \
+  (((__addr) + PZL_PAGE_SIZE - 1) & ~((uint64_t) PZL_PAGE_SIZE - 1))
+
+/* Copy host descriptor into emulator memory, files are read at *off */
+static uint64_t linux_sys_read_host(uzl_sys_t *sys, int32_t host_fd,
+                                    uint64_t *off, uint64_t addr,
+                                    uint64_t len)
+{
+  uint8_t buf[LINUX_SYS_BUF];
+  uint64_t done = 0;
+
+  while(done < len)
+  {
+    uint64_t step = len - done < sizeof(buf) ? len - done : sizeof(buf);
+    ssize_t ret = off ? pread(host_fd, buf, step, *off + done) :
+                        read(host_fd, buf, step);
+    if(ret < 0)
+      return done ? done : (uint64_t) -errno;
+    if(!uzl_sys_mem_write(sys, addr + done, buf, ret))
+      return done ? done : (uint64_t) -EFAULT;
+    done += ret;
+    if(ret < step)
+      break;
+  }
+  if(off)
+    *off += done;
+  return done;
+}
+
+/* Print emulator memory in the style of the original write hook */
+static uint64_t linux_sys_print(uzl_sys_t *sys, uint64_t fd,
+                                uint64_t addr, uint64_t len)
+{
+  uint8_t buf[LINUX_SYS_BUF];
+  uint64_t done;
+
+  /* Quiet mode */
+  if(sys->opts->quiet)
+    return len;
+
+  for(done = 0; done < len; done += sizeof(buf))
+  {
+    int step = len - done < sizeof(buf) ? len - done : sizeof(buf);
+    if(uc_mem_read(sys->uc, addr + done, buf, step) != UC_ERR_OK)
+      return done ? done : (uint64_t) -EFAULT;
+
+    /* Write to stdout */
+    switch(fd)
+    {
+      case STDIN_FILENO:
+        printf("stdin>:  %.*s", step, buf);
+        break;
+      case STDOUT_FILENO:
+        printf("stdout>: %.*s", step, buf);
+        break;
+      case STDERR_FILENO:
+        printf("stderr>: %.*s", step, buf);
+        break;
+      default:
+        printf("fd %lu>:\t%.*s", fd, step, buf);
+    }
+  }
+  return len;
+}
+
+/* Read syscall */
+uint64_t linux_sys_read(uzl_sys_t *sys, linux_sys_args_t *args)
+{
+  uzl_fd_t *vfd = uzl_sys_fd_get(sys, args->arg[0]);
+  if(vfd == NULL)
+    return (uint64_t) -EBADF;
+  if(vfd->input)
+    return uzl_sys_input_read(sys, args->arg[1], args->arg[2]);
+
+  switch(vfd->type)
+  {
+    case UZL_FD_STD:
+      return linux_sys_read_host(sys, args->arg[0], NULL, args->arg[1],
+                                 args->arg[2]);
+    case UZL_FD_FILE:
+      return linux_sys_read_host(sys, vfd->host_fd, &(vfd->off),
+                                 args->arg[1], args->arg[2]);
+    case UZL_FD_CONN:
+      /* Peer has nothing to send */
+      return 0;
+    default:
+      return (uint64_t) -ENOTCONN;
+  }
+}
+
+/* Write syscall */
+uint64_t linux_sys_write(uzl_sys_t *sys, linux_sys_args_t *args)
+{
+  uzl_fd_t *vfd = uzl_sys_fd_get(sys, args->arg[0]);
+  if(vfd == NULL || vfd->type == UZL_FD_FILE)
+    return (uint64_t) -EBADF;
+  if(vfd->input)
+    return uzl_sys_output_write(sys, args->arg[1], args->arg[2]);
+  return linux_sys_print(sys, args->arg[0], args->arg[1], args->arg[2]);
+}
+
+/* Open a host file read only relative to host_dir */
+static uint64_t linux_sys_open_at(uzl_sys_t *sys, int32_t host_dir,
+                                  uint64_t path_addr, uint64_t flags)
+{
+  char path[PATH_MAX];
+  uint64_t idx;
+
+  /* Writes stay inside the emulator */
+  if((flags & O_ACCMODE) != O_RDONLY)
+    return (uint64_t) -EACCES;
+
+  /* Path may end just before an unmapped page */
+  for(idx = 0; idx < sizeof(path); idx++)
+  {
+    if(uc_mem_read(sys->uc, path_addr + idx, &(path[idx]), 1) != UC_ERR_OK)
+      return (uint64_t) -EFAULT;
+    if(path[idx] == '\0')
+      break;
+  }
+  if(idx == sizeof(path))
+    return (uint64_t) -ENAMETOOLONG;
+
+  int32_t host_fd = openat(host_dir, path, O_RDONLY | O_CLOEXEC);
+  if(host_fd < 0)
+    return (uint64_t) -errno;
+
+  int32_t fd = uzl_sys_fd_alloc(sys, UZL_FD_FILE, host_fd);
+  if(fd < 0)
+  {
+    close(host_fd);
+    return (uint64_t) -EMFILE;
+  }
+  if(sys->opts->verbose)
+    printf("linux_sys_open_at: %s is fd %d\n", path, fd);
+  return fd;
+}
+
+/* Open syscall */
+uint64_t linux_sys_open(uzl_sys_t *sys, linux_sys_args_t *args)
+{
+  return linux_sys_open_at(sys, AT_FDCWD, args->arg[0], args->arg[1]);
+}
+
+/* Openat syscall */
+uint64_t linux_sys_openat(uzl_sys_t *sys, linux_sys_args_t *args)
+{
+  int32_t host_dir = AT_FDCWD;
+  if((int32_t) args->arg[0] != AT_FDCWD)
+  {
+    uzl_fd_t *vfd = uzl_sys_fd_get(sys, args->arg[0]);
+    if(vfd == NULL || vfd->host_fd < 0)
+      return (uint64_t) -EBADF;
+    host_dir = vfd->host_fd;
+  }
+  return linux_sys_open_at(sys, host_dir, args->arg[1], args->arg[2]);
+}
+
+/* Close syscall */
+uint64_t linux_sys_close(uzl_sys_t *sys, linux_sys_args_t *args)
+{
+  return uzl_sys_fd_close(sys, args->arg[0]) ? 0 : (uint64_t) -EBADF;
+}
+
+/* Mmap syscall */
+uint64_t linux_sys_mmap(uzl_sys_t *sys, linux_sys_args_t *args)
+{
+  uint64_t addr = args->arg[0];
+  uint64_t size = LINUX_PAGE_UP(args->arg[1]);
+  uint32_t perms = args->arg[2] & UC_PROT_ALL;
+  uint64_t flags = args->arg[3];
+  uzl_fd_t *vfd = NULL;
+
+  if(size == 0 || addr & (PZL_PAGE_SIZE - 1))
+    return (uint64_t) -EINVAL;
+
+  /* File mappings are copied from the host file */
+  if(!(flags & LINUX_MAP_ANONYMOUS))
+  {
+    vfd = uzl_sys_fd_get(sys, args->arg[4]);
+    if(vfd == NULL || vfd->type != UZL_FD_FILE)
+      return (uint64_t) -EBADF;
+  }
+
+  /* Fixed mappings replace what is already there */
+  if(flags & LINUX_MAP_FIXED)
+  {
+    if(!uzl_sys_mem_map(sys, addr, size, perms))
+    {
+      uint8_t zero[LINUX_SYS_BUF] = {0};
+      uint64_t off;
+      for(off = 0; off < size; off += sizeof(zero))
+      {
+        if(!uzl_sys_mem_write(sys, addr + off, zero, sizeof(zero)))
+          return (uint64_t) -ENOMEM;
+      }
+      if(uc_mem_protect(sys->uc, addr, size, perms) != UC_ERR_OK)
+        return (uint64_t) -ENOMEM;
+    }
+  }
+
+  /* Otherwise the hint, then the next free range from mmap_next */
+  else if(addr == 0 || !uzl_sys_mem_map(sys, addr, size, perms))
+  {
+    for(addr = sys->mmap_next; ; addr += size)
+    {
+      if(addr < sys->mmap_next)
+        return (uint64_t) -ENOMEM;
+      if(uzl_sys_mem_map(sys, addr, size, perms))
+        break;
+    }
+    sys->mmap_next = addr + size;
+  }
+
+  /* Contents */
+  if(vfd != NULL)
+  {
+    uint8_t buf[LINUX_SYS_BUF];
+    uint64_t off;
+    for(off = 0; off < size; off += sizeof(buf))
+    {
+      ssize_t ret = pread(vfd->host_fd, buf, sizeof(buf), args->arg[5] + off);
+      if(ret <= 0)
+        break;
+      uzl_sys_mem_write(sys, addr + off, buf, ret);
+    }
+  }
+  return addr;
+}
+
+/* Mmap2 syscall, 32 bit abis pass the offset in pages */
+uint64_t linux_sys_mmap2(uzl_sys_t *sys, linux_sys_args_t *args)
+{
+  args->arg[5] *= LINUX_MMAP2_UNIT;
+  return linux_sys_mmap(sys, args);
+}
+
+/* Mprotect syscall */
+uint64_t linux_sys_mprotect(uzl_sys_t *sys, linux_sys_args_t *args)
+{
+  if(uc_mem_protect(sys->uc, args->arg[0], LINUX_PAGE_UP(args->arg[1]),
+                    args->arg[2] & UC_PROT_ALL) != UC_ERR_OK)
+    return (uint64_t) -ENOMEM;
+  return 0;
+}
+
+/* Munmap syscall, mappings are kept and their addresses not reused */
+uint64_t linux_sys_munmap(uzl_sys_t *sys, linux_sys_args_t *args)
+{
+  return 0;
+}
+
+/* Brk syscall */
+uint64_t linux_sys_brk(uzl_sys_t *sys, linux_sys_args_t *args)
+{
+  uint64_t brk = args->arg[0];
+  if(brk == 0)
+    return sys->brk;
+
+  /* Map pages the break grows into, failure leaves it unchanged */
+  uint64_t brk_end = LINUX_PAGE_UP(brk);
+  if(brk_end > sys->brk_end)
+  {
+    if(uc_mem_map(sys->uc, sys->brk_end, brk_end - sys->brk_end,
+                  UC_PROT_READ | UC_PROT_WRITE) != UC_ERR_OK)
+      return sys->brk;
+    sys->brk_end = brk_end;
+  }
+  sys->brk = brk;
+  return brk;
+}
+
+/* Socket syscall */
+uint64_t linux_sys_socket(uzl_sys_t *sys, linux_sys_args_t *args)
+{
+  int32_t fd = uzl_sys_fd_alloc(sys, UZL_FD_SOCKET, -1);
+  return fd < 0 ? (uint64_t) -EMFILE : fd;
+}
+
+/* Accept and accept4 syscalls */
+uint64_t linux_sys_accept(uzl_sys_t *sys, linux_sys_args_t *args)
+{
+  uzl_fd_t *vfd = uzl_sys_fd_get(sys, args->arg[0]);
+  if(vfd == NULL)
+    return (uint64_t) -EBADF;
+  if(vfd->type != UZL_FD_SOCKET)
+    return (uint64_t) -ENOTSOCK;
+
+  /* Peer address is left empty */
+  if(args->arg[1] != 0 && args->arg[2] != 0)
+  {
+    uint32_t addr_len = 0;
+    uzl_sys_mem_write(sys, args->arg[2], &addr_len, sizeof(addr_len));
+  }
+
+  /* One connection per test case, the server waiting again ends the run */
+  if(sys->input != NULL && sys->input_conns > 0)
+  {
+    sys->exited = true;
+    uc_emu_stop(sys->uc);
+    return (uint64_t) -EAGAIN;
+  }
+
+  int32_t fd = uzl_sys_fd_alloc(sys, UZL_FD_CONN, -1);
+  if(fd < 0)
+    return (uint64_t) -EMFILE;
+
+  /* Connections carry the test case */
+  if(sys->input != NULL)
+  {
+    sys->fds[fd].input = true;
+    sys->input_conns++;
+  }
+  return fd;
+}
+
+/* Sendto syscall */
+uint64_t linux_sys_sendto(uzl_sys_t *sys, linux_sys_args_t *args)
+{
+  uzl_fd_t *vfd = uzl_sys_fd_get(sys, args->arg[0]);
+  if(vfd == NULL)
+    return (uint64_t) -EBADF;
+  if(vfd->input)
+    return uzl_sys_output_write(sys, args->arg[1], args->arg[2]);
+  if(vfd->type != UZL_FD_CONN)
+    return (uint64_t) -ENOTCONN;
+  return linux_sys_print(sys, args->arg[0], args->arg[1], args->arg[2]);
+}
+
+/* Recvfrom syscall */
+uint64_t linux_sys_recvfrom(uzl_sys_t *sys, linux_sys_args_t *args)
+{
+  uzl_fd_t *vfd = uzl_sys_fd_get(sys, args->arg[0]);
+  if(vfd == NULL)
+    return (uint64_t) -EBADF;
+  if(vfd->input)
+    return uzl_sys_input_read(sys, args->arg[1], args->arg[2]);
+  if(vfd->type != UZL_FD_CONN)
+    return (uint64_t) -ENOTCONN;
+
+  /* Peer has nothing to send */
+  return 0;
+}
+
+/* Bind, listen and setsockopt syscalls succeed on any socket */
+uint64_t linux_sys_sock_ok(uzl_sys_t *sys, linux_sys_args_t *args)
+{
+  uzl_fd_t *vfd = uzl_sys_fd_get(sys, args->arg[0]);
+  if(vfd == NULL)
+    return (uint64_t) -EBADF;
+  if(vfd->type != UZL_FD_SOCKET && vfd->type != UZL_FD_CONN)
+    return (uint64_t) -ENOTSOCK;
+  return 0;
+}
+
+/* Fork syscall */
+uint64_t linux_sys_fork(uzl_sys_t *sys, linux_sys_args_t *args)
+{
+  /* Return code*/
+  if(sys->opts->follow_child)
+    return 0;
+  return args->nr;
+}
+
+/* Clone syscall */
+uint64_t linux_sys_clone(uzl_sys_t *sys, linux_sys_args_t *args)
+{
+  /* Return code*/
+  if(sys->opts->follow_child)
+    return 0;
+  return args->nr;
+}
+
+/* Futex syscall, there are no other threads to wait for or wake */
+uint64_t linux_sys_futex(uzl_sys_t *sys, linux_sys_args_t *args)
+{
+  if((args->arg[1] & LINUX_FUTEX_CMD_MASK) == LINUX_FUTEX_WAIT)
+    return (uint64_t) -EAGAIN;
+  return 0;
+}
+
+/* Exit and exit_group syscalls */
+uint64_t linux_sys_exit_group(uzl_sys_t *sys, linux_sys_args_t *args)
+{
+  sys->exited = true;
+  sys->exit_code = (int32_t) args->arg[0];
+  if(sys->opts->verbose)
+    printf("linux_sys_exit_group: exited with %ld\n", sys->exit_code);
+  uc_emu_stop(sys->uc);
+  return 0;
+}
@@ -0,0 +1,104 @@
+#include <stdio.h>
+#include <errno.h>
+#include <stdint.h>
+#include <puzzle.h>
+#include <uuzzle.h>
+#include <unicorn.h>
+#include <stdbool.h>
+#include <linux.h>
+#include <linux_aarch64.h>
+
+
+/* Dispatch table, unlisted syscalls fail with ENOSYS */
+static const linux_sys_fn_t linux_aarch64_sys_table[LINUX_AARCH64_SYS_MAX] =
+{
+  [LINUX_AARCH64_SYS_OPENAT] = linux_sys_openat,
+  [LINUX_AARCH64_SYS_CLOSE] = linux_sys_close,
+  [LINUX_AARCH64_SYS_READ] = linux_sys_read,
+  [LINUX_AARCH64_SYS_WRITE] = linux_sys_write,
+  [LINUX_AARCH64_SYS_EXIT] = linux_sys_exit_group,
+  [LINUX_AARCH64_SYS_EXIT_GROUP] = linux_sys_exit_group,
+  [LINUX_AARCH64_SYS_FUTEX] = linux_sys_futex,
+  [LINUX_AARCH64_SYS_SOCKET] = linux_sys_socket,
+  [LINUX_AARCH64_SYS_BIND] = linux_sys_sock_ok,
+  [LINUX_AARCH64_SYS_LISTEN] = linux_sys_sock_ok,
+  [LINUX_AARCH64_SYS_ACCEPT] = linux_sys_accept,
+  [LINUX_AARCH64_SYS_SENDTO] = linux_sys_sendto,
+  [LINUX_AARCH64_SYS_RECVFROM] = linux_sys_recvfrom,
+  [LINUX_AARCH64_SYS_SETSOCKOPT] = linux_sys_sock_ok,
+  [LINUX_AARCH64_SYS_BRK] = linux_sys_brk,
+  [LINUX_AARCH64_SYS_MUNMAP] = linux_sys_munmap,
+  [LINUX_AARCH64_SYS_CLONE] = linux_sys_clone,
+  [LINUX_AARCH64_SYS_MMAP] = linux_sys_mmap,
+  [LINUX_AARCH64_SYS_MPROTECT] = linux_sys_mprotect,
+  [LINUX_AARCH64_SYS_ACCEPT4] = linux_sys_accept
+};
+
+/* Syscall number and arguments, read in one batch */
+static int linux_aarch64_sys_reg_ids[] =
+{
+  UC_ARM64_REG_X8,
+  UC_ARM64_REG_X0,
+  UC_ARM64_REG_X1,
+  UC_ARM64_REG_X2,
+  UC_ARM64_REG_X3,
+  UC_ARM64_REG_X4,
+  UC_ARM64_REG_X5
+};
+
+/* Register linux aarch64 syscalls */
+bool uzl_reg_linux_aarch64_sys(pzl_ctx_t *pzl_ctx, uc_engine *uc,
+                               uzl_sys_t *sys, uzl_opts_t *opts)
+{
+  if(uc_hook_add(uc, &(sys->hook), UC_HOOK_INTR, linux_aarch64_sys_hook_cb,
+                 sys, 1, 0) != UC_ERR_OK)
+  {
+    printf("uzl_reg_linux_aarch64_sys: cannot register syscall hook\n");
+    return false;
+  }
+  sys->hooked = true;
+  return true;
+}
+
+/* Syscall callback, pc is already past the svc */
+void linux_aarch64_sys_hook_cb(uc_engine *uc, uint32_t intno,
+                               void *user_data)
+{
+  uzl_sys_t *sys = (uzl_sys_t *) user_data;
+
+  /* Other exceptions end the run */
+  if(intno != LINUX_AARCH64_INTR_SWI)
+  {
+    if(sys->opts->verbose)
+      printf("linux_aarch64_sys_hook_cb: unhandled interrupt %u\n", intno);
+    uc_emu_stop(uc);
+    return;
+  }
+
+  linux_sys_args_t args;
+  void *vals[] =
+  {
+    &(args.nr),
+    &(args.arg[0]),
+    &(args.arg[1]),
+    &(args.arg[2]),
+    &(args.arg[3]),
+    &(args.arg[4]),
+    &(args.arg[5])
+  };
+
+  /* Get sys parameters */
+  uc_reg_read_batch(uc, linux_aarch64_sys_reg_ids, vals,
+                    sizeof(vals) / sizeof(vals[0]));
+
+  /* Dispatch on sys number */
+  uint64_t ret = (uint64_t) -ENOSYS;
+  if(args.nr < LINUX_AARCH64_SYS_MAX &&
+     linux_aarch64_sys_table[args.nr] != NULL)
+    ret = linux_aarch64_sys_table[args.nr](sys, &args);
+  else if(sys->opts->verbose)
+    printf("linux_aarch64_sys_hook_cb: unhandled syscall %lu\n", args.nr);
+
+  /* Return code */
+  uc_reg_write(uc, UC_ARM64_REG_X0, &ret);
+}
@@ -0,0 +1,175 @@
+#include <stdio.h>
+#include <errno.h>
+#include <stdint.h>
+#include <puzzle.h>
+#include <uuzzle.h>
+#include <unicorn.h>
+#include <stdbool.h>
+#include <linux.h>
+#include <linux_mips.h>
+
+
+/* Dispatch table, unlisted syscalls fail with ENOSYS */
+static const linux_sys_fn_t linux_mips_sys_table[LINUX_MIPS_SYS_MAX] =
+{
+  [LINUX_MIPS_SYS_EXIT] = linux_sys_exit_group,
+  [LINUX_MIPS_SYS_FORK] = linux_sys_fork,
+  [LINUX_MIPS_SYS_READ] = linux_sys_read,
+  [LINUX_MIPS_SYS_WRITE] = linux_sys_write,
+  [LINUX_MIPS_SYS_OPEN] = linux_sys_open,
+  [LINUX_MIPS_SYS_CLOSE] = linux_sys_close,
+  [LINUX_MIPS_SYS_BRK] = linux_sys_brk,
+  [LINUX_MIPS_SYS_MMAP] = linux_mips_sys_mmap,
+  [LINUX_MIPS_SYS_MUNMAP] = linux_sys_munmap,
+  [LINUX_MIPS_SYS_CLONE] = linux_sys_clone,
+  [LINUX_MIPS_SYS_MPROTECT] = linux_sys_mprotect,
+  [LINUX_MIPS_SYS_ACCEPT] = linux_sys_accept,
+  [LINUX_MIPS_SYS_BIND] = linux_sys_sock_ok,
+  [LINUX_MIPS_SYS_LISTEN] = linux_sys_sock_ok,
+  [LINUX_MIPS_SYS_RECVFROM] = linux_sys_recvfrom,
+  [LINUX_MIPS_SYS_SENDTO] = linux_sys_sendto,
+  [LINUX_MIPS_SYS_SETSOCKOPT] = linux_sys_sock_ok,
+  [LINUX_MIPS_SYS_SOCKET] = linux_sys_socket,
+  [LINUX_MIPS_SYS_MMAP2] = linux_mips_sys_mmap2,
+  [LINUX_MIPS_SYS_FUTEX] = linux_sys_futex,
+  [LINUX_MIPS_SYS_EXIT_GROUP] = linux_sys_exit_group,
+  [LINUX_MIPS_SYS_OPENAT] = linux_sys_openat,
+  [LINUX_MIPS_SYS_ACCEPT4] = linux_sys_accept
+};
+
+/* Syscall number and register arguments, read in one batch */
+static int linux_mips_sys_reg_ids[] =
+{
+  UC_MIPS_REG_V0,
+  UC_MIPS_REG_A0,
+  UC_MIPS_REG_A1,
+  UC_MIPS_REG_A2,
+  UC_MIPS_REG_A3,
+  UC_MIPS_REG_SP
+};
+
+/* Register linux mips o32 syscalls */
+bool uzl_reg_linux_mips_sys(pzl_ctx_t *pzl_ctx, uc_engine *uc,
+                            uzl_sys_t *sys, uzl_opts_t *opts)
+{
+  /* Anonymous mappings stay in the 32 bit address space */
+  sys->mmap_next = UZL_SYS_MMAP_BASE_32;
+
+  if(uc_hook_add(uc, &(sys->hook), UC_HOOK_INTR, linux_mips_sys_hook_cb,
+                 sys, 1, 0) != UC_ERR_OK)
+  {
+    printf("uzl_reg_linux_mips_sys: cannot register syscall hook\n");
+    return false;
+  }
+  sys->hooked = true;
+  return true;
+}
+
+/* Errno values where mips departs from the generic numbering */
+static uint64_t linux_mips_errno(uint64_t err)
+{
+  switch(err)
+  {
+    case ENAMETOOLONG:
+      return 78;
+    case ENOSYS:
+      return 89;
+    case ELOOP:
+      return 90;
+    case ENOTEMPTY:
+      return 93;
+    case ENOTSOCK:
+      return 95;
+    case ENOTCONN:
+      return 134;
+    default:
+      return err;
+  }
+}
+
+/* Syscall callback, unicorn resumes after the syscall once it returns */
+void linux_mips_sys_hook_cb(uc_engine *uc, uint32_t intno, void *user_data)
+{
+  uzl_sys_t *sys = (uzl_sys_t *) user_data;
+
+  /* Other exceptions end the run */
+  if(intno != LINUX_MIPS_INTR_SYSCALL)
+  {
+    if(sys->opts->verbose)
+      printf("linux_mips_sys_hook_cb: unhandled interrupt %u\n", intno);
+    uc_emu_stop(uc);
+    return;
+  }
+
+  /* Registers are 32 bit, the upper halves stay clear */
+  linux_sys_args_t args = {0};
+  uint64_t sp = 0;
+  void *vals[] =
+  {
+    &(args.nr),
+    &(args.arg[0]),
+    &(args.arg[1]),
+    &(args.arg[2]),
+    &(args.arg[3]),
+    &sp
+  };
+
+  /* Get sys parameters */
+  uc_reg_read_batch(uc, linux_mips_sys_reg_ids, vals,
+                    sizeof(vals) / sizeof(vals[0]));
+
+  /* Fifth and sixth arguments are passed on the stack in target order */
+  uint8_t stack[8];
+  if(uc_mem_read(uc, sp + 16, stack, sizeof(stack)) == UC_ERR_OK)
+  {
+    usr_regs_mips_t *usr_reg = sys->pzl_ctx->reg_rec->usr_reg;
+    uint32_t idx;
+    for(idx = 0; idx < 2; idx++)
+    {
+      uint8_t *word = stack + idx * 4;
+      args.arg[4 + idx] = usr_reg->big_endian ?
+        (uint32_t) word[0] << 24 | word[1] << 16 | word[2] << 8 | word[3] :
+        (uint32_t) word[3] << 24 | word[2] << 16 | word[1] << 8 | word[0];
+    }
+  }
+
+  /* Dispatch on sys number */
+  uint64_t ret = (uint64_t) -ENOSYS;
+  uint64_t nr = args.nr - LINUX_MIPS_SYS_BASE;
+  if(nr < LINUX_MIPS_SYS_MAX && linux_mips_sys_table[nr] != NULL)
+    ret = linux_mips_sys_table[nr](sys, &args);
+  else if(sys->opts->verbose)
+    printf("linux_mips_sys_hook_cb: unhandled syscall %lu\n", args.nr);
+
+  /* Result in v0, a3 flags a positive errno */
+  uint64_t err = 0;
+  if(ret > (uint64_t) -LINUX_MAX_ERRNO)
+  {
+    ret = linux_mips_errno(-ret);
+    err = 1;
+  }
+  uc_reg_write(uc, UC_MIPS_REG_V0, &ret);
+  uc_reg_write(uc, UC_MIPS_REG_A3, &err);
+}
+
+/* Translate mips mmap flags to the generic values */
+static void linux_mips_sys_map_flags(linux_sys_args_t *args)
+{
+  if(args->arg[3] & LINUX_MIPS_MAP_ANONYMOUS)
+    args->arg[3] = (args->arg[3] & ~(uint64_t) LINUX_MIPS_MAP_ANONYMOUS) |
+                   LINUX_MAP_ANONYMOUS;
+}
+
+/* Mmap syscall */
+uint64_t linux_mips_sys_mmap(uzl_sys_t *sys, linux_sys_args_t *args)
+{
+  linux_mips_sys_map_flags(args);
+  return linux_sys_mmap(sys, args);
+}
+
+/* Mmap2 syscall */
+uint64_t linux_mips_sys_mmap2(uzl_sys_t *sys, linux_sys_args_t *args)
+{
+  linux_mips_sys_map_flags(args);
+  return linux_sys_mmap2(sys, args);
+}
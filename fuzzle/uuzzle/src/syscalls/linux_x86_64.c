@@ -1,105 +1,95 @@
+#include <stdio.h>
+#include <errno.h>
 #include <stdint.h>
-#include <stdlib.h>
-#include <string.h>
-#include <unistd.h>
 #include <puzzle.h>
 #include <uuzzle.h>
 #include <unicorn.h>
 #include <stdbool.h>
+#include <linux.h>
 #include <linux_x86_64.h>
 
 
-/* Register linux x86_64 syscalls */
-bool uzl_reg_linux_x86_64_sys(pzl_ctx_t *pzl_ctx, uc_engine *uc,
-                              uc_hook *sys_hook, uzl_opts_t *opts)
+/* Dispatch table, unlisted syscalls fail with ENOSYS */
+static const linux_sys_fn_t linux_x86_64_sys_table[LINUX_X86_64_SYS_MAX] =
 {
-  uc_hook_add(uc, sys_hook, UC_HOOK_INSN, linux_x86_64_sys_hook_cb,
-              (void *) opts, 1, 0, UC_X86_INS_SYSCALL);
-  return true;
-}
+  [LINUX_X86_64_SYS_READ] = linux_sys_read,
+  [LINUX_X86_64_SYS_WRITE] = linux_sys_write,
+  [LINUX_X86_64_SYS_OPEN] = linux_sys_open,
+  [LINUX_X86_64_SYS_CLOSE] = linux_sys_close,
+  [LINUX_X86_64_SYS_MMAP] = linux_sys_mmap,
+  [LINUX_X86_64_SYS_MPROTECT] = linux_sys_mprotect,
+  [LINUX_X86_64_SYS_MUNMAP] = linux_sys_munmap,
+  [LINUX_X86_64_SYS_BRK] = linux_sys_brk,
+  [LINUX_X86_64_SYS_SOCKET] = linux_sys_socket,
+  [LINUX_X86_64_SYS_ACCEPT] = linux_sys_accept,
+  [LINUX_X86_64_SYS_SENDTO] = linux_sys_sendto,
+  [LINUX_X86_64_SYS_RECVFROM] = linux_sys_recvfrom,
+  [LINUX_X86_64_SYS_BIND] = linux_sys_sock_ok,
+  [LINUX_X86_64_SYS_LISTEN] = linux_sys_sock_ok,
+  [LINUX_X86_64_SYS_SETSOCKOPT] = linux_sys_sock_ok,
+  [LINUX_X86_64_SYS_CLONE] = linux_sys_clone,
+  [LINUX_X86_64_SYS_FORK] = linux_sys_fork,
+  [LINUX_X86_64_SYS_EXIT] = linux_sys_exit_group,
+  [LINUX_X86_64_SYS_FUTEX] = linux_sys_futex,
+  [LINUX_X86_64_SYS_EXIT_GROUP] = linux_sys_exit_group,
+  [LINUX_X86_64_SYS_OPENAT] = linux_sys_openat,
+  [LINUX_X86_64_SYS_ACCEPT4] = linux_sys_accept
+};
 
-/* Syscall callback */
-void linux_x86_64_sys_hook_cb(uc_engine *uc, void *usr_data, uzl_opts_t *opts)
+/* Syscall number and arguments, read in one batch */
+static int linux_x86_64_sys_reg_ids[] =
 {
-  linux_x86_64_sys_regs_t sys_regs;
+  UC_X86_REG_RAX,
+  UC_X86_REG_RDI,
+  UC_X86_REG_RSI,
+  UC_X86_REG_RDX,
+  UC_X86_REG_R10,
+  UC_X86_REG_R8,
+  UC_X86_REG_R9
+};
 
-  /* Get sys parameters */
-  uc_reg_read(uc, UC_X86_REG_RAX, &(sys_regs.rax));
-  uc_reg_read(uc, UC_X86_REG_RDI, &(sys_regs.rdi));
-  uc_reg_read(uc, UC_X86_REG_RSI, &(sys_regs.rsi));
-  uc_reg_read(uc, UC_X86_REG_RDX, &(sys_regs.rdx));
-  uc_reg_read(uc, UC_X86_REG_R10, &(sys_regs.r10));
-  uc_reg_read(uc, UC_X86_REG_R8, &(sys_regs.r8));
-  uc_reg_read(uc, UC_X86_REG_R9, &(sys_regs.r9));
-
-  /* Parse sys number */
-  switch(sys_regs.rax)
+/* Register linux x86_64 syscalls */
+bool uzl_reg_linux_x86_64_sys(pzl_ctx_t *pzl_ctx, uc_engine *uc,
+                              uzl_sys_t *sys, uzl_opts_t *opts)
+{
+  if(uc_hook_add(uc, &(sys->hook), UC_HOOK_INSN, linux_x86_64_sys_hook_cb,
+                 sys, 1, 0, UC_X86_INS_SYSCALL) != UC_ERR_OK)
   {
-    case LINUX_X86_64_SYS_WRITE:
-      linux_x86_64_sys_write(uc, &sys_regs, (uzl_opts_t *) usr_data);
-      break;
-    case LINUX_X86_64_SYS_CLONE:
-      linux_x86_64_sys_clone(uc, &sys_regs, (uzl_opts_t *) usr_data);
-      break;
-    case LINUX_X86_64_SYS_FORK:
-      linux_x86_64_sys_fork(uc, &sys_regs, (uzl_opts_t *) usr_data);
-      break;
-    default:
-      return;
+    printf("uzl_reg_linux_x86_64_sys: cannot register syscall hook\n");
+    return false;
   }
+  sys->hooked = true;
+  return true;
 }
 
-/* Write syscall */
-void linux_x86_64_sys_write(uc_engine *uc, linux_x86_64_sys_regs_t *sys_regs,
-                            uzl_opts_t *opts)
+/* Syscall callback */
+void linux_x86_64_sys_hook_cb(uc_engine *uc, void *user_data)
 {
-  /* Quiet mode */ 
-  if(opts->quiet)
-    return;
-
-  /* Emulate syscall */
-  uint8_t *buf = calloc(1, sys_regs->rdx);
-  uc_mem_read(uc, sys_regs->rsi, buf, sys_regs->rdx);
-
-  /* Write to stdout */
-  switch(sys_regs->rdi)
+  uzl_sys_t *sys = (uzl_sys_t *) user_data;
+  linux_sys_args_t args;
+  void *vals[] =
   {
-    case STDIN_FILENO:
-      printf("stdin>:  %s", buf);
-      break;
-    case STDOUT_FILENO:
-      printf("stdout>: %s", buf);
-      break;
-    case STDERR_FILENO:
-      printf("stderr>: %s", buf);
-      break;
-    default:
-      printf("fd %lu>:\t%s", (uint64_t) sys_regs->rdi, buf);
-  }
-
-  /* Return code*/
-  uc_reg_write(uc, UC_X86_REG_RAX, &(sys_regs->rdx));
+    &(args.nr),
+    &(args.arg[0]),
+    &(args.arg[1]),
+    &(args.arg[2]),
+    &(args.arg[3]),
+    &(args.arg[4]),
+    &(args.arg[5])
+  };
 
-  /* Cleanup */
-  free(buf);
-}
+  /* Get sys parameters */
+  uc_reg_read_batch(uc, linux_x86_64_sys_reg_ids, vals,
+                    sizeof(vals) / sizeof(vals[0]));
 
-/* Fork syscall */
-void linux_x86_64_sys_fork(uc_engine *uc, linux_x86_64_sys_regs_t *sys_regs,
-                          uzl_opts_t *opts)
-{
-  /* Return code*/
-  if(opts->follow_child)
-    sys_regs->rax = 0;
-  uc_reg_write(uc, UC_X86_REG_RAX, &(sys_regs->rax));
-}
+  /* Dispatch on sys number */
+  uint64_t ret = (uint64_t) -ENOSYS;
+  if(args.nr < LINUX_X86_64_SYS_MAX &&
+     linux_x86_64_sys_table[args.nr] != NULL)
+    ret = linux_x86_64_sys_table[args.nr](sys, &args);
+  else if(sys->opts->verbose)
+    printf("linux_x86_64_sys_hook_cb: unhandled syscall %lu\n", args.nr);
 
-/* Fork syscall */
-void linux_x86_64_sys_clone(uc_engine *uc, linux_x86_64_sys_regs_t *sys_regs,
-                           uzl_opts_t *opts)
-{
-  /* Return code*/
-  if(opts->follow_child)
-    sys_regs->rax = 0;
-  uc_reg_write(uc, UC_X86_REG_RAX, &(sys_regs->rax));
+  /* Return code */
+  uc_reg_write(uc, UC_X86_REG_RAX, &ret);
 }
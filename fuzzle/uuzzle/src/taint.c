@@ -0,0 +1,559 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <puzzle.h>
+#include <uuzzle.h>
+#include <unicorn.h>
+#include <capstone.h>
+
+
+/* Span of input offsets covering both tags */
+static uint32_t uzl_taint_merge(uint32_t tag0, uint32_t tag1)
+{
+  if(tag0 == 0)
+    return tag1;
+  if(tag1 == 0)
+    return tag0;
+
+  uint32_t first = (tag0 & 0xffff) < (tag1 & 0xffff) ?
+                   tag0 & 0xffff : tag1 & 0xffff;
+  uint32_t last = (tag0 >> 16) > (tag1 >> 16) ? tag0 >> 16 : tag1 >> 16;
+  return first | (last << 16);
+}
+
+/* Slot of a page in the shadow table */
+static uint64_t uzl_taint_slot(uzl_taint_t *taint, uint64_t page)
+{
+  uint64_t slot = ((page >> 12) * 0x9e3779b97f4a7c15) & (taint->tbl_cap - 1);
+  while(taint->tbl[slot] != 0 &&
+        taint->page_addr[taint->tbl[slot] - 1] != page)
+    slot = (slot + 1) & (taint->tbl_cap - 1);
+  return slot;
+}
+
+/* Grow page list and table ahead of another shadow page */
+static bool uzl_taint_grow(uzl_taint_t *taint)
+{
+  uint64_t idx;
+
+  /* Page list */
+  if(taint->page_cnt == taint->page_cap)
+  {
+    uint64_t cap = taint->page_cap * 2;
+    uint64_t *addr = realloc(taint->page_addr, cap * sizeof(uint64_t));
+    if(addr == NULL)
+      return false;
+    taint->page_addr = addr;
+    uint32_t **tags = realloc(taint->page_tags, cap * sizeof(uint32_t *));
+    if(tags == NULL)
+      return false;
+    taint->page_tags = tags;
+    taint->page_cap = cap;
+  }
+
+  /* Table stays at most half full */
+  if((taint->page_cnt + 1) * 2 > taint->tbl_cap)
+  {
+    uint64_t *tbl = calloc(taint->tbl_cap * 2, sizeof(uint64_t));
+    if(tbl == NULL)
+      return false;
+    free(taint->tbl);
+    taint->tbl = tbl;
+    taint->tbl_cap *= 2;
+    for(idx = 0; idx < taint->page_cnt; idx++)
+      taint->tbl[uzl_taint_slot(taint, taint->page_addr[idx])] = idx + 1;
+  }
+  return true;
+}
+
+/* Shadow tags of a page, NULL when it has none and alloc is false */
+static uint32_t *uzl_taint_page(uzl_taint_t *taint, uint64_t page, bool alloc)
+{
+  if(page == taint->last_page && (taint->last_tags != NULL || !alloc))
+    return taint->last_tags;
+
+  uint64_t slot = uzl_taint_slot(taint, page);
+  uint32_t *tags = NULL;
+  if(taint->tbl[slot] != 0)
+    tags = taint->page_tags[taint->tbl[slot] - 1];
+  else if(alloc)
+  {
+    if(!uzl_taint_grow(taint) ||
+       (tags = calloc(PZL_PAGE_SIZE, sizeof(uint32_t))) == NULL)
+    {
+      printf("uzl_taint_page: cannot shadow page %p\n", (void *) page);
+      return NULL;
+    }
+    slot = uzl_taint_slot(taint, page);
+    taint->page_addr[taint->page_cnt] = page;
+    taint->page_tags[taint->page_cnt] = tags;
+    taint->tbl[slot] = ++taint->page_cnt;
+  }
+
+  /* Consecutive accesses mostly stay on one page */
+  taint->last_page = page;
+  taint->last_tags = tags;
+  return tags;
+}
+
+/* Span of the tags of len guest bytes at addr */
+uint32_t uzl_taint_mem(uzl_taint_t *taint, uint64_t addr, uint64_t len)
+{
+  uint32_t tag = 0;
+  uint64_t idx;
+  if(taint->tbl == NULL)
+    return 0;
+
+  for(idx = 0; idx < len; idx++)
+  {
+    uint64_t cur = addr + idx;
+    uint32_t *tags = uzl_taint_page(taint,
+                                    cur & ~((uint64_t) PZL_PAGE_SIZE - 1),
+                                    false);
+    if(tags != NULL)
+      tag = uzl_taint_merge(tag, tags[cur % PZL_PAGE_SIZE]);
+  }
+  return tag;
+}
+
+/* Tag len guest bytes at addr, clean writes leave unshadowed pages alone */
+static bool uzl_taint_set(uzl_taint_t *taint, uint64_t addr, uint64_t len,
+                          uint32_t tag)
+{
+  uint64_t idx;
+  for(idx = 0; idx < len; idx++)
+  {
+    uint64_t cur = addr + idx;
+    uint32_t *tags = uzl_taint_page(taint,
+                                    cur & ~((uint64_t) PZL_PAGE_SIZE - 1),
+                                    tag != 0);
+    if(tags == NULL)
+    {
+      if(tag != 0)
+        return false;
+      continue;
+    }
+    tags[cur % PZL_PAGE_SIZE] = tag;
+  }
+  return true;
+}
+
+/* Tag len guest bytes at addr as input from offset off on */
+bool uzl_taint_input(uzl_taint_t *taint, uint64_t addr, uint64_t off,
+                     uint64_t len)
+{
+  uint64_t idx;
+  if(taint->tbl == NULL)
+    return true;
+
+  for(idx = 0; idx < len; idx++)
+  {
+    if(!uzl_taint_set(taint, addr + idx, 1, UZL_TAINT_TAG(off + idx)))
+      return false;
+  }
+  return true;
+}
+
+/* Slot of a sink in the sink table */
+static uint64_t uzl_taint_sink_slot(uzl_taint_t *taint, uint64_t addr,
+                                    uint8_t arg)
+{
+  uint64_t slot = ((addr + arg) * 0x9e3779b97f4a7c15) &
+                  (taint->sink_tbl_cap - 1);
+  while(taint->sink_tbl[slot] != 0 &&
+        (taint->sink[taint->sink_tbl[slot] - 1].addr != addr ||
+         taint->sink[taint->sink_tbl[slot] - 1].arg != arg))
+    slot = (slot + 1) & (taint->sink_tbl_cap - 1);
+  return slot;
+}
+
+/* Grow sink list and table ahead of another sink */
+static bool uzl_taint_sink_grow(uzl_taint_t *taint)
+{
+  uint64_t idx;
+  if(taint->sink_cnt == taint->sink_cap)
+  {
+    uzl_taint_sink_t *sink = realloc(taint->sink, taint->sink_cap * 2 *
+                                     sizeof(uzl_taint_sink_t));
+    if(sink == NULL)
+      return false;
+    taint->sink = sink;
+    taint->sink_cap *= 2;
+  }
+
+  /* Table stays at most half full */
+  if((taint->sink_cnt + 1) * 2 > taint->sink_tbl_cap)
+  {
+    uint64_t *tbl = calloc(taint->sink_tbl_cap * 2, sizeof(uint64_t));
+    if(tbl == NULL)
+      return false;
+    free(taint->sink_tbl);
+    taint->sink_tbl = tbl;
+    taint->sink_tbl_cap *= 2;
+    for(idx = 0; idx < taint->sink_cnt; idx++)
+      taint->sink_tbl[uzl_taint_sink_slot(taint, taint->sink[idx].addr,
+                                          taint->sink[idx].arg)] = idx + 1;
+  }
+  return true;
+}
+
+/* Record input reaching the sink at addr */
+static void uzl_taint_hit(uzl_taint_t *taint, uint64_t addr, uint8_t type,
+                          uint8_t arg, uint32_t tag)
+{
+  uint64_t slot = uzl_taint_sink_slot(taint, addr, arg);
+  uzl_taint_sink_t *sink;
+  if(taint->sink_tbl[slot] == 0)
+  {
+    if(!uzl_taint_sink_grow(taint))
+      return;
+    slot = uzl_taint_sink_slot(taint, addr, arg);
+    sink = &(taint->sink[taint->sink_cnt]);
+    memset(sink, 0, sizeof(uzl_taint_sink_t));
+    sink->addr = addr;
+    sink->type = type;
+    sink->arg = arg;
+    taint->sink_tbl[slot] = ++taint->sink_cnt;
+  }
+  else
+    sink = &(taint->sink[taint->sink_tbl[slot] - 1]);
+  sink->tag = uzl_taint_merge(sink->tag, tag);
+  sink->hits++;
+}
+
+/* Add a register slot to the sources or destinations of ins once */
+bool uzl_taint_ins_add(uzl_taint_ins_t *ins, bool dst, uint8_t reg)
+{
+  uint8_t *regs = dst ? ins->dst : ins->src;
+  uint8_t *cnt = dst ? &(ins->dst_cnt) : &(ins->src_cnt);
+  uint8_t idx;
+  if(reg == UZL_TAINT_REG_NONE)
+    return true;
+
+  for(idx = 0; idx < *cnt; idx++)
+  {
+    if(regs[idx] == reg)
+      return true;
+  }
+  if(*cnt == UZL_TAINT_INS_REGS)
+    return false;
+  regs[(*cnt)++] = reg;
+  return true;
+}
+
+/* Kind by capstone group, the backend refines it */
+static uint8_t uzl_taint_kind(cs_insn *insn)
+{
+  cs_detail *detail = insn->detail;
+  uint8_t kind = UZL_TAINT_INS_FLOW;
+  uint8_t idx;
+  for(idx = 0; idx < detail->groups_count; idx++)
+  {
+    switch(detail->groups[idx])
+    {
+      case CS_GRP_INT:
+        return UZL_TAINT_INS_SYSCALL;
+      case CS_GRP_JUMP:
+      case CS_GRP_CALL:
+      case CS_GRP_RET:
+        kind = UZL_TAINT_INS_BRANCH;
+        break;
+    }
+  }
+  return kind;
+}
+
+/* Slot of an address in the instruction cache */
+static uint64_t uzl_taint_ins_slot(uzl_taint_t *taint, uint64_t addr)
+{
+  uint64_t slot = (addr * 0x9e3779b97f4a7c15) & (taint->ent_cap - 1);
+  while(taint->ent[slot].used && taint->ent[slot].addr != addr)
+    slot = (slot + 1) & (taint->ent_cap - 1);
+  return slot;
+}
+
+/* Double the instruction cache */
+static bool uzl_taint_ins_grow(uzl_taint_t *taint)
+{
+  uzl_taint_ins_t *old_ent = taint->ent;
+  uint64_t old_cap = taint->ent_cap;
+  uint64_t idx;
+
+  taint->ent = calloc(old_cap * 2, sizeof(uzl_taint_ins_t));
+  if(taint->ent == NULL)
+  {
+    taint->ent = old_ent;
+    return false;
+  }
+  taint->ent_cap = old_cap * 2;
+  for(idx = 0; idx < old_cap; idx++)
+  {
+    if(old_ent[idx].used)
+      taint->ent[uzl_taint_ins_slot(taint, old_ent[idx].addr)] = old_ent[idx];
+  }
+  free(old_ent);
+  return true;
+}
+
+/* Decoded instruction at addr, disassembled once */
+static uzl_taint_ins_t *uzl_taint_ins(uzl_taint_t *taint, uc_engine *uc,
+                                      uint64_t addr, uint32_t size)
+{
+  uint64_t slot = uzl_taint_ins_slot(taint, addr);
+  if(taint->ent[slot].used)
+    return &(taint->ent[slot]);
+
+  /* Table stays at most half full */
+  if((taint->ent_cnt + 1) * 2 > taint->ent_cap)
+  {
+    if(!uzl_taint_ins_grow(taint))
+      return NULL;
+    slot = uzl_taint_ins_slot(taint, addr);
+  }
+
+  /* Instructions the backend cannot describe are kept as NONE */
+  uzl_taint_ins_t *ins = &(taint->ent[slot]);
+  const uint8_t *code = taint->code;
+  size_t code_size = size < sizeof(taint->code) ? size : sizeof(taint->code);
+  uint64_t code_addr = addr;
+  memset(ins, 0, sizeof(uzl_taint_ins_t));
+  if(uc_mem_read(uc, addr, taint->code, code_size) == UC_ERR_OK &&
+     cs_disasm_iter(taint->handle, &code, &code_size, &code_addr,
+                    taint->insn))
+  {
+    ins->kind = uzl_taint_kind(taint->insn);
+    if(!taint->arch->get_taint(taint->insn, ins))
+      memset(ins, 0, sizeof(uzl_taint_ins_t));
+  }
+
+  ins->addr = addr;
+  ins->used = true;
+  taint->ent_cnt++;
+  return ins;
+}
+
+/* Land the register results of the instruction in flight */
+static void uzl_taint_flush(uzl_taint_t *taint)
+{
+  uzl_taint_ins_t *ins = taint->pend;
+  uint8_t idx;
+  if(ins == NULL)
+    return;
+  taint->pend = NULL;
+
+  uint32_t tag = uzl_taint_merge(taint->pend_src, taint->pend_mem);
+  if(ins->kind == UZL_TAINT_INS_BRANCH && tag != 0)
+    uzl_taint_hit(taint, ins->addr, UZL_TAINT_SINK_BRANCH, 0, tag);
+  if(ins->kind != UZL_TAINT_INS_FLOW)
+    tag = 0;
+  for(idx = 0; idx < ins->dst_cnt; idx++)
+    taint->regs[ins->dst[idx]] = tag;
+}
+
+/* Instruction callback, the previous instruction's registers land first */
+static void uzl_taint_hook_code(uc_engine *uc, uint64_t address,
+                                uint32_t size, void *user_data)
+{
+  uzl_taint_t *taint = (uzl_taint_t *) user_data;
+  uzl_taint_flush(taint);
+
+  uzl_taint_ins_t *ins = uzl_taint_ins(taint, uc, address, size);
+  if(ins == NULL || ins->kind == UZL_TAINT_INS_NONE)
+    return;
+
+  /* Syscall arguments are read before the handler runs */
+  uint32_t tag = 0;
+  uint8_t idx;
+  for(idx = 0; idx < ins->src_cnt; idx++)
+  {
+    uint32_t reg_tag = taint->regs[ins->src[idx]];
+    if(ins->kind == UZL_TAINT_INS_SYSCALL && reg_tag != 0)
+      uzl_taint_hit(taint, address, UZL_TAINT_SINK_SYSCALL, idx, reg_tag);
+    tag = uzl_taint_merge(tag, reg_tag);
+  }
+  taint->pend = ins;
+  taint->pend_src = tag;
+  taint->pend_mem = 0;
+}
+
+/* Memory callback, reads add to the sources and writes take them */
+static void uzl_taint_hook_mem(uc_engine *uc, uc_mem_type type,
+                               uint64_t address, int size, int64_t value,
+                               void *user_data)
+{
+  uzl_taint_t *taint = (uzl_taint_t *) user_data;
+  if(type == UC_MEM_READ)
+  {
+    if(taint->pend != NULL)
+      taint->pend_mem = uzl_taint_merge(taint->pend_mem,
+                                        uzl_taint_mem(taint, address, size));
+    return;
+  }
+
+  /* Anything but data flow stores clean bytes, as a call's return address */
+  uint32_t tag = 0;
+  if(taint->pend != NULL && taint->pend->kind == UZL_TAINT_INS_FLOW)
+    tag = uzl_taint_merge(taint->pend_src, taint->pend_mem);
+  uzl_taint_set(taint, address, size, tag);
+}
+
+/*
+Track input through runs with --taint. Input the snapshot already holds
+is tagged with uzl_taint_input, input served through sys as it is read.
+Libc summaries stay off meanwhile since their copies bypass the hooks.
+Free before sys.
+*/
+bool uzl_taint_init(uzl_taint_t **taint, pzl_ctx_t *pzl_ctx, uc_engine *uc,
+                    uzl_sys_t *sys, uzl_opts_t *opts)
+{
+  uint32_t arch, mode;
+  uzl_taint_t *new_taint = calloc(1, sizeof(uzl_taint_t));
+  if(new_taint == NULL)
+  {
+    printf("uzl_taint_init: cannot allocate taint state\n");
+    return false;
+  }
+  new_taint->uc = uc;
+  new_taint->last_page = 1;
+  new_taint->arch = uzl_get_arch(pzl_ctx);
+  if(new_taint->arch == NULL)
+  {
+    printf("uzl_taint_init: unknown architecture\n");
+    uzl_taint_free(new_taint);
+    return false;
+  }
+  if(!opts->taint)
+  {
+    *taint = new_taint;
+    return true;
+  }
+
+  /* Capstone with operand details */
+  if(!uzl_get_cs_arch(pzl_ctx, &arch) || !uzl_get_cs_mode(pzl_ctx, &mode) ||
+     cs_open(arch, mode, &(new_taint->handle)) != CS_ERR_OK)
+  {
+    printf("uzl_taint_init: cannot initialise capstone\n");
+    uzl_taint_free(new_taint);
+    return false;
+  }
+  new_taint->cs_open = true;
+  if(cs_option(new_taint->handle, CS_OPT_DETAIL, CS_OPT_ON) != CS_ERR_OK ||
+     (new_taint->insn = cs_malloc(new_taint->handle)) == NULL)
+  {
+    printf("uzl_taint_init: cannot enable capstone details\n");
+    uzl_taint_free(new_taint);
+    return false;
+  }
+
+  /* Instruction cache, shadow pages and sinks */
+  new_taint->ent_cap = UZL_TAINT_CACHE_SIZE;
+  new_taint->ent = calloc(new_taint->ent_cap, sizeof(uzl_taint_ins_t));
+  new_taint->page_cap = UZL_TAINT_PAGES;
+  new_taint->page_addr = calloc(new_taint->page_cap, sizeof(uint64_t));
+  new_taint->page_tags = calloc(new_taint->page_cap, sizeof(uint32_t *));
+  new_taint->tbl_cap = UZL_TAINT_PAGES * 2;
+  new_taint->tbl = calloc(new_taint->tbl_cap, sizeof(uint64_t));
+  new_taint->sink_cap = UZL_TAINT_SINKS;
+  new_taint->sink = calloc(new_taint->sink_cap, sizeof(uzl_taint_sink_t));
+  new_taint->sink_tbl_cap = UZL_TAINT_SINKS * 2;
+  new_taint->sink_tbl = calloc(new_taint->sink_tbl_cap, sizeof(uint64_t));
+  if(new_taint->ent == NULL || new_taint->page_addr == NULL ||
+     new_taint->page_tags == NULL || new_taint->tbl == NULL ||
+     new_taint->sink == NULL || new_taint->sink_tbl == NULL)
+  {
+    printf("uzl_taint_init: cannot allocate taint buffers\n");
+    uzl_taint_free(new_taint);
+    return false;
+  }
+
+  /* Every instruction and data access, data flows through all code */
+  if(uc_hook_add(uc, &(new_taint->hooks[0]), UC_HOOK_CODE,
+                 uzl_taint_hook_code, new_taint, 1, 0) != UC_ERR_OK)
+  {
+    printf("uzl_taint_init: cannot register instruction hook\n");
+    uzl_taint_free(new_taint);
+    return false;
+  }
+  new_taint->hook_cnt++;
+  if(uc_hook_add(uc, &(new_taint->hooks[1]),
+                 UC_HOOK_MEM_READ | UC_HOOK_MEM_WRITE, uzl_taint_hook_mem,
+                 new_taint, 1, 0) != UC_ERR_OK)
+  {
+    printf("uzl_taint_init: cannot register memory hook\n");
+    uzl_taint_free(new_taint);
+    return false;
+  }
+  new_taint->hook_cnt++;
+
+  if(sys != NULL)
+  {
+    new_taint->sys = sys;
+    sys->taint = new_taint;
+  }
+  *taint = new_taint;
+  return true;
+}
+
+/* Start a new run untainted, shadow pages stay allocated for the next */
+bool uzl_taint_reset(uzl_taint_t *taint)
+{
+  uint64_t idx;
+  for(idx = 0; idx < taint->page_cnt; idx++)
+    memset(taint->page_tags[idx], 0, PZL_PAGE_SIZE * sizeof(uint32_t));
+  memset(taint->regs, 0, sizeof(taint->regs));
+  if(taint->sink_tbl != NULL)
+    memset(taint->sink_tbl, 0, taint->sink_tbl_cap * sizeof(uint64_t));
+  taint->sink_cnt = 0;
+  taint->pend = NULL;
+  return true;
+}
+
+/* Print the branches and syscall arguments input reached this run */
+bool uzl_taint_report(uzl_taint_t *taint)
+{
+  uint64_t idx;
+  uzl_taint_flush(taint);
+  for(idx = 0; idx < taint->sink_cnt; idx++)
+  {
+    uzl_taint_sink_t *sink = &(taint->sink[idx]);
+    if(sink->type == UZL_TAINT_SINK_BRANCH)
+      printf("uzl_taint_report: branch at %p on input %u-%u, %lu hits\n",
+             (void *) sink->addr, UZL_TAINT_FIRST(sink->tag),
+             UZL_TAINT_LAST(sink->tag), sink->hits);
+    else
+      printf("uzl_taint_report: syscall at %p argument %u on input %u-%u, "
+             "%lu hits\n", (void *) sink->addr, sink->arg,
+             UZL_TAINT_FIRST(sink->tag), UZL_TAINT_LAST(sink->tag),
+             sink->hits);
+  }
+  return true;
+}
+
+/* Remove hooks and free shadow pages and caches */
+bool uzl_taint_free(uzl_taint_t *taint)
+{
+  if(taint == NULL)
+    return false;
+
+  uint64_t idx;
+  for(idx = 0; idx < taint->hook_cnt; idx++)
+    uc_hook_del(taint->uc, taint->hooks[idx]);
+  if(taint->sys != NULL && taint->sys->taint == taint)
+    taint->sys->taint = NULL;
+
+  for(idx = 0; idx < taint->page_cnt; idx++)
+    free(taint->page_tags[idx]);
+  free(taint->page_tags);
+  free(taint->page_addr);
+  free(taint->tbl);
+  free(taint->sink);
+  free(taint->sink_tbl);
+  free(taint->ent);
+  if(taint->insn != NULL)
+    cs_free(taint->insn, 1);
+  if(taint->cs_open)
+    cs_close(&(taint->handle));
+  free(taint);
+  return true;
+}
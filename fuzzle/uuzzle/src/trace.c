@@ -0,0 +1,274 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <puzzle.h>
+#include <uuzzle.h>
+#include <unicorn.h>
+#include <capstone.h>
+
+
+/* Slot of an address in the instruction cache */
+static uint64_t uzl_trace_slot(uzl_trace_t *trace, uint64_t addr)
+{
+  uint64_t slot = (addr * 0x9e3779b97f4a7c15) & (trace->ent_cap - 1);
+  while(trace->ent[slot].insn != NULL && trace->ent[slot].addr != addr)
+    slot = (slot + 1) & (trace->ent_cap - 1);
+  return slot;
+}
+
+/* Double the instruction cache */
+static bool uzl_trace_grow(uzl_trace_t *trace)
+{
+  uzl_trace_ent_t *old_ent = trace->ent;
+  uint64_t old_cap = trace->ent_cap;
+  uint64_t idx;
+
+  trace->ent = calloc(old_cap * 2, sizeof(uzl_trace_ent_t));
+  if(trace->ent == NULL)
+  {
+    trace->ent = old_ent;
+    return false;
+  }
+  trace->ent_cap = old_cap * 2;
+  for(idx = 0; idx < old_cap; idx++)
+  {
+    if(old_ent[idx].insn != NULL)
+      trace->ent[uzl_trace_slot(trace, old_ent[idx].addr)] = old_ent[idx];
+  }
+  free(old_ent);
+  return true;
+}
+
+/* Decoded instruction at addr, disassembled once */
+static cs_insn *uzl_trace_insn(uzl_trace_t *trace, uc_engine *uc,
+                               uint64_t addr, uint32_t size)
+{
+  uint64_t slot = uzl_trace_slot(trace, addr);
+  if(trace->ent[slot].insn != NULL)
+    return trace->ent[slot].insn;
+
+  /* Table stays at most half full */
+  if((trace->ent_cnt + 1) * 2 > trace->ent_cap)
+  {
+    if(!uzl_trace_grow(trace))
+      return NULL;
+    slot = uzl_trace_slot(trace, addr);
+  }
+
+  cs_insn *insn = cs_malloc(trace->handle);
+  if(insn == NULL)
+    return NULL;
+
+  /* Unreadable code is not cached, the next execution reads it again */
+  const uint8_t *code = trace->code;
+  size_t code_size = size < sizeof(trace->code) ? size : sizeof(trace->code);
+  uint64_t code_addr = addr;
+  if(uc_mem_read(uc, addr, trace->code, code_size) != UC_ERR_OK)
+  {
+    cs_free(insn, 1);
+    return NULL;
+  }
+
+  /* Undecodable bytes are kept with id 0 */
+  if(!cs_disasm_iter(trace->handle, &code, &code_size, &code_addr, insn))
+  {
+    memset(insn, 0, sizeof(cs_insn));
+    insn->address = addr;
+    insn->size = size < sizeof(insn->bytes) ? size : sizeof(insn->bytes);
+    memcpy(insn->bytes, trace->code, insn->size);
+  }
+
+  trace->ent[slot].addr = addr;
+  trace->ent[slot].insn = insn;
+  trace->ent_cnt++;
+  return insn;
+}
+
+/* Instruction callback, only copies a record into the ring */
+static void uzl_trace_hook_code(uc_engine *uc, uint64_t address, uint32_t size,
+                                void *user_data)
+{
+  uzl_trace_t *trace = (uzl_trace_t *) user_data;
+  cs_insn *insn = uzl_trace_insn(trace, uc, address, size);
+  if(insn == NULL)
+    return;
+
+  /* Wait for the writer rather than drop records, stop if it failed */
+  uint64_t head = trace->head;
+  while(head - __atomic_load_n(&(trace->tail), __ATOMIC_ACQUIRE) ==
+        UZL_TRACE_RING_SIZE)
+  {
+    if(__atomic_load_n(&(trace->failed), __ATOMIC_ACQUIRE))
+    {
+      uc_emu_stop(uc);
+      return;
+    }
+    sched_yield();
+  }
+
+  uzl_trace_rec_t *rec = &(trace->ring[head & (UZL_TRACE_RING_SIZE - 1)]);
+  rec->addr = address;
+  rec->id = insn->id;
+  rec->size = insn->size;
+  rec->pad = 0;
+  memcpy(rec->bytes, insn->bytes, sizeof(rec->bytes));
+  __atomic_store_n(&(trace->head), head + 1, __ATOMIC_RELEASE);
+}
+
+/* Flush ring to disk until stopped and drained */
+static void *uzl_trace_writer(void *arg)
+{
+  uzl_trace_t *trace = (uzl_trace_t *) arg;
+  uint64_t tail = trace->tail;
+
+  while(true)
+  {
+    bool stop = __atomic_load_n(&(trace->stop), __ATOMIC_ACQUIRE);
+    uint64_t head = __atomic_load_n(&(trace->head), __ATOMIC_ACQUIRE);
+    if(head == tail)
+    {
+      if(stop)
+        break;
+      usleep(1000);
+      continue;
+    }
+
+    /* Contiguous run up to the end of the ring */
+    uint64_t idx = tail & (UZL_TRACE_RING_SIZE - 1);
+    uint64_t cnt = head - tail;
+    if(cnt > UZL_TRACE_RING_SIZE - idx)
+      cnt = UZL_TRACE_RING_SIZE - idx;
+
+    uint8_t *dat = (uint8_t *) &(trace->ring[idx]);
+    uint64_t len = cnt * sizeof(uzl_trace_rec_t);
+    while(len > 0)
+    {
+      ssize_t ret = write(trace->fd, dat, len);
+      if(ret < 0 && errno == EINTR)
+        continue;
+
+      /* Records stay in the ring, the hook stops once it is full */
+      if(ret <= 0)
+      {
+        printf("uzl_trace_writer: cannot write trace after %lu records\n",
+               tail);
+        __atomic_store_n(&(trace->failed), true, __ATOMIC_RELEASE);
+        return NULL;
+      }
+      dat += ret;
+      len -= ret;
+    }
+
+    tail += cnt;
+    __atomic_store_n(&(trace->tail), tail, __ATOMIC_RELEASE);
+  }
+  return NULL;
+}
+
+/* Start tracing every executed instruction to the trace file */
+bool uzl_trace_init(uzl_trace_t **trace, pzl_ctx_t *pzl_ctx, uc_engine *uc,
+                    uzl_opts_t *opts)
+{
+  uint32_t arch, mode;
+  uzl_trace_t *new_trace = calloc(1, sizeof(uzl_trace_t));
+  if(new_trace == NULL)
+  {
+    printf("uzl_trace_init: cannot allocate trace\n");
+    return false;
+  }
+  new_trace->uc = uc;
+  new_trace->fd = -1;
+
+  /* Capstone */
+  if(!uzl_get_cs_arch(pzl_ctx, &arch) || !uzl_get_cs_mode(pzl_ctx, &mode) ||
+     cs_open(arch, mode, &(new_trace->handle)) != CS_ERR_OK)
+  {
+    printf("uzl_trace_init: cannot initialise capstone\n");
+    free(new_trace);
+    return false;
+  }
+  new_trace->cs_open = true;
+
+  /* Instruction cache and ring */
+  new_trace->ent_cap = UZL_TRACE_CACHE_SIZE;
+  new_trace->ent = calloc(new_trace->ent_cap, sizeof(uzl_trace_ent_t));
+  new_trace->ring = malloc(UZL_TRACE_RING_SIZE * sizeof(uzl_trace_rec_t));
+  if(new_trace->ent == NULL || new_trace->ring == NULL)
+  {
+    printf("uzl_trace_init: cannot allocate trace buffers\n");
+    uzl_trace_free(new_trace);
+    return false;
+  }
+
+  /* Output */
+  char *file_name = opts->trace_file_name ? opts->trace_file_name :
+                                            UZL_TRACE_FILE;
+  new_trace->fd = open(file_name, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if(new_trace->fd < 0)
+  {
+    printf("uzl_trace_init: cannot open %s\n", file_name);
+    uzl_trace_free(new_trace);
+    return false;
+  }
+
+  /* Writer */
+  if(pthread_create(&(new_trace->writer), NULL, uzl_trace_writer,
+                    new_trace) != 0)
+  {
+    printf("uzl_trace_init: cannot start writer\n");
+    uzl_trace_free(new_trace);
+    return false;
+  }
+  new_trace->running = true;
+
+  /* Hook every instruction */
+  if(uc_hook_add(uc, &(new_trace->hook), UC_HOOK_CODE, uzl_trace_hook_code,
+                 new_trace, 1, 0) != UC_ERR_OK)
+  {
+    printf("uzl_trace_init: cannot register trace hook\n");
+    uzl_trace_free(new_trace);
+    return false;
+  }
+  new_trace->hooked = true;
+
+  *trace = new_trace;
+  return true;
+}
+
+/* Stop tracing, flush remaining records and free trace */
+bool uzl_trace_free(uzl_trace_t *trace)
+{
+  if(trace == NULL)
+    return false;
+
+  if(trace->hooked)
+    uc_hook_del(trace->uc, trace->hook);
+  if(trace->running)
+  {
+    __atomic_store_n(&(trace->stop), true, __ATOMIC_RELEASE);
+    pthread_join(trace->writer, NULL);
+  }
+  if(trace->failed)
+    printf("uzl_trace_free: trace is incomplete\n");
+  if(trace->fd >= 0)
+    close(trace->fd);
+
+  uint64_t idx;
+  for(idx = 0; trace->ent != NULL && idx < trace->ent_cap; idx++)
+  {
+    if(trace->ent[idx].insn != NULL)
+      cs_free(trace->ent[idx].insn, 1);
+  }
+  free(trace->ent);
+  free(trace->ring);
+  if(trace->cs_open)
+    cs_close(&(trace->handle));
+  free(trace);
+  return true;
+}
@@ -0,0 +1,93 @@
+#include <time.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <uuzzle.h>
+#include <unicorn.h>
+
+
+/* Monotonic clock in nanoseconds */
+static uint64_t uzl_watch_now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* Stop the run, address is a block of the loop it is stuck in */
+static void uzl_watch_trip(uzl_watch_t *watch, uint64_t address)
+{
+  if(watch->hung)
+    return;
+  watch->hung = true;
+  watch->hang_pc = address;
+  uc_emu_stop(watch->uc);
+}
+
+/* Block callback, the clock is only read every UZL_WATCH_CLOCK_BLOCKS */
+static void uzl_watch_hook_block(uc_engine *uc, uint64_t address,
+                                 uint32_t size, void *user_data)
+{
+  uzl_watch_t *watch = (uzl_watch_t *) user_data;
+
+  watch->blocks++;
+  if(watch->budget != 0 && watch->blocks > watch->budget)
+    uzl_watch_trip(watch, address);
+  else if(watch->timeout != 0 &&
+          (watch->blocks & (UZL_WATCH_CLOCK_BLOCKS - 1)) == 0 &&
+          uzl_watch_now() > watch->deadline)
+    uzl_watch_trip(watch, address);
+}
+
+/* Bound runs by --timeout and --budget, nothing is hooked without either */
+bool uzl_watch_init(uzl_watch_t **watch, uc_engine *uc, uzl_opts_t *opts)
+{
+  uzl_watch_t *new_watch = calloc(1, sizeof(uzl_watch_t));
+  if(new_watch == NULL)
+  {
+    printf("uzl_watch_init: cannot allocate watchdog\n");
+    return false;
+  }
+  new_watch->uc = uc;
+  new_watch->timeout = opts->timeout * 1000000;
+  new_watch->budget = opts->budget;
+
+  if(new_watch->timeout != 0 || new_watch->budget != 0)
+  {
+    if(uc_hook_add(uc, &(new_watch->hook), UC_HOOK_BLOCK,
+                   uzl_watch_hook_block, new_watch, 1, 0) != UC_ERR_OK)
+    {
+      printf("uzl_watch_init: cannot register block hook\n");
+      free(new_watch);
+      return false;
+    }
+    new_watch->hooked = true;
+  }
+
+  uzl_watch_reset(new_watch);
+  *watch = new_watch;
+  return true;
+}
+
+/* Arm for the next run, call right before uc_emu_start */
+bool uzl_watch_reset(uzl_watch_t *watch)
+{
+  watch->blocks = 0;
+  watch->hung = false;
+  watch->hang_pc = 0;
+  if(watch->timeout != 0)
+    watch->deadline = uzl_watch_now() + watch->timeout;
+  return true;
+}
+
+/* Remove block hook */
+bool uzl_watch_free(uzl_watch_t *watch)
+{
+  if(watch == NULL)
+    return false;
+
+  if(watch->hooked)
+    uc_hook_del(watch->uc, watch->hook);
+  free(watch);
+  return true;
+}